@@ -4,3 +4,7 @@
 export ANDROID_NDK_HOME=/usr/local/android-ndks/android-ndk-r16b
 export NDK_ROOT=/usr/local/android-ndks/android-ndk-r16b
 python mars/build_android.py 1 armeabi
+
+# CXX20_COROUTINE is off in the builds above; compile its C++20 sources, and a signals2 user beside them, on the host
+cmake -S mars/comm -B cmake_build/cxx20_coroutine -DCXX20_COROUTINE=ON
+cmake --build cmake_build/cxx20_coroutine --target coroutine/co_reactor.cc.o coroutine/co_socket.cc.o anr.cc.o
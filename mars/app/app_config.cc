@@ -0,0 +1,44 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * app_config.cc
+ */
+
+#include "mars/app/app_config.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace mars {
+namespace app {
+
+size_t ConfigRegistry::Register(const std::string& _name, const std::type_index& _type) {
+    // leaked, keys may still be resolved from static destructors
+    static std::mutex* mutex = new std::mutex();
+    static std::map<std::pair<std::string, std::type_index>, size_t>* slots =
+        new std::map<std::pair<std::string, std::type_index>, size_t>();
+
+    std::lock_guard<std::mutex> lock(*mutex);
+    auto key = std::make_pair(_name, _type);
+    auto it = slots->find(key);
+    if (it != slots->end()) {
+        return it->second;
+    }
+    size_t index = slots->size();
+    (*slots)[key] = index;
+    return index;
+}
+
+}  // namespace app
+}  // namespace mars
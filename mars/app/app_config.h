@@ -0,0 +1,87 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * app_config.h
+ *
+ * Typed config keys and the snapshot AppManager publishes them in.
+ */
+
+#ifndef MMNET_APP_CONFIG_H
+#define MMNET_APP_CONFIG_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+namespace mars {
+namespace app {
+
+// Every (key name, value type) pair of the process gets a dense slot index, the same for all AppManagers.
+class ConfigRegistry {
+ public:
+    static size_t Register(const std::string& _name, const std::type_index& _type);
+};
+
+// Typed handle of a config key. Its slot is resolved once, on first use, so keys can be plain constants
+// in headers without any static initialization.
+template <typename T>
+class ConfigKey {
+ public:
+    constexpr ConfigKey(const char* _name, T _default_value)
+    : name_(_name), default_value_(_default_value), index_(kUnresolved) {
+    }
+
+    const char* Name() const {
+        return name_;
+    }
+    const T& DefaultValue() const {
+        return default_value_;
+    }
+    size_t Index() const {
+        size_t index = index_.load(std::memory_order_relaxed);
+        if (kUnresolved == index) {
+            index = ConfigRegistry::Register(name_, typeid(T));
+            index_.store(index, std::memory_order_relaxed);
+        }
+        return index;
+    }
+
+ private:
+    ConfigKey(const ConfigKey&);
+    ConfigKey& operator=(const ConfigKey&);
+
+ private:
+    static const size_t kUnresolved = (size_t)-1;
+
+    const char* name_;
+    T default_value_;
+    mutable std::atomic<size_t> index_;
+};
+
+// Immutable once published: values[slot] is the value of that key, empty if it was never set.
+struct ConfigSnapshot {
+    std::vector<std::shared_ptr<const void>> values;
+    // the slots of the keys set so far, by name and then type, for the string-keyed reads
+    std::map<std::string, std::vector<std::pair<std::type_index, size_t>>> slots;
+};
+
+}  // namespace app
+}  // namespace mars
+
+#endif  // MMNET_APP_CONFIG_H
@@ -0,0 +1,94 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * app_config_unittest.cc
+ */
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mars/app/app_manager.h"
+
+using namespace mars::app;
+
+static const ConfigKey<int> kConfigUnittestInt("UnittestInt", 500);
+static const ConfigKey<bool> kConfigUnittestBool("UnittestBool", false);
+
+TEST(app_config, typed_keys) {
+    auto context = mars::boot::make_context_ptr("app_config_unittest_typed_keys");
+    AppManager manager(context.get());
+
+    EXPECT_EQ(500, manager.GetConfig(kConfigUnittestInt));
+    EXPECT_FALSE(manager.GetConfig(kConfigUnittestBool));
+
+    manager.SetConfig("UnittestInt", 1000);
+    manager.SetConfig("UnittestBool", true);
+    EXPECT_EQ(1000, manager.GetConfig(kConfigUnittestInt));
+    EXPECT_TRUE(manager.GetConfig(kConfigUnittestBool));
+    EXPECT_EQ(1000, manager.GetConfig<int>("UnittestInt", 0));
+
+    // a value of another type under the same name is a different key
+    manager.SetConfig("UnittestInt", std::string("2000"));
+    EXPECT_EQ(1000, manager.GetConfig(kConfigUnittestInt));
+    EXPECT_EQ("2000", manager.GetConfig<std::string>("UnittestInt", ""));
+    EXPECT_EQ(0, manager.GetConfig<int>("UnittestNeverSet", 0));
+}
+
+TEST(app_config, subscribers) {
+    auto context = mars::boot::make_context_ptr("app_config_unittest_subscribers");
+    AppManager manager(context.get());
+
+    std::vector<std::string> changed;
+    int id = manager.SubscribeConfig([&changed, &manager](const std::string& _key) {
+        // the new value is already published when subscribers run
+        EXPECT_EQ(42, manager.GetConfig(kConfigUnittestInt));
+        changed.push_back(_key);
+    });
+    manager.SetConfig("UnittestInt", 42);
+    manager.UnsubscribeConfig(id);
+    manager.SetConfig("UnittestBool", true);
+
+    ASSERT_EQ(1u, changed.size());
+    EXPECT_EQ("UnittestInt", changed[0]);
+}
+
+TEST(app_config, reads_while_set) {
+    auto context = mars::boot::make_context_ptr("app_config_unittest_reads_while_set");
+    AppManager manager(context.get());
+    manager.SetConfig("UnittestInt", 1);
+
+    // readers see some published value, never a freed snapshot, while SetConfig keeps replacing it
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.push_back(std::thread([&stop, &manager]() {
+            while (!stop) {
+                int typed = manager.GetConfig(kConfigUnittestInt);
+                int named = manager.GetConfig<int>("UnittestInt", 0);
+                EXPECT_LE(1, typed);
+                EXPECT_LE(1, named);
+            }
+        }));
+    }
+    for (int value = 2; value <= 2000; ++value) {
+        manager.SetConfig("UnittestInt", value);
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(2000, manager.GetConfig<int>("UnittestInt", 0));
+}
@@ -22,8 +22,15 @@ using namespace mars::boot;
 namespace mars {
 namespace app {
 
+#ifdef ANDROID
+static const ConfigKey<int> kConfigAlarmStartWakeupLook(kKeyAlarmStartWakeupLook, kAlarmStartWakeupLook);
+static const ConfigKey<int> kConfigAlarmOnWakeupLook(kKeyAlarmOnWakeupLook, kAlarmOnWakeupLook);
+#endif
+
 AppManager::AppManager(Context* context) : context_(context) {
     xinfo_function(TSF "mars2 context id %_", context_->GetContextId());
+    __PublishConfig(std::unique_ptr<ConfigSnapshot>(new ConfigSnapshot()));
+    SubscribeConfig(std::bind(&AppManager::__CheckCommSetting, this, std::placeholders::_1));
 }
 
 AppManager::~AppManager() {
@@ -178,15 +185,35 @@ void AppManager::__CheckCommSetting(const std::string& key) {
 #ifdef ANDROID
     xinfo2(TSF "AppConfig CheckCommSetting key:%_", key);
     if (key == kKeyAlarmStartWakeupLook) {
-        int wakeup = GetConfig<int>(kKeyAlarmStartWakeupLook, kAlarmStartWakeupLook);
+        int wakeup = GetConfig(kConfigAlarmStartWakeupLook);
         comm::Alarm::SetStartAlarmWakeLock(wakeup);
     } else if (key == kKeyAlarmOnWakeupLook) {
-        int wakeup = GetConfig<int>(kKeyAlarmOnWakeupLook, kAlarmOnWakeupLook);
+        int wakeup = GetConfig(kConfigAlarmOnWakeupLook);
         comm::Alarm::SetOnAlarmWakeLock(wakeup);
     }
 #endif
 }
 
+int AppManager::SubscribeConfig(const ConfigSubscriber& _subscriber) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int id = ++next_subscriber_id_;
+    config_subscribers_[id] = _subscriber;
+    return id;
+}
+
+void AppManager::UnsubscribeConfig(int _id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_subscribers_.erase(_id);
+}
+
+void AppManager::__PublishConfig(std::unique_ptr<ConfigSnapshot> _snapshot) {
+    config_snapshot_.store(_snapshot.get(), std::memory_order_release);
+    if (config_current_) {
+        config_retired_.push_back(std::move(config_current_));
+    }
+    config_current_ = std::move(_snapshot);
+}
+
 // #if TARGET_OS_IPHONE
 void AppManager::ClearProxyInfo() {
     std::lock_guard<std::timed_mutex> lock(slproxymutex_);
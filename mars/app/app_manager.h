@@ -5,12 +5,16 @@
 #ifndef MMNET_APP_MANAGER_H
 #define MMNET_APP_MANAGER_H
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
 #include <memory>
 #include <thread>
-#include <typeindex>
-#include <unordered_map>
+#include <vector>
 
 #include "mars/app/app.h"
+#include "mars/app/app_config.h"
 //#include "mars/boost/any.hpp"
 #include "mars/boot/base_manager.h"
 #include "mars/boot/context.h"
@@ -21,6 +25,8 @@
 namespace mars {
 namespace app {
 
+typedef std::function<void(const std::string& _key)> ConfigSubscriber;
+
 class AppManager : public mars::boot::BaseManager {
  public:
     explicit AppManager(mars::boot::Context* context);
@@ -46,31 +52,63 @@ class AppManager : public mars::boot::BaseManager {
     void ClearProxyInfo();
     //    #endif
 
+    // An index into the published snapshot, no lock taken, safe to call on any hot path.
+    template <typename T>
+    T GetConfig(const ConfigKey<T>& key) {
+        const ConfigSnapshot* snapshot = config_snapshot_.load(std::memory_order_acquire);
+        size_t index = key.Index();
+        if (index >= snapshot->values.size() || !snapshot->values[index]) {
+            return key.DefaultValue();
+        }
+        return *static_cast<const T*>(snapshot->values[index].get());
+    }
+
+    // Looks the name up in the snapshot itself, a key never set is not in it.
     template <typename T>
     T GetConfig(const std::string& key, T default_value) {
-        xinfo2(TSF "AppConfig GetConfig key:%_, default value:%_", key, default_value);
-        std::unique_lock<std::mutex> lock(mutex_);
-        auto it = config_.find(key);
-        auto type_it = types_.find(key);
-        if (it == config_.end() || type_it == types_.end() || types_.at(key).empty()
-            || types_.at(key) != std::type_index(typeid(T)).name()) {
-            xwarn2(TSF "AppConfig GetConfig return default value. ");
+        const ConfigSnapshot* snapshot = config_snapshot_.load(std::memory_order_acquire);
+        auto it = snapshot->slots.find(key);
+        if (it == snapshot->slots.end()) {
             return default_value;
         }
-        // return boost::any_cast<T>(it->second);
-        return *static_cast<T*>(it->second);
+        for (auto& slot : it->second) {
+            if (slot.first == std::type_index(typeid(T)) && snapshot->values[slot.second]) {
+                return *static_cast<const T*>(snapshot->values[slot.second].get());
+            }
+        }
+        return default_value;
     }
 
     template <typename T>
     void SetConfig(const std::string& key, T value) {
         xinfo2(TSF "AppConfig SetConfig key:%_, value:%_", key, value);
+        size_t index = ConfigRegistry::Register(key, typeid(T));
         std::unique_lock<std::mutex> lock(mutex_);
-        config_[key] = new T(value);
-        types_[key] = std::type_index(typeid(T)).name();
+        std::unique_ptr<ConfigSnapshot> snapshot(new ConfigSnapshot(*config_current_));
+        if (snapshot->values.size() <= index) {
+            snapshot->values.resize(index + 1);
+        }
+        snapshot->values[index] = std::make_shared<const T>(value);
+        auto& slots = snapshot->slots[key];
+        if (std::find(slots.begin(), slots.end(), std::make_pair(std::type_index(typeid(T)), index)) == slots.end()) {
+            slots.push_back(std::make_pair(std::type_index(typeid(T)), index));
+        }
+        __PublishConfig(std::move(snapshot));
+        std::vector<ConfigSubscriber> subscribers;
+        for (auto& item : config_subscribers_) {
+            subscribers.push_back(item.second);
+        }
         lock.unlock();
-        __CheckCommSetting(key);
+
+        for (auto& subscriber : subscribers) {
+            subscriber(key);
+        }
     }
 
+    // _subscriber is called with the key after every SetConfig, on the thread that set it.
+    int SubscribeConfig(const ConfigSubscriber& _subscriber);
+    void UnsubscribeConfig(int _id);
+
     void __CheckCommSetting(const std::string& key);
 
  private:
@@ -82,10 +120,15 @@ class AppManager : public mars::boot::BaseManager {
     uint64_t slproxytimetick_ = gettickcount();
     int slproxycount_ = 0;
 
+    void __PublishConfig(std::unique_ptr<ConfigSnapshot> _snapshot);
+
     std::mutex mutex_;
-    // std::unordered_map<std::string, boost::any> config_;
-    std::unordered_map<std::string, void*> config_;
-    std::unordered_map<std::string, std::string> types_;
+    std::atomic<const ConfigSnapshot*> config_snapshot_;
+    std::unique_ptr<ConfigSnapshot> config_current_;
+    // replaced ones, never freed while the manager lives: a reader may still be in one, and config changes are rare
+    std::vector<std::unique_ptr<ConfigSnapshot>> config_retired_;
+    std::map<int, ConfigSubscriber> config_subscribers_;
+    int next_subscriber_id_ = 0;
 };
 
 AppManager* GetDefaultAppManager();
@@ -21,6 +21,7 @@
 #define BASEPRJEVENT_H_
 
 #include "boost/signals2.hpp"
+#include "mars/comm/event_signal.h"
 
 extern boost::signals2::signal<void()>& GetSignalOnCreate();
 extern boost::signals2::signal<void(int _encoder_version)>& GetSignalOnInitBeforeOnCreate();
@@ -29,10 +30,11 @@ GetSignalOnInitBeforeOnCreateV2();
 extern boost::signals2::signal<void()>& GetSignalOnDestroy();
 extern boost::signals2::signal<void(int _sig)>& GetSignalOnSingalCrash();
 extern boost::signals2::signal<void()>& GetSignalOnExceptionCrash();
-extern boost::signals2::signal<void(bool _isForeground)>& GetSignalOnForeground();
-extern boost::signals2::signal<void()>& GetSignalOnNetworkChange();
+// raised often enough that emitting has to be cheap
+extern mars::comm::EventSignal<void(bool _isForeground)>& GetSignalOnForeground();
+extern mars::comm::EventSignal<void()>& GetSignalOnNetworkChange();
 
-extern boost::signals2::signal<void(const char* _tag, int64_t _send, int64_t _recv)>& GetSignalOnNetworkDataChange();
-extern boost::signals2::signal<void(int64_t _id)>& GetSignalOnAlarm();
+extern mars::comm::EventSignal<void(const char* _tag, int64_t _send, int64_t _recv)>& GetSignalOnNetworkDataChange();
+extern mars::comm::EventSignal<void(int64_t _id)>& GetSignalOnAlarm();
 
 #endif /* BASEPRJEVENT_H_ */
@@ -20,6 +20,7 @@
 #include "mars/baseevent/base_logic.h"
 #include "mars/baseevent/baseprjevent.h"
 #include "mars/comm/bootregister.h"
+#include "mars/comm/network/network_state.h"
 #include "mars/comm/platform_comm.h"
 #include "mars/comm/thread/lock.h"
 #include "mars/comm/time_utils.h"
@@ -61,6 +62,7 @@ void OnNetworkChange() {
 #ifdef __APPLE__
     FlushReachability();
 #endif
+    NetworkState::Instance().Invalidate();
     OnPlatformNetworkChange();
     GetSignalOnNetworkChange()();
 }
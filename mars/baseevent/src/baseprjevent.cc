@@ -49,22 +49,22 @@ boost::signals2::signal<void()>& GetSignalOnExceptionCrash() {
     return SignalOnExceptionCrash;
 }
 
-boost::signals2::signal<void(bool _isForeground)>& GetSignalOnForeground() {
-    static boost::signals2::signal<void(bool _isForeground)> SignalOnForeground;
+mars::comm::EventSignal<void(bool _isForeground)>& GetSignalOnForeground() {
+    static mars::comm::EventSignal<void(bool _isForeground)> SignalOnForeground;
     return SignalOnForeground;
 }
 
-boost::signals2::signal<void()>& GetSignalOnNetworkChange() {
-    static boost::signals2::signal<void()> SignalOnNetworkChange;
+mars::comm::EventSignal<void()>& GetSignalOnNetworkChange() {
+    static mars::comm::EventSignal<void()> SignalOnNetworkChange;
     return SignalOnNetworkChange;
 }
 
-boost::signals2::signal<void(const char* _tag, int64_t _send, int64_t _recv)>& GetSignalOnNetworkDataChange() {
-    static boost::signals2::signal<void(const char* _tag, int64_t _send, int64_t _recv)> SignalOnNetworkDataChange;
+mars::comm::EventSignal<void(const char* _tag, int64_t _send, int64_t _recv)>& GetSignalOnNetworkDataChange() {
+    static mars::comm::EventSignal<void(const char* _tag, int64_t _send, int64_t _recv)> SignalOnNetworkDataChange;
     return SignalOnNetworkDataChange;
 }
 
-boost::signals2::signal<void(int64_t _id)>& GetSignalOnAlarm() {
-    static boost::signals2::signal<void(int64_t _id)> SignalOnAlarm;
+mars::comm::EventSignal<void(int64_t _id)>& GetSignalOnAlarm() {
+    static mars::comm::EventSignal<void(int64_t _id)> SignalOnAlarm;
     return SignalOnAlarm;
 }
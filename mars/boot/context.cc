@@ -12,6 +12,7 @@ namespace boot {
 std::map<std::string, Context*> Context::s_context_map_;
 std::recursive_mutex Context::s_mutex_;
 std::atomic<int> Context::s_context_index;
+std::map<std::string, size_t> Context::s_manager_slot_map_;
 
 Context* Context::CreateContext(const std::string& context_id) {
     S_SCOPED_LOCK();
@@ -47,6 +48,9 @@ void Context::DestroyContext(Context* context) {
 }
 
 Context::Context() {
+    for (auto& slot : manager_slots_) {
+        slot.store(NULL, std::memory_order_relaxed);
+    }
     Init();
 }
 
@@ -71,6 +75,24 @@ int Context::UnInit() {
     return 0;
 }
 
+size_t Context::__ManagerSlotOfName(const std::string& clazz_name) {
+    S_SCOPED_LOCK();
+    auto iter = s_manager_slot_map_.find(clazz_name);
+    if (iter != s_manager_slot_map_.end()) {
+        return iter->second;
+    }
+    size_t slot = s_manager_slot_map_.size();
+    s_manager_slot_map_[clazz_name] = slot;
+    return slot;
+}
+
+void Context::__PublishManager(const std::string& clazz_name, void* mgr) {
+    size_t slot = __ManagerSlotOfName(clazz_name);
+    if (slot < kManagerSlotCount) {
+        manager_slots_[slot].store(mgr, std::memory_order_release);
+    }
+}
+
 void Context::SetContextId(const std::string& context_id) {
     context_id_ = context_id;
 }
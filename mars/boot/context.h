@@ -8,9 +8,10 @@
 #include <atomic>
 #include <map>
 #include <mutex>
+#include <memory>
 #include <string>
+#include <typeinfo>
 #include <vector>
-#include <memory>
 
 #include "base_manager.h"
 
@@ -40,10 +41,17 @@ class Context {
         S_SCOPED_LOCK();
         std::string clazz_name = ((BaseManager*)mgr)->GetName();
         manager_map_[clazz_name] = mgr;
+        __PublishManager(clazz_name, mgr);
     }
 
+    // wait-free unless more manager types are looked up than there are slots.
     template <typename T, typename std::enable_if<std::is_base_of<BaseManager, T>::value>::type* = nullptr>
     T* GetManager() {
+        size_t slot = __ManagerSlot<T>();
+        if (slot < kManagerSlotCount) {
+            return (T*)manager_slots_[slot].load(std::memory_order_acquire);
+        }
+
         S_SCOPED_LOCK();
         std::string clazz_name = typeid(T).name();
         // when context delete, then manager map will be null.
@@ -59,6 +67,7 @@ class Context {
         std::string clazz_name = ((BaseManager*)mgr)->GetName();
         if (manager_map_.find(clazz_name) != manager_map_.end()) {
             manager_map_.erase(clazz_name);
+            __PublishManager(clazz_name, NULL);
         }
     }
 
@@ -69,6 +78,7 @@ class Context {
     }
 
     void* GetManagerByName(std::string name) {
+        S_SCOPED_LOCK();
         if (java_clazz_name_c_clazz_name_map_.find(name) != java_clazz_name_c_clazz_name_map_.end()) {
             std::string clazz_name = java_clazz_name_c_clazz_name_map_[name];
             if (manager_map_.find(clazz_name) != manager_map_.end()) {
@@ -85,17 +95,32 @@ class Context {
         RemoveManager(mgr);
     }
 
+ private:
+    static const size_t kManagerSlotCount = 32;
+
+    // Dense index of a manager type, the same for every context. GetName() of a manager is the typeid name
+    // of its class, so a manager added through the name based path lands in the slot GetManager<T> reads.
+    template <typename T>
+    static size_t __ManagerSlot() {
+        static const size_t slot = __ManagerSlotOfName(typeid(T).name());
+        return slot;
+    }
+    static size_t __ManagerSlotOfName(const std::string& clazz_name);
+    void __PublishManager(const std::string& clazz_name, void* mgr);
+
  private:
     bool is_init_ = false;
     std::string context_id_;
     std::recursive_mutex mutex_;
     std::map<std::string, void*> manager_map_;
     std::map<std::string, std::string> java_clazz_name_c_clazz_name_map_;
+    std::atomic<void*> manager_slots_[kManagerSlotCount];
 
  private:
     static std::map<std::string, Context*> s_context_map_;
     static std::recursive_mutex s_mutex_;
     static std::atomic<int> s_context_index;
+    static std::map<std::string, size_t> s_manager_slot_map_;
 };
 
 template <class... Args>
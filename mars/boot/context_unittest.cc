@@ -0,0 +1,102 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * context_unittest.cc
+ *
+ * Manager lookup by type slot and by name, alone and while other threads add and remove managers.
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "context.h"
+#include "gtest/gtest.h"
+
+using namespace mars::boot;
+
+class FooManager : public BaseManager {
+ public:
+    std::string GetName() override {
+        return typeid(FooManager).name();
+    }
+};
+
+class BarManager : public BaseManager {
+ public:
+    std::string GetName() override {
+        return typeid(BarManager).name();
+    }
+};
+
+TEST(context, get_manager) {
+    auto context = make_context_ptr("context_unittest_get_manager");
+    auto other = make_context_ptr("context_unittest_get_manager_other");
+    FooManager foo;
+    BarManager bar;
+
+    EXPECT_EQ(nullptr, context->GetManager<FooManager>());
+
+    context->AddManager(&foo);
+    other->AddManagerWithName("com.tencent.mars.BarManager", &bar);
+    EXPECT_EQ(&foo, context->GetManager<FooManager>());
+    EXPECT_EQ(nullptr, context->GetManager<BarManager>());
+    EXPECT_EQ(&bar, other->GetManager<BarManager>());
+    EXPECT_EQ(nullptr, other->GetManager<FooManager>());
+    EXPECT_EQ(&bar, other->GetManagerByName("com.tencent.mars.BarManager"));
+
+    context->RemoveManager(&foo);
+    other->RemoveManagerWithName("com.tencent.mars.BarManager", &bar);
+    EXPECT_EQ(nullptr, context->GetManager<FooManager>());
+    EXPECT_EQ(nullptr, other->GetManager<BarManager>());
+    EXPECT_EQ(nullptr, other->GetManagerByName("com.tencent.mars.BarManager"));
+}
+
+TEST(context, lookup_while_managers_change) {
+    auto context = make_context_ptr("context_unittest_concurrent");
+    FooManager foo;
+    BarManager bar;
+    context->AddManagerWithName("com.tencent.mars.FooManager", &foo);
+
+    // readers see foo throughout, and bar either there or not, while bar comes and goes
+    Context* raw = context.get();
+    std::atomic<bool> stop(false);
+    std::atomic<int> wrong(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.push_back(std::thread([raw, &foo, &bar, &stop, &wrong]() {
+            while (!stop.load()) {
+                if (raw->GetManager<FooManager>() != &foo
+                    || raw->GetManagerByName("com.tencent.mars.FooManager") != &foo) {
+                    ++wrong;
+                }
+                BarManager* got = raw->GetManager<BarManager>();
+                if (nullptr != got && &bar != got) {
+                    ++wrong;
+                }
+            }
+        }));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        context->AddManager(&bar);
+        context->RemoveManager(&bar);
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(0, wrong.load());
+    EXPECT_EQ(nullptr, context->GetManager<BarManager>());
+    context->RemoveManagerWithName("com.tencent.mars.FooManager", &foo);
+}
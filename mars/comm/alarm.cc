@@ -229,23 +229,21 @@ void Alarm::OnAlarm(const MessageQueue::MessagePost_t& _id, MessageQueue::Messag
     seq_ = INVAILD_SEQ;
     endtime_ = curtime;
 
-    if (inthread_)
-        runthread_.start();
-    else
+    if (inthread_) {
+        if (!run_job_ || !run_job_->IsRunning())
+            run_job_ = Executor::Default().Post(boost::bind(&Alarm::__Run, this), "alarm");
+    } else {
         MessageQueue::AsyncInvoke(boost::bind(&Alarm::__Run, this),
                                   (MessageQueue::MessageTitle_t)this,
                                   reg_async_.Get(),
                                   "Alarm::__Run");
+    }
 }
 
 void Alarm::__Run() {
     target_->run();
 }
 
-const Thread& Alarm::RunThread() const {
-    return runthread_;
-}
-
 #ifdef ANDROID
 void Alarm::__StartWakeLock() {
     static WakeUpLock wakelock;
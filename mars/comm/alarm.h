@@ -23,6 +23,7 @@
 #include <boost/bind.hpp>
 
 #include "boot/context.h"
+#include "comm/executor.h"
 #include "comm/xlogger/xlogger.h"
 #include "messagequeue/message_queue.h"
 
@@ -58,7 +59,6 @@ class Alarm {
     , target_(detail::transform(_op))
     , reg_async_(MessageQueue::InstallAsyncHandler(MessageQueue::GetDefMessageQueue()))
     , broadcast_msg_id_(MessageQueue::KNullPost)
-    , runthread_(boost::bind(&Alarm::__Run, this), "alarm")
     , inthread_(_inthread)
     , seq_(0)
     , status_(kInit)
@@ -80,7 +80,6 @@ class Alarm {
     , target_(detail::transform(_op))
     , reg_async_(MessageQueue::InstallAsyncHandler(_id))
     , broadcast_msg_id_(MessageQueue::KNullPost)
-    , runthread_(boost::bind(&Alarm::__Run, this), "alarm")
     , inthread_(false)
     , seq_(0)
     , status_(kInit)
@@ -100,7 +99,8 @@ class Alarm {
         Cancel();
         reg_.CancelAndWait();
         reg_async_.CancelAndWait();
-        runthread_.join();
+        if (run_job_)
+            run_job_->Join();
         delete target_;
 #ifdef ANDROID
         delete wakelock_;
@@ -125,8 +125,6 @@ class Alarm {
     int After() const;
     int64_t ElapseTime() const;
 
-    const Thread& RunThread() const;
-
  private:
     Alarm(const Alarm&);
     Alarm& operator=(const Alarm&);
@@ -139,7 +137,7 @@ class Alarm {
     Runnable* target_;
     MessageQueue::ScopeRegister reg_async_;
     MessageQueue::MessagePost_t broadcast_msg_id_;
-    Thread runthread_;
+    ExecutorJobPtr run_job_;
     bool inthread_;
 
     int64_t seq_;
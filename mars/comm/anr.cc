@@ -19,8 +19,8 @@
 
 #include "anr.h"
 
-#include <algorithm>
-#include <vector>
+#include <atomic>
+#include <thread>
 
 #ifndef _WIN32
 #define __STDC_FORMAT_MACROS
@@ -47,155 +47,269 @@ boost::signals2::signal<void(bool _iOS_style, const check_content& _content)>& G
 
 namespace {
 
-NO_DESTROY static std::vector<check_content> sg_check_heap;
-NO_DESTROY static Mutex sg_mutex;
-NO_DESTROY static Condition sg_cond;
-static bool sg_exit = false;
+/*
+ * every thread arms its scopes in a slot of its own: a few relaxed stores under a sequence
+ * counter, no lock and no wakeup. the checker thread scans all slots on its own cadence.
+ */
+static const int kMaxNestedDepth = 8;
+static const int64_t kScanInterval = 1000;  // ms
+
+}  // namespace
+
+namespace mars {
+namespace comm {
+
+struct anr_frame {
+    anr_frame()
+    : seq(0)
+    , file("")
+    , func("")
+    , line(0)
+    , timeout(0)
+    , call_id(0)
+    , extra_info(NULL)
+    , start_time(0)
+    , start_tickcount(0)
+    , end_time(0)
+    , reporting(false)
+    , seen_seq(0)
+    , used_cpu_time(0)
+    , reported(false) {
+    }
+
+    // odd while the owner thread writes, end_time 0 when not armed
+    std::atomic<uint32_t> seq;
+    std::atomic<const char*> file;
+    std::atomic<const char*> func;
+    std::atomic<int> line;
+    std::atomic<int> timeout;
+    std::atomic<int> call_id;
+    std::atomic<void*> extra_info;
+    std::atomic<uint64_t> start_time;
+    std::atomic<uint64_t> start_tickcount;
+    std::atomic<uint64_t> end_time;
+    // set by the checker while it reports the frame, disarming waits it out so extra_info stays valid
+    std::atomic<bool> reporting;
+
+    // only touched by the checker thread
+    uint32_t seen_seq;
+    uint64_t used_cpu_time;
+    bool reported;
+};
+
+}  // namespace comm
+}  // namespace mars
+
+namespace {
+
+struct anr_slot {
+    anr_slot() : next(NULL), in_use(false), tid(0) {
+    }
 
-static void __unregister_anr_impl(uintptr_t _ptr) {
-    for (std::vector<check_content>::iterator it = sg_check_heap.begin(); it != sg_check_heap.end(); ++it) {
-        if (it->ptr == _ptr) {
-            sg_check_heap.erase(it);
-            std::make_heap(sg_check_heap.begin(), sg_check_heap.end());
-            break;
+    anr_frame frames[kMaxNestedDepth];
+    anr_slot* next;
+    std::atomic<bool> in_use;
+    std::atomic<intmax_t> tid;
+};
+
+// slots are never freed, a thread exiting hands its slot to the next new thread
+static std::atomic<anr_slot*> sg_slots(NULL);
+
+static anr_slot* __acquire_slot() {
+    for (anr_slot* slot = sg_slots.load(std::memory_order_acquire); slot != NULL; slot = slot->next) {
+        bool expected = false;
+        if (!slot->in_use.load(std::memory_order_relaxed)
+            && slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            slot->tid.store(xlogger_tid(), std::memory_order_relaxed);
+            return slot;
         }
     }
+
+    anr_slot* slot = new anr_slot;
+    slot->in_use.store(true, std::memory_order_relaxed);
+    slot->tid.store(xlogger_tid(), std::memory_order_relaxed);
+    anr_slot* head = sg_slots.load(std::memory_order_relaxed);
+    do {
+        slot->next = head;
+    } while (!sg_slots.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+    return slot;
 }
 
-static void __unregister_anr(uintptr_t _ptr) {
-    ScopedLock lock(sg_mutex);
-    __unregister_anr_impl(_ptr);
-    sg_cond.notifyAll(lock);
+struct thread_anr {
+    thread_anr() : slot(NULL), used(0) {
+    }
+    ~thread_anr() {
+        if (slot)
+            slot->in_use.store(false, std::memory_order_release);
+    }
+
+    anr_slot* slot;
+    uint32_t used;  // a bit a frame of the slot, scopes need not end in the order they began
+};
+
+static thread_anr& __thread_anr() {
+    thread_local thread_anr anr;
+    if (NULL == anr.slot)
+        anr.slot = __acquire_slot();
+    return anr;
 }
 
-static void __register_anr(uintptr_t _ptr,
-                           const char* _file,
-                           const char* _func,
-                           int _line,
-                           int _timeout,
-                           int _call_id,
-                           void* extra_info) {
-    ScopedLock lock(sg_mutex);
-    __unregister_anr_impl(_ptr);
-
-    if (0 >= _timeout)
-        return;
+static void __arm_frame(anr_frame& _frame,
+                        const char* _file,
+                        const char* _func,
+                        int _line,
+                        int _timeout,
+                        int _call_id,
+                        void* _extra_info) {
+    uint64_t now = clock_app_monotonic();
+    uint32_t seq = _frame.seq.load(std::memory_order_relaxed);
+    _frame.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    _frame.file.store(_file, std::memory_order_relaxed);
+    _frame.func.store(_func, std::memory_order_relaxed);
+    _frame.line.store(_line, std::memory_order_relaxed);
+    _frame.timeout.store(_timeout, std::memory_order_relaxed);
+    _frame.call_id.store(_call_id, std::memory_order_relaxed);
+    _frame.extra_info.store(_extra_info, std::memory_order_relaxed);
+    _frame.start_time.store(now, std::memory_order_relaxed);
+    _frame.start_tickcount.store(gettickcount(), std::memory_order_relaxed);
+    _frame.end_time.store(0 < _timeout ? now + _timeout : 0, std::memory_order_relaxed);
+
+    _frame.seq.store(seq + 2, std::memory_order_release);
+}
 
-    check_content ch = {_ptr,
-                        _file,
-                        _func,
-                        _line,
-                        _timeout,
-                        xlogger_tid(),
-                        clock_app_monotonic(),
-                        0,
-                        gettickcount(),
-                        0 /*init cpu_time*/,
-                        _call_id,
-                        extra_info};
-    ch.end_time = ch.start_time + ch.timeout;
-
-    sg_check_heap.push_back(ch);
-    std::push_heap(sg_check_heap.begin(), sg_check_heap.end());
-
-    sg_cond.notifyAll(lock);
+static void __disarm_frame(anr_frame& _frame) {
+    uint32_t seq = _frame.seq.load(std::memory_order_relaxed);
+    // seq_cst against __report_frame: either it sees the new seq and backs off, or this sees it reporting
+    _frame.seq.store(seq + 1);
+    _frame.end_time.store(0, std::memory_order_relaxed);
+    _frame.seq.store(seq + 2, std::memory_order_release);
+
+    while (_frame.reporting.load()) {
+        std::this_thread::yield();
+    }
+}
+
+// false when the owner was writing, or the frame is not armed
+static bool __snapshot_frame(anr_frame& _frame, intmax_t _tid, check_content& _content, uint32_t& _seq) {
+    _seq = _frame.seq.load(std::memory_order_acquire);
+    if (_seq & 1)
+        return false;
+
+    const char* file = _frame.file.load(std::memory_order_relaxed);
+    const char* func = _frame.func.load(std::memory_order_relaxed);
+    _content.ptr = reinterpret_cast<uintptr_t>(&_frame);
+    _content.line = _frame.line.load(std::memory_order_relaxed);
+    _content.timeout = _frame.timeout.load(std::memory_order_relaxed);
+    _content.tid = _tid;
+    _content.start_time = _frame.start_time.load(std::memory_order_relaxed);
+    _content.end_time = _frame.end_time.load(std::memory_order_relaxed);
+    _content.start_tickcount = _frame.start_tickcount.load(std::memory_order_relaxed);
+    _content.call_id = _frame.call_id.load(std::memory_order_relaxed);
+    _content.extra_info = _frame.extra_info.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (_frame.seq.load(std::memory_order_relaxed) != _seq || 0 == _content.end_time)
+        return false;
+
+    _content.file = file;
+    _content.func = func;
+    return true;
 }
 
-static const int64_t kEachRoundSleepTime = 15 * 1000;  // ms
+// the frame is still armed as _seq while the signal runs, so the scope and its extra_info are alive
+static void __report_frame(anr_frame& _frame, uint32_t _seq, bool _iOS_style, const check_content& _content) {
+    _frame.reporting.store(true);
+    if (_frame.seq.load() == _seq)
+        GetSignalCheckHit()(_iOS_style, _content);
+    _frame.reporting.store(false, std::memory_order_release);
+}
+
+NO_DESTROY static Mutex sg_mutex;
+NO_DESTROY static Condition sg_cond;
+static bool sg_exit = false;
+
 static const int64_t kTimeDeviation = 500;
 static bool iOS_style = false;
 
 static void __anr_checker_thread() {
     while (true) {
         ScopedLock lock(sg_mutex);
+        if (sg_exit)
+            return;
 
         uint64_t round_tick_start = clock_app_monotonic();
         clock_t use_cpu_clock_1 = clock();
         uint64_t use_cpu_time_1 = (uint64_t)(((double)use_cpu_clock_1 / CLOCKS_PER_SEC) * 1000);  // ms
+
+        int ret = sg_cond.wait(lock, kScanInterval);
         if (sg_exit)
             return;
-
-        int64_t wait_timeout = 0;
-        bool is_wait_timeout = false;
-
-        if (sg_check_heap.empty()) {
-            // wait_timeout = kEachRoundSleepTime;
-            sg_cond.wait(lock);
-            // is_wait_timeout = (ETIMEDOUT==ret);
-        } else {
-            wait_timeout = iOS_style ? (sg_check_heap.front().timeout - sg_check_heap.front().used_cpu_time)
-                                     : (sg_check_heap.front().end_time - clock_app_monotonic());
-            if (wait_timeout < 0) {
-                xwarn2("@%p", (void*)sg_check_heap.front().ptr)(TSF
-                                                                "wait_timeout:%_, end_time:%_, used_cpu_time:%_, "
-                                                                "timeout:%_ now:%_, iOS_style：%_, anr_checker_size:%_",
-                                                                wait_timeout,
-                                                                sg_check_heap.front().end_time,
-                                                                sg_check_heap.front().used_cpu_time,
-                                                                sg_check_heap.front().timeout,
-                                                                iOS_style,
-                                                                clock_app_monotonic(),
-                                                                sg_check_heap.size());
-                wait_timeout = 0;
-            }
-            wait_timeout = std::min(wait_timeout, kEachRoundSleepTime);
-            int ret = sg_cond.wait(lock, wait_timeout);
-            // is_wait_timeout = true;
-            is_wait_timeout = (wait_timeout > 0 && ETIMEDOUT == ret);
-        }
+        lock.unlock();
 
         int64_t round_tick_elapse = clock_app_monotonic() - round_tick_start;
         clock_t use_cpu_clock_2 = clock();
         uint64_t use_cpu_time_2 = (uint64_t)(((double)use_cpu_clock_2 / CLOCKS_PER_SEC) * 1000);  // ms
-        if (is_wait_timeout && round_tick_elapse > (wait_timeout + kTimeDeviation)) {
-            xwarn2("@%p", (void*)sg_check_heap.front().ptr)(TSF
-                                                            "now:%_, round_tick_start:%_, round_tick_elapse:%_, "
-                                                            "wait_timeout:%_, round cputime:%_, anr_checker_size:%_",
-                                                            clock_app_monotonic(),
-                                                            round_tick_start,
-                                                            round_tick_elapse,
-                                                            wait_timeout,
-                                                            use_cpu_time_2 - use_cpu_time_1,
-                                                            sg_check_heap.size());
+        if (ETIMEDOUT == ret && round_tick_elapse > (kScanInterval + kTimeDeviation)) {
+            xwarn2(TSF "now:%_, round_tick_start:%_, round_tick_elapse:%_, wait_timeout:%_, round cputime:%_",
+                   clock_app_monotonic(),
+                   round_tick_start,
+                   round_tick_elapse,
+                   kScanInterval,
+                   use_cpu_time_2 - use_cpu_time_1);
             iOS_style = true;
         }
-        for (std::vector<check_content>::iterator it = sg_check_heap.begin(); it != sg_check_heap.end(); ++it) {
-            if (use_cpu_time_2 >= use_cpu_time_1) {
-                it->used_cpu_time += (use_cpu_time_2 - use_cpu_time_1);
-            } else {
-                xerror2(
-                    TSF
-                    "use_cpu_time_2:%_, use_cpu_time_1:%_, use_cpu_clock_2:%_, use_cpu_clock_1:%_, CLOCKS_PER_SEC:%_",
+
+        uint64_t round_cpu_time = 0;
+        if (use_cpu_time_2 >= use_cpu_time_1) {
+            round_cpu_time = use_cpu_time_2 - use_cpu_time_1;
+        } else {
+            xerror2(TSF "use_cpu_time_2:%_, use_cpu_time_1:%_, use_cpu_clock_2:%_, use_cpu_clock_1:%_, CLOCKS_PER_SEC:%_",
                     use_cpu_time_2,
                     use_cpu_time_1,
                     use_cpu_clock_2,
                     use_cpu_clock_1,
                     CLOCKS_PER_SEC);
-            }
-        }
-        bool check_hit = false;
-        if (iOS_style) {
-            if (!sg_check_heap.empty()
-                && (uint64_t)sg_check_heap.front().timeout <= sg_check_heap.front().used_cpu_time) {
-                check_hit = true;
-                GetSignalCheckHit()(true, sg_check_heap.front());
-                xassert2(sg_check_heap.front().end_time <= clock_app_monotonic(),
-                         "end_time:%" PRIu64 ", now:%" PRIu64 ", anr_checker_size:%d, @%p",
-                         sg_check_heap.front().end_time,
-                         clock_app_monotonic(),
-                         (int)sg_check_heap.size(),
-                         (void*)sg_check_heap.front().ptr);  // old logic is strict than new logic
-            }
-        } else {
-            if (!sg_check_heap.empty() && sg_check_heap.front().end_time <= clock_app_monotonic()) {
-                check_hit = true;
-                GetSignalCheckHit()(false, sg_check_heap.front());
-            }
         }
 
-        if (!sg_check_heap.empty() && check_hit) {
-            std::pop_heap(sg_check_heap.begin(), sg_check_heap.end());
-            sg_check_heap.pop_back();
+        uint64_t now = clock_app_monotonic();
+        for (anr_slot* slot = sg_slots.load(std::memory_order_acquire); slot != NULL; slot = slot->next) {
+            intmax_t tid = slot->tid.load(std::memory_order_relaxed);
+            for (int i = 0; i < kMaxNestedDepth; ++i) {
+                anr_frame& frame = slot->frames[i];
+                check_content content;
+                uint32_t seq = 0;
+                if (!__snapshot_frame(frame, tid, content, seq))
+                    continue;
+
+                if (seq != frame.seen_seq) {  // armed again since the last round
+                    frame.seen_seq = seq;
+                    frame.used_cpu_time = 0;
+                    frame.reported = false;
+                } else {
+                    frame.used_cpu_time += round_cpu_time;
+                }
+                content.used_cpu_time = frame.used_cpu_time;
+
+                if (frame.reported)
+                    continue;
+
+                if (iOS_style) {
+                    if ((uint64_t)content.timeout <= content.used_cpu_time) {
+                        frame.reported = true;
+                        __report_frame(frame, seq, true, content);
+                        xassert2(content.end_time <= clock_app_monotonic(),
+                                 "end_time:%" PRIu64 ", now:%" PRIu64 ", @%p",
+                                 content.end_time,
+                                 clock_app_monotonic(),
+                                 (void*)content.ptr);  // old logic is strict than new logic
+                    }
+                } else if (content.end_time <= now) {
+                    frame.reported = true;
+                    __report_frame(frame, seq, false, content);
+                }
+            }
         }
     }
 }
@@ -228,18 +342,38 @@ static startup __startup;
 #endif
 
 scope_anr::scope_anr(const char* _file, const char* _func, int _line, int _id, void* _extra_info)
-: file_(_file), func_(_func), line_(_line), call_id_(_id), extra_info_(_extra_info) {
+: file_(_file), func_(_func), line_(_line), call_id_(_id), extra_info_(_extra_info), frame_(NULL) {
 }
 
 scope_anr::~scope_anr() {
 #ifndef ANR_CHECK_DISABLE
-    __unregister_anr(reinterpret_cast<uintptr_t>(this));
+    if (NULL == frame_)
+        return;
+    __disarm_frame(*frame_);
+    thread_anr& anr = __thread_anr();
+    anr.used &= ~(1u << (frame_ - anr.slot->frames));
 #endif
 }
 
 void scope_anr::anr(int _timeout) {
 #ifndef ANR_CHECK_DISABLE
-    __register_anr(reinterpret_cast<uintptr_t>(this), file_, func_, line_, _timeout, call_id_, extra_info_);
+    if (NULL == frame_) {
+        if (0 >= _timeout)
+            return;
+
+        thread_anr& anr = __thread_anr();
+        int index = 0;
+        while (index < kMaxNestedDepth && (anr.used & (1u << index))) {
+            ++index;
+        }
+        if (kMaxNestedDepth <= index) {
+            xwarn2(TSF "anr scopes nested too deep, %_:%_ not checked", func_, line_);
+            return;
+        }
+        anr.used |= 1u << index;
+        frame_ = &anr.slot->frames[index];
+    }
+    __arm_frame(*frame_, file_, func_, line_, _timeout, call_id_, extra_info_);
 #endif
 }
 
@@ -52,6 +52,8 @@ struct check_content {
         return end_time > _ref.end_time;
     }
 };
+
+struct anr_frame;
 }  // namespace comm
 }  // namespace mars
 
@@ -72,6 +74,7 @@ class scope_anr {
     int line_;
     int call_id_;
     void* extra_info_;
+    mars::comm::anr_frame* frame_;  // in the calling thread's slot, taken by the first anr()
 };
 
 extern boost::signals2::signal<void(bool _iOS_style, const mars::comm::check_content& _content)>& GetSignalCheckHit();
@@ -14,6 +14,8 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+
+#include <atomic>
 #ifndef _WIN32
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -30,6 +32,19 @@ const AutoBuffer KNullAtuoBuffer;
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
+static std::atomic<AutoBufferPool*> sg_pool(NULL);
+static std::atomic<uint64_t> sg_reallocs(0);
+static std::atomic<uint64_t> sg_pool_hits(0);
+static std::atomic<uint64_t> sg_bytes_zeroed(0);
+
+static void __FreeBlock(void* _block, size_t _size) {
+    AutoBufferPool* pool = sg_pool.load(std::memory_order_acquire);
+    if (NULL != pool)
+        pool->Put(_block, _size);
+    else
+        free(_block);
+}
+
 AutoBuffer::AutoBuffer(size_t _nSize) : parray_(NULL), pos_(0), length_(0), capacity_(0), malloc_unitsize_(_nSize) {
 }
 
@@ -59,6 +74,10 @@ void AutoBuffer::AddCapacity(size_t _len) {
     __FitSize(Capacity() + _len);
 }
 
+void AutoBuffer::Reserve(size_t _capacity) {
+    __FitSize(_capacity, false);
+}
+
 void AutoBuffer::Write(const AutoBuffer& _buffer) {
     Write(_buffer.Ptr(), _buffer.Length());
 }
@@ -271,7 +290,7 @@ void* AutoBuffer::Detach(size_t* _plen) {
 
 void AutoBuffer::Reset() {
     if (NULL != parray_)
-        free(parray_);
+        __FreeBlock(parray_, capacity_);
 
     parray_ = NULL;
     pos_ = 0;
@@ -279,32 +298,68 @@ void AutoBuffer::Reset() {
     capacity_ = 0;
 }
 
-void AutoBuffer::__FitSize(size_t _len) {
-    if (_len > capacity_) {
-        size_t mallocsize = ((_len + malloc_unitsize_ - 1) / malloc_unitsize_) * malloc_unitsize_;
+void AutoBuffer::SetPool(AutoBufferPool* _pool) {
+    sg_pool.store(_pool, std::memory_order_release);
+}
+
+AutoBuffer::Stats AutoBuffer::GetStats() {
+    Stats stats;
+    stats.reallocs = sg_reallocs.load(std::memory_order_relaxed);
+    stats.pool_hits = sg_pool_hits.load(std::memory_order_relaxed);
+    stats.bytes_zeroed = sg_bytes_zeroed.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AutoBuffer::ResetStats() {
+    sg_reallocs.store(0, std::memory_order_relaxed);
+    sg_pool_hits.store(0, std::memory_order_relaxed);
+    sg_bytes_zeroed.store(0, std::memory_order_relaxed);
+}
 
-        void* p = realloc(parray_, mallocsize);
+void AutoBuffer::__FitSize(size_t _len, bool _zerofill) {
+    if (_len <= capacity_)
+        return;
 
-        if (NULL == p) {
-            ASSERT2(p,
-                    "_len=%" PRIu64 ", m_nMallocUnitSize=%" PRIu64 ", nMallocSize=%" PRIu64 ", m_nCapacity=%" PRIu64,
-                    (uint64_t)_len,
-                    (uint64_t)malloc_unitsize_,
-                    (uint64_t)mallocsize,
-                    (uint64_t)capacity_);
+    // grow by half of what is there at least, so building a large buffer a piece at a time
+    // costs amortized O(1) copies per byte instead of one realloc per malloc_unitsize_
+    size_t wanted = max(_len, capacity_ + capacity_ / 2);
+    size_t mallocsize = ((wanted + malloc_unitsize_ - 1) / malloc_unitsize_) * malloc_unitsize_;
 
-            free(parray_);
-            parray_ = NULL;
-            capacity_ = 0;
-            return;
+    void* p = NULL;
+    AutoBufferPool* pool = sg_pool.load(std::memory_order_acquire);
+    if (NULL != pool && NULL != (p = pool->Get(mallocsize))) {
+        if (NULL != parray_) {
+            memcpy(p, parray_, capacity_);
+            pool->Put(parray_, capacity_);
         }
+        ++sg_pool_hits;
+    } else {
+        p = realloc(parray_, mallocsize);
+        ++sg_reallocs;
+    }
+
+    if (NULL == p) {
+        ASSERT2(p,
+                "_len=%" PRIu64 ", m_nMallocUnitSize=%" PRIu64 ", nMallocSize=%" PRIu64 ", m_nCapacity=%" PRIu64,
+                (uint64_t)_len,
+                (uint64_t)malloc_unitsize_,
+                (uint64_t)mallocsize,
+                (uint64_t)capacity_);
+
+        free(parray_);
+        parray_ = NULL;
+        capacity_ = 0;
+        return;
+    }
 
-        parray_ = (unsigned char*)p;
+    parray_ = (unsigned char*)p;
 
-        ASSERT2(_len <= 50 * 1024 * 1024, "%u", (uint32_t)_len);
-        ASSERT(parray_);
+    ASSERT2(_len <= 50 * 1024 * 1024, "%u", (uint32_t)_len);
+    ASSERT(parray_);
 
+    if (_zerofill) {
         memset(parray_ + capacity_, 0, mallocsize - capacity_);
-        capacity_ = mallocsize;
+        sg_bytes_zeroed.fetch_add(mallocsize - capacity_, std::memory_order_relaxed);
     }
+    capacity_ = mallocsize;
 }
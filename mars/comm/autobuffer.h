@@ -13,9 +13,25 @@
 #ifndef COMM_AUTOBUFFER_H_
 #define COMM_AUTOBUFFER_H_
 
+#include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
 
+// Where AutoBuffer takes its storage from when one is installed with AutoBuffer::SetPool.
+// Blocks going both ways are plain malloc blocks, so one that leaves through Detach() may
+// still be free()d by its new owner.
+class AutoBufferPool {
+ public:
+    virtual ~AutoBufferPool() {
+    }
+
+    // rounds _size up to the size the pool deals in, and returns a cached block of that size
+    // or NULL, in which case the caller reallocs one of the rounded size itself
+    virtual void* Get(size_t& _size) = 0;
+    // keeps or frees a block of _size bytes
+    virtual void Put(void* _block, size_t _size) = 0;
+};
+
 class AutoBuffer {
  public:
     enum TSeek {
@@ -24,6 +40,13 @@ class AutoBuffer {
         ESeekEnd,
     };
 
+    // process-wide, since every buffer is counted
+    struct Stats {
+        uint64_t reallocs;      // growths served by realloc
+        uint64_t pool_hits;     // growths served by the pool
+        uint64_t bytes_zeroed;  // by growths that zero-fill
+    };
+
  public:
     explicit AutoBuffer(size_t _size = 128);
     explicit AutoBuffer(void* _pbuffer, size_t _len, size_t _size = 128);
@@ -32,6 +55,9 @@ class AutoBuffer {
 
     void AllocWrite(size_t _readytowrite, bool _changelength = true);
     void AddCapacity(size_t _len);
+    // grows the capacity to at least _capacity without zero-filling, for callers that write
+    // the bytes before reading them (recv, memcpy); AllocWrite within it does not zero it either
+    void Reserve(size_t _capacity);
 
     template <class T>
     void Write(const T& _val) {
@@ -113,8 +139,13 @@ class AutoBuffer {
 
     void Reset();
 
+    // NULL (the default) allocates straight from realloc
+    static void SetPool(AutoBufferPool* _pool);
+    static Stats GetStats();
+    static void ResetStats();
+
  private:
-    void __FitSize(size_t _len);
+    void __FitSize(size_t _len, bool _zerofill = true);
 
  private:
     AutoBuffer(const AutoBuffer& _rhs);
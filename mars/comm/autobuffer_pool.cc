@@ -0,0 +1,98 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * autobuffer_pool.cc
+ */
+
+#include "autobuffer_pool.h"
+
+#include <stdlib.h>
+
+namespace mars {
+namespace comm {
+
+const size_t SizeClassPool::kMinClass;
+const size_t SizeClassPool::kMaxClass;
+const size_t SizeClassPool::kClassCount;
+
+SizeClassPool::SizeClassPool(size_t _per_class) : per_class_(_per_class) {
+}
+
+SizeClassPool::~SizeClassPool() {
+    for (size_t i = 0; i < kClassCount; ++i) {
+        for (size_t j = 0; j < free_[i].size(); ++j) free(free_[i][j]);
+    }
+}
+
+SizeClassPool& SizeClassPool::Shared() {
+    static SizeClassPool* pool = new SizeClassPool();
+    return *pool;
+}
+
+void* SizeClassPool::Get(size_t& _size) {
+    if (_size > kMaxClass || _size < kMinClass / 2)
+        return NULL;
+
+    // a buffer on its way past 2KB is rounded up to the 4KB class, like anything in between
+    int index = 0;
+    size_t class_size = kMinClass;
+    while (class_size < _size) {
+        class_size <<= 1;
+        ++index;
+    }
+    _size = class_size;
+
+    ScopedLock lock(mutex_[index]);
+    if (free_[index].empty())
+        return NULL;
+    void* block = free_[index].back();
+    free_[index].pop_back();
+    return block;
+}
+
+void SizeClassPool::Put(void* _block, size_t _size) {
+    int index = __ClassOf(_size);
+    if (0 > index) {
+        free(_block);
+        return;
+    }
+
+    ScopedLock lock(mutex_[index]);
+    if (free_[index].size() >= per_class_) {
+        lock.unlock();
+        free(_block);
+        return;
+    }
+    free_[index].push_back(_block);
+}
+
+size_t SizeClassPool::Cached() const {
+    size_t count = 0;
+    for (size_t i = 0; i < kClassCount; ++i) {
+        ScopedLock lock(mutex_[i]);
+        count += free_[i].size();
+    }
+    return count;
+}
+
+int SizeClassPool::__ClassOf(size_t _size) {
+    int index = 0;
+    for (size_t class_size = kMinClass; class_size <= kMaxClass; class_size <<= 1, ++index) {
+        if (class_size == _size)
+            return index;
+    }
+    return -1;
+}
+
+}  // namespace comm
+}  // namespace mars
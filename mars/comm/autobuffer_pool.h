@@ -0,0 +1,67 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * autobuffer_pool.h
+ *
+ * Keeps freed AutoBuffer blocks of 4KB, 8KB, ... 64KB, the sizes the link
+ * packers and receive buffers churn through, for the next buffer to grow
+ * into. Other sizes go straight to malloc.
+ */
+
+#ifndef COMM_AUTOBUFFER_POOL_H_
+#define COMM_AUTOBUFFER_POOL_H_
+
+#include <vector>
+
+#include "comm/autobuffer.h"
+#include "comm/thread/lock.h"
+
+namespace mars {
+namespace comm {
+
+class SizeClassPool : public AutoBufferPool {
+ public:
+    static const size_t kMinClass = 4 * 1024;
+    static const size_t kMaxClass = 64 * 1024;
+    static const size_t kClassCount = 5;
+
+    // _per_class blocks are kept per size class at most, 8 keep under 1MB in all
+    explicit SizeClassPool(size_t _per_class = 8);
+    virtual ~SizeClassPool();
+
+    // the one stn installs; never destroyed, buffers may be freed after exit begins
+    static SizeClassPool& Shared();
+
+    virtual void* Get(size_t& _size);
+    virtual void Put(void* _block, size_t _size);
+
+    size_t Cached() const;
+
+ private:
+    // -1 when _size is not served by the pool
+    static int __ClassOf(size_t _size);
+
+ private:
+    SizeClassPool(const SizeClassPool&);
+    SizeClassPool& operator=(const SizeClassPool&);
+
+ private:
+    const size_t per_class_;
+    mutable Mutex mutex_[kClassCount];
+    std::vector<void*> free_[kClassCount];
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif  // COMM_AUTOBUFFER_POOL_H_
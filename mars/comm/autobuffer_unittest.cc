@@ -0,0 +1,171 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * autobuffer_unittest.cc
+ *
+ * Geometric growth, Reserve not zeroing, blocks going round the size-class
+ * pool, and the stn buffer lifecycles running on the pool.
+ */
+
+#include "autobuffer.h"
+
+#include <stdlib.h>
+
+#include <string>
+
+#include "autobuffer_pool.h"
+#include "gtest/gtest.h"
+
+using namespace mars::comm;
+
+namespace {
+
+// installs a pool for one test and takes it out again
+class PoolScope {
+ public:
+    explicit PoolScope(AutoBufferPool* _pool) {
+        AutoBuffer::SetPool(_pool);
+        AutoBuffer::ResetStats();
+    }
+    ~PoolScope() {
+        AutoBuffer::SetPool(NULL);
+    }
+};
+
+// a request packed a header and a body at a time, then sent and dropped
+size_t PackAndDrop(size_t _body_len, const std::string& _piece) {
+    AutoBuffer buffer;
+    buffer.Write("0123456789abcdef", 16);
+    while (buffer.Length() < _body_len) buffer.Write(_piece.data(), _piece.size());
+    return buffer.Length();
+}
+
+// a long-link read buffer filled a recv at a time and unpacked from the front
+size_t ReceiveAndUnpack(size_t _total, size_t _chunk, size_t _packet) {
+    AutoBuffer buffer;
+    size_t unpacked = 0;
+    for (size_t received = 0; received < _total; received += _chunk) {
+        buffer.Reserve(buffer.Pos() + _chunk);
+        memset(buffer.PosPtr(), 'r', _chunk);
+        buffer.Length(buffer.Pos() + _chunk, buffer.Length() + _chunk);
+        while (buffer.Length() >= _packet) {
+            AutoBuffer body;
+            body.Write(buffer.Ptr(), _packet);
+            buffer.Move(-(off_t)_packet);
+            unpacked += body.Length();
+        }
+    }
+    return unpacked;
+}
+
+}  // namespace
+
+TEST(autobuffer, grows_geometrically) {
+    PoolScope scope(NULL);
+    AutoBuffer buffer;
+    std::string piece(100, 'p');
+    for (int i = 0; i < 40 * 1024; ++i) buffer.Write(piece.data(), piece.size());
+
+    EXPECT_EQ(4000u * 1024, buffer.Length());
+    // one realloc per 128 bytes used to be 32000 of them
+    EXPECT_GT(40u, AutoBuffer::GetStats().reallocs);
+    EXPECT_GE(buffer.Capacity(), buffer.Length());
+    EXPECT_GE(buffer.Length() * 2, buffer.Capacity());
+}
+
+TEST(autobuffer, first_allocation_is_exact) {
+    PoolScope scope(NULL);
+    AutoBuffer buffer;
+    buffer.AllocWrite(1000);
+    EXPECT_EQ(1024u, buffer.Capacity());
+    EXPECT_EQ(1000u, buffer.Length());
+    EXPECT_EQ(0, ((const char*)buffer.Ptr())[999]);
+}
+
+TEST(autobuffer, reserve_does_not_zero) {
+    PoolScope scope(NULL);
+    AutoBuffer buffer;
+    buffer.Reserve(64 * 1024);
+    EXPECT_EQ(64u * 1024, buffer.Capacity());
+    EXPECT_EQ(0u, buffer.Length());
+    EXPECT_EQ(0u, AutoBuffer::GetStats().bytes_zeroed);
+
+    buffer.AllocWrite(32 * 1024);
+    EXPECT_EQ(0u, AutoBuffer::GetStats().bytes_zeroed);
+
+    AutoBuffer zeroed;
+    zeroed.AllocWrite(4096);
+    EXPECT_EQ(4096u, AutoBuffer::GetStats().bytes_zeroed);
+}
+
+TEST(autobuffer, pool_recycles_blocks) {
+    SizeClassPool pool;
+    PoolScope scope(&pool);
+
+    {
+        AutoBuffer buffer;
+        buffer.AllocWrite(5000);
+        EXPECT_EQ(8u * 1024, buffer.Capacity());
+        memset(buffer.Ptr(), 'x', buffer.Length());
+    }
+    EXPECT_EQ(1u, pool.Cached());
+
+    AutoBuffer buffer;
+    buffer.Write("abc", 3);
+    buffer.AllocWrite(7000);
+    EXPECT_EQ(8u * 1024, buffer.Capacity());
+    EXPECT_EQ(1u, AutoBuffer::GetStats().pool_hits);
+    EXPECT_EQ(0u, pool.Cached());
+    EXPECT_EQ(0, memcmp("abc", buffer.Ptr(), 3));
+    // a recycled block is zero-filled like a fresh one
+    EXPECT_EQ(0, ((const char*)buffer.Ptr())[6000]);
+
+    // out of the pool's sizes, and blocks handed away, stay plain malloc blocks
+    AutoBuffer large;
+    large.AllocWrite(200 * 1024);
+    size_t len = 0;
+    free(large.Detach(&len));
+    EXPECT_EQ(200u * 1024, len);
+    EXPECT_EQ(0u, pool.Cached());
+}
+
+TEST(autobuffer, pool_keeps_at_most_per_class) {
+    SizeClassPool pool(2);
+    PoolScope scope(&pool);
+    {
+        AutoBuffer a, b, c;
+        a.AllocWrite(4096);
+        b.AllocWrite(4096);
+        c.AllocWrite(4096);
+    }
+    EXPECT_EQ(2u, pool.Cached());
+}
+
+TEST(autobuffer, stn_lifecycles_through_the_pool) {
+    const int kRounds = 200;
+    std::string piece(256, 'b');
+    SizeClassPool pool;
+    PoolScope scope(&pool);
+
+    for (int round = 0; round < kRounds; ++round) {
+        size_t body_len = 4 * 1024 + round % 60 * 1024;
+        size_t packed = PackAndDrop(body_len, piece);
+        EXPECT_LE(body_len, packed);
+        EXPECT_GT(body_len + piece.size(), packed);
+    }
+    const size_t kTotal = 1024 * 1024;
+    const size_t kPacket = 6 * 1024;
+    EXPECT_EQ(kTotal / kPacket * kPacket, ReceiveAndUnpack(kTotal, 16 * 1024, kPacket));
+
+    EXPECT_LT(0u, AutoBuffer::GetStats().pool_hits);
+}
@@ -0,0 +1,389 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * co_reactor.cc
+ */
+
+#include "co_reactor.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include "boost/bind.hpp"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::comm;
+
+namespace coroutine {
+
+static const int kMaxReadyEvents = 64;
+
+static thread_local Reactor* sg_current = NULL;
+
+Reactor& Reactor::Default() {
+    static Reactor* reactor = new Reactor;  // leaked: coroutines may still be suspended on it at exit
+    static bool started = reactor->Start();
+    (void)started;
+    return *reactor;
+}
+
+Reactor* Reactor::Current() {
+    return sg_current;
+}
+
+Reactor::Reactor()
+: thread_(boost::bind(&Reactor::__Run, this), "coro_reactor")
+, epoll_fd_(-1)
+, stopping_(false)
+, next_id_(0) {
+#ifdef __linux__
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    xassert2(0 <= epoll_fd_, TSF "epoll_create1 errno:%_", errno);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = breaker_.BreakerFD();
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, breaker_.BreakerFD(), &event);
+#endif
+}
+
+Reactor::~Reactor() {
+    Stop();
+    if (0 <= epoll_fd_)
+        close(epoll_fd_);
+}
+
+bool Reactor::Start() {
+    ScopedLock lock(mutex_);
+    stopping_ = false;
+    return 0 == thread_.start();
+}
+
+void Reactor::Stop() {
+    {
+        ScopedLock lock(mutex_);
+        stopping_ = true;
+        breaker_.Break();
+    }
+    if (!InLoop())
+        thread_.join();
+}
+
+bool Reactor::InLoop() const {
+    return this == sg_current;
+}
+
+Reactor::WatchId Reactor::Watch(SOCKET _fd, int _events, int _timeout_ms, const Callback& _callback, SOCKET _cancel_fd) {
+    ScopedLock lock(mutex_);
+    WatchId id = ++next_id_;
+    Watcher& watcher = watchers_[id];
+    watcher.fd = _fd;
+    watcher.cancel_fd = _cancel_fd;
+    watcher.events = _events & (kReadable | kWritable);
+    watcher.deadline = 0 <= _timeout_ms ? ::gettickcount() + _timeout_ms : 0;
+    watcher.callback = _callback;
+
+    if (INVALID_SOCKET != _fd)
+        __Link(id, _fd);
+    if (INVALID_SOCKET != _cancel_fd && _cancel_fd != _fd)
+        __Link(id, _cancel_fd);
+    if (0 != watcher.deadline)
+        timers_.insert(std::make_pair(watcher.deadline, id));
+
+    // the loop sleeps on what it knew when it went to sleep
+    if (!InLoop())
+        breaker_.Break();
+    return id;
+}
+
+Reactor::WatchId Reactor::After(int _timeout_ms, const Callback& _callback) {
+    return Watch(INVALID_SOCKET, 0, _timeout_ms, _callback);
+}
+
+bool Reactor::Cancel(WatchId _id) {
+    std::vector<Fired> fired;
+    {
+        ScopedLock lock(mutex_);
+        if (0 == watchers_.count(_id))
+            return false;
+        __Remove(_id, fired, kCancelled);
+    }
+
+    // run where every other callback runs
+    Callback callback = fired.front().first;
+    Post([callback]() {
+        callback(kCancelled);
+    });
+    return true;
+}
+
+void Reactor::Post(const std::function<void()>& _func) {
+    ScopedLock lock(mutex_);
+    posted_.push_back(_func);
+    if (!InLoop())
+        breaker_.Break();
+}
+
+size_t Reactor::WatchCount() const {
+    ScopedLock lock(mutex_);
+    return watchers_.size();
+}
+
+void Reactor::__Run() {
+    sg_current = this;
+    xinfo2(TSF "reactor %_ running", this);
+
+    std::vector<std::pair<SOCKET, int> > ready;
+    std::vector<Fired> fired;
+    std::vector<std::function<void()> > posted;
+    bool stopped = false;
+
+    // after stop, one more round per batch of callbacks until nothing is left to cancel
+    while (true) {
+        int timeout = -1;
+        {
+            ScopedLock lock(mutex_);
+            if (stopping_ && !stopped) {
+                stopped = true;
+                while (!watchers_.empty()) {
+                    __Remove(watchers_.begin()->first, fired, kCancelled);
+                }
+            }
+            if (stopped && fired.empty() && posted_.empty() && watchers_.empty())
+                break;
+
+            if (stopped || !posted_.empty() || !fired.empty()) {
+                timeout = 0;
+            } else if (!timers_.empty()) {
+                uint64_t now = ::gettickcount();
+                uint64_t deadline = timers_.begin()->first;
+                timeout = deadline <= now ? 0 : (int)std::min<uint64_t>(deadline - now, INT32_MAX);
+            }
+        }
+
+        ready.clear();
+        if (!stopped)
+            __Wait(timeout, ready);
+
+        {
+            ScopedLock lock(mutex_);
+            if (stopped) {
+                while (!watchers_.empty()) {
+                    __Remove(watchers_.begin()->first, fired, kCancelled);
+                }
+            }
+
+            for (size_t i = 0; i < ready.size(); ++i) {
+                SOCKET fd = ready[i].first;
+                int revents = ready[i].second;
+                if (fd == breaker_.BreakerFD()) {
+                    breaker_.Clear();
+                    continue;
+                }
+
+                std::map<SOCKET, std::vector<WatchId> >::iterator it = fds_.find(fd);
+                if (it == fds_.end())
+                    continue;
+
+                std::vector<WatchId> ids = it->second;
+                for (size_t j = 0; j < ids.size(); ++j) {
+                    Watcher& watcher = watchers_[ids[j]];
+                    int events = 0;
+                    if (fd == watcher.fd) {
+                        if (revents & kError)
+                            events |= kError | watcher.events;
+                        events |= revents & watcher.events;
+                    }
+                    if (fd == watcher.cancel_fd && (revents & (kReadable | kError)))
+                        events |= kBroken;
+                    if (0 != events)
+                        __Remove(ids[j], fired, events);
+                }
+            }
+
+            uint64_t now = ::gettickcount();
+            while (!timers_.empty() && timers_.begin()->first <= now) {
+                __Remove(timers_.begin()->second, fired, kTimeout);
+            }
+
+            posted.swap(posted_);
+        }
+
+        for (size_t i = 0; i < fired.size(); ++i) {
+            fired[i].first(fired[i].second);
+        }
+        fired.clear();
+        for (size_t i = 0; i < posted.size(); ++i) {
+            posted[i]();
+        }
+        posted.clear();
+    }
+
+    xinfo2(TSF "reactor %_ stopped", this);
+    sg_current = NULL;
+}
+
+int Reactor::__Wait(int _timeout, std::vector<std::pair<SOCKET, int> >& _ready) {
+#ifdef __linux__
+    struct epoll_event events[kMaxReadyEvents];
+    int n = epoll_wait(epoll_fd_, events, kMaxReadyEvents, _timeout);
+    if (0 > n) {
+        xerror2_if(EINTR != errno, TSF "epoll_wait errno:%_", errno);
+        return n;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        int revents = 0;
+        if (events[i].events & EPOLLIN)
+            revents |= kReadable;
+        if (events[i].events & EPOLLOUT)
+            revents |= kWritable;
+        if (events[i].events & (EPOLLERR | EPOLLHUP))
+            revents |= kError;
+        _ready.push_back(std::make_pair((SOCKET)events[i].data.fd, revents));
+    }
+    return n;
+#else
+    std::vector<struct pollfd> fds;
+    {
+        ScopedLock lock(mutex_);
+        fds.reserve(fds_.size() + 1);
+        struct pollfd breaker = {breaker_.BreakerFD(), POLLIN, 0};
+        fds.push_back(breaker);
+        for (std::map<SOCKET, std::vector<WatchId> >::const_iterator it = fds_.begin(); it != fds_.end(); ++it) {
+            int interest = __Interest(it->first);
+            struct pollfd fd = {it->first, 0, 0};
+            if (interest & kReadable)
+                fd.events |= POLLIN;
+            if (interest & kWritable)
+                fd.events |= POLLOUT;
+            fds.push_back(fd);
+        }
+    }
+
+    int n = poll(&fds[0], (nfds_t)fds.size(), _timeout);
+    if (0 > n) {
+        xerror2_if(EINTR != errno, TSF "poll errno:%_", errno);
+        return n;
+    }
+
+    for (size_t i = 0; i < fds.size() && 0 < n; ++i) {
+        if (0 == fds[i].revents)
+            continue;
+        int revents = 0;
+        if (fds[i].revents & POLLIN)
+            revents |= kReadable;
+        if (fds[i].revents & POLLOUT)
+            revents |= kWritable;
+        if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+            revents |= kError;
+        _ready.push_back(std::make_pair((SOCKET)fds[i].fd, revents));
+    }
+    return n;
+#endif
+}
+
+void Reactor::__Link(WatchId _id, SOCKET _fd) {
+    fds_[_fd].push_back(_id);
+    __UpdateInterest(_fd);
+}
+
+void Reactor::__Unlink(WatchId _id, SOCKET _fd) {
+    std::map<SOCKET, std::vector<WatchId> >::iterator it = fds_.find(_fd);
+    if (it == fds_.end())
+        return;
+    it->second.erase(std::remove(it->second.begin(), it->second.end(), _id), it->second.end());
+    if (it->second.empty())
+        fds_.erase(it);
+    __UpdateInterest(_fd);
+}
+
+void Reactor::__Remove(WatchId _id, std::vector<Fired>& _fired, int _events) {
+    std::map<WatchId, Watcher>::iterator it = watchers_.find(_id);
+    if (it == watchers_.end())
+        return;
+
+    Watcher& watcher = it->second;
+    if (INVALID_SOCKET != watcher.fd)
+        __Unlink(_id, watcher.fd);
+    if (INVALID_SOCKET != watcher.cancel_fd && watcher.cancel_fd != watcher.fd)
+        __Unlink(_id, watcher.cancel_fd);
+    if (0 != watcher.deadline)
+        timers_.erase(std::make_pair(watcher.deadline, _id));
+
+    _fired.push_back(std::make_pair(watcher.callback, _events));
+    watchers_.erase(it);
+}
+
+int Reactor::__Interest(SOCKET _fd) const {
+    std::map<SOCKET, std::vector<WatchId> >::const_iterator it = fds_.find(_fd);
+    if (it == fds_.end())
+        return 0;
+
+    int interest = 0;
+    for (size_t i = 0; i < it->second.size(); ++i) {
+        const Watcher& watcher = watchers_.find(it->second[i])->second;
+        if (_fd == watcher.fd)
+            interest |= watcher.events;
+        if (_fd == watcher.cancel_fd)
+            interest |= kReadable;
+    }
+    return interest;
+}
+
+void Reactor::__UpdateInterest(SOCKET _fd) {
+#ifdef __linux__
+    int interest = __Interest(_fd);
+    std::map<SOCKET, int>::iterator it = registered_.find(_fd);
+    int old = it == registered_.end() ? -1 : it->second;
+    if (interest == old)
+        return;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.data.fd = _fd;
+    if (interest & kReadable)
+        event.events |= EPOLLIN;
+    if (interest & kWritable)
+        event.events |= EPOLLOUT;
+
+    if (0 == interest) {
+        // closed fds have left the set on their own
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, _fd, &event);
+        registered_.erase(it);
+        return;
+    }
+
+    int ret = epoll_ctl(epoll_fd_, 0 > old ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, _fd, &event);
+    if (0 != ret && ENOENT == errno) {
+        // closed and reopened under the same number since we last looked
+        ret = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, _fd, &event);
+    } else if (0 != ret && EEXIST == errno) {
+        ret = epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, _fd, &event);
+    }
+    xerror2_if(0 != ret, TSF "epoll_ctl fd:%_, interest:%_, errno:%_", _fd, interest, errno);
+    registered_[_fd] = interest;
+#endif
+}
+
+}  // namespace coroutine
@@ -0,0 +1,121 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * co_reactor.h
+ *
+ * The event loop under the C++20 coroutines of co_task.h: one-shot watches
+ * on fds and timers, each ending in exactly one callback on the loop thread.
+ * epoll on Linux and Android, poll() elsewhere. A watch can name a second fd
+ * to be cancelled by, which is how a SocketBreaker stops an await.
+ */
+
+#ifndef COMM_COROUTINE_CO_REACTOR_H_
+#define COMM_COROUTINE_CO_REACTOR_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "mars/comm/socket/socketbreaker.h"
+#include "mars/comm/socket/unix_socket.h"
+#include "mars/comm/thread/mutex.h"
+#include "mars/comm/thread/thread.h"
+
+namespace coroutine {
+
+class Reactor {
+ public:
+    enum {
+        kReadable = 0x01,
+        kWritable = 0x02,
+        kError = 0x04,      // error or hang-up on the fd, which the next call on it reports
+        kTimeout = 0x08,
+        kBroken = 0x10,     // the cancel fd became readable
+        kCancelled = 0x20,  // Cancel(), or the reactor stopped
+    };
+
+    typedef uint64_t WatchId;
+    typedef std::function<void(int _events)> Callback;
+
+    // started on first use, runs until exit
+    static Reactor& Default();
+    // the reactor whose loop is running on this thread, NULL elsewhere
+    static Reactor* Current();
+
+ public:
+    Reactor();
+    ~Reactor();
+
+    bool Start();
+    // the loop ends after this iteration, watches still pending are called back with kCancelled
+    void Stop();
+    bool InLoop() const;
+
+    // callable from any thread; _timeout_ms < 0 waits forever, _fd INVALID_SOCKET makes a timer
+    WatchId Watch(SOCKET _fd,
+                  int _events,
+                  int _timeout_ms,
+                  const Callback& _callback,
+                  SOCKET _cancel_fd = INVALID_SOCKET);
+    WatchId After(int _timeout_ms, const Callback& _callback);
+    // the callback runs with kCancelled, unless it has already run; false then
+    bool Cancel(WatchId _id);
+    void Post(const std::function<void()>& _func);
+
+    size_t WatchCount() const;
+
+ private:
+    struct Watcher {
+        SOCKET fd;
+        SOCKET cancel_fd;
+        int events;
+        uint64_t deadline;  // 0: none
+        Callback callback;
+    };
+
+    typedef std::pair<Callback, int> Fired;
+
+    void __Run();
+    int __Wait(int _timeout, std::vector<std::pair<SOCKET, int> >& _ready);
+    void __Link(WatchId _id, SOCKET _fd);
+    void __Unlink(WatchId _id, SOCKET _fd);
+    void __Remove(WatchId _id, std::vector<Fired>& _fired, int _events);
+    void __UpdateInterest(SOCKET _fd);
+    int __Interest(SOCKET _fd) const;
+
+ private:
+    Reactor(const Reactor&);
+    Reactor& operator=(const Reactor&);
+
+ private:
+    mutable mars::comm::Mutex mutex_;
+    mars::comm::Thread thread_;
+    mars::comm::SocketBreaker breaker_;
+    int epoll_fd_;
+    bool stopping_;
+    WatchId next_id_;
+
+    std::map<WatchId, Watcher> watchers_;
+    std::map<SOCKET, std::vector<WatchId> > fds_;  // as the watched fd or the cancel fd
+    std::map<SOCKET, int> registered_;             // what epoll has been told
+    std::set<std::pair<uint64_t, WatchId> > timers_;
+    std::vector<std::function<void()> > posted_;
+};
+
+}  // namespace coroutine
+
+#endif  // COMM_COROUTINE_CO_REACTOR_H_
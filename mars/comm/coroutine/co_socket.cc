@@ -0,0 +1,282 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * co_socket.cc
+ */
+
+#include "co_socket.h"
+
+#include <netdb.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/executor.h"
+#include "mars/comm/socket/socket_address.h"
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::comm;
+
+namespace coroutine {
+
+// what is left of _timeout after _start, for the next wait
+static int __Remaining(int _timeout, uint64_t _start) {
+    if (0 > _timeout)
+        return -1;
+    uint64_t cost = ::gettickcount() - _start;
+    return cost >= (uint64_t)_timeout ? 0 : (int)(_timeout - cost);
+}
+
+Task<SOCKET> AsyncConnect(const socket_address& _address, int& _errcode, SocketBreaker& _breaker, int _timeout) {
+    SOCKET sock = socket(_address.address().sa_family, SOCK_STREAM, IPPROTO_TCP);
+    if (INVALID_SOCKET == sock) {
+        _errcode = socket_errno;
+        co_return INVALID_SOCKET;
+    }
+
+    if (0 != socket_set_nobio(sock)) {
+        _errcode = socket_errno;
+        socket_close(sock);
+        co_return INVALID_SOCKET;
+    }
+
+    int ret = connect(sock, &_address.address(), _address.address_length());
+    if (0 != ret && !IS_NOBLOCK_CONNECT_ERRNO(socket_errno)) {
+        _errcode = socket_errno;
+        socket_close(sock);
+        co_return INVALID_SOCKET;
+    }
+
+    if (0 != ret) {
+        int events = co_await WatchAwaiter(sock, Reactor::kWritable, _timeout, _breaker.BreakerFD());
+        if (events & Reactor::kTimeout) {
+            _errcode = SOCKET_ERRNO(ETIMEDOUT);
+            socket_close(sock);
+            co_return INVALID_SOCKET;
+        }
+        if (events & (Reactor::kBroken | Reactor::kCancelled)) {
+            _errcode = 0;
+            socket_close(sock);
+            co_return INVALID_SOCKET;
+        }
+    }
+
+    _errcode = socket_error(sock);
+    if (0 != _errcode) {
+        socket_close(sock);
+        co_return INVALID_SOCKET;
+    }
+    co_return sock;
+}
+
+Task<int> AsyncSend(SOCKET _sock,
+                    const void* _buffer,
+                    size_t _len,
+                    int& _errcode,
+                    SocketBreaker& _breaker,
+                    int _timeout) {
+    uint64_t start = ::gettickcount();
+    size_t sent_len = 0;
+
+    while (true) {
+        ssize_t nwrite = ::send(_sock, (const char*)_buffer + sent_len, _len - sent_len, 0);
+        if (nwrite == 0 || (0 > nwrite && !IS_NOBLOCK_SEND_ERRNO(socket_errno))) {
+            _errcode = socket_errno;
+            co_return -1;
+        }
+
+        if (0 < nwrite)
+            sent_len += nwrite;
+
+        if (sent_len >= _len) {
+            _errcode = 0;
+            co_return (int)sent_len;
+        }
+
+        int events = co_await WatchAwaiter(_sock, Reactor::kWritable, __Remaining(_timeout, start), _breaker.BreakerFD());
+        if (events & Reactor::kTimeout) {
+            _errcode = SOCKET_ERRNO(ETIMEDOUT);
+            co_return (int)sent_len;
+        }
+        if (events & (Reactor::kBroken | Reactor::kCancelled)) {
+            _errcode = 0;
+            co_return (int)sent_len;
+        }
+    }
+}
+
+Task<int> AsyncRecv(SOCKET _sock,
+                    AutoBuffer& _buffer,
+                    size_t _max_size,
+                    int& _errcode,
+                    SocketBreaker& _breaker,
+                    int _timeout,
+                    bool _wait_full_size) {
+    uint64_t start = ::gettickcount();
+    size_t recv_len = 0;
+
+    if (_buffer.Capacity() - _buffer.Length() < _max_size) {
+        _buffer.AddCapacity(_max_size - (_buffer.Capacity() - _buffer.Length()));
+    }
+
+    while (true) {
+        ssize_t nrecv = ::recv(_sock, _buffer.Ptr(_buffer.Length() + recv_len), _max_size - recv_len, 0);
+
+        if (0 == nrecv) {
+            _errcode = 0;
+            _buffer.Length(_buffer.Pos(), _buffer.Length() + recv_len);
+            co_return (int)recv_len;
+        }
+
+        if (0 > nrecv && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
+            _errcode = socket_errno;
+            co_return -1;
+        }
+
+        if (0 < nrecv)
+            recv_len += nrecv;
+
+        if (recv_len >= _max_size || (recv_len > 0 && !_wait_full_size)) {
+            _buffer.Length(_buffer.Pos(), _buffer.Length() + recv_len);
+            _errcode = 0;
+            co_return (int)recv_len;
+        }
+
+        int events = co_await WatchAwaiter(_sock, Reactor::kReadable, __Remaining(_timeout, start), _breaker.BreakerFD());
+        if (events & Reactor::kTimeout) {
+            _errcode = SOCKET_ERRNO(ETIMEDOUT);
+            _buffer.Length(_buffer.Pos(), _buffer.Length() + recv_len);
+            co_return (int)recv_len;
+        }
+        if (events & (Reactor::kBroken | Reactor::kCancelled)) {
+            _errcode = 0;
+            _buffer.Length(_buffer.Pos(), _buffer.Length() + recv_len);
+            co_return (int)recv_len;
+        }
+    }
+}
+
+Task<bool> AsyncSleep(int _millisecond, SocketBreaker* _breaker) {
+    int events =
+        co_await WatchAwaiter(INVALID_SOCKET, 0, _millisecond, NULL == _breaker ? INVALID_SOCKET : _breaker->BreakerFD());
+    co_return 0 != (events & Reactor::kTimeout);
+}
+
+namespace {
+
+struct ResolveState {
+    ResolveState() : finished(false), ok(false) {
+    }
+    std::atomic<bool> finished;  // whoever sets it first resumes the coroutine
+    bool ok;
+    std::vector<std::string> ips;
+};
+
+bool __Resolve(const std::string& _host, std::vector<std::string>& _ips) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* result = NULL;
+    int ret = getaddrinfo(_host.c_str(), NULL, &hints, &result);
+    if (0 != ret) {
+        xwarn2(TSF "resolve %_ failed: %_", _host, gai_strerror(ret));
+        return false;
+    }
+
+    for (struct addrinfo* it = result; NULL != it; it = it->ai_next) {
+        char ip[64] = {0};
+        const void* addr = AF_INET6 == it->ai_family ? (const void*)&((struct sockaddr_in6*)it->ai_addr)->sin6_addr
+                                                     : (const void*)&((struct sockaddr_in*)it->ai_addr)->sin_addr;
+        if (NULL == inet_ntop(it->ai_family, addr, ip, sizeof(ip)))
+            continue;
+        if (_ips.end() == std::find(_ips.begin(), _ips.end(), ip))
+            _ips.push_back(ip);
+    }
+    freeaddrinfo(result);
+    return !_ips.empty();
+}
+
+class ResolveAwaiter {
+ public:
+    ResolveAwaiter(const std::string& _host, int _timeout, SOCKET _cancel_fd)
+    : host_(_host), timeout_(_timeout), cancel_fd_(_cancel_fd), state_(std::make_shared<ResolveState>()) {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> _handle) {
+        Reactor* reactor = Reactor::Current();
+        ASSERT(NULL != reactor);
+        std::shared_ptr<ResolveState> state = state_;
+
+        Reactor::WatchId watch = reactor->Watch(
+            INVALID_SOCKET,
+            0,
+            timeout_,
+            [state, _handle](int) {
+                if (!state->finished.exchange(true))
+                    _handle.resume();
+            },
+            cancel_fd_);
+
+        std::string host = host_;
+        Executor::Blocking().Post(
+            [state, host, reactor, watch, _handle]() {
+                std::vector<std::string> ips;
+                bool ok = __Resolve(host, ips);
+                reactor->Post([state, ips, ok, reactor, watch, _handle]() {
+                    if (state->finished.exchange(true))
+                        return;
+                    state->ok = ok;
+                    state->ips = ips;
+                    reactor->Cancel(watch);
+                    _handle.resume();
+                });
+            },
+            "coro_resolve");
+    }
+
+    bool await_resume() const noexcept {
+        return state_->ok;
+    }
+
+    const std::vector<std::string>& Ips() const {
+        return state_->ips;
+    }
+
+ private:
+    std::string host_;
+    int timeout_;
+    SOCKET cancel_fd_;
+    std::shared_ptr<ResolveState> state_;
+};
+
+}  // namespace
+
+Task<bool> AsyncResolve(const std::string& _host, std::vector<std::string>& _ips, int _timeout, SocketBreaker* _breaker) {
+    ResolveAwaiter awaiter(_host, _timeout, NULL == _breaker ? INVALID_SOCKET : _breaker->BreakerFD());
+    bool ok = co_await awaiter;
+    if (ok)
+        _ips = awaiter.Ips();
+    co_return ok;
+}
+
+}  // namespace coroutine
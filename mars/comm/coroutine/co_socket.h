@@ -0,0 +1,71 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * co_socket.h
+ *
+ * The block_socket calls as awaitables, with the same arguments, return
+ * values and error codes, so that code moves over line by line: a broken
+ * _breaker ends the await the way it ends the select. Await them from a
+ * Task running on a Reactor.
+ */
+
+#ifndef COMM_COROUTINE_CO_SOCKET_H_
+#define COMM_COROUTINE_CO_SOCKET_H_
+
+#include <string>
+#include <vector>
+
+#include "co_task.h"
+#include "mars/comm/socket/socketbreaker.h"
+#include "mars/comm/socket/unix_socket.h"
+
+class AutoBuffer;
+class socket_address;
+
+namespace coroutine {
+
+Task<SOCKET> AsyncConnect(const socket_address& _address,
+                          int& _errcode,
+                          mars::comm::SocketBreaker& _breaker,
+                          int _timeout = -1 /*ms*/);
+
+Task<int> AsyncSend(SOCKET _sock,
+                    const void* _buffer,
+                    size_t _len,
+                    int& _errcode,
+                    mars::comm::SocketBreaker& _breaker,
+                    int _timeout = -1);
+
+Task<int> AsyncRecv(SOCKET _sock,
+                    AutoBuffer& _buffer,
+                    size_t _max_size,
+                    int& _errcode,
+                    mars::comm::SocketBreaker& _breaker,
+                    int _timeout = -1,
+                    bool _wait_full_size = false);
+
+// false if _breaker broke first
+Task<bool> AsyncSleep(int _millisecond, mars::comm::SocketBreaker* _breaker = NULL);
+
+/**
+ * getaddrinfo on comm::Executor::Blocking(), the coroutine waits without holding its thread
+ * return: false on timeout, break or failure; a late answer is dropped
+ */
+Task<bool> AsyncResolve(const std::string& _host,
+                        std::vector<std::string>& _ips,
+                        int _timeout = 3 * 1000,
+                        mars::comm::SocketBreaker* _breaker = NULL);
+
+}  // namespace coroutine
+
+#endif  // COMM_COROUTINE_CO_SOCKET_H_
@@ -0,0 +1,234 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * co_socket_unittest.cc
+ *
+ * The reactor's timers, watches and cancel, then the awaitables over a
+ * loopback listener: a round trip, a breaker ending a recv, sleep, resolve.
+ */
+
+#include "co_socket.h"
+
+#include <netinet/in.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "co_reactor.h"
+#include "co_task.h"
+#include "gtest/gtest.h"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/socket/socket_address.h"
+#include "mars/comm/time_utils.h"
+
+using namespace coroutine;
+using namespace mars::comm;
+
+namespace {
+
+// a loopback listener on an ephemeral port
+class Listener {
+ public:
+    Listener() : fd_(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)), port_(0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd_, (struct sockaddr*)&addr, sizeof(addr));
+        listen(fd_, 8);
+        socklen_t len = sizeof(addr);
+        getsockname(fd_, (struct sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+    }
+    ~Listener() {
+        close(fd_);
+    }
+
+    SOCKET Accept() {
+        return accept(fd_, NULL, NULL);
+    }
+    uint16_t Port() const {
+        return port_;
+    }
+
+ private:
+    SOCKET fd_;
+    uint16_t port_;
+};
+
+Task<std::string> Echo(uint16_t _port, const std::string& _request) {
+    SocketBreaker breaker;
+    int err = 0;
+    socket_address address("127.0.0.1", _port);
+    SOCKET sock = co_await AsyncConnect(address, err, breaker, 3000);
+    if (INVALID_SOCKET == sock)
+        co_return "";
+
+    int sent = co_await AsyncSend(sock, _request.data(), _request.size(), err, breaker, 3000);
+    if (sent != (int)_request.size()) {
+        socket_close(sock);
+        co_return "";
+    }
+
+    AutoBuffer buffer;
+    co_await AsyncRecv(sock, buffer, _request.size(), err, breaker, 3000, true);
+    socket_close(sock);
+    co_return std::string((const char*)buffer.Ptr(), buffer.Length());
+}
+
+Task<int> RecvUntilBroken(uint16_t _port, SocketBreaker& _breaker, int& _err) {
+    socket_address address("127.0.0.1", _port);
+    SOCKET sock = co_await AsyncConnect(address, _err, _breaker, 3000);
+    if (INVALID_SOCKET == sock)
+        co_return -2;
+
+    AutoBuffer buffer;
+    int ret = co_await AsyncRecv(sock, buffer, 16, _err, _breaker, 10 * 1000);
+    socket_close(sock);
+    co_return ret;
+}
+
+Task<size_t> Nested(int _depth) {
+    if (0 == _depth)
+        co_return 0;
+    size_t below = co_await Nested(_depth - 1);
+    co_return below + 1;
+}
+
+}  // namespace
+
+TEST(co_reactor, timers_fire_in_order_and_cancel) {
+    Reactor reactor;
+    ASSERT_TRUE(reactor.Start());
+
+    Mutex mutex;
+    std::vector<int> order;
+    std::atomic<int> cancelled(0);
+    reactor.After(60, [&](int _events) {
+        ScopedLock lock(mutex);
+        order.push_back(60);
+    });
+    reactor.After(20, [&](int _events) {
+        ScopedLock lock(mutex);
+        order.push_back(20);
+    });
+    Reactor::WatchId id = reactor.After(40, [&](int _events) {
+        if (_events & Reactor::kCancelled)
+            ++cancelled;
+    });
+    EXPECT_TRUE(reactor.Cancel(id));
+    EXPECT_FALSE(reactor.Cancel(id));
+
+    usleep(150 * 1000);
+    reactor.Stop();
+
+    ScopedLock lock(mutex);
+    ASSERT_EQ(2u, order.size());
+    EXPECT_EQ(20, order[0]);
+    EXPECT_EQ(60, order[1]);
+    EXPECT_EQ(1, cancelled);
+    EXPECT_EQ(0u, reactor.WatchCount());
+}
+
+TEST(co_reactor, cancel_fd_breaks_watch) {
+    Reactor reactor;
+    ASSERT_TRUE(reactor.Start());
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    SocketBreaker breaker;
+    std::atomic<int> fired(0);
+    reactor.Watch(fds[0], Reactor::kReadable, -1, [&](int _events) { fired = _events; }, breaker.BreakerFD());
+
+    usleep(20 * 1000);
+    EXPECT_EQ(0, fired);
+    breaker.Break();
+    for (int i = 0; i < 100 && 0 == fired; ++i) usleep(1000);
+    EXPECT_EQ(Reactor::kBroken, fired);
+
+    reactor.Stop();
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(co_reactor, stop_cancels_pending) {
+    Reactor reactor;
+    ASSERT_TRUE(reactor.Start());
+    std::atomic<int> fired(0);
+    reactor.After(-1, [&](int _events) { fired = _events; });
+    reactor.Stop();
+    EXPECT_EQ(Reactor::kCancelled, fired);
+}
+
+TEST(co_socket, round_trip) {
+    Listener listener;
+    std::atomic<bool> served(false);
+    Thread server([&]() {
+        SOCKET sock = listener.Accept();
+        char buf[32];
+        ssize_t n = recv(sock, buf, sizeof(buf), MSG_WAITALL);
+        if (0 < n)
+            send(sock, buf, n, 0);
+        close(sock);
+        served = true;
+    });
+    server.start();
+
+    std::string request(32, 'x');  // the server echoes exactly 32 bytes
+    EXPECT_EQ(request, SyncWait(Echo(listener.Port(), request)));
+    server.join();
+    EXPECT_TRUE(served);
+}
+
+TEST(co_socket, breaker_ends_recv) {
+    Listener listener;
+    SOCKET peer = INVALID_SOCKET;
+    Thread server([&]() { peer = listener.Accept(); });
+    server.start();
+
+    SocketBreaker breaker;
+    int err = -1;
+    Reactor::Default().After(50, [&](int) { breaker.Break(); });
+
+    // a recv that timed out instead would leave ETIMEDOUT
+    EXPECT_EQ(0, SyncWait(RecvUntilBroken(listener.Port(), breaker, err)));
+    EXPECT_EQ(0, err);
+
+    server.join();
+    close(peer);
+}
+
+TEST(co_socket, sleep_and_break) {
+    uint64_t start = ::gettickcount();
+    EXPECT_TRUE(SyncWait(AsyncSleep(30)));
+    EXPECT_LE(25u, ::gettickcount() - start);
+
+    SocketBreaker breaker;
+    breaker.Break();
+    EXPECT_FALSE(SyncWait(AsyncSleep(10 * 1000, &breaker)));
+}
+
+TEST(co_socket, resolve_localhost) {
+    std::vector<std::string> ips;
+    ASSERT_TRUE(SyncWait(AsyncResolve("localhost", ips)));
+    EXPECT_FALSE(ips.empty());
+}
+
+TEST(co_task, nested_awaits_reuse_frames) {
+    EXPECT_EQ(100u, SyncWait(Nested(100)));
+    // the second run is served from the loop thread's free lists
+    EXPECT_EQ(100u, SyncWait(Nested(100)));
+}
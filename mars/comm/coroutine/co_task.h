@@ -0,0 +1,356 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * co_task.h
+ *
+ * Stackless C++20 coroutines on a Reactor. Unlike coroutine.h there is no
+ * stack per coroutine and no MessageQueue round trip per resume: a Task is
+ * a heap frame, resumed straight from the reactor's callback on its loop
+ * thread. Frames are recycled per thread by size, so the short-lived tasks
+ * every await makes do not go to malloc.
+ *
+ *     coroutine::Task<int> Fetch(SOCKET _sock, SocketBreaker& _breaker) {
+ *         int err = 0;
+ *         int sent = co_await coroutine::AsyncSend(_sock, req, len, err, _breaker, 5000);
+ *         ...
+ *     }
+ *     coroutine::Spawn(Fetch(sock, breaker));           // from the loop or any thread
+ *     int ret = coroutine::SyncWait(Fetch(sock, breaker));  // from a thread that may block
+ *
+ * Only built with CXX20_COROUTINE, which compiles the coroutine sources as C++20.
+ */
+
+#ifndef COMM_COROUTINE_CO_TASK_H_
+#define COMM_COROUTINE_CO_TASK_H_
+
+#if !defined(__cpp_impl_coroutine)
+#error "co_task.h needs C++20 coroutines, build with -DCXX20_COROUTINE=ON"
+#endif
+
+#include <stddef.h>
+
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+#include "mars/comm/assert/__assert.h"
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/lock.h"
+#include "co_reactor.h"
+
+namespace coroutine {
+
+// per thread free lists of coroutine frames, by 64 byte class up to 2KB; a frame freed on
+// another thread than it came from simply joins that thread's lists
+class FrameAllocator {
+ public:
+    static const size_t kGranularity = 64;
+    static const size_t kClasses = 32;
+    static const size_t kMaxCached = 64;  // per class and thread
+
+    static void* Allocate(size_t _size) {
+        size_t index = __Class(_size);
+        if (kClasses <= index)
+            return ::operator new(_size);
+
+        Cache& cache = __Cache();
+        Block* block = cache.free[index];
+        if (NULL != block) {
+            cache.free[index] = block->next;
+            --cache.count[index];
+            return block;
+        }
+        return ::operator new((index + 1) * kGranularity);
+    }
+
+    static void Deallocate(void* _ptr, size_t _size) {
+        size_t index = __Class(_size);
+        if (kClasses <= index) {
+            ::operator delete(_ptr);
+            return;
+        }
+
+        Cache& cache = __Cache();
+        if (kMaxCached <= cache.count[index]) {
+            ::operator delete(_ptr);
+            return;
+        }
+        Block* block = static_cast<Block*>(_ptr);
+        block->next = cache.free[index];
+        cache.free[index] = block;
+        ++cache.count[index];
+    }
+
+ private:
+    struct Block {
+        Block* next;
+    };
+
+    struct Cache {
+        Cache() {
+            for (size_t i = 0; i < kClasses; ++i) {
+                free[i] = NULL;
+                count[i] = 0;
+            }
+        }
+        ~Cache() {
+            for (size_t i = 0; i < kClasses; ++i) {
+                while (NULL != free[i]) {
+                    Block* next = free[i]->next;
+                    ::operator delete(free[i]);
+                    free[i] = next;
+                }
+            }
+        }
+
+        Block* free[kClasses];
+        size_t count[kClasses];
+    };
+
+    static size_t __Class(size_t _size) {
+        return (_size + kGranularity - 1) / kGranularity - 1;
+    }
+
+    static Cache& __Cache() {
+        static thread_local Cache cache;
+        return cache;
+    }
+};
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    // resumes whoever awaited the task, if anyone did
+    struct FinalAwaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> _handle) noexcept {
+            std::coroutine_handle<> continuation = _handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    static void* operator new(size_t _size) {
+        return FrameAllocator::Allocate(_size);
+    }
+    static void operator delete(void* _ptr, size_t _size) {
+        FrameAllocator::Deallocate(_ptr, _size);
+    }
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+    FinalAwaiter final_suspend() const noexcept {
+        return {};
+    }
+    void unhandled_exception() const noexcept {
+        std::terminate();  // built without exceptions
+    }
+
+    std::coroutine_handle<> continuation;
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    Task<T> get_return_object();
+    void return_value(T _value) {
+        value = std::move(_value);
+    }
+    T value{};
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() const {
+    }
+};
+
+}  // namespace detail
+
+// lazy: nothing runs until the task is awaited, spawned or waited for
+template <typename T = void>
+class Task {
+ public:
+    typedef detail::Promise<T> promise_type;
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+    explicit Task(handle_type _handle) : handle_(_handle) {
+    }
+    Task(Task&& _rhs) noexcept : handle_(std::exchange(_rhs.handle_, nullptr)) {
+    }
+    Task& operator=(Task&& _rhs) noexcept {
+        if (this != &_rhs) {
+            if (handle_)
+                handle_.destroy();
+            handle_ = std::exchange(_rhs.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~Task() {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> _awaiting) noexcept {
+        handle_.promise().continuation = _awaiting;
+        return handle_;
+    }
+    T await_resume() {
+        if constexpr (!std::is_void<T>::value)
+            return std::move(handle_.promise().value);
+    }
+
+ private:
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+ private:
+    handle_type handle_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> Promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<Promise<T> >::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void> >::from_promise(*this));
+}
+
+// owns itself once started, and frees itself at the end
+struct Detached {
+    struct promise_type : PromiseBase {
+        Detached get_return_object() {
+            return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+        void return_void() const {
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+inline Detached RunDetached(Task<void> _task) {
+    co_await _task;
+}
+
+}  // namespace detail
+
+// runs _task to its end on _reactor's loop; callable from any thread
+inline void Spawn(Task<void> _task, Reactor& _reactor = Reactor::Default()) {
+    std::coroutine_handle<> handle = detail::RunDetached(std::move(_task)).handle;
+    if (_reactor.InLoop()) {
+        handle.resume();
+    } else {
+        _reactor.Post([handle]() {
+            handle.resume();
+        });
+    }
+}
+
+namespace detail {
+
+template <typename T>
+struct SyncState {
+    SyncState() : done(false) {
+    }
+    mars::comm::Mutex mutex;
+    mars::comm::Condition cond;
+    bool done;
+    typename std::conditional<std::is_void<T>::value, char, T>::type value{};
+};
+
+template <typename T>
+Task<void> RunAndSignal(Task<T> _task, SyncState<T>& _state) {
+    if constexpr (std::is_void<T>::value) {
+        co_await _task;
+    } else {
+        _state.value = co_await _task;
+    }
+    mars::comm::ScopedLock lock(_state.mutex);
+    _state.done = true;
+    _state.cond.notifyAll(lock);
+}
+
+}  // namespace detail
+
+// blocks the calling thread, which must not be _reactor's loop, until _task is done
+template <typename T>
+T SyncWait(Task<T> _task, Reactor& _reactor = Reactor::Default()) {
+    ASSERT(!_reactor.InLoop());
+    detail::SyncState<T> state;
+    Spawn(detail::RunAndSignal(std::move(_task), state), _reactor);
+
+    mars::comm::ScopedLock lock(state.mutex);
+    while (!state.done) {
+        state.cond.wait(lock);
+    }
+    if constexpr (!std::is_void<T>::value)
+        return std::move(state.value);
+}
+
+// resumes on the loop with what happened to a watch; the coroutine must be running on a reactor
+class WatchAwaiter {
+ public:
+    WatchAwaiter(SOCKET _fd, int _events, int _timeout_ms, SOCKET _cancel_fd)
+    : fd_(_fd), events_(_events), timeout_ms_(_timeout_ms), cancel_fd_(_cancel_fd), fired_(0) {
+    }
+
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> _handle) {
+        Reactor* reactor = Reactor::Current();
+        ASSERT(NULL != reactor);
+        reactor->Watch(
+            fd_,
+            events_,
+            timeout_ms_,
+            [this, _handle](int _events) {
+                fired_ = _events;
+                _handle.resume();
+            },
+            cancel_fd_);
+    }
+    int await_resume() const noexcept {
+        return fired_;
+    }
+
+ private:
+    SOCKET fd_;
+    int events_;
+    int timeout_ms_;
+    SOCKET cancel_fd_;
+    int fired_;
+};
+
+}  // namespace coroutine
+
+#endif  // COMM_COROUTINE_CO_TASK_H_
@@ -19,6 +19,7 @@
 
 #include "dns/dns.h"
 
+#include "mars/comm/executor.h"
 #include "mars/comm/macro.h"
 #include "mars/comm/network/getaddrinfo_with_timeout.h"
 #include "network/getdnssvraddrs.h"
@@ -27,7 +28,6 @@
 #include "socket/unix_socket.h"
 #include "thread/condition.h"
 #include "thread/lock.h"
-#include "thread/thread.h"
 #include "time_utils.h"
 #include "xlogger/xlogger.h"
 
@@ -43,7 +43,7 @@ enum {
 };
 
 struct dnsinfo {
-    thread_tid threadid;
+    uint64_t id;
     DNS* dns;
     // DNS::DNSFunc    dns_func;
     std::function<std::vector<std::string>(const std::string& _host, bool _longlink_host, const std::map<std::string, std::string>& _extra_info)> dns_func;
@@ -58,9 +58,9 @@ struct dnsinfo {
 
 std::string DNSInfoToString(const struct dnsinfo& _info) {
     XMessage msg;
-    msg(TSF "info:%_, threadid:%_, dns:%_, host_name:%_, status:%_",
+    msg(TSF "info:%_, id:%_, dns:%_, host_name:%_, status:%_",
         &_info,
-        _info.threadid,
+        _info.id,
         _info.dns,
         _info.host_name,
         _info.status);
@@ -69,7 +69,8 @@ std::string DNSInfoToString(const struct dnsinfo& _info) {
 NO_DESTROY static std::vector<dnsinfo> sg_dnsinfo_vec;
 NO_DESTROY static Condition sg_condition;
 NO_DESTROY static Mutex sg_mutex;
-void DNS::__GetIP() {
+static uint64_t sg_dnsinfo_id = 0;
+void DNS::__GetIP(uint64_t _id) {
     xverbose_function();
 
     auto start_time = ::gettickcount();
@@ -85,7 +86,7 @@ void DNS::__GetIP() {
     std::vector<dnsinfo>::iterator iter = sg_dnsinfo_vec.begin();
 
     for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-        if (iter->threadid == ThreadUtil::currentthreadid()) {
+        if (iter->id == _id) {
             host_name = iter->host_name;
             dnsfunc = iter->dns_func;
             longlink_host = iter->longlink_host;
@@ -95,6 +96,10 @@ void DNS::__GetIP() {
         }
     }
 
+    if (iter == sg_dnsinfo_vec.end()) {  // queued past the caller's timeout
+        xwarn2(TSF "dnsinfo %_ already gone", _id);
+        return;
+    }
     lock.unlock();
     xdebug2(TSF "dnsfunc is null: %_, %_", host_name, (dnsfunc == NULL));
     if (NULL == dnsfunc) {
@@ -131,7 +136,7 @@ void DNS::__GetIP() {
 
         iter = sg_dnsinfo_vec.begin();
         for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-            if (iter->threadid == ThreadUtil::currentthreadid()) {
+            if (iter->id == _id) {
                 break;
             }
         }
@@ -201,7 +206,7 @@ void DNS::__GetIP() {
 
         iter = sg_dnsinfo_vec.begin();
         for (; iter != sg_dnsinfo_vec.end(); ++iter) {
-            if (iter->threadid == ThreadUtil::currentthreadid()) {
+            if (iter->id == _id) {
                 break;
             }
         }
@@ -244,16 +249,11 @@ bool DNS::GetHostByName(const std::string& _host_name,
     if (_breaker && _breaker->isbreak)
         return false;
 
-    Thread thread(std::bind(&DNS::__GetIP, this), _host_name.c_str());
-    int startRet = thread.start();
-
-    if (startRet != 0) {
-        xerror2(TSF "start the thread fail");
-        return false;
-    }
-
+    // the job looks its dnsinfo up by id, after this function released sg_mutex for the first wait
     dnsinfo info;
-    info.threadid = thread.tid();
+    info.id = ++sg_dnsinfo_id;
+    Executor::Default().Post(std::bind(&DNS::__GetIP, this, info.id), "dns");
+
     info.host_name = _host_name;
     info.dns_func = dnsfunc_;
     info.dns = this;
@@ -276,7 +276,7 @@ bool DNS::GetHostByName(const std::string& _host_name,
         std::vector<dnsinfo>::iterator it = sg_dnsinfo_vec.begin();
 
         for (; it != sg_dnsinfo_vec.end(); ++it) {
-            if (info.threadid == it->threadid)
+            if (info.id == it->id)
                 break;
         }
 
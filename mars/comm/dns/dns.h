@@ -71,7 +71,7 @@ class DNS {
     }
 
  private:
-    void __GetIP();
+    void __GetIP(uint64_t _id);
 
  private:
     //    DNSFunc dnsfunc_;
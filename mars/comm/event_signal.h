@@ -0,0 +1,238 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * event_signal.h
+ *
+ * A synchronous signal for events raised far more often than slots come and
+ * go, like the traffic counters and the alarms. Slots live in an immutable
+ * array swapped whole on connect and disconnect, so an emit counts itself in,
+ * loads the current array and calls through it: two atomic adds on the
+ * signal's own counter, no lock, no allocation and nothing copied. A replaced
+ * array is freed by whoever finds no emit in flight, the replacing call or
+ * the last emit out. A slot may instead be delivered on a MessageQueue, with
+ * its arguments copied.
+ *
+ * connect, connect with a group, disconnect by an equal functor and
+ * disconnect_all_slots keep the boost::signals2 spelling, so call sites move
+ * over by changing the declared type. Grouped slots run in group order before
+ * ungrouped ones, as signals2 puts them by default.
+ */
+
+#ifndef COMM_EVENT_SIGNAL_H_
+#define COMM_EVENT_SIGNAL_H_
+
+#include <limits.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/function.hpp"
+#include "comm/messagequeue/message_queue.h"
+#include "comm/thread/lock.h"
+
+namespace mars {
+namespace comm {
+
+template <typename Signature>
+class EventSignal;
+
+template <typename... Args>
+class EventSignal<void(Args...)> {
+ public:
+    typedef void result_type;
+    typedef boost::function<void(Args...)> slot_type;
+    typedef uint64_t SlotId;
+
+ public:
+    EventSignal() : slots_(NULL), count_(0), readers_(0), retiring_(false), next_id_(1) {
+    }
+    ~EventSignal() {
+        delete slots_.load();
+        for (size_t i = 0; i < retired_.size(); ++i) {
+            delete retired_[i];
+        }
+    }
+
+    SlotId connect(const slot_type& _slot) {
+        return __Connect(kUngrouped, _slot, MessageQueue::MessageHandler_t());
+    }
+
+    // lower groups run first, all of them before the ungrouped slots
+    SlotId connect(int _group, const slot_type& _slot) {
+        return __Connect(_group, _slot, MessageQueue::MessageHandler_t());
+    }
+
+    // _slot runs on _handler's queue rather than on the emitting thread
+    SlotId connect(const slot_type& _slot, const MessageQueue::MessageHandler_t& _handler) {
+        return __Connect(kUngrouped, _slot, _handler);
+    }
+
+    // every slot comparing equal to _func, e.g. the same boost::bind expression it was connected with
+    template <typename F>
+    void disconnect(const F& _func) {
+        __Remove([&_func](const Slot& _slot) { return _slot.func == _func; });
+    }
+
+    void Disconnect(SlotId _id) {
+        __Remove([_id](const Slot& _slot) { return _slot.id == _id; });
+    }
+
+    void disconnect_all_slots() {
+        __Remove([](const Slot&) { return true; });
+    }
+
+    bool empty() const {
+        return 0 == count_.load(std::memory_order_acquire);
+    }
+
+    size_t num_slots() const {
+        return count_.load(std::memory_order_acquire);
+    }
+
+    // a slot disconnected while this runs is skipped if it has not been reached yet
+    void operator()(Args... _args) const {
+        if (0 == count_.load(std::memory_order_acquire))
+            return;
+
+        // seq_cst, paired with __Publish(): counted in before the load, an emit either sees the new array or is seen
+        readers_.fetch_add(1);
+        const SlotArray* slots = slots_.load();
+        if (NULL != slots) {
+            for (typename SlotArray::const_iterator it = slots->begin(); it != slots->end(); ++it) {
+                const std::shared_ptr<Slot>& slot = *it;
+                if (!slot->connected.load(std::memory_order_acquire))
+                    continue;
+                if (MessageQueue::KInvalidQueueID == slot->handler.queue)
+                    slot->func(_args...);
+                else
+                    MessageQueue::AsyncInvoke(boost::bind(&EventSignal::__Deliver, slot, _args...), slot->handler);
+            }
+        }
+        if (1 == readers_.fetch_sub(1) && retiring_.load())
+            __Reclaim();
+    }
+
+ private:
+    static const int kUngrouped = INT_MAX;
+
+    struct Slot {
+        slot_type func;
+        int group;
+        SlotId id;
+        MessageQueue::MessageHandler_t handler;
+        std::atomic<bool> connected;
+    };
+    typedef std::vector<std::shared_ptr<Slot> > SlotArray;
+
+    SlotId __Connect(int _group, const slot_type& _slot, const MessageQueue::MessageHandler_t& _handler) {
+        std::shared_ptr<Slot> slot = std::make_shared<Slot>();
+        slot->func = _slot;
+        slot->group = _group;
+        slot->handler = _handler;
+        slot->connected.store(true);
+
+        ScopedLock lock(mutex_);
+        slot->id = next_id_++;
+        const SlotArray* current = slots_.load();
+        SlotArray* slots = NULL == current ? new SlotArray() : new SlotArray(*current);
+
+        // after every slot of the same or a lower group, so connect order holds within a group
+        typename SlotArray::iterator pos = slots->begin();
+        while (pos != slots->end() && (*pos)->group <= _group) ++pos;
+        slots->insert(pos, slot);
+
+        __Publish(slots);
+        return slot->id;
+    }
+
+    template <typename Pred>
+    void __Remove(const Pred& _pred) {
+        ScopedLock lock(mutex_);
+        const SlotArray* current = slots_.load();
+        if (NULL == current)
+            return;
+
+        SlotArray* slots = new SlotArray();
+        slots->reserve(current->size());
+        for (typename SlotArray::const_iterator it = current->begin(); it != current->end(); ++it) {
+            if (_pred(**it))
+                (*it)->connected.store(false, std::memory_order_release);
+            else
+                slots->push_back(*it);
+        }
+        if (slots->size() == current->size()) {
+            delete slots;
+            return;
+        }
+        if (slots->empty()) {
+            delete slots;
+            slots = NULL;
+        }
+
+        __Publish(slots);
+    }
+
+    // under mutex_
+    void __Publish(const SlotArray* _slots) {
+        const SlotArray* old = slots_.exchange(_slots);
+        count_.store(NULL == _slots ? 0 : _slots->size(), std::memory_order_release);
+        if (NULL != old) {
+            retired_.push_back(old);
+            retiring_.store(true);
+        }
+        if (0 == readers_.load())
+            __FreeRetired();
+    }
+
+    void __Reclaim() const {
+        ScopedLock lock(mutex_);
+        if (0 == readers_.load())
+            __FreeRetired();
+    }
+
+    // under mutex_, with no emit in flight
+    void __FreeRetired() const {
+        for (size_t i = 0; i < retired_.size(); ++i) {
+            delete retired_[i];
+        }
+        retired_.clear();
+        retiring_.store(false);
+    }
+
+    static void __Deliver(const std::shared_ptr<Slot>& _slot, typename std::decay<Args>::type... _args) {
+        if (_slot->connected.load(std::memory_order_acquire))
+            _slot->func(_args...);
+    }
+
+ private:
+    EventSignal(const EventSignal&);
+    EventSignal& operator=(const EventSignal&);
+
+ private:
+    mutable Mutex mutex_;  // connect and disconnect, and freeing replaced arrays
+    std::atomic<const SlotArray*> slots_;
+    std::atomic<size_t> count_;
+    mutable std::atomic<int> readers_;  // emits in flight
+    mutable std::atomic<bool> retiring_;
+    mutable std::vector<const SlotArray*> retired_;  // replaced while an emit may still be in them
+    SlotId next_id_;
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif  // COMM_EVENT_SIGNAL_H_
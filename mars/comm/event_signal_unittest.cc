@@ -0,0 +1,180 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * event_signal_unittest.cc
+ *
+ * Group order, disconnecting by an equal boost::bind and from inside an
+ * emit, emits racing connect and disconnect, and delivery on a MessageQueue.
+ */
+
+#include "event_signal.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "comm/thread/condition.h"
+#include "gtest/gtest.h"
+
+using namespace mars::comm;
+
+namespace {
+
+class Counter {
+ public:
+    Counter() : count(0), bytes(0) {
+    }
+    void OnData(const char* _tag, int64_t _send, int64_t _recv) {
+        ++count;
+        bytes += _send + _recv;
+    }
+
+    int count;
+    int64_t bytes;
+};
+
+void Append(std::vector<int>* _order, int _value) {
+    _order->push_back(_value);
+}
+
+volatile int64_t sg_sink = 0;
+void Sink(const char* _tag, int64_t _send, int64_t _recv) {
+    sg_sink += _send;
+}
+
+}  // namespace
+
+TEST(event_signal, groups_run_before_ungrouped_in_order) {
+    EventSignal<void()> signal;
+    std::vector<int> order;
+    signal.connect(boost::bind(&Append, &order, 100));
+    signal.connect(5, boost::bind(&Append, &order, 5));
+    signal.connect(1, boost::bind(&Append, &order, 1));
+    signal.connect(boost::bind(&Append, &order, 101));
+    signal.connect(5, boost::bind(&Append, &order, 6));
+
+    signal();
+    int expected[] = {1, 5, 6, 100, 101};
+    EXPECT_EQ(std::vector<int>(expected, expected + 5), order);
+}
+
+TEST(event_signal, disconnect_by_equal_bind) {
+    EventSignal<void(const char*, int64_t, int64_t)> signal;
+    Counter a, b;
+    signal.connect(boost::bind(&Counter::OnData, &a, _1, _2, _3));
+    signal.connect(boost::bind(&Counter::OnData, &b, _1, _2, _3));
+    signal.connect(&Sink);
+    EXPECT_EQ(3u, signal.num_slots());
+
+    signal("t", 10, 5);
+    signal.disconnect(boost::bind(&Counter::OnData, &a, _1, _2, _3));
+    signal.disconnect(&Sink);
+    signal("t", 1, 1);
+
+    EXPECT_EQ(1, a.count);
+    EXPECT_EQ(15, a.bytes);
+    EXPECT_EQ(2, b.count);
+    EXPECT_EQ(1u, signal.num_slots());
+
+    signal.disconnect_all_slots();
+    EXPECT_TRUE(signal.empty());
+    signal("t", 1, 1);
+    EXPECT_EQ(2, b.count);
+}
+
+TEST(event_signal, disconnect_inside_emit) {
+    EventSignal<void(int)> signal;
+    std::vector<int> calls;
+    EventSignal<void(int)>::SlotId second = 0;
+    signal.connect([&](int _v) {
+        calls.push_back(1);
+        signal.Disconnect(second);
+        signal.connect([&](int) { calls.push_back(3); });
+    });
+    second = signal.connect([&](int _v) { calls.push_back(2); });
+
+    // the running emit skips the slot disconnected under it and does not see the one connected
+    signal(0);
+    ASSERT_EQ(1u, calls.size());
+    EXPECT_EQ(1, calls[0]);
+    EXPECT_EQ(2u, signal.num_slots());
+}
+
+TEST(event_signal, emit_while_slots_change) {
+    EventSignal<void(int)> signal;
+    std::atomic<int> kept(0);
+    signal.connect([&](int _v) { kept += _v; });
+
+    const int kThreads = 4;
+    const int kEmits = 20000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.push_back(std::thread([&] {
+            for (int n = 0; n < kEmits; ++n) signal(1);
+        }));
+    }
+    // every swap retires an array some emit may still be walking
+    for (int i = 0; i < 1000; ++i) {
+        EventSignal<void(int)>::SlotId id = signal.connect([](int) {});
+        signal.Disconnect(id);
+    }
+    for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+
+    EXPECT_EQ(kThreads * kEmits, kept.load());
+    EXPECT_EQ(1u, signal.num_slots());
+}
+
+TEST(event_signal, bind_ref_emits) {
+    EventSignal<void(int, const std::string&)> signal;
+    std::string got;
+    signal.connect([&](int _status, const std::string& _name) { got = _name + std::to_string(_status); });
+    boost::function<void()> deferred = boost::bind(boost::ref(signal), 3, std::string("main"));
+    deferred();
+    EXPECT_EQ("main3", got);
+}
+
+TEST(event_signal, delivers_on_message_queue) {
+    MessageQueue::MessageQueueCreater creater(true, "event_signal_test");
+    MessageQueue::MessageQueue_t queue = creater.GetMessageQueue();
+    MessageQueue::MessageHandler_t handler = MessageQueue::InstallAsyncHandler(queue);
+
+    EventSignal<void(const std::string&)> signal;
+    Mutex mutex;
+    Condition cond;
+    std::string got;
+    MessageQueue::MessageQueue_t ran_on = MessageQueue::KInvalidQueueID;
+    signal.connect(
+        [&](const std::string& _value) {
+            ScopedLock lock(mutex);
+            got = _value;
+            ran_on = MessageQueue::CurrentThreadMessageQueue();
+            cond.notifyAll(lock);
+        },
+        handler);
+
+    {
+        std::string temp("copied");
+        signal(temp);
+    }
+
+    ScopedLock lock(mutex);
+    if (got.empty())
+        cond.wait(lock, 2000);
+    EXPECT_EQ("copied", got);
+    EXPECT_EQ(queue, ran_on);
+    lock.unlock();
+    creater.CancelAndWait();
+}
@@ -0,0 +1,380 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * executor.cc
+ */
+
+#include "executor.h"
+
+#include <algorithm>
+
+#include "comm/time_utils.h"
+#include "comm/xlogger/xlogger.h"
+
+namespace mars {
+namespace comm {
+
+namespace {
+
+struct current_job {
+    current_job() : executor(NULL), worker(NULL), job(NULL) {
+    }
+
+    Executor* executor;
+    void* worker;
+    ExecutorJob* job;
+};
+
+static current_job& __current() {
+    thread_local current_job current;
+    return current;
+}
+
+static const uint64_t kSlowQueueTime = 1000;  // ms
+
+}  // namespace
+
+struct Executor::Worker {
+    Worker() : thread(NULL), alive(false) {
+    }
+
+    Mutex mutex;
+    std::deque<ExecutorJobPtr> jobs;  // the owner pushes and pops at the back, thieves take the front
+    Thread* thread;
+    bool alive;  // under the executor mutex
+};
+
+ExecutorJob::ExecutorJob(const std::function<void()>& _func, const char* _tag, uint64_t _due_tick)
+: func_(_func), tag_(_tag ? _tag : ""), post_tick_(gettickcount()), due_tick_(_due_tick), state_(kQueued) {
+}
+
+bool ExecutorJob::Cancel() {
+    int expected = kQueued;
+    if (!state_.compare_exchange_strong(expected, kCanceled))
+        return false;
+    __Finish(kCanceled);
+    return true;
+}
+
+bool ExecutorJob::TryRun() {
+    if (due_tick_ > gettickcount() || !__Begin())
+        return false;
+    __Execute();
+    return true;
+}
+
+void ExecutorJob::Join() {
+    if (__current().job == this) {
+        xassert2(false, TSF "job %_ joins itself", tag_);
+        return;
+    }
+    if (TryRun())
+        return;
+
+    ScopedLock lock(mutex_);
+    while (kRunning >= state_.load())
+        cond_.wait(lock);
+}
+
+bool ExecutorJob::IsRunning() const {
+    return kRunning >= state_.load();
+}
+
+int ExecutorJob::State() const {
+    return state_.load();
+}
+
+const char* ExecutorJob::Tag() const {
+    return tag_;
+}
+
+bool ExecutorJob::__Begin() {
+    int expected = kQueued;
+    return state_.compare_exchange_strong(expected, kRunning);
+}
+
+void ExecutorJob::__Execute() {
+    uint64_t queue_time = gettickcount() - std::max(post_tick_, due_tick_);
+    xdebug2_if(queue_time >= kSlowQueueTime, TSF "job %_ queued %_ms", tag_, queue_time);
+
+    ExecutorJob* outer = __current().job;
+    __current().job = this;
+    func_();
+    func_ = nullptr;  // drops what the job captured before anyone joining wakes up
+    __current().job = outer;
+
+    __Finish(kDone);
+}
+
+void ExecutorJob::__Finish(int _state) {
+    ScopedLock lock(mutex_);
+    state_.store(_state);
+    cond_.notifyAll(lock);
+}
+
+Executor& Executor::Default() {
+    static Executor* executor = new Executor(kDefaultCoreWorkers, kDefaultMaxWorkers, "executor");
+    return *executor;
+}
+
+Executor& Executor::Blocking() {
+    static Executor* executor = new Executor(kBlockingCoreWorkers, kBlockingMaxWorkers, "executor.io");
+    return *executor;
+}
+
+const char* Executor::CurrentTag() {
+    ExecutorJob* job = __current().job;
+    return job ? job->Tag() : "";
+}
+
+Executor::Executor(size_t _core_workers, size_t _max_workers, const char* _name)
+: core_workers_(std::max<size_t>(1, _core_workers))
+, max_workers_(std::max(std::max<size_t>(1, _core_workers), _max_workers))
+, name_(_name)
+, delayed_seq_(0)
+, alive_(0)
+, stop_(false)
+, idle_(0)
+, pending_(0) {
+    for (size_t i = 0; i < max_workers_; ++i) {
+        workers_.push_back(new Worker);
+    }
+
+    ScopedLock lock(mutex_);
+    for (size_t i = 0; i < core_workers_; ++i) {
+        __SpawnLocked();
+    }
+}
+
+Executor::~Executor() {
+    ScopedLock lock(mutex_);
+    stop_ = true;
+    cond_.notifyAll(lock);
+    lock.unlock();
+
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        if (workers_[i]->thread) {
+            workers_[i]->thread->join();
+            delete workers_[i]->thread;
+        }
+    }
+
+    // whatever no worker took is canceled, so nobody stays in Join()
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        for (size_t j = 0; j < workers_[i]->jobs.size(); ++j) {
+            workers_[i]->jobs[j]->Cancel();
+        }
+        delete workers_[i];
+    }
+    for (size_t i = 0; i < queue_.size(); ++i) {
+        queue_[i]->Cancel();
+    }
+    for (size_t i = 0; i < delayed_.size(); ++i) {
+        delayed_[i].job->Cancel();
+    }
+}
+
+ExecutorJobPtr Executor::Post(const std::function<void()>& _func, const char* _tag) {
+    ExecutorJobPtr job(new ExecutorJob(_func, _tag, 0));
+
+    current_job& current = __current();
+    if (current.executor == this) {
+        Worker* self = static_cast<Worker*>(current.worker);
+        ScopedLock local(self->mutex);
+        self->jobs.push_back(job);
+        local.unlock();
+        ++pending_;
+
+        ScopedLock lock(mutex_);
+        __WakeLocked(lock);
+        return job;
+    }
+
+    ScopedLock lock(mutex_);
+    if (stop_) {
+        job->Cancel();
+        return job;
+    }
+    queue_.push_back(job);
+    ++pending_;
+    __WakeLocked(lock);
+    return job;
+}
+
+ExecutorJobPtr Executor::PostDelayed(const std::function<void()>& _func, int64_t _after_ms, const char* _tag) {
+    if (0 >= _after_ms)
+        return Post(_func, _tag);
+
+    ExecutorJobPtr job(new ExecutorJob(_func, _tag, gettickcount() + (uint64_t)_after_ms));
+    ScopedLock lock(mutex_);
+    if (stop_) {
+        job->Cancel();
+        return job;
+    }
+
+    Delayed delayed = {job->due_tick_, ++delayed_seq_, job};
+    delayed_.push_back(delayed);
+    std::push_heap(delayed_.begin(), delayed_.end());
+    // a sleeping worker recomputes its timeout
+    __WakeLocked(lock);
+    return job;
+}
+
+size_t Executor::WorkerCount() {
+    ScopedLock lock(mutex_);
+    return alive_;
+}
+
+void Executor::__Run(Worker* _worker) {
+    current_job& current = __current();
+    current.executor = this;
+    current.worker = _worker;
+
+    while (true) {
+        ExecutorJobPtr job;
+        if (__PopLocal(*_worker, job) || __PopShared(job) || __Steal(*_worker, job)) {
+            // canceled, or a joiner ran it already
+            if (job->__Begin())
+                job->__Execute();
+            continue;
+        }
+
+        if (!__Idle(*_worker))
+            break;
+    }
+
+    current.executor = NULL;
+    current.worker = NULL;
+}
+
+bool Executor::__PopLocal(Worker& _worker, ExecutorJobPtr& _job) {
+    ScopedLock lock(_worker.mutex);
+    if (_worker.jobs.empty())
+        return false;
+
+    _job = _worker.jobs.back();
+    _worker.jobs.pop_back();
+    --pending_;
+    return true;
+}
+
+bool Executor::__PopShared(ExecutorJobPtr& _job) {
+    ScopedLock lock(mutex_);
+    __PromoteDueLocked(gettickcount());
+    if (queue_.empty())
+        return false;
+
+    _job = queue_.front();
+    queue_.pop_front();
+    --pending_;
+    return true;
+}
+
+bool Executor::__Steal(Worker& _thief, ExecutorJobPtr& _job) {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[i];
+        if (&victim == &_thief)
+            continue;
+
+        ScopedLock lock(victim.mutex);
+        if (victim.jobs.empty())
+            continue;
+
+        _job = victim.jobs.front();
+        victim.jobs.pop_front();
+        --pending_;
+        return true;
+    }
+    return false;
+}
+
+// false when the worker has to exit: the executor stops, or an extra worker idled out
+bool Executor::__Idle(Worker& _worker) {
+    ScopedLock lock(mutex_);
+    ++idle_;
+    while (true) {
+        // idle_ is raised before pending_ is read and Post raises pending_ before reading idle_: one of them sees
+        // the other, so a post never slips between the check and the wait
+        if (stop_) {
+            --idle_;
+            return false;
+        }
+        uint64_t now = gettickcount();
+        if (0 < pending_.load() || __PromoteDueLocked(now)) {
+            --idle_;
+            return true;
+        }
+
+        int64_t timeout = kIdleKeepAlive;
+        if (!delayed_.empty()) {
+            timeout = std::min<int64_t>(timeout, (int64_t)(delayed_.front().due - now));
+        }
+        int ret = cond_.wait(lock, (long)std::max<int64_t>(1, timeout));
+
+        if (ETIMEDOUT == ret && timeout == kIdleKeepAlive && alive_ > core_workers_ && 0 == pending_.load()) {
+            ScopedLock local(_worker.mutex);
+            if (_worker.jobs.empty()) {
+                _worker.alive = false;
+                --alive_;
+                --idle_;
+                xinfo2(TSF "%_ worker idled out, alive:%_", name_, alive_);
+                return false;
+            }
+        }
+    }
+}
+
+void Executor::__WakeLocked(ScopedLock& _lock) {
+    size_t idle = idle_.load();
+    if (0 < idle) {
+        cond_.notifyOne(_lock);
+    }
+    // a notified worker stays in idle_ until it wakes, so back-to-back posts are counted against idle_, not its sign
+    if (!stop_ && idle < pending_.load() && alive_ < max_workers_) {
+        __SpawnLocked();
+    }
+}
+
+void Executor::__SpawnLocked() {
+    for (size_t i = 0; i < workers_.size(); ++i) {
+        Worker* worker = workers_[i];
+        if (worker->alive)
+            continue;
+
+        if (worker->thread) {  // retired, its thread is on the way out
+            worker->thread->join();
+            delete worker->thread;
+        }
+        worker->alive = true;
+        worker->thread = new Thread(std::bind(&Executor::__Run, this, worker), name_.c_str());
+        worker->thread->start();
+        ++alive_;
+        xinfo2_if(alive_ > core_workers_, TSF "%_ grows to %_ workers", name_, alive_);
+        return;
+    }
+}
+
+bool Executor::__PromoteDueLocked(uint64_t _now) {
+    bool promoted = false;
+    while (!delayed_.empty() && delayed_.front().due <= _now) {
+        std::pop_heap(delayed_.begin(), delayed_.end());
+        queue_.push_back(delayed_.back().job);
+        delayed_.pop_back();
+        ++pending_;
+        promoted = true;
+    }
+    return promoted;
+}
+
+}  // namespace comm
+}  // namespace mars
@@ -0,0 +1,163 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * executor.h
+ *
+ * A bounded pool for the blocking helpers that used to start a thread each.
+ * Jobs posted from a worker go to its own deque, the others to a shared queue;
+ * idle workers steal from the front of busy workers' deques. The pool keeps its
+ * core workers, grows while every worker is busy and shrinks back when idle.
+ * Jobs that hold their worker on network I/O go to Blocking(), so they can't
+ * fill Default() and hold up the short one-shot jobs queued there.
+ */
+
+#ifndef COMM_EXECUTOR_H_
+#define COMM_EXECUTOR_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "comm/thread/condition.h"
+#include "comm/thread/lock.h"
+#include "comm/thread/mutex.h"
+#include "comm/thread/thread.h"
+
+namespace mars {
+namespace comm {
+
+class Executor;
+
+class ExecutorJob {
+ public:
+    enum {
+        kQueued,
+        kRunning,
+        kDone,
+        kCanceled,
+    };
+
+ public:
+    // true when no worker has taken it yet; it never runs then
+    bool Cancel();
+    // runs it on the calling thread when no worker has taken it yet and its delay is over
+    bool TryRun();
+    // until it has run or been canceled; helps with TryRun first, so a worker joining a queued job can't stall
+    void Join();
+
+    bool IsRunning() const;  // queued, waiting for its delay, or running
+    int State() const;
+    const char* Tag() const;
+
+ private:
+    friend class Executor;
+    ExecutorJob(const std::function<void()>& _func, const char* _tag, uint64_t _due_tick);
+
+    bool __Begin();
+    void __Execute();
+    void __Finish(int _state);
+
+ private:
+    ExecutorJob(const ExecutorJob&);
+    ExecutorJob& operator=(const ExecutorJob&);
+
+ private:
+    std::function<void()> func_;
+    const char* tag_;
+    uint64_t post_tick_;
+    uint64_t due_tick_;
+    std::atomic<int> state_;
+    Mutex mutex_;
+    Condition cond_;
+};
+
+typedef std::shared_ptr<ExecutorJob> ExecutorJobPtr;
+
+class Executor {
+ public:
+    static const size_t kDefaultCoreWorkers = 4;
+    static const size_t kDefaultMaxWorkers = 64;
+    static const size_t kBlockingCoreWorkers = 2;
+    static const size_t kBlockingMaxWorkers = 128;
+    static const int64_t kIdleKeepAlive = 60 * 1000;  // ms, for workers beyond the core ones
+
+    // shared by the whole process, never destroyed
+    static Executor& Default();
+    // the same, for jobs blocked on the network for up to a task timeout: short links, resolves waiting on DNS
+    static Executor& Blocking();
+    // tag of the job running on the calling thread, "" outside of a job
+    static const char* CurrentTag();
+
+ public:
+    Executor(size_t _core_workers, size_t _max_workers, const char* _name);
+    // jobs not started by then are canceled
+    ~Executor();
+
+    // _tag must outlive the job, a string literal in practice
+    ExecutorJobPtr Post(const std::function<void()>& _func, const char* _tag = "");
+    ExecutorJobPtr PostDelayed(const std::function<void()>& _func, int64_t _after_ms, const char* _tag = "");
+
+    size_t WorkerCount();
+
+ private:
+    struct Worker;
+    struct Delayed {
+        uint64_t due;
+        uint64_t seq;
+        ExecutorJobPtr job;
+
+        bool operator<(const Delayed& _other) const {  // min-heap on due, fifo for the same due
+            return due != _other.due ? due > _other.due : seq > _other.seq;
+        }
+    };
+
+    void __Run(Worker* _worker);
+    bool __PopLocal(Worker& _worker, ExecutorJobPtr& _job);
+    bool __PopShared(ExecutorJobPtr& _job);
+    bool __Steal(Worker& _thief, ExecutorJobPtr& _job);
+    bool __Idle(Worker& _worker);
+    void __WakeLocked(ScopedLock& _lock);
+    void __SpawnLocked();
+    bool __PromoteDueLocked(uint64_t _now);
+
+ private:
+    Executor(const Executor&);
+    Executor& operator=(const Executor&);
+
+ private:
+    const size_t core_workers_;
+    const size_t max_workers_;
+    const std::string name_;
+
+    Mutex mutex_;
+    Condition cond_;
+    std::deque<ExecutorJobPtr> queue_;
+    std::vector<Delayed> delayed_;
+    uint64_t delayed_seq_;
+    std::vector<Worker*> workers_;  // max_workers_ slots, a slot is reused once its worker retired
+    size_t alive_;
+    bool stop_;
+
+    std::atomic<size_t> idle_;
+    std::atomic<size_t> pending_;  // posted and not yet taken by a worker
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif  // COMM_EXECUTOR_H_
@@ -0,0 +1,220 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * executor_unittest.cc
+ *
+ * Join, cancel, delays, the worker bound, growth for a burst of blocking jobs,
+ * stealing, and Default() staying free while Blocking() is full.
+ */
+
+#include "executor.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace mars::comm;
+
+namespace {
+
+// holds each job until _count of them run at the same time; false if they never do
+class Rendezvous {
+ public:
+    explicit Rendezvous(int _count) : count_(_count), arrived_(0) {
+    }
+
+    bool Arrive() {
+        ScopedLock lock(mutex_);
+        if (++arrived_ >= count_) {
+            cond_.notifyAll(lock);
+            return true;
+        }
+        while (arrived_ < count_) {
+            if (ETIMEDOUT == cond_.wait(lock, 10 * 1000))
+                return false;
+        }
+        return true;
+    }
+
+ private:
+    const int count_;
+    int arrived_;
+    Mutex mutex_;
+    Condition cond_;
+};
+
+}  // namespace
+
+TEST(executor, join_and_tag) {
+    Executor executor(2, 4, "test");
+    std::atomic<int> ran(0);
+    std::string tag;
+    ExecutorJobPtr job = executor.Post(
+        [&]() {
+            tag = Executor::CurrentTag();
+            ++ran;
+        },
+        "tagged");
+    job->Join();
+    EXPECT_EQ(1, ran);
+    EXPECT_EQ("tagged", tag);
+    EXPECT_EQ(ExecutorJob::kDone, job->State());
+    EXPECT_STREQ("", Executor::CurrentTag());
+}
+
+TEST(executor, joining_a_queued_job_runs_it) {
+    // one worker that posts and waits for its own child: the join runs the child inline
+    Executor executor(1, 1, "test");
+    std::atomic<int> ran(0);
+    executor
+        .Post([&]() {
+            ExecutorJobPtr child = executor.Post([&]() { ++ran; }, "child");
+            child->Join();
+            ++ran;
+        })
+        ->Join();
+    EXPECT_EQ(2, ran);
+}
+
+TEST(executor, cancel_delayed) {
+    Executor executor(1, 1, "test");
+    std::atomic<int> ran(0);
+    ExecutorJobPtr late = executor.PostDelayed([&]() { ++ran; }, 10 * 1000);
+    ExecutorJobPtr soon = executor.PostDelayed([&]() { ++ran; }, 50);
+
+    EXPECT_TRUE(late->Cancel());
+    EXPECT_FALSE(late->IsRunning());
+    late->Join();
+
+    auto begin = std::chrono::steady_clock::now();
+    soon->Join();
+    auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+    EXPECT_EQ(1, ran);
+    EXPECT_FALSE(soon->Cancel());
+    EXPECT_GE(cost.count(), 20);
+}
+
+TEST(executor, workers_stay_bounded) {
+    Executor executor(2, 8, "test");
+    std::atomic<int> ran(0);
+    std::vector<ExecutorJobPtr> jobs;
+    for (int i = 0; i < 32; ++i) {
+        jobs.push_back(executor.Post([&]() {
+            usleep(20 * 1000);
+            ++ran;
+        }));
+    }
+    EXPECT_LE(executor.WorkerCount(), 8u);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        jobs[i]->Join();
+    }
+    EXPECT_EQ(32, ran);
+    EXPECT_GE(executor.WorkerCount(), 2u);
+}
+
+TEST(executor, a_burst_of_blocking_jobs_runs_at_once) {
+    const int kJobs = 32;
+    Executor executor(kJobs / 2, kJobs, "test");
+    Rendezvous rendezvous(kJobs + 1);
+    std::atomic<int> met(0);
+
+    // posted back to back, before any worker wakes: each needs a worker of its own
+    std::vector<ExecutorJobPtr> jobs;
+    for (int i = 0; i < kJobs; ++i) {
+        jobs.push_back(executor.Post([&]() {
+            if (rendezvous.Arrive())
+                ++met;
+        }));
+    }
+    // joins only once they met, a join would run a job still queued right here
+    EXPECT_TRUE(rendezvous.Arrive());
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        jobs[i]->Join();
+    }
+    EXPECT_EQ(kJobs, met);
+    EXPECT_EQ((size_t)kJobs, executor.WorkerCount());
+}
+
+TEST(executor, stealing_spreads_posts_from_a_worker) {
+    Executor executor(4, 4, "test");
+    Rendezvous rendezvous(4 + 1);
+    std::atomic<int> ran(0);
+    std::atomic<int> met(0);
+    std::vector<ExecutorJobPtr> children;
+    Mutex mutex;
+
+    ExecutorJobPtr parent = executor.Post([&]() {
+        // all in this worker's deque; the others have to steal them to run in parallel
+        for (int i = 0; i < 8; ++i) {
+            ExecutorJobPtr child = executor.Post([&]() {
+                if (rendezvous.Arrive())
+                    ++met;
+                ++ran;
+            });
+            ScopedLock lock(mutex);
+            children.push_back(child);
+        }
+    });
+    // joins only once four children met, a join would run a job still queued right here
+    EXPECT_TRUE(rendezvous.Arrive());
+    parent->Join();
+    ScopedLock lock(mutex);
+    for (size_t i = 0; i < children.size(); ++i) {
+        children[i]->Join();
+    }
+    EXPECT_EQ(8, ran);
+    EXPECT_EQ(8, met);
+}
+
+TEST(executor, full_blocking_pool_leaves_default_free) {
+    Mutex mutex;
+    Condition cond;
+    bool release = false;
+    std::vector<ExecutorJobPtr> blocked;
+    // more blocked jobs than Default() could ever run at once
+    for (size_t i = 0; i < Executor::kDefaultMaxWorkers + 8; ++i) {
+        blocked.push_back(Executor::Blocking().Post(
+            [&]() {
+                ScopedLock lock(mutex);
+                while (!release) cond.wait(lock);
+            },
+            "blocked"));
+    }
+
+    std::atomic<bool> ran(false);
+    ExecutorJobPtr one_shot = Executor::Default().Post(
+        [&]() {
+            ScopedLock lock(mutex);
+            ran = true;
+            cond.notifyAll(lock);
+        },
+        "one_shot");
+    ScopedLock lock(mutex);
+    while (!ran) {
+        if (ETIMEDOUT == cond.wait(lock, 10 * 1000))
+            break;
+    }
+    EXPECT_TRUE(ran);
+    release = true;
+    cond.notifyAll(lock);
+    lock.unlock();
+
+    one_shot->Join();
+    for (size_t i = 0; i < blocked.size(); ++i) {
+        blocked[i]->Join();
+    }
+}
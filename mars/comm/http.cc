@@ -720,6 +720,26 @@ Parser::TRecvStatus Parser::Recv(const void* _buffer,
         return recvstatus_;
     }
 
+    if (__DirectBody()) {
+        // nothing is staged past the headers, the body goes to the receiver without a stop in recvbuf_
+        int64_t content_length = headfields_.ContentLength();
+        size_t appendlen = std::min(_length, (size_t)(content_length - (int64_t)bodyreceiver_->Length()));
+        xwarn2_if(appendlen < _length,
+                  TSF "recv len bigger than contentlen, (%_, %_, %_)",
+                  _length,
+                  bodyreceiver_->Length(),
+                  content_length);
+        bodyreceiver_->AppendData(_buffer, appendlen);
+        if (consumed_bytes) {
+            *consumed_bytes = appendlen;
+        }
+        if ((int64_t)bodyreceiver_->Length() == content_length) {
+            recvstatus_ = kEnd;
+            bodyreceiver_->EndData();
+        }
+        return recvstatus_;
+    }
+
     if (recvstatus_ < kBody && headerbuf_.Length() < 4096 && !response_header_ready_) {
         headerbuf_.Write(_buffer, std::min(_length, (size_t)4096));
 
@@ -829,6 +849,7 @@ Parser::TRecvStatus Parser::Recv(const void* _buffer,
                 }
 
                 headerlength_ = headerslength;
+                __ReserveBody();
                 if (only_parse_header) {
                     xwarn2(TSF "only parse headers.");
                     return recvstatus_;
@@ -1035,6 +1056,7 @@ Parser::TRecvStatus Parser::Recv(AutoBuffer& _recv_buffer) {
                 recvstatus_ = kBody;
                 _recv_buffer.Move(-headerslength);
                 headerlength_ = headerslength;
+                __ReserveBody();
             } break;
 
             case kBody: {
@@ -1155,6 +1177,38 @@ const HeaderFields& Parser::Fields() const {
     return headfields_;
 }
 
+size_t Parser::BodyPending() const {
+    if (!__DirectBody())
+        return 0;
+    return (size_t)(headfields_.ContentLength() - (int64_t)bodyreceiver_->Length());
+}
+
+Parser::TRecvStatus Parser::BodyReceived(size_t _length) {
+    xassert2(__DirectBody() && NULL != bodyreceiver_->InPlaceBuffer(), TSF "status:%_", recvstatus_);
+    xassert2(_length <= BodyPending(), TSF "received:%_, pending:%_", _length, BodyPending());
+
+    bodyreceiver_->total_length_ += _length;
+    if ((uint64_t)bodyreceiver_->Length() == headfields_.ContentLength()) {
+        recvstatus_ = kEnd;
+        bodyreceiver_->EndData();
+    }
+    return recvstatus_;
+}
+
+bool Parser::__DirectBody() const {
+    return kBody == recvstatus_ && NULL != bodyreceiver_ && 0 == recvbuf_.Length()
+           && !headfields_.IsTransferEncodingChunked() && 0 < headfields_.ContentLength();
+}
+
+void Parser::__ReserveBody() {
+    if (NULL == bodyreceiver_ || headfields_.IsTransferEncodingChunked())
+        return;
+    int64_t content_length = headfields_.ContentLength();
+    if (0 < content_length) {
+        bodyreceiver_->Reserve((size_t)content_length);
+    }
+}
+
 BodyReceiver& Parser::Body() {
     return *bodyreceiver_;
 }
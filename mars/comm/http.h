@@ -20,6 +20,7 @@
 #ifndef HTTP_H_
 #define HTTP_H_
 
+#include <algorithm>
 #include <list>
 #include <map>
 #include <string>
@@ -292,11 +293,20 @@ class BodyReceiver {
     }
     virtual void EndData() {
     }
+    // the headers announced _length body bytes, called before the first AppendData
+    virtual void Reserve(size_t /*_length*/) {
+    }
+    // where the body is kept, if in memory: the caller may receive into its end and report it with
+    // Parser::BodyReceived instead of going through AppendData
+    virtual AutoBuffer* InPlaceBuffer() {
+        return NULL;
+    }
     size_t Length() const {
         return total_length_;
     }
 
  private:
+    friend class Parser;
     size_t total_length_ = 0;
 };
 
@@ -310,6 +320,16 @@ class MemoryBodyReceiver : public BodyReceiver {
     }
     void EndData() override {
     }
+    void Reserve(size_t _length) override {
+        // a lying content-length can't make us allocate more than this up front
+        static const size_t kMaxReserve = 16 * 1024 * 1024;
+        size_t want = body_.Length() + std::min(_length, kMaxReserve);
+        if (want > body_.Capacity())
+            body_.AddCapacity(want - body_.Capacity());
+    }
+    AutoBuffer* InPlaceBuffer() override {
+        return &body_;
+    }
 
  private:
     AutoBuffer& body_;
@@ -344,6 +364,12 @@ class Parser {
     TRecvStatus Recv(AutoBuffer& _recv_buffer);
     TRecvStatus RecvStatus() const;
 
+    // body bytes still expected when they may be received straight into Body().InPlaceBuffer(): headers parsed,
+    // a content-length, not chunked and nothing buffered in the parser; 0 otherwise
+    size_t BodyPending() const;
+    // _length body bytes the caller received at the end of Body().InPlaceBuffer()
+    TRecvStatus BodyReceived(size_t _length);
+
     TCsMode CsMode() const;
     bool FirstLineReady() const;
     const RequestLine& Request() const;
@@ -364,6 +390,10 @@ class Parser {
     bool Error() const;
     bool Success() const;
 
+ private:
+    bool __DirectBody() const;
+    void __ReserveBody();
+
  private:
     TRecvStatus recvstatus_;
     AutoBuffer recvbuf_;
@@ -0,0 +1,628 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * http2.cc
+ */
+
+#include "http2.h"
+
+#include <algorithm>
+
+#include "comm/xlogger/xlogger.h"
+
+namespace http2 {
+
+const char kConnectionPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+namespace {
+
+struct StaticEntry {
+    const char* name;
+    const char* value;
+};
+
+// RFC 7541 appendix A, index 1 first
+static const StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+static const size_t kStaticTableCount = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+// RFC 7541 appendix B, the last one is EOS
+static const uint32_t kHuffmanCodes[257] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5,
+    0xfffffe6, 0xfffffe7, 0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9,
+    0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec, 0xfffffed, 0xfffffee,
+    0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9,
+    0xffffffa, 0xffffffb, 0x14, 0x3f8, 0x3f9, 0xffa,
+    0x1ff9, 0x15, 0xf8, 0x7fa, 0x3fa, 0x3fb,
+    0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b,
+    0x1c, 0x1d, 0x1e, 0x1f, 0x5c, 0xfb,
+    0x7ffc, 0x20, 0xffb, 0x3fc, 0x1ffa, 0x21,
+    0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e,
+    0x6f, 0x70, 0x71, 0x72, 0xfc, 0x73,
+    0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5,
+    0x25, 0x26, 0x27, 0x6, 0x74, 0x75,
+    0x28, 0x29, 0x2a, 0x7, 0x2b, 0x76,
+    0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd,
+    0x1ffd, 0xffffffc, 0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8,
+    0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9, 0x3fffd6, 0x7fffda,
+    0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1,
+    0x7fffe2, 0x7fffe3, 0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5,
+    0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef, 0x3fffda, 0x1fffdd,
+    0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf,
+    0x7fffeb, 0x7fffec, 0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2,
+    0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef, 0xfffea, 0x3fffe2,
+    0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2,
+    0x3fffe8, 0x1ffffec, 0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde,
+    0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed, 0x7fff2, 0x1fffe3,
+    0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3,
+    0x7ffffe4, 0x7ffffe5, 0xfffec, 0xfffff3, 0xfffed, 0x1fffe6,
+    0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3, 0x3fffea, 0x3fffeb,
+    0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8,
+    0x7ffffe9, 0x7ffffea, 0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed,
+    0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee, 0x3fffffff,
+};
+static const uint8_t kHuffmanBits[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+static const size_t kEntryOverhead = 32;
+static const size_t kMaxEncoderTableSize = 4096;  // what we are willing to keep for the peer's decoder
+
+struct HuffmanNode {
+    int16_t child[2];  // 0 for none, the root is never a child
+    int16_t symbol;    // -1 for inner nodes
+};
+
+static std::vector<HuffmanNode>* __BuildHuffmanTree() {
+    std::vector<HuffmanNode>* tree = new std::vector<HuffmanNode>(1);
+    (*tree)[0].child[0] = (*tree)[0].child[1] = 0;
+    (*tree)[0].symbol = -1;
+
+    for (int symbol = 0; symbol < 257; ++symbol) {
+        size_t node = 0;
+        for (int bit = kHuffmanBits[symbol] - 1; bit >= 0; --bit) {
+            int branch = (kHuffmanCodes[symbol] >> bit) & 1;
+            if (0 == (*tree)[node].child[branch]) {
+                HuffmanNode child;
+                child.child[0] = child.child[1] = 0;
+                child.symbol = -1;
+                tree->push_back(child);
+                (*tree)[node].child[branch] = (int16_t)(tree->size() - 1);
+            }
+            node = (*tree)[node].child[branch];
+        }
+        (*tree)[node].symbol = (int16_t)symbol;
+    }
+    return tree;
+}
+
+static const std::vector<HuffmanNode>& __HuffmanTree() {
+    static const std::vector<HuffmanNode>* tree = __BuildHuffmanTree();  // never freed, like the tables above
+    return *tree;
+}
+
+static void __Append(AutoBuffer& _out, const void* _data, size_t _length) {
+    _out.Seek(0, AutoBuffer::ESeekEnd);
+    _out.Write(_data, _length);
+}
+
+static void __AppendByte(AutoBuffer& _out, uint8_t _byte) {
+    __Append(_out, &_byte, 1);
+}
+
+static void __PutUint32(uint8_t* _buffer, uint32_t _value) {
+    _buffer[0] = (uint8_t)(_value >> 24);
+    _buffer[1] = (uint8_t)(_value >> 16);
+    _buffer[2] = (uint8_t)(_value >> 8);
+    _buffer[3] = (uint8_t)_value;
+}
+
+// RFC 7541 5.1
+static void __PackInt(uint8_t _flags, int _prefix_bits, uint64_t _value, AutoBuffer& _out) {
+    uint8_t max = (uint8_t)((1 << _prefix_bits) - 1);
+    if (_value < max) {
+        __AppendByte(_out, (uint8_t)(_flags | _value));
+        return;
+    }
+
+    __AppendByte(_out, (uint8_t)(_flags | max));
+    _value -= max;
+    while (_value >= 0x80) {
+        __AppendByte(_out, (uint8_t)((_value & 0x7f) | 0x80));
+        _value >>= 7;
+    }
+    __AppendByte(_out, (uint8_t)_value);
+}
+
+static bool __UnpackInt(const uint8_t*& _pos, const uint8_t* _end, int _prefix_bits, uint64_t& _value) {
+    if (_pos >= _end)
+        return false;
+
+    uint8_t max = (uint8_t)((1 << _prefix_bits) - 1);
+    _value = *_pos++ & max;
+    if (_value < max)
+        return true;
+
+    for (int shift = 0; _pos < _end && shift <= 56; shift += 7) {
+        uint8_t byte = *_pos++;
+        _value += (uint64_t)(byte & 0x7f) << shift;
+        if (0 == (byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// RFC 7541 5.2, huffman whenever it is shorter
+static void __PackString(const std::string& _str, AutoBuffer& _out) {
+    size_t huffman_length = HuffmanEncodedLength(_str);
+    if (huffman_length < _str.size()) {
+        __PackInt(0x80, 7, huffman_length, _out);
+        HuffmanEncode(_str, _out);
+    } else {
+        __PackInt(0x00, 7, _str.size(), _out);
+        __Append(_out, _str.data(), _str.size());
+    }
+}
+
+static bool __UnpackString(const uint8_t*& _pos, const uint8_t* _end, std::string& _str) {
+    if (_pos >= _end)
+        return false;
+
+    bool huffman = 0 != (*_pos & 0x80);
+    uint64_t length = 0;
+    if (!__UnpackInt(_pos, _end, 7, length) || length > (uint64_t)(_end - _pos))
+        return false;
+
+    bool ret = true;
+    if (huffman) {
+        ret = HuffmanDecode(_pos, (size_t)length, _str);
+    } else {
+        _str.assign((const char*)_pos, (size_t)length);
+    }
+    _pos += length;
+    return ret;
+}
+
+}  // namespace
+
+void PackFrameHeader(uint32_t _length, uint8_t _type, uint8_t _flags, uint32_t _stream_id, uint8_t* _header) {
+    _header[0] = (uint8_t)(_length >> 16);
+    _header[1] = (uint8_t)(_length >> 8);
+    _header[2] = (uint8_t)_length;
+    _header[3] = _type;
+    _header[4] = _flags;
+    __PutUint32(_header + 5, _stream_id & kMaxWindowSize);
+}
+
+void PackFrame(uint8_t _type,
+               uint8_t _flags,
+               uint32_t _stream_id,
+               const void* _payload,
+               size_t _length,
+               AutoBuffer& _out) {
+    uint8_t header[kFrameHeaderLength];
+    PackFrameHeader((uint32_t)_length, _type, _flags, _stream_id, header);
+    __Append(_out, header, sizeof(header));
+    if (0 < _length) {
+        __Append(_out, _payload, _length);
+    }
+}
+
+bool UnpackFrameHeader(const void* _buffer, size_t _length, FrameHeader& _header) {
+    if (_length < kFrameHeaderLength)
+        return false;
+
+    const uint8_t* header = (const uint8_t*)_buffer;
+    _header.length = ((uint32_t)header[0] << 16) | ((uint32_t)header[1] << 8) | header[2];
+    _header.type = header[3];
+    _header.flags = header[4];
+    _header.stream_id = ReadUint32(header + 5) & kMaxWindowSize;
+    return true;
+}
+
+void PackSettings(const SettingList& _settings, AutoBuffer& _out) {
+    std::vector<uint8_t> payload(_settings.size() * 6);
+    for (size_t i = 0; i < _settings.size(); ++i) {
+        payload[i * 6] = (uint8_t)(_settings[i].first >> 8);
+        payload[i * 6 + 1] = (uint8_t)_settings[i].first;
+        __PutUint32(&payload[i * 6 + 2], _settings[i].second);
+    }
+    PackFrame(kFrameSettings, 0, 0, payload.empty() ? NULL : &payload[0], payload.size(), _out);
+}
+
+void PackSettingsAck(AutoBuffer& _out) {
+    PackFrame(kFrameSettings, kFlagAck, 0, NULL, 0, _out);
+}
+
+void PackWindowUpdate(uint32_t _stream_id, uint32_t _increment, AutoBuffer& _out) {
+    uint8_t payload[4];
+    __PutUint32(payload, _increment & kMaxWindowSize);
+    PackFrame(kFrameWindowUpdate, 0, _stream_id, payload, sizeof(payload), _out);
+}
+
+void PackRstStream(uint32_t _stream_id, uint32_t _error_code, AutoBuffer& _out) {
+    uint8_t payload[4];
+    __PutUint32(payload, _error_code);
+    PackFrame(kFrameRstStream, 0, _stream_id, payload, sizeof(payload), _out);
+}
+
+void PackGoAway(uint32_t _last_stream_id, uint32_t _error_code, AutoBuffer& _out) {
+    uint8_t payload[8];
+    __PutUint32(payload, _last_stream_id & kMaxWindowSize);
+    __PutUint32(payload + 4, _error_code);
+    PackFrame(kFrameGoAway, 0, 0, payload, sizeof(payload), _out);
+}
+
+void PackPing(bool _ack, const void* _opaque, AutoBuffer& _out) {
+    PackFrame(kFramePing, _ack ? kFlagAck : 0, 0, _opaque, 8, _out);
+}
+
+bool UnpackSettings(const void* _payload, size_t _length, SettingList& _settings) {
+    if (0 != _length % 6)
+        return false;
+
+    const uint8_t* payload = (const uint8_t*)_payload;
+    for (size_t pos = 0; pos < _length; pos += 6) {
+        uint16_t id = (uint16_t)((payload[pos] << 8) | payload[pos + 1]);
+        _settings.push_back(std::make_pair(id, ReadUint32(payload + pos + 2)));
+    }
+    return true;
+}
+
+uint32_t ReadUint32(const void* _buffer) {
+    const uint8_t* buffer = (const uint8_t*)_buffer;
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | buffer[3];
+}
+
+HpackTable::HpackTable() : size_(0), max_size_(kDefaultHeaderTableSize) {
+}
+
+void HpackTable::SetMaxSize(size_t _max_size) {
+    max_size_ = _max_size;
+    __Evict(0);
+}
+
+size_t HpackTable::MaxSize() const {
+    return max_size_;
+}
+
+size_t HpackTable::Size() const {
+    return size_;
+}
+
+size_t HpackTable::Count() const {
+    return entries_.size();
+}
+
+void HpackTable::Add(const std::string& _name, const std::string& _value) {
+    size_t entry_size = _name.size() + _value.size() + kEntryOverhead;
+    if (entry_size > max_size_) {  // RFC 7541 4.4: empties the table and is not added
+        entries_.clear();
+        size_ = 0;
+        return;
+    }
+
+    __Evict(entry_size);
+    entries_.push_front(std::make_pair(_name, _value));
+    size_ += entry_size;
+}
+
+const std::pair<std::string, std::string>& HpackTable::Get(size_t _index) const {
+    return entries_[_index - 1];
+}
+
+void HpackTable::__Evict(size_t _room) {
+    while (!entries_.empty() && size_ + _room > max_size_) {
+        size_ -= entries_.back().first.size() + entries_.back().second.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+HpackEncoder::HpackEncoder() : pending_max_size_(kDefaultHeaderTableSize), size_update_(false) {
+}
+
+void HpackEncoder::SetMaxTableSize(size_t _max_size) {
+    pending_max_size_ = std::min(_max_size, kMaxEncoderTableSize);
+    size_update_ = pending_max_size_ != table_.MaxSize();
+}
+
+void HpackEncoder::Encode(const HeaderList& _headers, AutoBuffer& _out) {
+    if (size_update_) {
+        __PackInt(0x20, 5, pending_max_size_, _out);
+        table_.SetMaxSize(pending_max_size_);
+        size_update_ = false;
+    }
+
+    for (HeaderList::const_iterator it = _headers.begin(); it != _headers.end(); ++it) {
+        const std::string& name = it->first;
+        const std::string& value = it->second;
+
+        bool value_match = false;
+        size_t index = __Find(name, value, value_match);
+        if (0 != index && value_match) {
+            __PackInt(0x80, 7, index, _out);
+            continue;
+        }
+
+        bool indexing = false;
+        if ("authorization" == name || "proxy-authorization" == name) {
+            __PackInt(0x10, 4, index, _out);  // never indexed, not even by intermediaries
+        } else if (":path" == name || "content-length" == name) {
+            __PackInt(0x00, 4, index, _out);  // a new value every request, indexing it only evicts useful entries
+        } else {
+            __PackInt(0x40, 6, index, _out);
+            indexing = true;
+        }
+        if (0 == index) {
+            __PackString(name, _out);
+        }
+        __PackString(value, _out);
+
+        if (indexing) {
+            table_.Add(name, value);
+        }
+    }
+}
+
+size_t HpackEncoder::__Find(const std::string& _name, const std::string& _value, bool& _value_match) const {
+    size_t name_index = 0;
+    for (size_t i = 0; i < kStaticTableCount; ++i) {
+        if (_name != kStaticTable[i].name)
+            continue;
+        if (_value == kStaticTable[i].value) {
+            _value_match = true;
+            return i + 1;
+        }
+        if (0 == name_index)
+            name_index = i + 1;
+    }
+    for (size_t i = 1; i <= table_.Count(); ++i) {
+        const std::pair<std::string, std::string>& entry = table_.Get(i);
+        if (_name != entry.first)
+            continue;
+        if (_value == entry.second) {
+            _value_match = true;
+            return kStaticTableCount + i;
+        }
+        if (0 == name_index)
+            name_index = kStaticTableCount + i;
+    }
+    _value_match = false;
+    return name_index;
+}
+
+HpackDecoder::HpackDecoder() : max_size_(kDefaultHeaderTableSize) {
+}
+
+void HpackDecoder::SetMaxTableSize(size_t _max_size) {
+    max_size_ = _max_size;
+    if (table_.MaxSize() > _max_size) {
+        table_.SetMaxSize(_max_size);
+    }
+}
+
+bool HpackDecoder::Decode(const void* _block, size_t _length, HeaderList& _headers) {
+    const uint8_t* pos = (const uint8_t*)_block;
+    const uint8_t* end = pos + _length;
+    _headers.clear();
+
+    while (pos < end) {
+        uint8_t first = *pos;
+        uint64_t value = 0;
+
+        if (first & 0x80) {  // indexed
+            std::pair<std::string, std::string> field;
+            if (!__UnpackInt(pos, end, 7, value) || !__Lookup((size_t)value, field)) {
+                xerror2(TSF "bad indexed field %_", value);
+                return false;
+            }
+            _headers.push_back(field);
+            continue;
+        }
+
+        if (0x20 == (first & 0xe0)) {  // dynamic table size update
+            if (!__UnpackInt(pos, end, 5, value) || value > max_size_) {
+                xerror2(TSF "bad table size update %_, max %_", value, max_size_);
+                return false;
+            }
+            table_.SetMaxSize((size_t)value);
+            continue;
+        }
+
+        // literals: with incremental indexing, without indexing, never indexed
+        bool indexing = 0 != (first & 0x40);
+        std::pair<std::string, std::string> field;
+        if (!__UnpackInt(pos, end, indexing ? 6 : 4, value)) {
+            return false;
+        }
+        if (0 != value) {
+            std::pair<std::string, std::string> named;
+            if (!__Lookup((size_t)value, named)) {
+                xerror2(TSF "bad name index %_", value);
+                return false;
+            }
+            field.first = named.first;
+        } else if (!__UnpackString(pos, end, field.first)) {
+            return false;
+        }
+        if (!__UnpackString(pos, end, field.second)) {
+            return false;
+        }
+
+        if (indexing) {
+            table_.Add(field.first, field.second);
+        }
+        _headers.push_back(field);
+    }
+    return true;
+}
+
+bool HpackDecoder::__Lookup(size_t _index, std::pair<std::string, std::string>& _field) const {
+    if (0 == _index)
+        return false;
+    if (_index <= kStaticTableCount) {
+        _field.first = kStaticTable[_index - 1].name;
+        _field.second = kStaticTable[_index - 1].value;
+        return true;
+    }
+    if (_index - kStaticTableCount > table_.Count())
+        return false;
+    _field = table_.Get(_index - kStaticTableCount);
+    return true;
+}
+
+size_t HuffmanEncodedLength(const std::string& _str) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < _str.size(); ++i) {
+        bits += kHuffmanBits[(uint8_t)_str[i]];
+    }
+    return (size_t)((bits + 7) / 8);
+}
+
+void HuffmanEncode(const std::string& _str, AutoBuffer& _out) {
+    uint64_t bits = 0;
+    int count = 0;
+    for (size_t i = 0; i < _str.size(); ++i) {
+        uint8_t symbol = (uint8_t)_str[i];
+        bits = (bits << kHuffmanBits[symbol]) | kHuffmanCodes[symbol];
+        count += kHuffmanBits[symbol];
+        while (count >= 8) {
+            count -= 8;
+            __AppendByte(_out, (uint8_t)(bits >> count));
+        }
+    }
+    if (0 < count) {  // padded with the most significant bits of EOS
+        __AppendByte(_out, (uint8_t)((bits << (8 - count)) | (0xff >> count)));
+    }
+}
+
+bool HuffmanDecode(const void* _data, size_t _length, std::string& _str) {
+    const std::vector<HuffmanNode>& tree = __HuffmanTree();
+    const uint8_t* data = (const uint8_t*)_data;
+
+    _str.clear();
+    _str.reserve(_length * 8 / 5);
+    size_t node = 0;
+    int depth = 0;
+    bool all_ones = true;
+    for (size_t i = 0; i < _length; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            int branch = (data[i] >> bit) & 1;
+            node = tree[node].child[branch];
+            if (0 == node)
+                return false;
+            ++depth;
+            all_ones = all_ones && 1 == branch;
+
+            if (0 <= tree[node].symbol) {
+                if (256 == tree[node].symbol)  // EOS inside a string is an error
+                    return false;
+                _str.push_back((char)tree[node].symbol);
+                node = 0;
+                depth = 0;
+                all_ones = true;
+            }
+        }
+    }
+    // RFC 7541 5.2: at most 7 bits of padding, all ones
+    return depth < 8 && all_ones;
+}
+
+}  // namespace http2
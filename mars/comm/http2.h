@@ -0,0 +1,188 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * http2.h
+ *
+ * HTTP/2 framing (RFC 7540) and HPACK (RFC 7541), just the codec: connections
+ * and streams are up to the transport using them.
+ */
+
+#ifndef COMM_HTTP2_H_
+#define COMM_HTTP2_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mars/comm/autobuffer.h"
+
+namespace http2 {
+
+extern const char kConnectionPreface[];  // what a client sends first, 24 bytes
+static const size_t kConnectionPrefaceLength = 24;
+static const size_t kFrameHeaderLength = 9;
+
+static const uint32_t kDefaultWindowSize = 65535;
+static const uint32_t kMaxWindowSize = 0x7fffffff;
+static const uint32_t kDefaultMaxFrameSize = 16384;
+static const uint32_t kDefaultHeaderTableSize = 4096;
+
+enum TFrameType {
+    kFrameData = 0x0,
+    kFrameHeaders = 0x1,
+    kFramePriority = 0x2,
+    kFrameRstStream = 0x3,
+    kFrameSettings = 0x4,
+    kFramePushPromise = 0x5,
+    kFramePing = 0x6,
+    kFrameGoAway = 0x7,
+    kFrameWindowUpdate = 0x8,
+    kFrameContinuation = 0x9,
+};
+
+enum TFrameFlag {
+    kFlagEndStream = 0x1,
+    kFlagAck = 0x1,
+    kFlagEndHeaders = 0x4,
+    kFlagPadded = 0x8,
+    kFlagPriority = 0x20,
+};
+
+enum TSettingsId {
+    kSettingsHeaderTableSize = 0x1,
+    kSettingsEnablePush = 0x2,
+    kSettingsMaxConcurrentStreams = 0x3,
+    kSettingsInitialWindowSize = 0x4,
+    kSettingsMaxFrameSize = 0x5,
+    kSettingsMaxHeaderListSize = 0x6,
+};
+
+enum TErrorCode {
+    kNoError = 0x0,
+    kProtocolError = 0x1,
+    kInternalError = 0x2,
+    kFlowControlError = 0x3,
+    kSettingsTimeout = 0x4,
+    kStreamClosed = 0x5,
+    kFrameSizeError = 0x6,
+    kRefusedStream = 0x7,
+    kCancel = 0x8,
+    kCompressionError = 0x9,
+    kConnectError = 0xa,
+    kEnhanceYourCalm = 0xb,
+    kInadequateSecurity = 0xc,
+    kHttp11Required = 0xd,
+};
+
+struct FrameHeader {
+    FrameHeader() : length(0), type(0), flags(0), stream_id(0) {
+    }
+
+    uint32_t length;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream_id;
+};
+
+typedef std::vector<std::pair<std::string, std::string>> HeaderList;
+typedef std::vector<std::pair<uint16_t, uint32_t>> SettingList;
+
+// the 9 header bytes alone, for a payload sent from where it already is
+void PackFrameHeader(uint32_t _length, uint8_t _type, uint8_t _flags, uint32_t _stream_id, uint8_t* _header);
+void PackFrame(uint8_t _type,
+               uint8_t _flags,
+               uint32_t _stream_id,
+               const void* _payload,
+               size_t _length,
+               AutoBuffer& _out);
+// false while less than a frame header is there
+bool UnpackFrameHeader(const void* _buffer, size_t _length, FrameHeader& _header);
+
+void PackSettings(const SettingList& _settings, AutoBuffer& _out);
+void PackSettingsAck(AutoBuffer& _out);
+void PackWindowUpdate(uint32_t _stream_id, uint32_t _increment, AutoBuffer& _out);
+void PackRstStream(uint32_t _stream_id, uint32_t _error_code, AutoBuffer& _out);
+void PackGoAway(uint32_t _last_stream_id, uint32_t _error_code, AutoBuffer& _out);
+void PackPing(bool _ack, const void* _opaque /*8 bytes*/, AutoBuffer& _out);
+// false on a malformed payload
+bool UnpackSettings(const void* _payload, size_t _length, SettingList& _settings);
+
+uint32_t ReadUint32(const void* _buffer);
+
+// the dynamic table both ends keep in step; index 1 is the newest entry
+class HpackTable {
+ public:
+    HpackTable();
+
+    void SetMaxSize(size_t _max_size);
+    size_t MaxSize() const;
+    size_t Size() const;
+    size_t Count() const;
+
+    void Add(const std::string& _name, const std::string& _value);
+    const std::pair<std::string, std::string>& Get(size_t _index) const;
+
+ private:
+    void __Evict(size_t _room);
+
+ private:
+    std::deque<std::pair<std::string, std::string>> entries_;
+    size_t size_;
+    size_t max_size_;
+};
+
+class HpackEncoder {
+ public:
+    HpackEncoder();
+
+    // the peer's SETTINGS_HEADER_TABLE_SIZE; the next block carries the size update
+    void SetMaxTableSize(size_t _max_size);
+    // names must be lowercase; values that change per request (":path", "content-length") are not indexed
+    void Encode(const HeaderList& _headers, AutoBuffer& _out);
+
+ private:
+    size_t __Find(const std::string& _name, const std::string& _value, bool& _value_match) const;
+
+ private:
+    HpackTable table_;
+    size_t pending_max_size_;
+    bool size_update_;
+};
+
+class HpackDecoder {
+ public:
+    HpackDecoder();
+
+    // what we announced as SETTINGS_HEADER_TABLE_SIZE
+    void SetMaxTableSize(size_t _max_size);
+    // replaces _headers; false on a compression error, which breaks the whole connection
+    bool Decode(const void* _block, size_t _length, HeaderList& _headers);
+
+ private:
+    bool __Lookup(size_t _index, std::pair<std::string, std::string>& _field) const;
+
+ private:
+    HpackTable table_;
+    size_t max_size_;
+};
+
+size_t HuffmanEncodedLength(const std::string& _str);
+void HuffmanEncode(const std::string& _str, AutoBuffer& _out);
+bool HuffmanDecode(const void* _data, size_t _length, std::string& _str);
+
+}  // namespace http2
+
+#endif  // COMM_HTTP2_H_
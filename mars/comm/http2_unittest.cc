@@ -0,0 +1,189 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * http2_unittest.cc
+ *
+ * HPACK against the examples of RFC 7541 appendix C, the encoder and decoder
+ * against each other, and what the dynamic table saves on repeated headers.
+ */
+
+#include "http2.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+using namespace http2;
+
+static std::string Unhex(const std::string& _hex) {
+    std::string bytes;
+    for (size_t i = 0; i + 1 < _hex.size(); i += 2) {
+        bytes.push_back((char)strtol(_hex.substr(i, 2).c_str(), NULL, 16));
+    }
+    return bytes;
+}
+
+static std::string Bytes(const AutoBuffer& _buffer) {
+    return std::string((const char*)_buffer.Ptr(), _buffer.Length());
+}
+
+static HeaderList Request(const std::string& _path, const std::string& _custom) {
+    HeaderList headers;
+    headers.push_back(std::make_pair(":method", "GET"));
+    headers.push_back(std::make_pair(":scheme", "http"));
+    headers.push_back(std::make_pair(":path", _path));
+    headers.push_back(std::make_pair(":authority", "www.example.com"));
+    if (!_custom.empty()) {
+        headers.push_back(std::make_pair("cache-control", "no-cache"));
+    }
+    return headers;
+}
+
+TEST(hpack, rfc7541_c3_requests_without_huffman) {
+    HpackDecoder decoder;
+    HeaderList headers;
+
+    std::string first = Unhex("828684410f7777772e6578616d706c652e636f6d");
+    ASSERT_TRUE(decoder.Decode(first.data(), first.size(), headers));
+    EXPECT_TRUE(Request("/", "") == headers);
+
+    std::string second = Unhex("828684be58086e6f2d6361636865");
+    ASSERT_TRUE(decoder.Decode(second.data(), second.size(), headers));
+    EXPECT_TRUE(Request("/", "cache") == headers);
+
+    std::string third = Unhex("828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565");
+    ASSERT_TRUE(decoder.Decode(third.data(), third.size(), headers));
+    ASSERT_EQ(5u, headers.size());
+    EXPECT_EQ("https", headers[1].second);
+    EXPECT_EQ("/index.html", headers[2].second);
+    EXPECT_EQ("www.example.com", headers[3].second);
+    EXPECT_EQ("custom-key", headers[4].first);
+    EXPECT_EQ("custom-value", headers[4].second);
+}
+
+TEST(hpack, rfc7541_c4_requests_with_huffman) {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    const char* kExpected[] = {
+        "828684418cf1e3c2e5f23a6ba0ab90f4ff",
+        "828684be5886a8eb10649cbf",
+        "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf",
+    };
+
+    HeaderList requests[3] = {Request("/", ""), Request("/", "cache"), HeaderList()};
+    requests[2].push_back(std::make_pair(":method", "GET"));
+    requests[2].push_back(std::make_pair(":scheme", "https"));
+    requests[2].push_back(std::make_pair(":path", "/index.html"));
+    requests[2].push_back(std::make_pair(":authority", "www.example.com"));
+    requests[2].push_back(std::make_pair("custom-key", "custom-value"));
+
+    for (int i = 0; i < 3; ++i) {
+        AutoBuffer block;
+        encoder.Encode(requests[i], block);
+        EXPECT_EQ(Unhex(kExpected[i]), Bytes(block)) << "request " << i;
+
+        HeaderList headers;
+        ASSERT_TRUE(decoder.Decode(block.Ptr(), block.Length(), headers));
+        EXPECT_TRUE(requests[i] == headers) << "request " << i;
+    }
+}
+
+TEST(hpack, rfc7541_c6_eviction) {
+    HpackDecoder decoder;
+    decoder.SetMaxTableSize(256);
+    HeaderList headers;
+
+    std::string first = Unhex(
+        "488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff6e919d29ad171863c78f0b97c8e9ae82ae43d3");
+    ASSERT_TRUE(decoder.Decode(first.data(), first.size(), headers));
+    ASSERT_EQ(4u, headers.size());
+    EXPECT_EQ(":status", headers[0].first);
+    EXPECT_EQ("302", headers[0].second);
+    EXPECT_EQ("private", headers[1].second);
+    EXPECT_EQ("Mon, 21 Oct 2013 20:13:21 GMT", headers[2].second);
+    EXPECT_EQ("https://www.example.com", headers[3].second);
+
+    // ":status 307" pushes ":status 302" out of the 256 byte table
+    std::string second = Unhex("4883640effc1c0bf");
+    ASSERT_TRUE(decoder.Decode(second.data(), second.size(), headers));
+    ASSERT_EQ(4u, headers.size());
+    EXPECT_EQ("307", headers[0].second);
+    EXPECT_EQ("private", headers[1].second);
+    EXPECT_EQ("https://www.example.com", headers[3].second);
+
+    // index 66 would be the evicted entry
+    std::string evicted = Unhex("bf");
+    evicted[0] = (char)(0x80 | 66);
+    EXPECT_FALSE(decoder.Decode(evicted.data(), evicted.size(), headers));
+}
+
+TEST(hpack, repeated_headers_shrink) {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+
+    HeaderList headers;
+    headers.push_back(std::make_pair(":method", "POST"));
+    headers.push_back(std::make_pair(":scheme", "http"));
+    headers.push_back(std::make_pair(":authority", "short.weixin.qq.com"));
+    headers.push_back(std::make_pair(":path", "/cgi-bin/micromsg-bin/newsync"));
+    headers.push_back(std::make_pair("accept", "*/*"));
+    headers.push_back(std::make_pair("user-agent", "MicroMessenger Client"));
+    headers.push_back(std::make_pair("cache-control", "no-cache"));
+    headers.push_back(std::make_pair("content-type", "application/octet-stream"));
+    headers.push_back(std::make_pair("content-length", "1024"));
+    headers.push_back(std::make_pair("authorization", "secret"));
+
+    AutoBuffer first;
+    encoder.Encode(headers, first);
+    headers[8].second = "2048";
+    AutoBuffer second;
+    encoder.Encode(headers, second);
+
+    size_t plain = 0;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        plain += headers[i].first.size() + headers[i].second.size() + 4;
+    }
+    EXPECT_LT(first.Length(), plain);
+    // what repeats is one byte per field from the second request on; the path and the length are sent each time
+    EXPECT_LT(second.Length(), first.Length() / 2);
+
+    HeaderList decoded;
+    ASSERT_TRUE(decoder.Decode(first.Ptr(), first.Length(), decoded));
+    ASSERT_TRUE(decoder.Decode(second.Ptr(), second.Length(), decoded));
+    EXPECT_TRUE(headers == decoded);
+
+    // "authorization" is never indexed: static name 23 behind the 0001 prefix, in every request
+    EXPECT_NE(std::string::npos, Bytes(second).find(Unhex("1f08")));
+}
+
+TEST(http2, frames) {
+    AutoBuffer out;
+    PackWindowUpdate(3, 0x10000, out);
+    FrameHeader header;
+    ASSERT_TRUE(UnpackFrameHeader(out.Ptr(), out.Length(), header));
+    EXPECT_EQ(4u, header.length);
+    EXPECT_EQ(kFrameWindowUpdate, header.type);
+    EXPECT_EQ(3u, header.stream_id);
+    EXPECT_EQ(0x10000u, ReadUint32(out.Ptr(kFrameHeaderLength)));
+    EXPECT_FALSE(UnpackFrameHeader(out.Ptr(), kFrameHeaderLength - 1, header));
+
+    SettingList settings;
+    settings.push_back(std::make_pair((uint16_t)kSettingsInitialWindowSize, (uint32_t)1 << 20));
+    settings.push_back(std::make_pair((uint16_t)kSettingsEnablePush, (uint32_t)0));
+    AutoBuffer packed;
+    PackSettings(settings, packed);
+    SettingList unpacked;
+    ASSERT_TRUE(UnpackSettings(packed.Ptr(kFrameHeaderLength), packed.Length() - kFrameHeaderLength, unpacked));
+    EXPECT_TRUE(settings == unpacked);
+    EXPECT_FALSE(UnpackSettings(packed.Ptr(kFrameHeaderLength), 5, unpacked));
+}
@@ -30,7 +30,9 @@
 #include "boost/bind.hpp"
 #include "comm/anr.h"
 #include "comm/bootrun.h"
+#include "comm/executor.h"
 #include "comm/messagequeue/message_queue.h"
+#include "comm/metrics.h"
 #include "comm/thread/lock.h"
 #include "comm/time_utils.h"
 #ifdef __APPLE__
@@ -51,6 +53,9 @@ std::function<void(size_t, std::string)> g_mq_max_size_callback = nullptr;
 
 #define MAX_MQ_SIZE 5000
 
+static Counter sg_dispatched("comm.messagequeue.dispatched");
+static Histogram sg_handler_ns("comm.messagequeue.handler_ns");
+
 static unsigned int __MakeSeq() {
     static unsigned int s_seq = 0;
 
@@ -873,12 +878,12 @@ static void __ANRCheckCallback(bool _iOS_style, const mars::comm::check_content&
     MessageHandler_t mq_id = *((MessageHandler_t*)_content.extra_info);
     xinfo2(TSF "anr check content:%_, handler:(%_,%_)", _content.call_id, mq_id.queue, mq_id.seq);
 
-    std::shared_ptr<Thread> thread(new Thread(boost::bind(__ANRAssert, _iOS_style, _content, mq_id)));
-    thread->start_after(kWaitANRTimeout);
+    ExecutorJobPtr assert_job =
+        Executor::Default().PostDelayed(boost::bind(__ANRAssert, _iOS_style, _content, mq_id), kWaitANRTimeout, "anr");
 
     MessageQueue::AsyncInvoke(
         [=]() {
-            if (thread->isruning()) {
+            if (assert_job->Cancel()) {
                 xinfo2(
                     TSF
                     "misjudge anr, timeout:%_, tid:%_, runing time:%_, real time:%_, used_cpu_time:%_, handler:(%_,%_)",
@@ -889,7 +894,6 @@ static void __ANRCheckCallback(bool _iOS_style, const mars::comm::check_content&
                     _content.used_cpu_time,
                     mq_id.queue,
                     mq_id.seq);
-                thread->cancel_after();
             }
         },
         MessageQueue::DefAsyncInvokeHandler(mq_id.queue),
@@ -1011,6 +1015,8 @@ void RunLoop::Run() {
         messagewrapper->message.execute_time = ::gettickcount();
         for (std::list<HandlerWrapper>::iterator it = fit_handler.begin(); it != fit_handler.end(); ++it) {
             SCOPE_ANR_AUTO((int)anr_timeout, kMQCallANRId, &(*it).reg);
+            sg_dispatched.Add();
+            Histogram::ScopedTimer handler_timer(sg_handler_ns);
             uint64_t timestart = ::clock_app_monotonic();
             (*it).handler(messagewrapper->postid, messagewrapper->message);
             uint64_t timeend = ::clock_app_monotonic();
@@ -0,0 +1,333 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * metrics.cc
+ */
+
+#include "metrics.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "comm/time_utils.h"
+#include "comm/xlogger/xlogger.h"
+
+namespace mars {
+namespace comm {
+
+const size_t Metric::kMaxMetrics;
+const int Histogram::kSubBucketBits;
+const size_t Histogram::kSubBuckets;
+const size_t Histogram::kBuckets;
+const size_t Histogram::kCells;
+
+struct MetricsRegistry::Entry {
+    std::string name;
+    Metric::Kind kind;
+    size_t cells;
+    const std::atomic<int64_t>* gauge;
+    std::vector<int64_t> retired;  // what the exited threads left
+};
+
+// its destructor hands the thread's cells back when the thread exits
+struct MetricsRegistry::ThreadExit {
+    ~ThreadExit() {
+        MetricsRegistry::Shared().__OnThreadExit();
+    }
+};
+
+namespace {
+
+// taken by id 0, a metric recorded into before its constructor ran, and by a thread past its exit; never read
+std::atomic<int64_t> sg_sink[Histogram::kCells];
+
+thread_local bool sg_thread_exited = false;
+
+void AppendJsonString(std::string& _json, const std::string& _str) {
+    _json += '"';
+    for (size_t i = 0; i < _str.size(); ++i) {
+        char c = _str[i];
+        if ('"' == c || '\\' == c) {
+            _json += '\\';
+            _json += c;
+        } else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+            _json += escaped;
+        } else {
+            _json += c;
+        }
+    }
+    _json += '"';
+}
+
+const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+const char* const kQuantileNames[] = {"p50", "p90", "p99", "p999", "max"};
+
+}  // namespace
+
+Metric::Metric(const char* _name, Kind _kind, size_t _cells, const std::atomic<int64_t>* _gauge)
+: id_(MetricsRegistry::Shared().__Register(_name, _kind, _cells, _gauge)) {
+}
+
+std::atomic<int64_t>* Metric::__NewCells() const {
+    return MetricsRegistry::Shared().__NewCells(id_);
+}
+
+uint64_t MetricsSnapshot::HistogramData::Percentile(double _quantile) const {
+    if (0 == count || buckets.empty())
+        return 0;
+
+    uint64_t rank = (uint64_t)(_quantile * count + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen < rank)
+            continue;
+        uint64_t width = i < 2 * Histogram::kSubBuckets ? 1 : (uint64_t)1 << ((i >> Histogram::kSubBucketBits) - 1);
+        return Histogram::BucketLowest(i) + width / 2;
+    }
+    return 0;
+}
+
+MetricsSnapshot MetricsSnapshot::Diff(const MetricsSnapshot& _earlier) const {
+    MetricsSnapshot diff = *this;
+    for (std::map<std::string, int64_t>::iterator it = diff.counters.begin(); it != diff.counters.end(); ++it) {
+        std::map<std::string, int64_t>::const_iterator then = _earlier.counters.find(it->first);
+        if (_earlier.counters.end() != then)
+            it->second -= then->second;
+    }
+
+    for (std::map<std::string, HistogramData>::iterator it = diff.histograms.begin(); it != diff.histograms.end();
+         ++it) {
+        std::map<std::string, HistogramData>::const_iterator then = _earlier.histograms.find(it->first);
+        if (_earlier.histograms.end() == then)
+            continue;
+        HistogramData& now = it->second;
+        now.count -= then->second.count;
+        now.sum -= then->second.sum;
+        for (size_t i = 0; i < now.buckets.size() && i < then->second.buckets.size(); ++i) {
+            now.buckets[i] -= then->second.buckets[i];
+        }
+    }
+    return diff;
+}
+
+std::string MetricsSnapshot::ToText() const {
+    std::string text;
+    char line[512];
+    for (std::map<std::string, int64_t>::const_iterator it = counters.begin(); it != counters.end(); ++it) {
+        snprintf(line, sizeof(line), "counter %s %" PRId64 "\n", it->first.c_str(), it->second);
+        text += line;
+    }
+    for (std::map<std::string, int64_t>::const_iterator it = gauges.begin(); it != gauges.end(); ++it) {
+        snprintf(line, sizeof(line), "gauge %s %" PRId64 "\n", it->first.c_str(), it->second);
+        text += line;
+    }
+    for (std::map<std::string, HistogramData>::const_iterator it = histograms.begin(); it != histograms.end(); ++it) {
+        const HistogramData& data = it->second;
+        int len = snprintf(line,
+                           sizeof(line),
+                           "histogram %s count:%" PRIu64 " mean:%" PRIu64,
+                           it->first.c_str(),
+                           data.count,
+                           data.Mean());
+        text.append(line, std::min(len, (int)sizeof(line) - 1));
+        for (size_t i = 0; i < sizeof(kQuantiles) / sizeof(kQuantiles[0]); ++i) {
+            snprintf(line, sizeof(line), " %s:%" PRIu64, kQuantileNames[i], data.Percentile(kQuantiles[i]));
+            text += line;
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+std::string MetricsSnapshot::ToJson() const {
+    std::string json;
+    char number[64];
+    snprintf(number, sizeof(number), "{\"tick\":%" PRIu64 ",\"counters\":{", tick);
+    json += number;
+    for (std::map<std::string, int64_t>::const_iterator it = counters.begin(); it != counters.end(); ++it) {
+        if (counters.begin() != it)
+            json += ',';
+        AppendJsonString(json, it->first);
+        snprintf(number, sizeof(number), ":%" PRId64, it->second);
+        json += number;
+    }
+
+    json += "},\"gauges\":{";
+    for (std::map<std::string, int64_t>::const_iterator it = gauges.begin(); it != gauges.end(); ++it) {
+        if (gauges.begin() != it)
+            json += ',';
+        AppendJsonString(json, it->first);
+        snprintf(number, sizeof(number), ":%" PRId64, it->second);
+        json += number;
+    }
+
+    json += "},\"histograms\":{";
+    for (std::map<std::string, HistogramData>::const_iterator it = histograms.begin(); it != histograms.end(); ++it) {
+        const HistogramData& data = it->second;
+        if (histograms.begin() != it)
+            json += ',';
+        AppendJsonString(json, it->first);
+        snprintf(number, sizeof(number), ":{\"count\":%" PRIu64 ",\"sum\":%" PRId64, data.count, data.sum);
+        json += number;
+        for (size_t i = 0; i < sizeof(kQuantiles) / sizeof(kQuantiles[0]); ++i) {
+            snprintf(number, sizeof(number), ",\"%s\":%" PRIu64, kQuantileNames[i], data.Percentile(kQuantiles[i]));
+            json += number;
+        }
+
+        // only the buckets holding something, as [lowest value, count]
+        json += ",\"buckets\":[";
+        bool first = true;
+        for (size_t i = 0; i < data.buckets.size(); ++i) {
+            if (0 == data.buckets[i])
+                continue;
+            snprintf(number,
+                     sizeof(number),
+                     "%s[%" PRIu64 ",%" PRIu64 "]",
+                     first ? "" : ",",
+                     Histogram::BucketLowest(i),
+                     data.buckets[i]);
+            json += number;
+            first = false;
+        }
+        json += "]}";
+    }
+    json += "}}";
+    return json;
+}
+
+MetricsRegistry& MetricsRegistry::Shared() {
+    static MetricsRegistry* registry = new MetricsRegistry();
+    return *registry;
+}
+
+MetricsRegistry::MetricsRegistry() : entries_(1, (Entry*)NULL) {
+}
+
+void MetricsRegistry::Snapshot(MetricsSnapshot& _snapshot) const {
+    _snapshot = MetricsSnapshot();
+
+    ScopedLock lock(mutex_);
+    _snapshot.tick = ::gettickcount();
+    std::vector<int64_t> values;
+    for (size_t id = 1; id < entries_.size(); ++id) {
+        const Entry& entry = *entries_[id];
+        if (Metric::kGauge == entry.kind) {
+            _snapshot.gauges[entry.name] += entry.gauge->load(std::memory_order_relaxed);
+            continue;
+        }
+
+        values = entry.retired;
+        for (size_t i = 0; i < threads_.size(); ++i) {
+            const std::atomic<int64_t>* cells = threads_[i]->slots[id].load(std::memory_order_acquire);
+            if (NULL == cells)
+                continue;
+            for (size_t j = 0; j < entry.cells; ++j) {
+                values[j] += cells[j].load(std::memory_order_relaxed);
+            }
+        }
+
+        if (Metric::kCounter == entry.kind) {
+            _snapshot.counters[entry.name] += values[0];
+            continue;
+        }
+
+        MetricsSnapshot::HistogramData& data = _snapshot.histograms[entry.name];
+        data.buckets.resize(Histogram::kBuckets, 0);
+        for (size_t i = 0; i < Histogram::kBuckets; ++i) {
+            data.buckets[i] += values[i];
+            data.count += values[i];
+        }
+        data.sum += values[Histogram::kBuckets];
+    }
+}
+
+size_t MetricsRegistry::__Register(const char* _name,
+                                   Metric::Kind _kind,
+                                   size_t _cells,
+                                   const std::atomic<int64_t>* _gauge) {
+    ScopedLock lock(mutex_);
+    if (Metric::kMaxMetrics <= entries_.size()) {
+        lock.unlock();
+        xerror2(TSF "metric %_ dropped, all %_ ids taken", _name, Metric::kMaxMetrics);
+        return 0;
+    }
+
+    Entry* entry = new Entry();
+    entry->name = _name;
+    entry->kind = _kind;
+    entry->cells = _cells;
+    entry->gauge = _gauge;
+    entry->retired.resize(_cells, 0);
+    entries_.push_back(entry);
+    return entries_.size() - 1;
+}
+
+std::atomic<int64_t>* MetricsRegistry::__NewCells(size_t _id) {
+    if (sg_thread_exited)
+        return sg_sink;
+
+    Metric::ThreadCells*& local = Metric::__Local();
+    ScopedLock lock(mutex_);
+    if (NULL == local) {
+        local = new Metric::ThreadCells();
+        for (size_t i = 0; i < Metric::kMaxMetrics; ++i) {
+            local->slots[i].store(NULL, std::memory_order_relaxed);
+        }
+        local->slots[0].store(sg_sink, std::memory_order_relaxed);
+        threads_.push_back(local);
+        static thread_local ThreadExit thread_exit;
+        (void)thread_exit;
+    }
+
+    if (0 == _id || entries_.size() <= _id || 0 == entries_[_id]->cells)
+        return sg_sink;
+
+    size_t count = entries_[_id]->cells;
+    std::atomic<int64_t>* cells = new std::atomic<int64_t>[count];
+    for (size_t i = 0; i < count; ++i) {
+        cells[i].store(0, std::memory_order_relaxed);
+    }
+    local->slots[_id].store(cells, std::memory_order_release);
+    return cells;
+}
+
+void MetricsRegistry::__OnThreadExit() {
+    sg_thread_exited = true;
+    Metric::ThreadCells*& local = Metric::__Local();
+    if (NULL == local)
+        return;
+
+    ScopedLock lock(mutex_);
+    threads_.erase(std::remove(threads_.begin(), threads_.end(), local), threads_.end());
+    for (size_t id = 1; id < entries_.size(); ++id) {
+        std::atomic<int64_t>* cells = local->slots[id].load(std::memory_order_relaxed);
+        if (NULL == cells)
+            continue;
+        Entry& entry = *entries_[id];
+        for (size_t i = 0; i < entry.cells; ++i) {
+            entry.retired[i] += cells[i].load(std::memory_order_relaxed);
+        }
+        delete[] cells;
+    }
+    delete local;
+    local = NULL;
+}
+
+}  // namespace comm
+}  // namespace mars
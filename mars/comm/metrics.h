@@ -0,0 +1,266 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * metrics.h
+ *
+ * Counters, gauges and latency histograms any module declares at module
+ * scope and one registry snapshots, diffs and dumps as text or JSON:
+ *
+ *     static mars::comm::Counter sg_sent_bytes("stn.longlink.sent_bytes");
+ *     sg_sent_bytes.Add(writelen);
+ *
+ * Counters and histograms keep a set of cells per thread, created on the
+ * thread's first record and only ever written by it, so a record is a
+ * thread-local load and a plain add, no lock and no locked instruction.
+ * A snapshot sums the cells of the live threads and what exited threads
+ * left behind. Histograms are log-linear, as HdrHistogram: 8 linear buckets
+ * per power of two, so a percentile is off by at most 1/16 of its value.
+ *
+ * A metric stays registered for the life of the process and is meant for
+ * module scope or a static: one made per object would run out of the
+ * kMaxMetrics ids. Recording into one not yet constructed, from another
+ * module's static initialization, is dropped rather than crashing.
+ * Metrics of the same name add up in a snapshot.
+ */
+
+#ifndef COMM_METRICS_H_
+#define COMM_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "comm/thread/lock.h"
+
+namespace mars {
+namespace comm {
+
+class MetricsRegistry;
+
+class Metric {
+ public:
+    enum Kind {
+        kCounter,
+        kGauge,
+        kHistogram,
+    };
+
+    // ids ever handed out, across all modules; id 0 takes what is recorded into an unconstructed metric
+    static const size_t kMaxMetrics = 512;
+
+ protected:
+    Metric(const char* _name, Kind _kind, size_t _cells, const std::atomic<int64_t>* _gauge = NULL);
+
+    // this thread's _cells cells of the metric
+    std::atomic<int64_t>* __Cells() const {
+        ThreadCells* local = __Local();
+        if (NULL != local) {
+            std::atomic<int64_t>* cells = local->slots[id_].load(std::memory_order_relaxed);
+            if (NULL != cells)
+                return cells;
+        }
+        return __NewCells();
+    }
+
+    // a cell has a single writer, so a plain add does, readers see the old value or the new
+    static void __Bump(std::atomic<int64_t>& _cell, int64_t _n) {
+        _cell.store(_cell.load(std::memory_order_relaxed) + _n, std::memory_order_relaxed);
+    }
+
+ private:
+    friend class MetricsRegistry;
+    struct ThreadCells {
+        std::atomic<std::atomic<int64_t>*> slots[kMaxMetrics];
+    };
+
+    static ThreadCells*& __Local() {
+        static thread_local ThreadCells* local = NULL;
+        return local;
+    }
+    std::atomic<int64_t>* __NewCells() const;
+
+ private:
+    Metric(const Metric&);
+    Metric& operator=(const Metric&);
+
+ protected:
+    size_t id_;
+};
+
+// only goes up, Add(-n) is taken but reads oddly in a diff
+class Counter : public Metric {
+ public:
+    explicit Counter(const char* _name) : Metric(_name, kCounter, 1) {
+    }
+
+    void Add(int64_t _n = 1) {
+        __Bump(*__Cells(), _n);
+    }
+};
+
+// a level, like connections open or bytes queued, set from wherever it changes
+class Gauge : public Metric {
+ public:
+    explicit Gauge(const char* _name) : Metric(_name, kGauge, 0, &value_), value_(0) {
+    }
+
+    void Set(int64_t _value) {
+        value_.store(_value, std::memory_order_relaxed);
+    }
+    void Add(int64_t _n) {
+        value_.fetch_add(_n, std::memory_order_relaxed);
+    }
+    int64_t Value() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+ private:
+    std::atomic<int64_t> value_;
+};
+
+class Histogram : public Metric {
+ public:
+    static const int kSubBucketBits = 3;
+    static const size_t kSubBuckets = 1 << kSubBucketBits;
+    // values below 2 * kSubBuckets get a bucket each, every power of two above kSubBuckets of them
+    static const size_t kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+    // the buckets, then the sum
+    static const size_t kCells = kBuckets + 1;
+
+    // records the time from construction to destruction, in nanoseconds
+    class ScopedTimer {
+     public:
+        explicit ScopedTimer(Histogram& _histogram)
+        : histogram_(_histogram), start_(std::chrono::steady_clock::now()) {
+        }
+        ~ScopedTimer() {
+            histogram_.Record(
+                (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_)
+                    .count());
+        }
+
+     private:
+        ScopedTimer(const ScopedTimer&);
+        ScopedTimer& operator=(const ScopedTimer&);
+
+     private:
+        Histogram& histogram_;
+        const std::chrono::steady_clock::time_point start_;
+    };
+
+ public:
+    explicit Histogram(const char* _name) : Metric(_name, kHistogram, kCells) {
+    }
+
+    void Record(uint64_t _value) {
+        std::atomic<int64_t>* cells = __Cells();
+        __Bump(cells[BucketOf(_value)], 1);
+        __Bump(cells[kBuckets], (int64_t)_value);
+    }
+
+    static size_t BucketOf(uint64_t _value) {
+        if (_value < 2 * kSubBuckets)
+            return (size_t)_value;
+        int shift = __HighestBit(_value) - kSubBucketBits;
+        return ((size_t)(shift + 1) << kSubBucketBits) + (size_t)((_value >> shift) & (kSubBuckets - 1));
+    }
+    // the smallest value of _bucket, the next bucket's lowest is its end
+    static uint64_t BucketLowest(size_t _bucket) {
+        if (_bucket < 2 * kSubBuckets)
+            return _bucket;
+        int shift = (int)(_bucket >> kSubBucketBits) - 1;
+        return (uint64_t)(kSubBuckets + (_bucket & (kSubBuckets - 1))) << shift;
+    }
+
+ private:
+    static int __HighestBit(uint64_t _value) {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(_value);
+#else
+        int bit = 0;
+        while (_value >>= 1) ++bit;
+        return bit;
+#endif
+    }
+};
+
+struct MetricsSnapshot {
+    struct HistogramData {
+        HistogramData() : count(0), sum(0) {
+        }
+
+        // the middle of the bucket holding the _quantile'th value, 0 when empty
+        uint64_t Percentile(double _quantile) const;
+        uint64_t Mean() const {
+            return 0 == count ? 0 : (uint64_t)(sum / (int64_t)count);
+        }
+
+        uint64_t count;
+        int64_t sum;
+        std::vector<uint64_t> buckets;  // Histogram::kBuckets of them
+    };
+
+    MetricsSnapshot() : tick(0) {
+    }
+
+    // what was recorded since _earlier: counters and histograms less what they held then, gauges as they are now
+    MetricsSnapshot Diff(const MetricsSnapshot& _earlier) const;
+
+    // a line a metric, histograms as count, mean and p50 to max
+    std::string ToText() const;
+    // {"tick":..., "counters":{...}, "gauges":{...}, "histograms":{name: {count, sum, p50..., "buckets":[[lowest, count], ...]}}}
+    std::string ToJson() const;
+
+    uint64_t tick;  // gettickcount when taken
+    std::map<std::string, int64_t> counters;
+    std::map<std::string, int64_t> gauges;
+    std::map<std::string, HistogramData> histograms;
+};
+
+class MetricsRegistry {
+ public:
+    // never destroyed, threads may still record while statics go away
+    static MetricsRegistry& Shared();
+
+    void Snapshot(MetricsSnapshot& _snapshot) const;
+
+ private:
+    friend class Metric;
+    struct Entry;
+    struct ThreadExit;
+
+    MetricsRegistry();
+
+    size_t __Register(const char* _name, Metric::Kind _kind, size_t _cells, const std::atomic<int64_t>* _gauge);
+    std::atomic<int64_t>* __NewCells(size_t _id);
+    void __OnThreadExit();
+
+ private:
+    MetricsRegistry(const MetricsRegistry&);
+    MetricsRegistry& operator=(const MetricsRegistry&);
+
+ private:
+    mutable Mutex mutex_;
+    std::vector<Entry*> entries_;  // by id, entries_[0] stays NULL
+    std::vector<Metric::ThreadCells*> threads_;
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif  // COMM_METRICS_H_
@@ -0,0 +1,150 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * metrics_unittest.cc
+ *
+ * Bucketing, sums across live and exited threads, snapshot diffs and the
+ * dumps.
+ */
+
+#include "metrics.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mars/rapidjson/document.h"
+
+using namespace mars::comm;
+
+namespace {
+
+// names are process wide, each test takes its own
+Counter sg_test_counter("test.metrics.counter");
+Counter sg_test_counter_twin("test.metrics.counter");
+Gauge sg_test_gauge("test.metrics.gauge");
+Histogram sg_test_histogram("test.metrics.histogram");
+Histogram sg_test_diffed("test.metrics.diffed");
+Counter sg_test_hot("test.metrics.hot");
+
+MetricsSnapshot Take() {
+    MetricsSnapshot snapshot;
+    MetricsRegistry::Shared().Snapshot(snapshot);
+    return snapshot;
+}
+
+}  // namespace
+
+TEST(MetricsTest, BucketsAreLogLinear) {
+    for (uint64_t value = 0; value < 16; ++value) {
+        EXPECT_EQ(value, Histogram::BucketLowest(Histogram::BucketOf(value)));
+    }
+
+    uint64_t values[] = {16, 17, 31, 100, 1000, 123456789, 1ull << 40, ~0ull};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+        size_t bucket = Histogram::BucketOf(values[i]);
+        ASSERT_LT(bucket, Histogram::kBuckets);
+        uint64_t lowest = Histogram::BucketLowest(bucket);
+        EXPECT_LE(lowest, values[i]);
+        if (bucket + 1 < Histogram::kBuckets)
+            EXPECT_LT(values[i], Histogram::BucketLowest(bucket + 1));
+        // a bucket is at most 1/8 of its lowest value wide
+        EXPECT_LE(values[i] - lowest, lowest / Histogram::kSubBuckets);
+    }
+    EXPECT_EQ(Histogram::kBuckets - 1, Histogram::BucketOf(~0ull));
+
+    for (size_t bucket = 1; bucket < Histogram::kBuckets; ++bucket) {
+        EXPECT_LT(Histogram::BucketLowest(bucket - 1), Histogram::BucketLowest(bucket));
+        EXPECT_EQ(bucket, Histogram::BucketOf(Histogram::BucketLowest(bucket)));
+    }
+}
+
+TEST(MetricsTest, CountersSumOverThreads) {
+    int64_t before = Take().counters["test.metrics.counter"];
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.push_back(std::thread([]() {
+            for (int j = 0; j < 10000; ++j) {
+                sg_test_counter.Add();
+            }
+            sg_test_counter_twin.Add(5);
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    sg_test_counter.Add(3);
+
+    // the threads have exited, what they counted stays
+    EXPECT_EQ(before + 8 * 10000 + 8 * 5 + 3, Take().counters["test.metrics.counter"]);
+}
+
+TEST(MetricsTest, Gauge) {
+    sg_test_gauge.Set(10);
+    sg_test_gauge.Add(-3);
+    EXPECT_EQ(7, sg_test_gauge.Value());
+    EXPECT_EQ(7, Take().gauges["test.metrics.gauge"]);
+}
+
+TEST(MetricsTest, HistogramPercentiles) {
+    for (uint64_t value = 1; value <= 10000; ++value) {
+        sg_test_histogram.Record(value);
+    }
+
+    MetricsSnapshot::HistogramData data = Take().histograms["test.metrics.histogram"];
+    EXPECT_EQ(10000u, data.count);
+    EXPECT_EQ(10000 * 10001 / 2, data.sum);
+    EXPECT_EQ(5000u, data.Mean());
+
+    uint64_t expected[] = {5000, 9000, 9900, 9990, 10000};
+    double quantiles[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+        uint64_t got = data.Percentile(quantiles[i]);
+        EXPECT_NEAR((double)expected[i], (double)got, expected[i] / 16.0) << quantiles[i];
+    }
+}
+
+TEST(MetricsTest, DiffAndDumps) {
+    sg_test_diffed.Record(100);
+    MetricsSnapshot earlier = Take();
+
+    std::thread([]() {
+        sg_test_diffed.Record(1000);
+        sg_test_diffed.Record(1000);
+        sg_test_hot.Add(2);
+    }).join();
+    MetricsSnapshot diff = Take().Diff(earlier);
+
+    const MetricsSnapshot::HistogramData& data = diff.histograms["test.metrics.diffed"];
+    EXPECT_EQ(2u, data.count);
+    EXPECT_EQ(2000, data.sum);
+    EXPECT_EQ(0u, data.buckets[Histogram::BucketOf(100)]);
+    EXPECT_EQ(2, diff.counters["test.metrics.hot"]);
+
+    std::string text = diff.ToText();
+    EXPECT_NE(std::string::npos, text.find("counter test.metrics.hot 2\n"));
+    EXPECT_NE(std::string::npos, text.find("histogram test.metrics.diffed count:2 mean:1000"));
+
+    std::string json = diff.ToJson();
+    rapidjson::Document doc;
+    ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError()) << json;
+    EXPECT_EQ(2, doc["counters"]["test.metrics.hot"].GetInt64());
+    EXPECT_EQ(7, doc["gauges"]["test.metrics.gauge"].GetInt64());
+    const rapidjson::Value& histogram = doc["histograms"]["test.metrics.diffed"];
+    EXPECT_EQ(2u, histogram["count"].GetUint64());
+    ASSERT_EQ(1u, histogram["buckets"].Size());
+    EXPECT_EQ(Histogram::BucketLowest(Histogram::BucketOf(1000)), histogram["buckets"][0][0].GetUint64());
+    EXPECT_EQ(2u, histogram["buckets"][0][1].GetUint64());
+}
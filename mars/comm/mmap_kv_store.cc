@@ -0,0 +1,432 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * mmap_kv_store.cc
+ *
+ * file:   | magic "MKV1" | version | 8 reserved | record | record | ... | zeros
+ * record: | crc32 of what follows | type | 0 | key len (16) | value len (32) | key | value
+ */
+
+#include "mmap_kv_store.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "boost/filesystem.hpp"
+#include "comm/mmap_util.h"
+#include "comm/xlogger/xlogger.h"
+
+namespace mars {
+namespace comm {
+
+namespace {
+
+const char kMagic[4] = {'M', 'K', 'V', '1'};
+const uint32_t kVersion = 1;
+const size_t kFileHeadSize = 16;
+
+struct RecordHead {
+    uint32_t crc;
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t key_len;
+    uint32_t value_len;
+};
+
+uint32_t __Crc(const char* _data, size_t _len) {
+    return (uint32_t)crc32(crc32(0L, Z_NULL, 0), (const Bytef*)_data, (uInt)_len);
+}
+
+void __SyncMapping(boost::iostreams::mapped_file& _file, bool _wait) {
+#ifndef _WIN32
+    if (IsMmapFileOpenSucc(_file))
+        msync(_file.data(), _file.size(), _wait ? MS_SYNC : MS_ASYNC);
+#endif
+}
+
+}  // namespace
+
+const size_t MmapKVStore::kDefaultFileSize;
+const size_t MmapKVStore::kMaxFileSize;
+
+MmapKVStore::MmapKVStore(const std::string& _path, size_t _file_size)
+: path_(_path), tail_(kFileHeadSize), live_bytes_(0), compacting_(false) {
+    // a compaction that died before its rename
+    boost::system::error_code ec;
+    boost::filesystem::remove(path_ + ".compact", ec);
+
+    if (!__Open(std::max(_file_size, (size_t)4096)))
+        return;
+    __Load();
+    xinfo2(TSF "%_ open, keys:%_, tail:%_, size:%_, torn:%_",
+           path_,
+           index_.size(),
+           tail_,
+           file_.size(),
+           stats_.dropped_on_load);
+}
+
+MmapKVStore::~MmapKVStore() {
+    ExecutorJobPtr job;
+    {
+        ScopedLock lock(mutex_);
+        job = compact_job_;
+    }
+    if (job) {
+        job->Cancel();
+        job->Join();
+    }
+
+    ScopedLock lock(mutex_);
+    __SyncMapping(file_, false);
+    CloseMmapFile(file_);
+}
+
+bool MmapKVStore::IsOpen() const {
+    ScopedLock lock(mutex_);
+    return IsMmapFileOpenSucc(file_);
+}
+
+bool MmapKVStore::Has(const std::string& _key) const {
+    ScopedLock lock(mutex_);
+    return index_.end() != index_.find(_key);
+}
+
+int64_t MmapKVStore::GetInt(const std::string& _key, int64_t _default) const {
+    ScopedLock lock(mutex_);
+    std::map<std::string, Entry>::const_iterator it = index_.find(_key);
+    if (index_.end() == it || kTypeInt != it->second.type)
+        return _default;
+    return it->second.int_value;
+}
+
+std::string MmapKVStore::GetString(const std::string& _key, const std::string& _default) const {
+    ScopedLock lock(mutex_);
+    std::map<std::string, Entry>::const_iterator it = index_.find(_key);
+    if (index_.end() == it || kTypeString != it->second.type)
+        return _default;
+    return it->second.str_value;
+}
+
+void MmapKVStore::Keys(std::vector<std::string>& _keys) const {
+    ScopedLock lock(mutex_);
+    _keys.clear();
+    _keys.reserve(index_.size());
+    for (std::map<std::string, Entry>::const_iterator it = index_.begin(); it != index_.end(); ++it) {
+        _keys.push_back(it->first);
+    }
+}
+
+size_t MmapKVStore::Count() const {
+    ScopedLock lock(mutex_);
+    return index_.size();
+}
+
+bool MmapKVStore::SetInt(const std::string& _key, int64_t _value) {
+    ScopedLock lock(mutex_);
+    std::map<std::string, Entry>::const_iterator it = index_.find(_key);
+    if (index_.end() != it && kTypeInt == it->second.type && _value == it->second.int_value) {
+        ++stats_.unchanged;
+        return true;
+    }
+    return __Append(lock, _key, kTypeInt, &_value, sizeof(_value));
+}
+
+bool MmapKVStore::SetString(const std::string& _key, const std::string& _value) {
+    ScopedLock lock(mutex_);
+    std::map<std::string, Entry>::const_iterator it = index_.find(_key);
+    if (index_.end() != it && kTypeString == it->second.type && _value == it->second.str_value) {
+        ++stats_.unchanged;
+        return true;
+    }
+    return __Append(lock, _key, kTypeString, _value.data(), _value.size());
+}
+
+bool MmapKVStore::Erase(const std::string& _key) {
+    ScopedLock lock(mutex_);
+    if (index_.end() == index_.find(_key))
+        return true;
+    return __Append(lock, _key, kTypeErased, NULL, 0);
+}
+
+bool MmapKVStore::Compact() {
+    ScopedLock lock(mutex_);
+    return __Compact(lock, 0);
+}
+
+void MmapKVStore::Flush() {
+    ScopedLock lock(mutex_);
+    __SyncMapping(file_, false);
+}
+
+MmapKVStore::Stats MmapKVStore::GetStats() const {
+    ScopedLock lock(mutex_);
+    return stats_;
+}
+
+bool MmapKVStore::__Open(size_t _file_size) {
+    if (OpenMmapFile(path_.c_str(), (unsigned int)_file_size, file_) && kFileHeadSize < file_.size())
+        return true;
+
+    // an empty or unmappable leftover, start over
+    xwarn2(TSF "%_ can't be mapped, recreating", path_);
+    CloseMmapFile(file_);
+    boost::system::error_code ec;
+    boost::filesystem::remove(path_, ec);
+    if (OpenMmapFile(path_.c_str(), (unsigned int)_file_size, file_))
+        return true;
+
+    xerror2(TSF "%_ open fail", path_);
+    return false;
+}
+
+void MmapKVStore::__Load() {
+    char* data = file_.data();
+    size_t size = file_.size();
+
+    if (0 != memcmp(data, kMagic, sizeof(kMagic))) {
+        // new, or not ours
+        memset(data, 0, size);
+        memcpy(data, kMagic, sizeof(kMagic));
+        memcpy(data + sizeof(kMagic), &kVersion, sizeof(kVersion));
+        tail_ = kFileHeadSize;
+        return;
+    }
+
+    size_t pos = kFileHeadSize;
+    while (pos + sizeof(RecordHead) <= size) {
+        RecordHead head;
+        memcpy(&head, data + pos, sizeof(head));
+        if (0 == head.type)
+            break;  // the zeros past the last record
+
+        size_t record_size = sizeof(RecordHead) + head.key_len + head.value_len;
+        if (pos + record_size > size || head.crc != __Crc(data + pos + sizeof(head.crc), record_size - sizeof(head.crc))
+            || kTypeErased < head.type || (kTypeInt == head.type && sizeof(int64_t) != head.value_len)) {
+            // torn by a crash mid-write; what follows it is not trusted either
+            ++stats_.dropped_on_load;
+            memset(data + pos, 0, size - pos);
+            break;
+        }
+
+        std::string key(data + pos + sizeof(head), head.key_len);
+        const char* value = data + pos + sizeof(head) + head.key_len;
+        std::map<std::string, Entry>::iterator it = index_.find(key);
+        if (index_.end() != it) {
+            live_bytes_ -= it->second.record_size;
+            index_.erase(it);
+        }
+
+        if (kTypeErased != head.type) {
+            Entry& entry = index_[key];
+            entry.type = head.type;
+            entry.int_value = 0;
+            entry.record_size = record_size;
+            if (kTypeInt == head.type)
+                memcpy(&entry.int_value, value, sizeof(entry.int_value));
+            else
+                entry.str_value.assign(value, head.value_len);
+            live_bytes_ += record_size;
+        }
+        pos += record_size;
+    }
+    tail_ = pos;
+}
+
+bool MmapKVStore::__Append(ScopedLock& _lock,
+                           const std::string& _key,
+                           int _type,
+                           const void* _value,
+                           size_t _value_len) {
+    if (!IsMmapFileOpenSucc(file_) || _key.empty() || 0xffff < _key.size())
+        return false;
+
+    size_t record_size = sizeof(RecordHead) + _key.size() + _value_len;
+    // full before the async compaction got to it: this writer waits for one, the readers don't
+    while (tail_ + record_size > file_.size()) {
+        if (!__Compact(_lock, record_size) || !IsMmapFileOpenSucc(file_))
+            return false;
+    }
+
+    __WriteRecord(file_.data() + tail_, _key, _type, _value, _value_len);
+    tail_ += record_size;
+    ++stats_.appended;
+
+    std::map<std::string, Entry>::iterator it = index_.find(_key);
+    if (index_.end() != it) {
+        live_bytes_ -= it->second.record_size;
+        if (kTypeErased == _type)
+            index_.erase(it);
+    }
+    if (kTypeErased != _type) {
+        Entry& entry = index_[_key];
+        entry.type = _type;
+        entry.int_value = 0;
+        entry.str_value.clear();
+        entry.record_size = record_size;
+        if (kTypeInt == _type)
+            memcpy(&entry.int_value, _value, sizeof(entry.int_value));
+        else
+            entry.str_value.assign((const char*)_value, _value_len);
+        live_bytes_ += record_size;
+    }
+
+    if (tail_ > file_.size() / 4 * 3 && !(compact_job_ && compact_job_->IsRunning()))
+        __CompactAsync();
+    return true;
+}
+
+bool MmapKVStore::__Compact(ScopedLock& _lock, size_t _extra) {
+    if (compacting_) {
+        // the one running frees as much as another would
+        while (compacting_) compacted_.wait(_lock);
+        return true;
+    }
+
+    size_t wanted = kFileHeadSize + live_bytes_ + _extra;
+    size_t size = std::max(file_.size(), (size_t)4096);
+    // keep half of the new file free, so the next compaction is as far away as this one was
+    while (size < wanted * 2 && size < kMaxFileSize) size *= 2;
+    if (size < wanted) {
+        xerror2(TSF "%_ full, live:%_, wanted:%_", path_, live_bytes_, wanted);
+        return false;
+    }
+
+    std::string tmp = path_ + ".compact";
+    boost::system::error_code ec;
+    boost::filesystem::remove(tmp, ec);
+
+    boost::iostreams::mapped_file out;
+    if (!OpenMmapFile(tmp.c_str(), (unsigned int)size, out)) {
+        xerror2(TSF "%_ open fail", tmp);
+        return false;
+    }
+
+    compacting_ = true;
+    std::map<std::string, Entry> index(index_);
+    size_t from = tail_;
+    _lock.unlock();
+
+    char* data = out.data();
+    memcpy(data, kMagic, sizeof(kMagic));
+    memcpy(data + sizeof(kMagic), &kVersion, sizeof(kVersion));
+    size_t pos = kFileHeadSize;
+    for (std::map<std::string, Entry>::iterator it = index.begin(); it != index.end(); ++it) {
+        if (kTypeInt == it->second.type)
+            pos += __WriteRecord(data + pos, it->first, kTypeInt, &it->second.int_value, sizeof(int64_t));
+        else
+            pos += __WriteRecord(data + pos,
+                                 it->first,
+                                 kTypeString,
+                                 it->second.str_value.data(),
+                                 it->second.str_value.size());
+    }
+    // the sync a compaction costs: the rename must not reach the disk before the records do
+    __SyncMapping(out, true);
+
+    _lock.lock();
+    bool swapped = __SwapIn(out, size, pos, from);
+    compacting_ = false;
+    compacted_.notifyAll();
+    return swapped;
+}
+
+bool MmapKVStore::__SwapIn(boost::iostreams::mapped_file& _out, size_t _size, size_t _pos, size_t _from) {
+    std::string tmp = path_ + ".compact";
+    boost::system::error_code ec;
+
+    // the records appended while the lock was dropped, whole and CRC'd already: copied as they are
+    size_t appended = tail_ - _from;
+    if (_pos + appended > _size) {
+        xerror2(TSF "%_ compaction outrun by %_ bytes of appends", path_, appended);
+        CloseMmapFile(_out);
+        boost::filesystem::remove(tmp, ec);
+        return false;
+    }
+    if (0 < appended) {
+        memcpy(_out.data() + _pos, file_.data() + _from, appended);
+        __SyncMapping(_out, true);  // only the pages just written are dirty
+    }
+    CloseMmapFile(_out);
+    __SyncMapping(file_, false);
+    CloseMmapFile(file_);
+
+    boost::filesystem::rename(tmp, path_, ec);
+    if (ec) {
+        xerror2(TSF "rename %_ fail:%_", tmp, ec.message());
+        boost::filesystem::remove(tmp, ec);
+        __Open(_size);
+        return false;
+    }
+
+    if (!__Open(_size)) {
+        index_.clear();
+        tail_ = kFileHeadSize;
+        live_bytes_ = 0;
+        return false;
+    }
+
+    xinfo2(TSF "%_ compacted, %_ -> %_ bytes, appended meanwhile:%_, keys:%_, size:%_",
+           path_,
+           tail_,
+           _pos + appended,
+           appended,
+           index_.size(),
+           file_.size());
+    // live_bytes_ stays: the index points at records of the same sizes in the new file
+    tail_ = _pos + appended;
+    ++stats_.compactions;
+    return true;
+}
+
+void MmapKVStore::__CompactAsync() {
+    compact_job_ = Executor::Default().Post(
+        [this]() {
+            ScopedLock lock(mutex_);
+            if (tail_ > file_.size() / 4 * 3)
+                __Compact(lock, 0);
+        },
+        "mmap_kv_compact");
+}
+
+size_t MmapKVStore::__WriteRecord(char* _dst,
+                                  const std::string& _key,
+                                  int _type,
+                                  const void* _value,
+                                  size_t _value_len) {
+    RecordHead head;
+    head.crc = 0;
+    head.type = (uint8_t)_type;
+    head.reserved = 0;
+    head.key_len = (uint16_t)_key.size();
+    head.value_len = (uint32_t)_value_len;
+
+    memcpy(_dst + sizeof(head), _key.data(), _key.size());
+    if (0 < _value_len)
+        memcpy(_dst + sizeof(head) + _key.size(), _value, _value_len);
+    memcpy(_dst, &head, sizeof(head));
+
+    size_t record_size = sizeof(head) + _key.size() + _value_len;
+    head.crc = __Crc(_dst + sizeof(head.crc), record_size - sizeof(head.crc));
+    // the crc last, so a record is only whole once it is
+    memcpy(_dst, &head.crc, sizeof(head.crc));
+    return record_size;
+}
+
+}  // namespace comm
+}  // namespace mars
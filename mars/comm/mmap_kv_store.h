@@ -0,0 +1,127 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * mmap_kv_store.h
+ *
+ * A small persisted key-value map for state like the heartbeat intervals
+ * learnt per network. Every Set appends one CRC'd record to an mmap'd log
+ * instead of rewriting a file, so a write costs the record and what reaches
+ * the page cache survives the process dying. A torn record at the tail
+ * fails its CRC and is dropped when the log is replayed on open. Once the
+ * log is three quarters full, its live records are rewritten to a fresh
+ * file on comm::Executor and swapped in by rename. The rewrite and its sync
+ * run on a copy of the index without the lock; records appended meanwhile
+ * are copied over as they are when the file is swapped, under the lock.
+ */
+
+#ifndef COMM_MMAP_KV_STORE_H_
+#define COMM_MMAP_KV_STORE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "boost/iostreams/device/mapped_file.hpp"
+#include "comm/executor.h"
+#include "comm/thread/condition.h"
+#include "comm/thread/lock.h"
+
+namespace mars {
+namespace comm {
+
+class MmapKVStore {
+ public:
+    static const size_t kDefaultFileSize = 64 * 1024;
+    static const size_t kMaxFileSize = 4 * 1024 * 1024;
+
+    struct Stats {
+        Stats() : appended(0), unchanged(0), compactions(0), dropped_on_load(0) {
+        }
+        uint64_t appended;         // records written
+        uint64_t unchanged;        // Sets skipped, the value was already there
+        uint64_t compactions;
+        uint64_t dropped_on_load;  // torn records found at the tail when the log was replayed
+    };
+
+ public:
+    // opens or creates _path; _file_size is where a new file starts, it grows by compaction
+    explicit MmapKVStore(const std::string& _path, size_t _file_size = kDefaultFileSize);
+    ~MmapKVStore();
+
+    bool IsOpen() const;
+
+    bool Has(const std::string& _key) const;
+    // _default when missing or stored as a string
+    int64_t GetInt(const std::string& _key, int64_t _default) const;
+    std::string GetString(const std::string& _key, const std::string& _default = "") const;
+    void Keys(std::vector<std::string>& _keys) const;
+    size_t Count() const;
+
+    // false only when the record can't be written; Setting what is stored already writes nothing
+    bool SetInt(const std::string& _key, int64_t _value);
+    bool SetString(const std::string& _key, const std::string& _value);
+    bool Erase(const std::string& _key);
+
+    // compacts now on the calling thread, or waits for the compaction already running
+    bool Compact();
+    // schedules write-back of the dirty pages without waiting for it
+    void Flush();
+
+    Stats GetStats() const;
+
+ private:
+    enum {
+        kTypeInt = 1,
+        kTypeString = 2,
+        kTypeErased = 3,
+    };
+
+    struct Entry {
+        int type;
+        int64_t int_value;
+        std::string str_value;
+        size_t record_size;
+    };
+
+    bool __Open(size_t _file_size);
+    void __Load();
+    // both are called with _lock held and may drop it while compacting
+    bool __Append(ScopedLock& _lock, const std::string& _key, int _type, const void* _value, size_t _value_len);
+    bool __Compact(ScopedLock& _lock, size_t _extra);
+    bool __SwapIn(boost::iostreams::mapped_file& _out, size_t _size, size_t _pos, size_t _from);
+    void __CompactAsync();
+    static size_t __WriteRecord(char* _dst, const std::string& _key, int _type, const void* _value, size_t _value_len);
+
+ private:
+    MmapKVStore(const MmapKVStore&);
+    MmapKVStore& operator=(const MmapKVStore&);
+
+ private:
+    const std::string path_;
+    mutable Mutex mutex_;
+    boost::iostreams::mapped_file file_;
+    std::map<std::string, Entry> index_;
+    size_t tail_;        // where the next record goes
+    size_t live_bytes_;  // records the index still points at
+    bool compacting_;   // a compaction dropped the lock, the others wait on compacted_
+    Condition compacted_;
+    ExecutorJobPtr compact_job_;
+    Stats stats_;
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif  // COMM_MMAP_KV_STORE_H_
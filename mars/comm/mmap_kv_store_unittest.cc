@@ -0,0 +1,185 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * mmap_kv_store_unittest.cc
+ *
+ * Values surviving a reopen, a torn tail record dropped on replay, unchanged
+ * Sets writing nothing, compaction reclaiming and growing the file, and
+ * records appended while a compaction runs without the lock kept by it.
+ */
+
+#include "mmap_kv_store.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem.hpp"
+#include "gtest/gtest.h"
+
+using namespace mars::comm;
+
+namespace {
+
+class TempPath {
+ public:
+    TempPath() {
+        char name[] = "/tmp/mmap_kv_XXXXXX";
+        int fd = mkstemp(name);
+        close(fd);
+        unlink(name);
+        path_ = name;
+    }
+    ~TempPath() {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path_, ec);
+        boost::filesystem::remove(path_ + ".compact", ec);
+    }
+    const std::string& Path() const {
+        return path_;
+    }
+
+ private:
+    std::string path_;
+};
+
+}  // namespace
+
+TEST(mmap_kv_store, values_survive_reopen) {
+    TempPath path;
+    {
+        MmapKVStore store(path.Path());
+        ASSERT_TRUE(store.IsOpen());
+        EXPECT_TRUE(store.SetInt("wifi\x1f" "curHeart", 270));
+        EXPECT_TRUE(store.SetInt("wifi\x1f" "modifyTime", 1700000000LL * 1000));
+        EXPECT_TRUE(store.SetString("wifi\x1f" "name", "office"));
+        EXPECT_TRUE(store.SetInt("4g\x1f" "curHeart", 210));
+        EXPECT_TRUE(store.Erase("4g\x1f" "curHeart"));
+        EXPECT_TRUE(store.SetInt("wifi\x1f" "curHeart", 300));
+    }
+
+    MmapKVStore store(path.Path());
+    EXPECT_EQ(3u, store.Count());
+    EXPECT_EQ(300, store.GetInt("wifi\x1f" "curHeart", 0));
+    EXPECT_EQ(1700000000LL * 1000, store.GetInt("wifi\x1f" "modifyTime", 0));
+    EXPECT_EQ("office", store.GetString("wifi\x1f" "name"));
+    EXPECT_FALSE(store.Has("4g\x1f" "curHeart"));
+    // the type is part of the value
+    EXPECT_EQ(-1, store.GetInt("wifi\x1f" "name", -1));
+    EXPECT_EQ(0u, store.GetStats().dropped_on_load);
+}
+
+TEST(mmap_kv_store, unchanged_set_writes_nothing) {
+    TempPath path;
+    MmapKVStore store(path.Path());
+    store.SetInt("k", 1);
+    store.SetInt("k", 1);
+    store.SetString("s", "v");
+    store.SetString("s", "v");
+    store.Erase("missing");
+    EXPECT_EQ(2u, store.GetStats().appended);
+    EXPECT_EQ(2u, store.GetStats().unchanged);
+}
+
+TEST(mmap_kv_store, torn_tail_is_dropped) {
+    TempPath path;
+    {
+        MmapKVStore store(path.Path());
+        store.SetInt("first", 1);
+        store.SetInt("second", 2);
+    }
+
+    // flip a byte of the second record's value, as a crash halfway through writing it would leave it
+    FILE* file = fopen(path.Path().c_str(), "rb+");
+    ASSERT_TRUE(NULL != file);
+    const long kSecondValue = 16 + (12 + 5 + 8) + 12 + 6;
+    fseek(file, kSecondValue, SEEK_SET);
+    fputc(0x7f, file);
+    fclose(file);
+
+    {
+        MmapKVStore store(path.Path());
+        EXPECT_EQ(1u, store.GetStats().dropped_on_load);
+        EXPECT_EQ(1, store.GetInt("first", 0));
+        EXPECT_FALSE(store.Has("second"));
+        // appends go where the torn record was
+        store.SetInt("third", 3);
+    }
+
+    MmapKVStore store(path.Path());
+    EXPECT_EQ(0u, store.GetStats().dropped_on_load);
+    EXPECT_EQ(2u, store.Count());
+    EXPECT_EQ(3, store.GetInt("third", 0));
+}
+
+TEST(mmap_kv_store, compaction_reclaims_and_grows) {
+    TempPath path;
+    {
+        MmapKVStore store(path.Path(), 4096);
+        // one key rewritten far more often than the file could hold without compaction
+        for (int i = 0; i < 2000; ++i) ASSERT_TRUE(store.SetInt("heart", i));
+        EXPECT_LE(1u, store.GetStats().compactions);
+        EXPECT_EQ(4096, (int)boost::filesystem::file_size(path.Path()));
+
+        // more live data than 4KB holds
+        std::string value(100, 'v');
+        for (int i = 0; i < 100; ++i) ASSERT_TRUE(store.SetString("key" + std::to_string(i), value));
+        EXPECT_LT(4096u, boost::filesystem::file_size(path.Path()));
+        EXPECT_TRUE(store.Compact());
+    }
+
+    MmapKVStore store(path.Path(), 4096);
+    EXPECT_EQ(101u, store.Count());
+    EXPECT_EQ(1999, store.GetInt("heart", 0));
+    EXPECT_EQ(std::string(100, 'v'), store.GetString("key99"));
+    EXPECT_FALSE(boost::filesystem::exists(path.Path() + ".compact"));
+}
+
+TEST(mmap_kv_store, appends_during_compaction_are_kept) {
+    TempPath path;
+    const int kWriters = 4;
+    const int kKeys = 500;
+    {
+        MmapKVStore store(path.Path(), 4096);
+        std::vector<std::thread> writers;
+        for (int w = 0; w < kWriters; ++w) {
+            writers.push_back(std::thread([&store, w]() {
+                for (int i = 0; i < kKeys; ++i) {
+                    std::string key = std::to_string(w) + "." + std::to_string(i);
+                    ASSERT_TRUE(store.SetInt(key, i));
+                    ASSERT_TRUE(store.SetInt(key, i + 1));
+                    if (0 == i % 7)
+                        ASSERT_TRUE(store.Erase(key));
+                }
+            }));
+        }
+        for (int i = 0; i < 50; ++i) EXPECT_TRUE(store.Compact());
+        for (size_t w = 0; w < writers.size(); ++w) writers[w].join();
+        EXPECT_LE(50u, store.GetStats().compactions);
+    }
+
+    MmapKVStore store(path.Path());
+    EXPECT_EQ(0u, store.GetStats().dropped_on_load);
+    for (int w = 0; w < kWriters; ++w) {
+        for (int i = 0; i < kKeys; ++i) {
+            std::string key = std::to_string(w) + "." + std::to_string(i);
+            if (0 == i % 7)
+                EXPECT_FALSE(store.Has(key)) << key;
+            else
+                EXPECT_EQ(i + 1, store.GetInt(key, -1)) << key;
+        }
+    }
+}
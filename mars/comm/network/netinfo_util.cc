@@ -21,9 +21,9 @@
 #include <vector>
 
 #include "comm/network/getdnssvraddrs.h"
-#include "comm/network/getgateway.h"
 #include "comm/network/getifaddrs.h"
 #include "comm/network/local_routetable.h"
+#include "comm/network/network_state.h"
 #include "comm/platform_comm.h"
 #include "comm/socket/local_ipstack.h"
 #include "comm/socket/socket_address.h"
@@ -99,19 +99,16 @@ std::string GetDetailNetInfo(bool _need_wifi_ssid) {
     detail_net_info << "--------NetConfig Info----------"
                     << "\n";
     // 2.网络配置信息（默认网关、dns svr、路由表）
-    in6_addr addr6_gateway;
-    memset(&addr6_gateway, 0, sizeof(addr6_gateway));
-
-    if (0 == getdefaultgateway6(&addr6_gateway)) {
-        detail_net_info << "getdefaultgateway6:" << socket_address(addr6_gateway).ipv6() << "\n";
+    // the gateways probed for the current network, as the ip stack above
+    std::shared_ptr<const NetworkStateSnapshot> network = NetworkState::Instance().Current();
+    if (network->has_gateway6) {
+        detail_net_info << "getdefaultgateway6:" << socket_address(network->gateway6).ipv6() << "\n";
     } else {
         detail_net_info << "getdefaultgateway6:"
                         << "failed. ";
     }
-    in_addr addr_gateway;
-    memset(&addr_gateway, 0, sizeof(addr_gateway));
-    if (0 == getdefaultgateway(&addr_gateway)) {
-        detail_net_info << "getdefaultgateway:" << socket_address(addr_gateway).ip() << "\n";
+    if (network->has_gateway4) {
+        detail_net_info << "getdefaultgateway:" << socket_address(network->gateway4).ip() << "\n";
     } else {
         detail_net_info << "getdefaultgateway:"
                         << "failed. ";
@@ -0,0 +1,180 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * network_state.cc
+ */
+
+#include "network_state.h"
+
+#include <string.h>
+
+#include "boost/bind.hpp"
+#include "comm/network/getgateway.h"
+#include "comm/thread/lock.h"
+#include "comm/thread/thread.h"
+#include "comm/time_utils.h"
+#include "comm/xlogger/xlogger.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace mars {
+namespace comm {
+
+// without route events, a probe is trusted this long unless the platform reports a network change
+static const uint64_t kProbeTrustTime = 10 * 1000;
+
+NetworkState& NetworkState::Instance() {
+    // never destroyed, connects may still run from static destructors
+    static NetworkState* state = new NetworkState();
+    return *state;
+}
+
+NetworkState::NetworkState() : epoch_(1), watching_route_(false), route_fd_(-1), route_thread_(NULL) {
+#ifdef __linux__
+    // Android 11 refuses bind() on NETLINK_ROUTE to apps, we fall back to kProbeTrustTime then.
+    route_fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (0 > route_fd_) {
+        xwarn2(TSF "netlink socket fail:(%_, %_)", errno, strerror(errno));
+        return;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (0 != bind(route_fd_, (struct sockaddr*)&addr, sizeof(addr))) {
+        xwarn2(TSF "netlink bind fail:(%_, %_)", errno, strerror(errno));
+        close(route_fd_);
+        route_fd_ = -1;
+        return;
+    }
+
+    watching_route_ = true;
+    route_thread_ = new Thread(boost::bind(&NetworkState::__WatchRoute, this), "net_state");
+    route_thread_->start();
+#endif
+}
+
+std::shared_ptr<const NetworkStateSnapshot> NetworkState::Current() {
+    uint64_t epoch = Epoch();
+    {
+        ScopedLock lock(mutex_);
+        if (snapshot_ && __IsFresh(*snapshot_, epoch)) {
+            return snapshot_;
+        }
+    }
+
+    // one probe per epoch, the callers that raced it take its result
+    ScopedLock probe_lock(probe_mutex_);
+    epoch = Epoch();
+    {
+        ScopedLock lock(mutex_);
+        if (snapshot_ && __IsFresh(*snapshot_, epoch)) {
+            return snapshot_;
+        }
+    }
+
+    std::shared_ptr<const NetworkStateSnapshot> snapshot = __Probe(epoch);
+    ScopedLock lock(mutex_);
+    snapshot_ = snapshot;
+    return snapshot;
+}
+
+void NetworkState::Invalidate() {
+    epoch_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+bool NetworkState::__IsFresh(const NetworkStateSnapshot& _snapshot, uint64_t _epoch) const {
+    if (_snapshot.epoch != _epoch) {
+        return false;
+    }
+    return watching_route_ || gettickcount() - _snapshot.probe_tick < kProbeTrustTime;
+}
+
+std::shared_ptr<const NetworkStateSnapshot> NetworkState::__Probe(uint64_t _epoch) {
+    std::shared_ptr<NetworkStateSnapshot> snapshot = std::make_shared<NetworkStateSnapshot>();
+    snapshot->epoch = _epoch;
+    snapshot->probe_tick = gettickcount();
+    snapshot->ipstack = local_ipstack_probe_log(snapshot->ipstack_log);
+
+    memset(&snapshot->gateway4, 0, sizeof(snapshot->gateway4));
+    memset(&snapshot->gateway6, 0, sizeof(snapshot->gateway6));
+#ifndef _WIN32
+    snapshot->has_gateway4 = 0 == getdefaultgateway(&snapshot->gateway4);
+    snapshot->has_gateway6 = 0 == getdefaultgateway6(&snapshot->gateway6);
+#else
+    snapshot->has_gateway4 = false;
+    snapshot->has_gateway6 = false;
+#endif
+
+    xinfo2(TSF "network state epoch:%_, ipstack:%_, gateway4:%_, gateway6:%_",
+           _epoch,
+           TLocalIPStackStr[snapshot->ipstack],
+           snapshot->has_gateway4,
+           snapshot->has_gateway6);
+    return snapshot;
+}
+
+void NetworkState::__WatchRoute() {
+#ifdef __linux__
+    char buf[8192];
+    while (true) {
+        ssize_t len = recv(route_fd_, buf, sizeof(buf), 0);
+        if (0 > len) {
+            if (EINTR == errno) {
+                continue;
+            }
+            if (ENOBUFS == errno) {
+                // events were dropped, whatever they were
+                Invalidate();
+                continue;
+            }
+            xerror2(TSF "netlink recv fail:(%_, %_), stop watching route", errno, strerror(errno));
+            break;
+        }
+
+        bool changed = false;
+        for (struct nlmsghdr* nh = (struct nlmsghdr*)buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            switch (nh->nlmsg_type) {
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                case RTM_NEWROUTE:
+                case RTM_DELROUTE:
+                    changed = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (changed) {
+            Invalidate();
+        }
+    }
+
+    // from now on the probe time bounds how stale a snapshot can be
+    watching_route_ = false;
+    close(route_fd_);
+    route_fd_ = -1;
+#endif
+}
+
+}  // namespace comm
+}  // namespace mars
@@ -0,0 +1,84 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * network_state.h
+ *
+ * IP stack and default gateways of the current network, probed once per network epoch. An epoch ends on a
+ * platform network change, on a Linux rtnetlink address/route/link event, or, where route events can't be
+ * watched, after a few seconds.
+ */
+
+#ifndef COMM_NETWORK_NETWORK_STATE_H_
+#define COMM_NETWORK_NETWORK_STATE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "comm/socket/local_ipstack.h"
+#include "comm/socket/unix_socket.h"
+#include "comm/thread/mutex.h"
+
+namespace mars {
+namespace comm {
+
+class Thread;
+
+struct NetworkStateSnapshot {
+    uint64_t epoch;
+    uint64_t probe_tick;
+    TLocalIPStack ipstack;
+    std::string ipstack_log;  // what local_ipstack_probe_log() wrote while probing
+    bool has_gateway4;
+    in_addr gateway4;
+    bool has_gateway6;
+    in6_addr gateway6;
+};
+
+class NetworkState {
+ public:
+    static NetworkState& Instance();
+
+    // The snapshot of the current epoch, probed by the first caller of the epoch.
+    std::shared_ptr<const NetworkStateSnapshot> Current();
+    uint64_t Epoch() const {
+        return epoch_.load(std::memory_order_acquire);
+    }
+    void Invalidate();
+
+ private:
+    NetworkState();
+    NetworkState(const NetworkState&);
+    NetworkState& operator=(const NetworkState&);
+
+    bool __IsFresh(const NetworkStateSnapshot& _snapshot, uint64_t _epoch) const;
+    std::shared_ptr<const NetworkStateSnapshot> __Probe(uint64_t _epoch);
+    void __WatchRoute();
+
+ private:
+    std::atomic<uint64_t> epoch_;
+    std::atomic<bool> watching_route_;
+    int route_fd_;
+    Thread* route_thread_;
+
+    Mutex mutex_;
+    Mutex probe_mutex_;
+    std::shared_ptr<const NetworkStateSnapshot> snapshot_;
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif /* COMM_NETWORK_NETWORK_STATE_H_ */
@@ -17,6 +17,11 @@
 //  Created by yerungui on 16/3/30.
 //
 
+#include <string.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 #include "comm/autobuffer.h"
 #include "comm/platform_comm.h"
 #include "comm/socket/socket_address.h"
@@ -108,23 +113,59 @@ SOCKET block_socket_connect(const socket_address& _address,
     return sock.release();
 }
 
-/*
- * return value:
- */
-int block_socket_send(SOCKET _sock,
-                      const void* _buffer,
-                      size_t _len,
-                      SocketBreaker& _breaker,
-                      int& _errcode,
-                      int _timeout) {
+// one send() of what is left of _head followed by _body, gathered where the platform can
+static ssize_t __send_once(SOCKET _sock,
+                           const void* _head,
+                           size_t _head_len,
+                           const void* _body,
+                           size_t _body_len,
+                           size_t _sent_len) {
+#ifdef _WIN32
+    if (_sent_len < _head_len)
+        return ::send(_sock, (const char*)_head + _sent_len, (int)(_head_len - _sent_len), 0);
+    return ::send(_sock, (const char*)_body + (_sent_len - _head_len), (int)(_head_len + _body_len - _sent_len), 0);
+#else
+    struct iovec iov[2];
+    int count = 0;
+    if (_sent_len < _head_len) {
+        iov[count].iov_base = (char*)_head + _sent_len;
+        iov[count].iov_len = _head_len - _sent_len;
+        ++count;
+    }
+    size_t body_sent = _sent_len > _head_len ? _sent_len - _head_len : 0;
+    if (body_sent < _body_len) {
+        iov[count].iov_base = (char*)_body + body_sent;
+        iov[count].iov_len = _body_len - body_sent;
+        ++count;
+    }
+    if (1 == count)
+        return ::send(_sock, iov[0].iov_base, iov[0].iov_len, 0);
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    return ::sendmsg(_sock, &msg, 0);
+#endif
+}
+
+int block_socket_sendv(SOCKET _sock,
+                       const void* _head,
+                       size_t _head_len,
+                       const void* _body,
+                       size_t _body_len,
+                       SocketBreaker& _breaker,
+                       int& _errcode,
+                       int _timeout) {
     uint64_t start = gettickcount();
     int32_t cost_time = 0;
     size_t sent_len = 0;
+    size_t len = _head_len + _body_len;
 
     SocketSelect sel(_breaker);
 
     while (true) {
-        ssize_t nwrite = ::send(_sock, (const char*)_buffer + sent_len, _len - sent_len, 0);
+        ssize_t nwrite = __send_once(_sock, _head, _head_len, _body, _body_len, sent_len);
         if (nwrite == 0 || (0 > nwrite && !IS_NOBLOCK_SEND_ERRNO(socket_errno))) {
             _errcode = socket_errno;
             return -1;
@@ -133,7 +174,7 @@ int block_socket_send(SOCKET _sock,
         if (0 < nwrite)
             sent_len += nwrite;
 
-        if (sent_len >= _len) {
+        if (sent_len >= len) {
             _errcode = 0;
             return (int)sent_len;
         }
@@ -171,6 +212,18 @@ int block_socket_send(SOCKET _sock,
     }
 }
 
+/*
+ * return value:
+ */
+int block_socket_send(SOCKET _sock,
+                      const void* _buffer,
+                      size_t _len,
+                      SocketBreaker& _breaker,
+                      int& _errcode,
+                      int _timeout) {
+    return block_socket_sendv(_sock, _buffer, _len, NULL, 0, _breaker, _errcode, _timeout);
+}
+
 int block_socket_recv(SOCKET _sock,
                       AutoBuffer& _buffer,
                       size_t _max_size,
@@ -45,6 +45,15 @@ int block_socket_send(SOCKET _sock,
                       SocketBreaker& _breaker,
                       int& _errcode,
                       int _timeout = -1);
+// _head and then _body in gathered writes, without joining them in one buffer first
+int block_socket_sendv(SOCKET _sock,
+                       const void* _head,
+                       size_t _head_len,
+                       const void* _body,
+                       size_t _body_len,
+                       SocketBreaker& _breaker,
+                       int& _errcode,
+                       int _timeout = -1);
 int block_socket_recv(SOCKET _sock,
                       AutoBuffer& _buffer,
                       size_t _max_size,
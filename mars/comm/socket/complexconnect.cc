@@ -32,10 +32,12 @@
 #include "comm/comm_data.h"
 #include "comm/crypt/ibase64.h"
 #include "comm/http.h"
+#include "comm/macro.h"
 #include "comm/platform_comm.h"
 #include "comm/socket/socket_address.h"
 #include "comm/socket/socketselect.h"
 #include "comm/socket/tcpclient_fsm.h"
+#include "comm/thread/lock.h"
 #include "comm/time_utils.h"
 #include "comm/xlogger/xlogger.h"
 
@@ -43,6 +45,109 @@ namespace mars {
 namespace comm {
 
 static const int kMaxConnectingLoopCount = 30;
+// RFC 8305 5: however fast connects have been, attempts are not staggered tighter than this
+static const unsigned int kMinAttemptDelay = 100;
+#ifdef _WIN32
+// the feed's wakeup is an event, not an fd select can take
+static const int kFeedPollInterval = 50;
+#endif
+
+// connect rtt of the winning attempts, smoothed the way TCP does its rto (RFC 6298)
+NO_DESTROY static Mutex sg_rtt_mutex;
+static int sg_srtt = 0;  // 0: no sample yet
+static int sg_rttvar = 0;
+
+static void __ReportConnectRtt(int _rtt) {
+    if (0 >= _rtt)
+        return;
+
+    ScopedLock lock(sg_rtt_mutex);
+    if (0 == sg_srtt) {
+        sg_srtt = _rtt;
+        sg_rttvar = _rtt / 2;
+        return;
+    }
+    sg_rttvar = (3 * sg_rttvar + abs(sg_srtt - _rtt)) / 4;
+    sg_srtt = (7 * sg_srtt + _rtt) / 8;
+}
+
+static int __RttAttemptDelay() {
+    ScopedLock lock(sg_rtt_mutex);
+    return 0 == sg_srtt ? 0 : sg_srtt + 4 * sg_rttvar;
+}
+
+ConnectFeed::ConnectFeed(bool _interleave_family)
+: interleave_family_(_interleave_family), first_v6_(false), last_v6_(false), handed_(0), finished_(false) {
+}
+
+ConnectFeed::~ConnectFeed() {
+}
+
+void ConnectFeed::Push(const std::vector<socket_address>& _addrs) {
+    if (_addrs.empty())
+        return;
+
+    ScopedLock lock(mutex_);
+    xassert2(!finished_, "push after finish");
+    for (std::vector<socket_address>::const_iterator it = _addrs.begin(); it != _addrs.end(); ++it) {
+        if (addrs_.empty())
+            first_v6_ = it->isv6();
+        (interleave_family_ && it->isv6() ? v6_ : v4_).push_back((unsigned int)addrs_.size());
+        addrs_.push_back(*it);
+    }
+    lock.unlock();
+    wakeup_.Break();
+}
+
+void ConnectFeed::Finish() {
+    ScopedLock lock(mutex_);
+    finished_ = true;
+    lock.unlock();
+    wakeup_.Break();
+}
+
+const socket_address* ConnectFeed::Next(unsigned int& _index) {
+    ScopedLock lock(mutex_);
+    std::deque<unsigned int>* queue = &v4_;
+    if (interleave_family_) {
+        // the other family than last time, the first family pushed to begin with
+        bool want_v6 = 0 == handed_ ? first_v6_ : !last_v6_;
+        queue = want_v6 ? &v6_ : &v4_;
+        if (queue->empty())
+            queue = want_v6 ? &v4_ : &v6_;
+    }
+    if (queue->empty())
+        return NULL;
+
+    _index = queue->front();
+    queue->pop_front();
+    last_v6_ = queue == &v6_;
+    ++handed_;
+    return &addrs_[_index];
+}
+
+bool ConnectFeed::HasPending() const {
+    ScopedLock lock(mutex_);
+    return !v4_.empty() || !v6_.empty();
+}
+
+bool ConnectFeed::IsFinished() const {
+    ScopedLock lock(mutex_);
+    return finished_;
+}
+
+unsigned int ConnectFeed::Count() const {
+    ScopedLock lock(mutex_);
+    return (unsigned int)addrs_.size();
+}
+
+SocketBreaker& ConnectFeed::Wakeup() {
+    return wakeup_;
+}
+
+void ConnectFeed::ClearWakeup() {
+    wakeup_.Clear();
+}
 
 bool IsV6(const socket_address& _address) {
     in6_addr addr6 = IN6ADDR_ANY_INIT;
@@ -122,6 +227,13 @@ int ComplexConnect::__ConnectTimeout(unsigned int _index) const {
     return __ConnectTime(_index) + timeout_;
 }
 
+unsigned int ComplexConnect::__AttemptDelay() const {
+    int delay = __RttAttemptDelay();
+    if (0 == delay)
+        return interval_;
+    return std::min(interval_, std::max(kMinAttemptDelay, (unsigned int)delay));
+}
+
 namespace {
 
 class ConnectCheckFSM : public TcpClientFSM {
@@ -565,16 +677,15 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
                                         const socket_address* _proxy_addr,
                                         const std::string& _proxy_username,
                                         const std::string& _proxy_pwd) {
-    trycount_ = 0;
-    index_ = -1;
-    errcode_ = 0;
-    index_conn_rtt_ = 0;
-    index_conn_totalcost_ = 0;
-    totalcost_ = 0;
-    is_interrupted_ = false;
-    is_connective_check_failed_ = false;
-
     if (_vecaddr.empty()) {
+        trycount_ = 0;
+        index_ = -1;
+        errcode_ = 0;
+        index_conn_rtt_ = 0;
+        index_conn_totalcost_ = 0;
+        totalcost_ = 0;
+        is_interrupted_ = false;
+        is_connective_check_failed_ = false;
         xwarn2(TSF "_vecaddr size:%_, m_timeout:%_, m_interval:%_, m_error_interval:%_, m_max_connect:%_, @%_",
                _vecaddr.size(),
                timeout_,
@@ -585,53 +696,50 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
         return INVALID_SOCKET;
     }
 
+    // the caller has ordered the list already
+    ConnectFeed feed(false);
+    feed.Push(_vecaddr);
+    feed.Finish();
+    return __ConnectImpatient(feed, _breaker, _observer, _proxy_type, _proxy_addr, _proxy_username, _proxy_pwd);
+}
+
+SOCKET ComplexConnect::ConnectImpatient(ConnectFeed& _feed, SocketBreaker& _breaker, MComplexConnect* _observer) {
+    return __ConnectImpatient(_feed, _breaker, _observer, mars::comm::kProxyNone, NULL, "", "");
+}
+
+SOCKET ComplexConnect::__ConnectImpatient(ConnectFeed& _feed,
+                                          SocketBreaker& _breaker,
+                                          MComplexConnect* _observer,
+                                          mars::comm::ProxyType _proxy_type,
+                                          const socket_address* _proxy_addr,
+                                          const std::string& _proxy_username,
+                                          const std::string& _proxy_pwd) {
+    trycount_ = 0;
+    index_ = -1;
+    errcode_ = 0;
+    index_conn_rtt_ = 0;
+    index_conn_totalcost_ = 0;
+    totalcost_ = 0;
+    is_interrupted_ = false;
+    is_connective_check_failed_ = false;
+
+    const unsigned int interval = __AttemptDelay();
+
     xinfo2_if(need_detail_log_,
-              TSF "_vecaddr size:%_, m_timeout:%_, m_interval:%_, m_error_interval:%_, m_max_connect:%_, @%_",
-              _vecaddr.size(),
+              TSF "feed size:%_, finished:%_, m_timeout:%_, m_interval:%_(%_), m_error_interval:%_, "
+                  "m_max_connect:%_, @%_",
+              _feed.Count(),
+              _feed.IsFinished(),
               timeout_,
               interval_,
+              interval,
               error_interval_,
               max_connect_,
               this);
 
     uint64_t starttime = gettickcount();
-    std::vector<ConnectCheckFSM*> vecsocketfsm;
-
-    for (unsigned int i = 0; i < _vecaddr.size(); ++i) {
-        xverbose2(TSF "complex.conn %_", _vecaddr[i].url());
-
-        ConnectCheckFSM* ic = NULL;
-        if (mars::comm::kProxyHttpTunel == _proxy_type && _proxy_addr) {
-            ic = new ConnectHttpTunelCheckFSM(_vecaddr[i],
-                                              *_proxy_addr,
-                                              _proxy_username,
-                                              _proxy_pwd,
-                                              timeout_,
-                                              i,
-                                              _observer);
-        } else if (mars::comm::kProxySocks5 == _proxy_type && _proxy_addr) {
-            ic = new ConnectSocks5CheckFSM(_vecaddr[i],
-                                           *_proxy_addr,
-                                           _proxy_username,
-                                           _proxy_pwd,
-                                           timeout_,
-                                           i,
-                                           _observer);
-        } else {
-            if (indepent_timeout_) {
-                if (IsV6(_vecaddr[i])) {
-                    ic = new ConnectCheckFSM(_vecaddr[i], v6_timeout_, i, _observer);
-                    xdebug2(TSF "ip %_ is v6", _vecaddr[i].ip());
-                } else {
-                    ic = new ConnectCheckFSM(_vecaddr[i], v4_timeout_, i, _observer);
-                }
-            } else {
-                ic = new ConnectCheckFSM(_vecaddr[i], timeout_, i, _observer);
-            }
-        }
-
-        vecsocketfsm.push_back(ic);
-    }
+    std::vector<ConnectCheckFSM*> vecsocketfsm;  // by start order
+    std::vector<unsigned int> vecindex;          // the feed index of each
 
     uint64_t curtime = gettickcount();
 
@@ -640,7 +748,6 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
     xdebug2(TSF "curtime:%_, laststart_connecttime:%_, @%_", curtime, laststart_connecttime, this);
 
     int lasterror = 0;
-    unsigned int index = 0;
     SOCKET retsocket = INVALID_SOCKET;
 
     int loop_count = 0;
@@ -652,47 +759,95 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
         sel.PreSelect();
 
         int next_connect_timeout =
-            int(((0 == lasterror) ? interval_ : error_interval_) - (curtime - laststart_connecttime));
+            int(((0 == lasterror) ? interval : error_interval_) - (curtime - laststart_connecttime));
 
         xverbose2(TSF "next_connect_timeout %_", next_connect_timeout);
 
         int timeout = (int)timeout_;
         unsigned int runing_count =
             (unsigned int)std::count_if(vecsocketfsm.begin(), vecsocketfsm.end(), &__isconnecting);
+        bool has_pending = _feed.HasPending();
 
-        if (index < vecsocketfsm.size() && 0 < next_connect_timeout && runing_count < max_connect_) {
+        if (has_pending && 0 < next_connect_timeout && runing_count < max_connect_) {
             timeout = std::min(timeout, next_connect_timeout);
         }
 
         // connect
-        if (index < vecsocketfsm.size() && 0 >= next_connect_timeout && runing_count < max_connect_) {
+        if (has_pending && 0 >= next_connect_timeout && runing_count < max_connect_) {
+            unsigned int i = 0;
+            const socket_address* addr = _feed.Next(i);
+            xverbose2(TSF "complex.conn %_", addr->url());
+
+            ConnectCheckFSM* ic = NULL;
+            if (mars::comm::kProxyHttpTunel == _proxy_type && _proxy_addr) {
+                ic = new ConnectHttpTunelCheckFSM(*addr,
+                                                  *_proxy_addr,
+                                                  _proxy_username,
+                                                  _proxy_pwd,
+                                                  timeout_,
+                                                  i,
+                                                  _observer);
+            } else if (mars::comm::kProxySocks5 == _proxy_type && _proxy_addr) {
+                ic = new ConnectSocks5CheckFSM(*addr,
+                                               *_proxy_addr,
+                                               _proxy_username,
+                                               _proxy_pwd,
+                                               timeout_,
+                                               i,
+                                               _observer);
+            } else {
+                if (indepent_timeout_) {
+                    if (IsV6(*addr)) {
+                        ic = new ConnectCheckFSM(*addr, v6_timeout_, i, _observer);
+                        xdebug2(TSF "ip %_ is v6", addr->ip());
+                    } else {
+                        ic = new ConnectCheckFSM(*addr, v4_timeout_, i, _observer);
+                    }
+                } else {
+                    ic = new ConnectCheckFSM(*addr, timeout_, i, _observer);
+                }
+            }
+
+            vecsocketfsm.push_back(ic);
+            vecindex.push_back(i);
+
             if (runing_count + 1 < max_connect_) {
-                timeout = std::min(timeout, (int)interval_);
+                timeout = std::min(timeout, (int)interval);
             }
             xdebug2(TSF "running count: %_, index: %_, timeout: %_, %_",
-                    index,
                     runing_count,
+                    i,
                     next_connect_timeout,
                     timeout);
 
             laststart_connecttime = gettickcount();
             lasterror = 0;
 
-            trycount_ = (unsigned int)(index + 1);
-            ++index;
+            trycount_ = (unsigned int)vecsocketfsm.size();
         }
 
-        for (unsigned int i = 0; i < index; ++i) {
+        for (unsigned int i = 0; i < vecsocketfsm.size(); ++i) {
             if (NULL == vecsocketfsm[i])
                 continue;
 
             xgroup2_define(group);
             vecsocketfsm[i]->PreSelect(sel, group);
-            need_detail_log_ && !group.Empty() ? (xgroup2(TSF "index:%_, @%_, ", i, this) << group) : group.Clear();
+            need_detail_log_ && !group.Empty() ? (xgroup2(TSF "index:%_, @%_, ", vecindex[i], this) << group)
+                                               : group.Clear();
             timeout = std::min(timeout, vecsocketfsm[i]->Timeout());
             xdebug2(TSF "connect ip timeout: %_", vecsocketfsm[i]->Timeout());
         }
 
+        // addresses still to come wake the select up
+        bool feed_finished = _feed.IsFinished();
+        if (!feed_finished) {
+#ifdef _WIN32
+            timeout = std::min(timeout, kFeedPollInterval);
+#else
+            sel.Read_FD_SET(_feed.Wakeup().BreakerFD());
+#endif
+        }
+
         xdebug2(TSF "timeout:%_, @%_", timeout, this);
         int ret = 0;
 
@@ -725,15 +880,21 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
             break;
         }
 
+#ifndef _WIN32
+        if (!feed_finished && sel.Read_FD_ISSET(_feed.Wakeup().BreakerFD())) {
+            _feed.ClearWakeup();
+        }
+#endif
+
         // socket
-        for (unsigned int i = 0; i < index; ++i) {
+        for (unsigned int i = 0; i < vecsocketfsm.size(); ++i) {
             if (NULL == vecsocketfsm[i])
                 continue;
 
             xgroup2_define(group);
             vecsocketfsm[i]->AfterSelect(sel, group);
             (!group.Empty() && need_detail_log_) ? (xgroup2(TSF "index:%_, @%_, status:%_,%_",
-                                                            i,
+                                                            vecindex[i],
                                                             this,
                                                             vecsocketfsm[i]->Status(),
                                                             vecsocketfsm[i]->CheckStatus())
@@ -742,7 +903,7 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
 
             if (TcpClientFSM::EEnd == vecsocketfsm[i]->Status()) {
                 if (_observer)
-                    _observer->OnFinished(i,
+                    _observer->OnFinished(vecindex[i],
                                           socket_address(&vecsocketfsm[i]->Address()),
                                           vecsocketfsm[i]->Socket(),
                                           vecsocketfsm[i]->Error(),
@@ -762,7 +923,7 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
             if (TcpClientFSM::EReadWrite == vecsocketfsm[i]->Status()
                 && ConnectCheckFSM::ECheckFail == vecsocketfsm[i]->CheckStatus()) {
                 if (_observer)
-                    _observer->OnFinished(i,
+                    _observer->OnFinished(vecindex[i],
                                           socket_address(&vecsocketfsm[i]->Address()),
                                           vecsocketfsm[i]->Socket(),
                                           vecsocketfsm[i]->Error(),
@@ -783,7 +944,7 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
             if (TcpClientFSM::EReadWrite == vecsocketfsm[i]->Status()
                 && ConnectCheckFSM::ECheckOK == vecsocketfsm[i]->CheckStatus()) {
                 if (_observer)
-                    _observer->OnFinished(i,
+                    _observer->OnFinished(vecindex[i],
                                           socket_address(&vecsocketfsm[i]->Address()),
                                           vecsocketfsm[i]->Socket(),
                                           vecsocketfsm[i]->Error(),
@@ -794,7 +955,7 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
                 errcode_ = vecsocketfsm[i]->Error();
                 xinfo2_if(need_detail_log_,
                           TSF "index:%_, sock:%_, suc ConnectImpatient:%_:%_, RTT:(%_, %_), @%_",
-                          i,
+                          vecindex[i],
                           vecsocketfsm[i]->Socket(),
                           vecsocketfsm[i]->IP(),
                           vecsocketfsm[i]->Port(),
@@ -802,9 +963,10 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
                           vecsocketfsm[i]->TotalRtt(),
                           this);
                 retsocket = vecsocketfsm[i]->Socket();
-                index_ = i;
+                index_ = vecindex[i];
                 index_conn_rtt_ = vecsocketfsm[i]->Rtt();
                 index_conn_totalcost_ = vecsocketfsm[i]->TotalRtt();
+                __ReportConnectRtt(index_conn_rtt_);
                 vecsocketfsm[i]->Socket(INVALID_SOCKET);
                 delete vecsocketfsm[i];
                 vecsocketfsm[i] = NULL;
@@ -812,8 +974,8 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
             }
         }
 
-        // end of loop
-        bool all_invalid = true;
+        // end of loop, once nothing is connecting and nothing more will be fed
+        bool all_invalid = _feed.IsFinished() && !_feed.HasPending();
 
         for (unsigned int i = 0; i < vecsocketfsm.size(); ++i) {
             if (NULL != vecsocketfsm[i]) {
@@ -833,6 +995,7 @@ SOCKET ComplexConnect::ConnectImpatient(const std::vector<socket_address>& _veca
 
     } while (true);
 
+    // the losers are closed at once, without waiting for their handshakes
     for (unsigned int i = 0; i < vecsocketfsm.size(); ++i) {
         if (NULL != vecsocketfsm[i]) {
             vecsocketfsm[i]->Close(false);
@@ -22,19 +22,20 @@
 
 #include <stddef.h>
 
+#include <deque>
 #include <vector>
 
 #include "comm_data.h"
+#include "comm/socket/socket_address.h"
+#include "comm/socket/socketbreaker.h"
+#include "comm/thread/mutex.h"
 #include "unix_socket.h"
 
-class socket_address;
 class AutoBuffer;
 
 namespace mars {
 namespace comm {
 
-class SocketBreaker;
-
 class MComplexConnect {
  public:
     virtual ~MComplexConnect() {
@@ -75,6 +76,47 @@ class MComplexConnect {
     }
 };
 
+/**
+ * addresses handed to ConnectImpatient while it is already connecting, by a resolver still
+ * waiting on other hosts or families; Finish() once nothing more will come.
+ * With _interleave_family the addresses are tried alternating IPv6 and IPv4, starting with
+ * the family of the first one pushed (RFC 8305 4), otherwise in the order pushed.
+ * An address keeps the index of its push order in the MComplexConnect callbacks and Index().
+ */
+class ConnectFeed {
+ public:
+    explicit ConnectFeed(bool _interleave_family = true);
+    ~ConnectFeed();
+
+    void Push(const std::vector<socket_address>& _addrs);
+    void Finish();
+
+    // the next address to try, NULL if none is waiting; it stays valid as long as the feed
+    const socket_address* Next(unsigned int& _index);
+    bool HasPending() const;
+    bool IsFinished() const;
+    unsigned int Count() const;
+    // becomes readable on every Push() and Finish(), until ClearWakeup()
+    SocketBreaker& Wakeup();
+    void ClearWakeup();
+
+ private:
+    ConnectFeed(const ConnectFeed&);
+    ConnectFeed& operator=(const ConnectFeed&);
+
+ private:
+    mutable Mutex mutex_;
+    SocketBreaker wakeup_;
+    const bool interleave_family_;
+    std::deque<socket_address> addrs_;  // by push order, a deque so Next() stays valid over Push()
+    std::deque<unsigned int> v6_;
+    std::deque<unsigned int> v4_;  // every index when not interleaving
+    bool first_v6_;
+    bool last_v6_;
+    unsigned int handed_;
+    bool finished_;
+};
+
 class ComplexConnect {
  public:
  public:
@@ -97,6 +139,8 @@ class ComplexConnect {
                             const socket_address* _proxy_addr = NULL,
                             const std::string& _proxy_username = "",
                             const std::string& _proxy_pwd = "");
+    // starts on the first address fed while the rest are still coming
+    SOCKET ConnectImpatient(ConnectFeed& _feed, SocketBreaker& _breaker, MComplexConnect* _observer = NULL);
 
     unsigned int TryCount() const {
         return trycount_;
@@ -130,6 +174,14 @@ class ComplexConnect {
  private:
     int __ConnectTime(unsigned int _index) const;
     int __ConnectTimeout(unsigned int _index) const;
+    unsigned int __AttemptDelay() const;
+    SOCKET __ConnectImpatient(ConnectFeed& _feed,
+                              SocketBreaker& _breaker,
+                              MComplexConnect* _observer,
+                              mars::comm::ProxyType _proxy_type,
+                              const socket_address* _proxy_addr,
+                              const std::string& _proxy_username,
+                              const std::string& _proxy_pwd);
 
  private:
     ComplexConnect(const ComplexConnect&);
@@ -0,0 +1,151 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * complexconnect_unittest.cc
+ *
+ * The feed's family interleaving, and a connect that wins on the first
+ * address fed while the feed is still open.
+ */
+
+#include "complexconnect.h"
+
+#include <netinet/in.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "comm/thread/condition.h"
+#include "comm/thread/lock.h"
+#include "comm/thread/thread.h"
+#include "gtest/gtest.h"
+
+using namespace mars::comm;
+
+namespace {
+
+std::vector<std::string> __Drain(ConnectFeed& _feed, std::vector<unsigned int>& _indexes) {
+    std::vector<std::string> ips;
+    unsigned int index = 0;
+    const socket_address* addr = NULL;
+    while (NULL != (addr = _feed.Next(index))) {
+        ips.push_back(addr->ip());
+        _indexes.push_back(index);
+    }
+    return ips;
+}
+
+}  // namespace
+
+TEST(complexconnect, feed_interleaves_families) {
+    ConnectFeed feed;
+    std::vector<socket_address> first;
+    first.push_back(socket_address("2001:db8::1", 80));
+    first.push_back(socket_address("2001:db8::2", 80));
+    first.push_back(socket_address("192.0.2.1", 80));
+    feed.Push(first);
+    feed.Push(std::vector<socket_address>(1, socket_address("192.0.2.2", 80)));
+    feed.Finish();
+
+    std::vector<unsigned int> indexes;
+    std::vector<std::string> ips = __Drain(feed, indexes);
+    ASSERT_EQ(4u, ips.size());
+    EXPECT_EQ("2001:db8::1", ips[0]);
+    EXPECT_EQ("192.0.2.1", ips[1]);
+    EXPECT_EQ("2001:db8::2", ips[2]);
+    EXPECT_EQ("192.0.2.2", ips[3]);
+    // callbacks and Index() keep the push order
+    EXPECT_EQ(0u, indexes[0]);
+    EXPECT_EQ(2u, indexes[1]);
+    EXPECT_EQ(1u, indexes[2]);
+    EXPECT_EQ(3u, indexes[3]);
+    EXPECT_FALSE(feed.HasPending());
+}
+
+TEST(complexconnect, feed_keeps_order_without_interleave) {
+    ConnectFeed feed(false);
+    std::vector<socket_address> addrs;
+    addrs.push_back(socket_address("192.0.2.1", 80));
+    addrs.push_back(socket_address("2001:db8::1", 80));
+    addrs.push_back(socket_address("2001:db8::2", 80));
+    feed.Push(addrs);
+
+    std::vector<unsigned int> indexes;
+    std::vector<std::string> ips = __Drain(feed, indexes);
+    ASSERT_EQ(3u, ips.size());
+    EXPECT_EQ("192.0.2.1", ips[0]);
+    EXPECT_EQ("2001:db8::1", ips[1]);
+    EXPECT_EQ("2001:db8::2", ips[2]);
+}
+
+TEST(complexconnect, connects_before_feed_finishes) {
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, bind(listener, (struct sockaddr*)&addr, sizeof(addr)));
+    ASSERT_EQ(0, listen(listener, 8));
+    socklen_t len = sizeof(addr);
+    getsockname(listener, (struct sockaddr*)&addr, &len);
+    uint16_t port = ntohs(addr.sin_port);
+
+    // the first host resolves after 50ms, the feed finishes only once the connect has returned
+    ConnectFeed feed;
+    Mutex mutex;
+    Condition returned_cond;
+    bool returned = false;
+    Thread resolver([&]() {
+        usleep(50 * 1000);
+        feed.Push(std::vector<socket_address>(1, socket_address("127.0.0.1", port)));
+        ScopedLock lock(mutex);
+        if (!returned)
+            returned_cond.wait(lock, 10 * 1000);  // bounded, a connect waiting for Finish() still ends
+        lock.unlock();
+        feed.Finish();
+    });
+    resolver.start();
+
+    SocketBreaker breaker;
+    ComplexConnect conn(5000, 1000);
+    SOCKET sock = conn.ConnectImpatient(feed, breaker);
+    EXPECT_FALSE(feed.IsFinished());
+    ScopedLock lock(mutex);
+    returned = true;
+    returned_cond.notifyAll(lock);
+    lock.unlock();
+
+    EXPECT_NE(INVALID_SOCKET, sock);
+    EXPECT_EQ(0, conn.Index());
+    EXPECT_EQ(1u, conn.TryCount());
+
+    resolver.join();
+    socket_close(sock);
+    socket_close(listener);
+}
+
+TEST(complexconnect, finished_empty_feed_gives_up) {
+    ConnectFeed feed;
+    Thread resolver([&]() {
+        usleep(50 * 1000);
+        feed.Finish();
+    });
+    resolver.start();
+
+    SocketBreaker breaker;
+    ComplexConnect conn(5000, 1000);
+    EXPECT_EQ(INVALID_SOCKET, conn.ConnectImpatient(feed, breaker));
+    EXPECT_EQ(0u, conn.TryCount());
+    resolver.join();
+}
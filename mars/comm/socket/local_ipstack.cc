@@ -21,6 +21,8 @@
 
 #include <vector>
 
+#include "comm/network/network_state.h"
+#include "comm/time_utils.h"
 #include "xlogger/xlogger.h"
 #if (defined(__APPLE__) || defined(ANDROID))
 #include <strings.h>
@@ -259,14 +261,9 @@ TLocalIPStack __local_ipstack_detect(std::string& _log) {
 #endif
 }
 
-TLocalIPStack local_ipstack_detect() {
-    std::string log;
-    return __local_ipstack_detect(log);
-}
-
 static void __local_info(std::string& _log);
 
-TLocalIPStack local_ipstack_detect_log(std::string& _log) {
+TLocalIPStack local_ipstack_probe_log(std::string& _log) {
     __local_info(_log);
     _log += get_local_route_table();
     return __local_ipstack_detect(_log);
@@ -483,24 +480,31 @@ TLocalIPStack __local_ipstack_detect(std::string& _log) {
     return (TLocalIPStack)local_stack;
 }
 
-TLocalIPStack local_ipstack_detect() {
+TLocalIPStack local_ipstack_probe_log(std::string& _log) {
     xinfo2(TSF "windows start to detect local stack");
+    _log = "no implement";
     std::string log;
     return __local_ipstack_detect(log);
 }
-TLocalIPStack local_ipstack_detect_log(std::string& _log) {
+
+#else
+
+TLocalIPStack local_ipstack_probe_log(std::string& _log) {
     _log = "no implement";
-    return local_ipstack_detect();
+    return ELocalIPStack_IPv4;
 }
 
-#else
+#endif  //__APPLE__
 
 TLocalIPStack local_ipstack_detect() {
-    return ELocalIPStack_IPv4;
+    return mars::comm::NetworkState::Instance().Current()->ipstack;
 }
+
 TLocalIPStack local_ipstack_detect_log(std::string& _log) {
-    _log = "no implement";
-    return local_ipstack_detect();
+    std::shared_ptr<const mars::comm::NetworkStateSnapshot> snapshot = mars::comm::NetworkState::Instance().Current();
+    // the log of the probe of this network, maybe written for an earlier caller
+    _log += "cached, epoch:" + std::to_string(snapshot->epoch) + ", probed "
+          + std::to_string(gettickcount() - snapshot->probe_tick) + "ms ago; ";
+    _log += snapshot->ipstack_log;
+    return snapshot->ipstack;
 }
-
-#endif  //__APPLE__
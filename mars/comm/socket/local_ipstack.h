@@ -46,5 +46,8 @@ TLocalIPStack local_ipstack_detect();
 
 #include <string>
 TLocalIPStack local_ipstack_detect_log(std::string& _log);
+// Probes with throwaway sockets right now. The two above return the result cached for the current network,
+// local_ipstack_detect_log with the log of that probe, labeled with its epoch and age.
+TLocalIPStack local_ipstack_probe_log(std::string& _log);
 
 #endif /* __ip_type__ */
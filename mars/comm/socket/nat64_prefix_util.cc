@@ -19,6 +19,8 @@
 
 #include "nat64_prefix_util.h"
 
+#include "comm/network/network_state.h"
+#include "comm/thread/lock.h"
 #include "local_ipstack.h"
 #include "mars/comm/network/getaddrinfo_with_timeout.h"
 #include "platform_comm.h"
@@ -200,86 +202,132 @@ static void ReplaceNat64WithV4IP(struct in6_addr* _replaced_nat64_addr, const st
     }
 }
 
-bool ConvertV4toNat64V6(const struct in_addr& _v4_addr, struct in6_addr& _v6_addr) {
-    xdebug_function();
-    if (ELocalIPStack_IPv6 != local_ipstack_detect()) {
-        xwarn2(TSF "Current Network is not ELocalIPStack_IPv6, no need GetNetworkNat64Prefix.");
-        return false;
+/*
+ * ipv4only.arpa as the DNS64 of the current network synthesizes it, resolved once per network epoch.
+ * Only a valid answer is kept, a failed lookup is retried by the next caller.
+ * */
+static bool GetIPv4OnlyArpaNat64Addr(struct in6_addr& _nat64_addr) {
+    static Mutex mutex;
+    static uint64_t cached_epoch = 0;
+    static struct in6_addr cached_addr;
+
+    uint64_t epoch = NetworkState::Instance().Epoch();
+    {
+        ScopedLock lock(mutex);
+        if (cached_epoch == epoch) {
+            memcpy(&_nat64_addr, &cached_addr, sizeof(cached_addr));
+            return true;
+        }
     }
-    struct ::addrinfo hints, *res = NULL, *res0 = NULL;
-    int error = 0;
 
+    struct ::addrinfo hints, *res = NULL, *res0 = NULL;
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = PF_INET6;
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_ADDRCONFIG;
 
-    char v4_ip[16] = {0};
-    socket_inet_ntop(AF_INET, &_v4_addr, v4_ip, sizeof(v4_ip));
     bool is_timeout = false;
-#ifdef __APPLE__
-    if (publiccomponent_GetSystemVersion() >= 9.2f) {  // higher than iOS9.2
-        error = getaddrinfo_with_timeout(v4_ip, NULL, &hints, &res0, is_timeout, 2000);
-    } else {  // lower than iOS9.2 or other platform
-#endif
-        error = mars::comm::getaddrinfo_with_timeout("ipv4only.arpa", NULL, &hints, &res0, is_timeout, 2000);
-#ifdef __APPLE__
-    }
-#endif
-
+    int error = mars::comm::getaddrinfo_with_timeout("ipv4only.arpa", NULL, &hints, &res0, is_timeout, 2000);
     bool ret = false;
     if (error == 0) {
         for (res = res0; res; res = res->ai_next) {
-            char ip_buf[64] = {0};
-
             if (AF_INET6 == res->ai_family) {
-#ifdef __APPLE__
-                if (publiccomponent_GetSystemVersion() >= 9.2f) {  // higher than iOS9.2
-                    // copy all 16 bytes
-                    memcpy((char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr32), 16);
+                struct in6_addr* addr = &(((sockaddr_in6*)res->ai_addr)->sin6_addr);
+                if (IsNat64AddrValid(addr)) {
+                    memcpy(&_nat64_addr, addr, sizeof(_nat64_addr));
                     ret = true;
                     break;
-                } else {  // lower than iOS9.2 or other platform
-#endif
+                }
+                xerror2(TSF "Nat64 addr invalid, =%_", strutil::Hex2Str((char*)addr, 16));
+            } else if (AF_INET == res->ai_family) {
+                char ip_buf[64] = {0};
+                const char* ip_str =
+                    socket_inet_ntop(AF_INET, &(((sockaddr_in*)res->ai_addr)->sin_addr), ip_buf, sizeof(ip_buf));
+                xinfo2(TSF "AF_INET ip_str = %_", ip_str);
+            } else {
+                xerror2(TSF "invalid ai_family = %_", res->ai_family);
+            }
+        }
+    } else {
+        xerror2(TSF " getaddrinfo error = %_, res0:@%_, timeout:%_", error, res0, is_timeout);
+    }
+    if (NULL != res0)
+        freeaddrinfo(res0);
+
+    if (ret) {
+        ScopedLock lock(mutex);
+        cached_epoch = epoch;
+        memcpy(&cached_addr, &_nat64_addr, sizeof(cached_addr));
+    }
+    return ret;
+}
 
-                    if (IsNat64AddrValid((struct in6_addr*)&(((sockaddr_in6*)res->ai_addr)->sin6_addr))) {
-                        ReplaceNat64WithV4IP((struct in6_addr*)&(((sockaddr_in6*)res->ai_addr)->sin6_addr), &_v4_addr);
-#ifdef WIN32
-                        memcpy((char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).u), 16);
-#else
-                    memcpy((char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr16), 16);
-#endif
-                        const char* ip_str = socket_inet_ntop(AF_INET6, &_v6_addr, ip_buf, sizeof(ip_buf));
-                        xdebug2(TSF "AF_INET6 v4_ip=%_, nat64 ip_str = %_", v4_ip, ip_str);
-                        ret = true;
-                        break;
-                    } else {
-                        xerror2(TSF "Nat64 addr invalid, =%_",
-                                strutil::Hex2Str((char*)&(((sockaddr_in6*)res->ai_addr)->sin6_addr), 16));
-                        ret = false;
-                    }
 #ifdef __APPLE__
-                }
-#endif
+// iOS 9.2 and above synthesize the literal v4 address itself, so there is nothing per network to cache.
+static bool SynthesizeNat64V6(const struct in_addr& _v4_addr, struct in6_addr& _v6_addr) {
+    struct ::addrinfo hints, *res = NULL, *res0 = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = PF_INET6;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    char v4_ip[16] = {0};
+    socket_inet_ntop(AF_INET, &_v4_addr, v4_ip, sizeof(v4_ip));
+    bool is_timeout = false;
+    int error = getaddrinfo_with_timeout(v4_ip, NULL, &hints, &res0, is_timeout, 2000);
 
+    bool ret = false;
+    if (error == 0) {
+        for (res = res0; res; res = res->ai_next) {
+            if (AF_INET6 == res->ai_family) {
+                // copy all 16 bytes
+                memcpy((char*)&_v6_addr, (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr32), 16);
+                ret = true;
+                break;
             } else if (AF_INET == res->ai_family) {
+                char ip_buf[64] = {0};
                 const char* ip_str =
                     socket_inet_ntop(AF_INET, &(((sockaddr_in*)res->ai_addr)->sin_addr), ip_buf, sizeof(ip_buf));
                 xinfo2(TSF "AF_INET ip_str = %_", ip_str);
-                ret = false;
             } else {
                 xerror2(TSF "invalid ai_family = %_", res->ai_family);
-                ret = false;
             }
         }
     } else {
         xerror2(TSF " getaddrinfo error = %_, res0:@%_", error, res0);
-        ret = false;
     }
     if (NULL != res0)
         freeaddrinfo(res0);
     return ret;
 }
+#endif
+
+bool ConvertV4toNat64V6(const struct in_addr& _v4_addr, struct in6_addr& _v6_addr) {
+    xdebug_function();
+    if (ELocalIPStack_IPv6 != local_ipstack_detect()) {
+        xwarn2(TSF "Current Network is not ELocalIPStack_IPv6, no need GetNetworkNat64Prefix.");
+        return false;
+    }
+#ifdef __APPLE__
+    if (publiccomponent_GetSystemVersion() >= 9.2f) {  // higher than iOS9.2
+        return SynthesizeNat64V6(_v4_addr, _v6_addr);
+    }
+#endif
+
+    struct in6_addr nat64_addr;
+    if (!GetIPv4OnlyArpaNat64Addr(nat64_addr)) {
+        return false;
+    }
+    ReplaceNat64WithV4IP(&nat64_addr, &_v4_addr);
+    memcpy((char*)&_v6_addr, (char*)&nat64_addr, 16);
+
+    char v4_ip[16] = {0};
+    char ip_buf[64] = {0};
+    xdebug2(TSF "AF_INET6 v4_ip=%_, nat64 ip_str = %_",
+            socket_inet_ntop(AF_INET, &_v4_addr, v4_ip, sizeof(v4_ip)),
+            socket_inet_ntop(AF_INET6, &_v6_addr, ip_buf, sizeof(ip_buf)));
+    return true;
+}
 
 bool ConvertV4toNat64V6(const std::string& _v4_ip, std::string& _nat64_v6_ip) {
     struct in_addr v4_addr = {0};
@@ -306,57 +354,26 @@ bool GetNetworkNat64Prefix(struct in6_addr& _nat64_prefix_in6) {
         xwarn2(TSF "Current Network is not ELocalIPStack_IPv6, no need GetNetworkNat64Prefix.");
         return false;
     }
-    struct ::addrinfo hints, *res = NULL, *res0 = NULL;
-    int error = 0;
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = PF_INET6;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_ADDRCONFIG;
 
+    struct in6_addr nat64_addr;
     bool ret = false;
 #ifdef __APPLE__
     if (publiccomponent_GetSystemVersion() >= 9.2f) {
-        error = getaddrinfo("192.0.2.1", NULL, &hints, &res0);
+        struct in_addr our_define_v4_addr;
+        memcpy(&our_define_v4_addr, kOurDefineV4Addr, sizeof(our_define_v4_addr));
+        ret = SynthesizeNat64V6(our_define_v4_addr, nat64_addr);
     } else {
-#endif
-        error = getaddrinfo("ipv4only.arpa", NULL, &hints, &res0);
-#ifdef __APPLE__
+        ret = GetIPv4OnlyArpaNat64Addr(nat64_addr);
     }
-#endif
-    if (error == 0) {
-        for (res = res0; res; res = res->ai_next) {
-            char ip_buf[64] = {0};
-
-            if (AF_INET6 == res->ai_family) {
-#ifdef WIN32
-                memcpy((char*)&(_nat64_prefix_in6.u), (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).u), 12);
 #else
-                memcpy((char*)&(_nat64_prefix_in6.s6_addr16),
-                       (char*)&((((sockaddr_in6*)res->ai_addr)->sin6_addr).s6_addr16),
-                       12);
+    ret = GetIPv4OnlyArpaNat64Addr(nat64_addr);
 #endif
-                ret = true;
-                break;
-
-            } else if (AF_INET == res->ai_family) {
-                const char* ip_str =
-                    socket_inet_ntop(AF_INET, &(((sockaddr_in*)res->ai_addr)->sin_addr), ip_buf, sizeof(ip_buf));
-                xinfo2(TSF "AF_INET ip_str = %_", ip_str);
-                ret = false;
-            } else {
-                xerror2(TSF "invalid ai_family = %_", res->ai_family);
-                ret = false;
-            }
-        }
-    } else {
-        xerror2(TSF " getaddrinfo error = %_, res0:@%_", error, res0);
-        ret = false;
+    if (!ret) {
+        return false;
     }
 
-    if (NULL != res0)
-        freeaddrinfo(res0);
-    return ret;
+    memcpy((char*)&_nat64_prefix_in6, (char*)&nat64_addr, 12);
+    return true;
 }
 
 bool GetNetworkNat64Prefix(std::string& _nat64_prefix) {
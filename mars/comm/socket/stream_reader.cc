@@ -0,0 +1,158 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * stream_reader.cc
+ */
+
+#include "stream_reader.h"
+
+#include <algorithm>
+
+#include "comm/metrics.h"
+#include "comm/time_utils.h"
+#include "comm/xlogger/xlogger.h"
+
+namespace mars {
+namespace comm {
+
+const size_t StreamReader::kMinChunk;
+const size_t StreamReader::kMaxChunk;
+const size_t StreamReader::kDefaultBudget;
+const int StreamReader::kMaxRcvBuf;
+
+static Counter sg_recv_calls("comm.socket.recv_calls");
+static Counter sg_recv_bytes("comm.socket.recv_bytes");
+static Histogram sg_wakeup_bytes("comm.socket.wakeup_bytes");
+
+double StreamReader::Stats::BytesPerWakeup() const {
+    return 0 == wakeups ? 0 : (double)bytes / wakeups;
+}
+
+double StreamReader::Stats::WakeupsPerSecond(uint64_t _now) const {
+    if (0 == start_tick || _now <= start_tick)
+        return 0;
+    return wakeups * 1000.0 / (_now - start_tick);
+}
+
+StreamReader::StreamReader(size_t _budget, bool _tune_rcvbuf)
+: budget_(std::max(_budget, kMinChunk))
+, tune_rcvbuf_(_tune_rcvbuf)
+, avg_wakeup_bytes_(64 * 1024)
+, rcvbuf_(0)
+, pending_errno_(0) {
+}
+
+int StreamReader::Drain(SOCKET _sock, AutoBuffer& _buffer, size_t& _read, int& _errcode) {
+    if (0 == stats_.start_tick)
+        stats_.start_tick = ::gettickcount();
+    ++stats_.wakeups;
+
+    _read = 0;
+    _errcode = 0;
+    bool budget_hit = false;
+
+    if (0 != pending_errno_) {
+        // the data before it went up last wakeup; a recv now might not fail the same way
+        _errcode = pending_errno_;
+        pending_errno_ = 0;
+        return kError;
+    }
+
+    while (true) {
+        int nread = socket_nread(_sock);
+        // FIONREAD says dry; the first recv still goes ahead, it may be the FIN that woke us
+        if (0 < _read && 0 == nread)
+            break;
+        size_t chunk = __NextChunk(nread, budget_ - _read);
+
+        _buffer.Reserve(_buffer.Pos() + chunk);  // recv fills it, no need to zero it first
+        ssize_t recvlen = recv(_sock, (char*)_buffer.PosPtr(), chunk, 0);
+        ++stats_.reads;
+        sg_recv_calls.Add();
+
+        if (0 == recvlen) {
+            // what came before the FIN goes up first, the next wakeup reports the close
+            if (0 == _read)
+                return kClosed;
+            break;
+        }
+
+        if (0 > recvlen) {
+            if (IS_NOBLOCK_READ_ERRNO(socket_errno))
+                break;
+            if (0 == _read) {
+                _errcode = socket_errno;
+                return kError;
+            }
+            // as with the FIN, the data goes up first and the next wakeup reports the error
+            pending_errno_ = socket_errno;
+            break;
+        }
+
+        _buffer.Length(_buffer.Pos() + recvlen, _buffer.Length() + recvlen);
+        _read += recvlen;
+
+        // a short read has emptied the receive queue; another recv would only say EAGAIN
+        if ((size_t)recvlen < chunk)
+            break;
+
+        if (budget_ <= _read) {
+            budget_hit = true;
+            ++stats_.budget_hits;
+            break;
+        }
+    }
+
+    stats_.bytes += _read;
+    sg_recv_bytes.Add((int64_t)_read);
+    sg_wakeup_bytes.Record(_read);
+    stats_.max_wakeup_bytes = std::max(stats_.max_wakeup_bytes, _read);
+    avg_wakeup_bytes_ = (avg_wakeup_bytes_ * 7 + _read) / 8;
+
+    if (tune_rcvbuf_)
+        __TuneRcvBuf(_sock, _read, budget_hit);
+
+    return kRead;
+}
+
+size_t StreamReader::__NextChunk(int _nread, size_t _left) const {
+    size_t chunk = 0 < _nread ? (size_t)_nread : avg_wakeup_bytes_;
+    chunk = std::min(std::max(chunk, kMinChunk), kMaxChunk);
+    return std::max(std::min(chunk, _left), (size_t)1);
+}
+
+void StreamReader::__TuneRcvBuf(SOCKET _sock, size_t _wakeup_bytes, bool _budget_hit) {
+    if (0 == rcvbuf_) {
+        socklen_t len = sizeof(rcvbuf_);
+        if (0 != getsockopt(_sock, SOL_SOCKET, SO_RCVBUF, (char*)&rcvbuf_, &len) || 0 >= rcvbuf_) {
+            rcvbuf_ = kMaxRcvBuf;  // unknown, leave it alone
+            return;
+        }
+    }
+
+    // the window, not the reads, is what holds the burst back
+    if (kMaxRcvBuf <= rcvbuf_ || (!_budget_hit && _wakeup_bytes < (size_t)rcvbuf_ * 3 / 4))
+        return;
+
+    int rcvbuf = std::min(rcvbuf_ * 2, kMaxRcvBuf);
+    if (0 != setsockopt(_sock, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf))) {
+        xwarn2(TSF "sock:%_ SO_RCVBUF %_ err:%_", _sock, rcvbuf, socket_errno);
+        rcvbuf_ = kMaxRcvBuf;
+        return;
+    }
+    xinfo2(TSF "sock:%_ SO_RCVBUF %_ -> %_, wakeup bytes:%_", _sock, rcvbuf_, rcvbuf, _wakeup_bytes);
+    rcvbuf_ = rcvbuf;
+}
+
+}  // namespace comm
+}  // namespace mars
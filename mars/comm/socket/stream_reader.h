@@ -0,0 +1,94 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * stream_reader.h
+ *
+ * Reads a readable stream socket dry in one select wakeup instead of one
+ * fixed recv per wakeup: each recv is sized from FIONREAD, or from what the
+ * last wakeups brought, and the drain stops at EAGAIN, at a short read or at
+ * a byte budget that keeps a long burst from starving the sends.
+ */
+
+#ifndef COMM_SOCKET_STREAM_READER_H_
+#define COMM_SOCKET_STREAM_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "comm/autobuffer.h"
+#include "comm/socket/unix_socket.h"
+
+namespace mars {
+namespace comm {
+
+class StreamReader {
+ public:
+    enum {
+        kRead,    // something or nothing read, the socket is drained or the budget spent
+        kClosed,  // the peer closed, nothing read in this wakeup
+        kError,   // _errcode, nothing read in this wakeup; an error after data is reported by the next Drain
+    };
+
+    struct Stats {
+        Stats() : start_tick(0), wakeups(0), reads(0), bytes(0), budget_hits(0), max_wakeup_bytes(0) {
+        }
+        double BytesPerWakeup() const;
+        double WakeupsPerSecond(uint64_t _now) const;
+
+        uint64_t start_tick;
+        uint64_t wakeups;
+        uint64_t reads;        // recv calls
+        uint64_t bytes;
+        uint64_t budget_hits;  // wakeups that stopped with data still waiting
+        size_t max_wakeup_bytes;
+    };
+
+    static const size_t kMinChunk = 4 * 1024;
+    static const size_t kMaxChunk = 512 * 1024;
+    static const size_t kDefaultBudget = 1024 * 1024;
+    static const int kMaxRcvBuf = 1024 * 1024;
+
+    // _tune_rcvbuf doubles SO_RCVBUF while wakeups find it nearly full; it is off by default on
+    // Linux and Android, where setting it would turn the kernel's own autotuning off
+    explicit StreamReader(size_t _budget = kDefaultBudget, bool _tune_rcvbuf = kTuneRcvBufDefault);
+
+    // appends at _buffer's Pos(), moving Pos() and Length() along as the old 64KB recv did
+    int Drain(SOCKET _sock, AutoBuffer& _buffer, size_t& _read, int& _errcode);
+
+    const Stats& GetStats() const {
+        return stats_;
+    }
+
+ private:
+#if defined(__linux__) || defined(__ANDROID__)
+    static const bool kTuneRcvBufDefault = false;
+#else
+    static const bool kTuneRcvBufDefault = true;
+#endif
+
+    size_t __NextChunk(int _nread, size_t _left) const;
+    void __TuneRcvBuf(SOCKET _sock, size_t _wakeup_bytes, bool _budget_hit);
+
+ private:
+    const size_t budget_;
+    const bool tune_rcvbuf_;
+    size_t avg_wakeup_bytes_;  // smoothed, sizes the first recv when FIONREAD says nothing
+    int rcvbuf_;               // 0: not read yet
+    int pending_errno_;        // a recv failed after data was read, 0: none
+    Stats stats_;
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif  // COMM_SOCKET_STREAM_READER_H_
@@ -0,0 +1,183 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * stream_reader_unittest.cc
+ *
+ * A burst drained in one wakeup, the budget cutting a longer one, and the
+ * close or reset reported only once what came before it has been handed up.
+ */
+
+#include "stream_reader.h"
+
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+using namespace mars::comm;
+
+namespace {
+
+class SocketPair {
+ public:
+    SocketPair() {
+        fds_[0] = fds_[1] = INVALID_SOCKET;
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds_);
+        socket_set_nobio(fds_[0]);
+        int sndbuf = 4 * 1024 * 1024;
+        setsockopt(fds_[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    }
+    ~SocketPair() {
+        Close(0);
+        Close(1);
+    }
+
+    SOCKET Reader() const {
+        return fds_[0];
+    }
+
+    // what actually went into the pair, the peer's buffer may take less
+    size_t Write(size_t _len) {
+        std::string data(_len, 'm');
+        size_t sent = 0;
+        while (sent < _len) {
+            ssize_t n = send(fds_[1], data.data() + sent, _len - sent, MSG_DONTWAIT);
+            if (0 >= n)
+                break;
+            sent += n;
+        }
+        return sent;
+    }
+
+    void Close(int _i) {
+        if (INVALID_SOCKET != fds_[_i])
+            close(fds_[_i]);
+        fds_[_i] = INVALID_SOCKET;
+    }
+
+ private:
+    SOCKET fds_[2];
+};
+
+}  // namespace
+
+TEST(stream_reader, drains_burst_in_one_wakeup) {
+    SocketPair pair;
+    size_t written = pair.Write(200 * 1024);
+    ASSERT_LT(64u * 1024, written);
+
+    StreamReader reader(StreamReader::kDefaultBudget, false);
+    AutoBuffer buffer;
+    size_t read = 0;
+    int err = 0;
+    EXPECT_EQ(StreamReader::kRead, reader.Drain(pair.Reader(), buffer, read, err));
+    EXPECT_EQ(written, read);
+    EXPECT_EQ(written, buffer.Length());
+    EXPECT_EQ(written, buffer.Pos());
+
+    const StreamReader::Stats& stats = reader.GetStats();
+    EXPECT_EQ(1u, stats.wakeups);
+    EXPECT_EQ(written, stats.bytes);
+    EXPECT_EQ(written, stats.max_wakeup_bytes);
+    EXPECT_EQ(0u, stats.budget_hits);
+}
+
+TEST(stream_reader, budget_leaves_the_rest_for_next_wakeup) {
+    SocketPair pair;
+    size_t written = pair.Write(100 * 1024);
+    ASSERT_LT(32u * 1024, written);
+
+    StreamReader reader(32 * 1024, false);
+    AutoBuffer buffer;
+    size_t read = 0;
+    int err = 0;
+    EXPECT_EQ(StreamReader::kRead, reader.Drain(pair.Reader(), buffer, read, err));
+    EXPECT_EQ(32u * 1024, read);
+    EXPECT_EQ(1u, reader.GetStats().budget_hits);
+
+    size_t total = read;
+    while (total < written && StreamReader::kRead == reader.Drain(pair.Reader(), buffer, read, err) && 0 < read)
+        total += read;
+    EXPECT_EQ(written, total);
+    EXPECT_EQ(written, buffer.Length());
+    EXPECT_DOUBLE_EQ((double)written / reader.GetStats().wakeups, reader.GetStats().BytesPerWakeup());
+}
+
+TEST(stream_reader, close_after_data) {
+    SocketPair pair;
+    size_t written = pair.Write(1000);
+    pair.Close(1);
+
+    StreamReader reader;
+    AutoBuffer buffer;
+    size_t read = 0;
+    int err = 0;
+    EXPECT_EQ(StreamReader::kRead, reader.Drain(pair.Reader(), buffer, read, err));
+    EXPECT_EQ(written, read);
+    EXPECT_EQ(StreamReader::kClosed, reader.Drain(pair.Reader(), buffer, read, err));
+    EXPECT_EQ(0u, read);
+}
+
+TEST(stream_reader, reset_after_data) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    SOCKET listener = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, bind(listener, (struct sockaddr*)&addr, sizeof(addr)));
+    ASSERT_EQ(0, listen(listener, 1));
+    socklen_t len = sizeof(addr);
+    getsockname(listener, (struct sockaddr*)&addr, &len);
+
+    SOCKET client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, connect(client, (struct sockaddr*)&addr, sizeof(addr)));
+    SOCKET server = accept(listener, NULL, NULL);
+    socket_set_nobio(client);
+
+    std::string data(3000, 'm');
+    ASSERT_EQ((ssize_t)data.size(), send(server, data.data(), data.size(), 0));
+    struct linger abort_close = {1, 0};
+    setsockopt(server, SOL_SOCKET, SO_LINGER, &abort_close, sizeof(abort_close));
+    close(server);
+    usleep(50 * 1000);
+
+    StreamReader reader;
+    AutoBuffer buffer;
+    size_t read = 0;
+    int err = 0;
+    EXPECT_EQ(StreamReader::kRead, reader.Drain(client, buffer, read, err));
+    EXPECT_EQ(data.size(), read);
+    EXPECT_EQ(0, err);
+    EXPECT_EQ(StreamReader::kError, reader.Drain(client, buffer, read, err));
+    EXPECT_EQ(0u, read);
+    EXPECT_EQ(ECONNRESET, err);
+
+    close(client);
+    close(listener);
+}
+
+TEST(stream_reader, nothing_waiting) {
+    SocketPair pair;
+    StreamReader reader;
+    AutoBuffer buffer;
+    size_t read = 1;
+    int err = 1;
+    EXPECT_EQ(StreamReader::kRead, reader.Drain(pair.Reader(), buffer, read, err));
+    EXPECT_EQ(0u, read);
+    EXPECT_EQ(0, err);
+    EXPECT_EQ(0u, buffer.Length());
+}
@@ -21,6 +21,8 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include "boost/bind.hpp"
 #include "comm/socket/socket_address.h"
 #include "comm/thread/lock.h"
@@ -28,11 +30,18 @@
 
 using namespace mars::comm;
 
+// bionic has accept4 from android-21
+#if defined(__linux__) && !(defined(__ANDROID__) && __ANDROID_API__ < 21)
+#define TCPSERVER_ACCEPT4 1
+#endif
+
 TcpServer::TcpServer(const char* _ip, uint16_t _port, MTcpServer& _observer, int _backlog)
 : observer_(_observer)
 , thread_(boost::bind(&TcpServer::__ListenThread, this))
 , listen_sock_(INVALID_SOCKET)
-, backlog_(_backlog) {
+, backlog_(_backlog)
+, acceptor_error_(0)
+, handler_stop_(false) {
     bind_addr_ = new socket_address(_ip, _port);
 }
 
@@ -41,7 +50,9 @@ TcpServer::TcpServer(const sockaddr_in& _bindaddr, MTcpServer& _observer, int _b
 , thread_(boost::bind(&TcpServer::__ListenThread, this))
 , listen_sock_(INVALID_SOCKET)
 , bind_addr_(new socket_address(_bindaddr))
-, backlog_(_backlog) {
+, backlog_(_backlog)
+, acceptor_error_(0)
+, handler_stop_(false) {
 }
 
 TcpServer::~TcpServer() {
@@ -53,6 +64,15 @@ SOCKET TcpServer::Socket() const {
     return listen_sock_;
 }
 
+void TcpServer::SetAcceptOptions(const TcpServerAcceptOptions& _options) {
+    ScopedLock lock(mutex_);
+    xassert2(!thread_.isruning(), "accept options are only read when the server starts");
+    options_ = _options;
+    options_.acceptors = std::max(1, options_.acceptors);
+    options_.accept_batch = std::max(1, options_.accept_batch);
+    options_.handler_threads = std::max(0, options_.handler_threads);
+}
+
 bool TcpServer::StartAndWait(bool* _newone) {
     ScopedLock lock(mutex_);
     bool newone = false;
@@ -94,125 +114,317 @@ void TcpServer::StopAndWait() {
 void TcpServer::__ListenThread() {
     xgroup2_define(break_group);
 
+    int error = 0;
     do {
         ScopedLock lock(mutex_);
 
         xassert2(INVALID_SOCKET == listen_sock_, TSF "m_listen_sock:%_", listen_sock_);
 
-        SOCKET listen_sock = socket(bind_addr_->address().sa_family, SOCK_STREAM, 0);
+        // only linux balances connections across SO_REUSEPORT sockets, elsewhere the acceptors share one
+        bool reuseport = 1 < options_.acceptors;
+#ifndef __linux__
+        reuseport = false;
+#endif
+
+        SOCKET listen_sock = __Listen(*bind_addr_, reuseport);
 
         if (INVALID_SOCKET == listen_sock) {
-            xerror2(TSF "socket create err:(%_, %_)", socket_errno, socket_strerror(socket_errno)) >> break_group;
+            xerror2(TSF "listen fail (%_:%_)", bind_addr_->ip(), bind_addr_->port()) >> break_group;
             cond_.notifyAll(lock);
             break;
         }
 
-        if (0 > socket_reuseaddr(listen_sock, 1)) {  // make sure before than bind
+        if (reuseport) {
+            // with port 0 the first bind picks the port, the shards have to bind that one
+            struct sockaddr_storage bound;
+            socklen_t bound_len = sizeof(bound);
+            getsockname(listen_sock, (struct sockaddr*)&bound, &bound_len);
+            socket_address shard_addr((struct sockaddr*)&bound);
+
+            for (int i = 1; i < options_.acceptors; ++i) {
+                SOCKET shard = __Listen(shard_addr, true);
+                if (INVALID_SOCKET == shard) {
+                    xwarn2(TSF "shard listen fail, acceptors share the first %_ sockets", shard_socks_.size() + 1);
+                    break;
+                }
+                shard_socks_.push_back(shard);
+            }
+        }
 
-            xerror2(TSF "socket reuseaddr err:(%_, %_)", socket_errno, socket_strerror(socket_errno)) >> break_group;
-            socket_close(listen_sock);
-            cond_.notifyAll(lock);
-            break;
+        listen_sock_ = listen_sock;
+        cond_.notifyAll(lock);
+        lock.unlock();
+
+        xinfo2(TSF "listen start sock:(%_, %_:%_), acceptors:%_, shards:%_, batch:%_, handlers:%_",
+               listen_sock_,
+               bind_addr_->ip(),
+               bind_addr_->port(),
+               options_.acceptors,
+               shard_socks_.size(),
+               options_.accept_batch,
+               options_.handler_threads);
+        observer_.OnCreate(this);
+
+        for (int i = 0; i < options_.handler_threads; ++i) {
+            handlers_.push_back(new Thread(boost::bind(&TcpServer::__HandlerThread, this), "tcpserver_handler"));
+            handlers_.back()->start();
         }
 
-        if (0 > bind(listen_sock, &bind_addr_->address(), bind_addr_->address_length())) {
-            xerror2(TSF "socket bind err:(%_, %_)", socket_errno, socket_strerror(socket_errno)) >> break_group;
-            socket_close(listen_sock);
-            cond_.notifyAll(lock);
-            break;
+        lock.lock();
+        acceptor_error_ = 0;
+        for (int i = 1; i < options_.acceptors; ++i) {
+            SOCKET sock = (size_t)i <= shard_socks_.size() ? shard_socks_[i - 1] : listen_sock_;
+            acceptors_.push_back(
+                new Thread(boost::bind(&TcpServer::__ExtraAcceptLoop, this, sock), "tcpserver_accept"));
+            acceptors_.back()->start();
         }
+        lock.unlock();
 
-        if (0 > listen(listen_sock, backlog_)) {
-            xerror2(TSF "socket listen err:(%_, %_)", socket_errno, socket_strerror(socket_errno)) >> break_group;
-            socket_close(listen_sock);
-            cond_.notifyAll(lock);
-            break;
+        error = __AcceptLoop(listen_sock_);
+        if (0 == error)
+            error = socket_errno;
+    } while (false);
+
+    if (!acceptors_.empty()) {
+        // they select on the same breaker, an error on this one stops them too
+        breaker_.Break();
+        for (size_t i = 0; i < acceptors_.size(); ++i) {
+            acceptors_[i]->join();
+            delete acceptors_[i];
         }
+        acceptors_.clear();
 
-        listen_sock_ = listen_sock;
-        cond_.notifyAll(lock);
-        lock.unlock();
+        ScopedLock lock(mutex_);
+        if (0 != acceptor_error_)
+            error = acceptor_error_;
+    }
 
-        xinfo2(TSF "listen start sock:(%_, %_:%_)", listen_sock_, bind_addr_->ip(), bind_addr_->port());
-        observer_.OnCreate(this);
+    if (!handlers_.empty()) {
+        {
+            ScopedLock lock(handler_mutex_);
+            handler_stop_ = true;
+            handler_cond_.notifyAll(lock);
+        }
+        for (size_t i = 0; i < handlers_.size(); ++i) {
+            handlers_[i]->join();
+            delete handlers_[i];
+        }
+        handlers_.clear();
+
+        ScopedLock lock(handler_mutex_);
+        for (std::list<Accepted>::iterator it = accepted_.begin(); it != accepted_.end(); ++it) {
+            socket_close(it->sock);
+        }
+        accepted_.clear();
+        handler_stop_ = false;
+    }
+
+    for (size_t i = 0; i < shard_socks_.size(); ++i) {
+        if (INVALID_SOCKET != shard_socks_[i])
+            socket_close(shard_socks_[i]);
+    }
+    shard_socks_.clear();
+
+    xinfo2(TSF "listen end sock:(%_, %_:%_), ", listen_sock_, bind_addr_->ip(), bind_addr_->port()) << break_group;
+
+    {
+        ScopedLock lock(mutex_);
+        if (INVALID_SOCKET != listen_sock_) {
+            socket_close(listen_sock_);
+            listen_sock_ = INVALID_SOCKET;
+        }
+    }
+
+    observer_.OnError(this, error);
+}
+
+SOCKET TcpServer::__Listen(const socket_address& _addr, bool _reuseport) {
+    SOCKET listen_sock = socket(_addr.address().sa_family, SOCK_STREAM, 0);
+
+    if (INVALID_SOCKET == listen_sock) {
+        xerror2(TSF "socket create err:(%_, %_)", socket_errno, socket_strerror(socket_errno));
+        return INVALID_SOCKET;
+    }
+
+    if (0 > socket_reuseaddr(listen_sock, 1)) {  // make sure before than bind
+        xerror2(TSF "socket reuseaddr err:(%_, %_)", socket_errno, socket_strerror(socket_errno));
+        socket_close(listen_sock);
+        return INVALID_SOCKET;
+    }
+
+    if (_reuseport && 0 > socket_reuseport(listen_sock, 1)) {
+        xerror2(TSF "socket reuseport err:(%_, %_)", socket_errno, socket_strerror(socket_errno));
+        socket_close(listen_sock);
+        return INVALID_SOCKET;
+    }
+
+    if (0 > bind(listen_sock, &_addr.address(), _addr.address_length())) {
+        xerror2(TSF "socket bind err:(%_, %_)", socket_errno, socket_strerror(socket_errno));
+        socket_close(listen_sock);
+        return INVALID_SOCKET;
+    }
 
-        while (true) {
+    if (0 > listen(listen_sock, backlog_)) {
+        xerror2(TSF "socket listen err:(%_, %_)", socket_errno, socket_strerror(socket_errno));
+        socket_close(listen_sock);
+        return INVALID_SOCKET;
+    }
+
+    return listen_sock;
+}
+
+int TcpServer::__AcceptLoop(SOCKET _listen_sock) {
+    xgroup2_define(break_group);
+
+    // a shared socket has to be non-blocking too, another acceptor may take the connection first
+    bool nonblock = 1 < options_.accept_batch || 1 < options_.acceptors;
+#ifdef WIN32
+    nonblock = false;  // there is no select in front of accept below
+#endif
+
+    if (nonblock && 0 != socket_set_nobio(_listen_sock)) {
+        xwarn2(TSF "nobio err:(%_, %_), accept one by one", socket_errno, socket_strerror(socket_errno));
+        nonblock = false;
+    }
+
+    int error = 0;
+    while (true) {
 #ifndef WIN32
-            SocketSelect sel(breaker_);
-            sel.PreSelect();
-            sel.Exception_FD_SET(listen_sock_);
-            sel.Read_FD_SET(listen_sock_);
+        SocketSelect sel(breaker_);
+        sel.PreSelect();
+        sel.Exception_FD_SET(_listen_sock);
+        sel.Read_FD_SET(_listen_sock);
 
-            int selret = sel.Select();
+        int selret = sel.Select();
 
-            if (0 > selret) {
-                xerror2(TSF "select ret:%_, err:(%_, %_)", selret, sel.Errno(), socket_strerror(sel.Errno()))
-                    >> break_group;
-                break;
-            }
+        if (0 > selret) {
+            xerror2(TSF "select ret:%_, err:(%_, %_)", selret, sel.Errno(), socket_strerror(sel.Errno()))
+                >> break_group;
+            error = sel.Errno();
+            break;
+        }
 
-            if (sel.IsException()) {
-                xerror2(TSF "breaker exception") >> break_group;
-                break;
-            }
+        if (sel.IsException()) {
+            xerror2(TSF "breaker exception") >> break_group;
+            error = socket_errno;
+            break;
+        }
 
-            if (sel.IsBreak()) {
-                xinfo2(TSF "breaker by user") >> break_group;
-                break;
-            }
+        if (sel.IsBreak()) {
+            xinfo2(TSF "breaker by user") >> break_group;
+            break;
+        }
 
-            if (sel.Exception_FD_ISSET(listen_sock_)) {
-                xerror2(TSF "socket exception err:(%_, %_)",
-                        socket_error(listen_sock_),
-                        socket_strerror(socket_error(listen_sock_)))
-                    >> break_group;
-                break;
-            }
+        if (sel.Exception_FD_ISSET(_listen_sock)) {
+            error = socket_error(_listen_sock);
+            xerror2(TSF "socket exception err:(%_, %_)", error, socket_strerror(error)) >> break_group;
+            break;
+        }
 
-            if (!sel.Read_FD_ISSET(listen_sock_)) {
-                xerror2(TSF "socket unreadable but break by unknown") >> break_group;
-                break;
-            }
+        if (!sel.Read_FD_ISSET(_listen_sock)) {
+            xerror2(TSF "socket unreadable but break by unknown") >> break_group;
+            error = socket_errno;
+            break;
+        }
 #endif
 
+        int batch = nonblock ? options_.accept_batch : 1;
+
+        for (int i = 0; i < batch; ++i) {
             struct sockaddr_in client_addr = {0};
 
             socklen_t client_addr_len = sizeof(client_addr);
 
-            SOCKET client = accept(listen_sock_, (struct sockaddr*)&client_addr, &client_addr_len);
+#ifdef TCPSERVER_ACCEPT4
+            SOCKET client = accept4(_listen_sock, (struct sockaddr*)&client_addr, &client_addr_len, SOCK_CLOEXEC);
+#else
+            SOCKET client = accept(_listen_sock, (struct sockaddr*)&client_addr, &client_addr_len);
+#endif
 
             if (INVALID_SOCKET == client) {
-                xerror2(TSF "accept return client invalid:%_, err:(%_, %_)",
-                        client,
-                        socket_errno,
-                        socket_strerror(socket_errno))
+                error = socket_errno;
+                // drained, or the client gave up while queued
+                if (nonblock && (IS_NOBLOCK_READ_ERRNO(error) || SOCKET_ERRNO(ECONNABORTED) == error)) {
+                    error = 0;
+                    break;
+                }
+
+                xerror2(TSF "accept return client invalid:%_, err:(%_, %_)", client, error, socket_strerror(error))
                     >> break_group;
                 break;
             }
 
+#ifndef TCPSERVER_ACCEPT4
+            // accept passes O_NONBLOCK of the listen socket on, OnAccept always got a blocking socket
+            if (nonblock)
+                socket_set_bio(client);
+#endif
+
             char cli_ip[16] = {0};
             socket_inet_ntop(AF_INET, &(client_addr.sin_addr), cli_ip, sizeof(cli_ip));
             xinfo2(TSF "listen accept sock:(%_, %_:%_) cli:(%_, %_:%_)",
-                   listen_sock_,
+                   _listen_sock,
                    bind_addr_->ip(),
                    bind_addr_->port(),
                    client,
                    cli_ip,
                    ntohs(client_addr.sin_port));
 
-            observer_.OnAccept(this, client, client_addr);
+            if (handlers_.empty()) {
+                observer_.OnAccept(this, client, client_addr);
+            } else {
+                Accepted accepted = {client, client_addr};
+                ScopedLock lock(handler_mutex_);
+                accepted_.push_back(accepted);
+                handler_cond_.notifyOne(lock);
+            }
         }
-    } while (false);
 
-    xinfo2(TSF "listen end sock:(%_, %_:%_), ", listen_sock_, bind_addr_->ip(), bind_addr_->port()) << break_group;
+        if (0 != error)
+            break;
+    }
 
-    {
-        ScopedLock lock(mutex_);
-        if (INVALID_SOCKET != listen_sock_) {
-            socket_close(listen_sock_);
-            listen_sock_ = INVALID_SOCKET;
+    xinfo2(TSF "accept end sock:(%_, %_:%_), ", _listen_sock, bind_addr_->ip(), bind_addr_->port()) << break_group;
+    return error;
+}
+
+void TcpServer::__ExtraAcceptLoop(SOCKET _listen_sock) {
+    int error = __AcceptLoop(_listen_sock);
+    if (0 == error)
+        return;
+
+    // the kernel keeps handing a shard its share of connections until it is closed, and with one acceptor gone
+    // the server stops altogether, as on an error of the listen thread
+    ScopedLock lock(mutex_);
+    if (0 == acceptor_error_)
+        acceptor_error_ = error;
+    for (size_t i = 0; i < shard_socks_.size(); ++i) {
+        if (_listen_sock == shard_socks_[i]) {
+            socket_close(shard_socks_[i]);
+            shard_socks_[i] = INVALID_SOCKET;
         }
     }
+    lock.unlock();
+    breaker_.Break();
+}
+
+void TcpServer::__HandlerThread() {
+    while (true) {
+        Accepted accepted;
+        {
+            ScopedLock lock(handler_mutex_);
+            while (accepted_.empty() && !handler_stop_) {
+                handler_cond_.wait(lock);
+            }
+
+            // what is still queued is closed by the listen thread
+            if (handler_stop_)
+                return;
 
-    observer_.OnError(this, socket_errno);
+            accepted = accepted_.front();
+            accepted_.pop_front();
+        }
+
+        observer_.OnAccept(this, accepted.sock, accepted.addr);
+    }
 }
@@ -20,6 +20,9 @@
 #ifndef TcpServer_H_
 #define TcpServer_H_
 
+#include <list>
+#include <vector>
+
 #include "comm/socket/socketselect.h"
 #include "comm/socket/unix_socket.h"
 #include "comm/thread/condition.h"
@@ -45,6 +48,15 @@ class MTcpServer {
     virtual void OnError(TcpServer* _server, int _error) = 0;
 };
 
+struct TcpServerAcceptOptions {
+    TcpServerAcceptOptions() : acceptors(1), accept_batch(1), handler_threads(0) {
+    }
+
+    int acceptors;        // listen threads; on linux each has its own SO_REUSEPORT socket, elsewhere they share one
+    int accept_batch;     // accepts drained per wakeup from a non-blocking listen socket
+    int handler_threads;  // 0: OnAccept runs on the listen thread; else on a pool of this many threads
+};
+
 class TcpServer {
  public:
     TcpServer(const char* _ip, uint16_t _port, MTcpServer& _observer, int _backlog = 256);
@@ -53,6 +65,9 @@ class TcpServer {
 
     SOCKET Socket() const;
 
+    // before StartAndWait, the defaults keep one listen thread that accepts and calls OnAccept itself
+    void SetAcceptOptions(const TcpServerAcceptOptions& _options);
+
     bool StartAndWait(bool* _newone = NULL);
     void StopAndWait();
 
@@ -62,6 +77,11 @@ class TcpServer {
 
  private:
     void __ListenThread();
+    SOCKET __Listen(const socket_address& _addr, bool _reuseport);
+    // the error it stopped on, 0 if the breaker stopped it
+    int __AcceptLoop(SOCKET _listen_sock);
+    void __ExtraAcceptLoop(SOCKET _listen_sock);
+    void __HandlerThread();
 
  protected:
     MTcpServer& observer_;
@@ -74,6 +94,21 @@ class TcpServer {
     const int backlog_;
 
     mars::comm::SocketBreaker breaker_;
+
+    TcpServerAcceptOptions options_;
+    std::vector<SOCKET> shard_socks_;  // the SO_REUSEPORT sockets of the extra acceptors
+    std::vector<mars::comm::Thread*> acceptors_;
+    int acceptor_error_;  // of the first extra acceptor to fail, under mutex_
+    std::vector<mars::comm::Thread*> handlers_;
+
+    struct Accepted {
+        SOCKET sock;
+        sockaddr_in addr;
+    };
+    mars::comm::Mutex handler_mutex_;
+    mars::comm::Condition handler_cond_;
+    std::list<Accepted> accepted_;
+    bool handler_stop_;
 };
 
 #endif /* TcpServer_H_ */
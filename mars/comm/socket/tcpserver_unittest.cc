@@ -0,0 +1,153 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * tcpserver_unittest.cc
+ *
+ * Every loopback connection accepted, by the single listen thread and by
+ * sharded acceptors draining in batches with a handler pool, restarts, and
+ * a failed shard stopping the server.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "tcpserver.h"
+
+static const int kClients = 4;
+static const int kConnectsPerClient = 50;
+
+class CountingServer : public MTcpServer {
+ public:
+    CountingServer() : accepted(0), errors(0), last_error(0) {
+    }
+
+    virtual void OnCreate(TcpServer* _server) {
+    }
+    virtual void OnAccept(TcpServer* _server, SOCKET _sock, const sockaddr_in& _addr) {
+        socket_close(_sock);
+        ++accepted;
+    }
+    virtual void OnError(TcpServer* _server, int _error) {
+        last_error = _error;
+        ++errors;
+    }
+
+    std::atomic<int> accepted;
+    std::atomic<int> errors;
+    std::atomic<int> last_error;
+};
+
+static void AcceptAll(const TcpServerAcceptOptions& _options) {
+    CountingServer observer;
+    TcpServer server("127.0.0.1", 0, observer, 1024);
+    server.SetAcceptOptions(_options);
+    EXPECT_TRUE(server.StartAndWait());
+
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(server.Socket(), (struct sockaddr*)&addr, &len);
+
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClients; ++i) {
+        clients.push_back(std::thread([addr]() {
+            for (int j = 0; j < kConnectsPerClient; ++j) {
+                SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+                if (0 != connect(sock, (const struct sockaddr*)&addr, sizeof(addr))) {
+                    ADD_FAILURE() << "connect err:" << socket_errno;
+                }
+                socket_close(sock);
+            }
+        }));
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    // connect() returns once the kernel queued the connection, the acceptors may still be on the way
+    const int total = kClients * kConnectsPerClient;
+    for (int waited = 0; observer.accepted < total && waited < 30 * 1000; ++waited) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(total, observer.accepted);
+    server.StopAndWait();
+    EXPECT_EQ(1, observer.errors);
+}
+
+TEST(tcpserver, single_acceptor_accepts_all) {
+    AcceptAll(TcpServerAcceptOptions());
+}
+
+TEST(tcpserver, sharded_acceptors_accept_all) {
+    TcpServerAcceptOptions sharded;
+    sharded.acceptors = 4;
+    sharded.accept_batch = 64;
+    sharded.handler_threads = 2;
+    AcceptAll(sharded);
+}
+
+TEST(tcpserver, restart_with_options) {
+    CountingServer observer;
+    TcpServer server("127.0.0.1", 0, observer);
+    TcpServerAcceptOptions options;
+    options.acceptors = 2;
+    options.handler_threads = 1;
+    server.SetAcceptOptions(options);
+
+    for (int round = 0; round < 2; ++round) {
+        ASSERT_TRUE(server.StartAndWait());
+        server.StopAndWait();
+    }
+    EXPECT_EQ(2, observer.errors);
+    EXPECT_EQ(INVALID_SOCKET, server.Socket());
+}
+
+#ifdef __linux__
+class ShardedServer : public TcpServer {
+ public:
+    explicit ShardedServer(MTcpServer& _observer) : TcpServer("127.0.0.1", 0, _observer) {
+    }
+
+    SOCKET FirstShard() {
+        mars::comm::ScopedLock lock(mutex_);
+        return shard_socks_.empty() ? INVALID_SOCKET : shard_socks_[0];
+    }
+};
+
+// a shard left listening without its acceptor would queue connections nobody takes
+TEST(tcpserver, failed_shard_stops_the_server) {
+    CountingServer observer;
+    ShardedServer server(observer);
+    TcpServerAcceptOptions options;
+    options.acceptors = 2;
+    server.SetAcceptOptions(options);
+    ASSERT_TRUE(server.StartAndWait());
+    SOCKET shard = server.FirstShard();
+    ASSERT_NE(INVALID_SOCKET, shard);
+
+    // accept on a listen socket shut down fails with EINVAL
+    shutdown(shard, SHUT_RDWR);
+    for (int waited = 0; 0 == observer.errors && waited < 10 * 1000; ++waited) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(1, observer.errors);
+    EXPECT_EQ(EINVAL, observer.last_error);
+    EXPECT_EQ(INVALID_SOCKET, server.Socket());
+
+    server.StopAndWait();
+    EXPECT_EQ(1, observer.errors);
+}
+#endif
@@ -0,0 +1,331 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udp_batch.cc
+ */
+
+#include "udp_batch.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "comm/xlogger/xlogger.h"
+
+// bionic has recvmmsg/sendmmsg from android-21
+#if defined(__linux__) && !(defined(__ANDROID__) && __ANDROID_API__ < 21)
+#define UDP_BATCH_MMSG 1
+#endif
+
+#ifdef UDP_BATCH_MMSG
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+namespace mars {
+namespace comm {
+
+static const size_t kMaxBatch = 64;
+static const size_t kMaxGsoSegments = 64;
+static const size_t kMaxGsoBytes = 65507;  // the largest ipv4 udp payload
+
+static bool __SameAddr(const UdpDatagram& _lhs, const UdpDatagram& _rhs) {
+    return _lhs.addr_len == _rhs.addr_len && 0 == memcmp(&_lhs.addr, &_rhs.addr, _lhs.addr_len);
+}
+
+UdpSendRing::UdpSendRing(size_t _capacity) : slots_(_capacity ? _capacity : 1), head_(0), size_(0), gso_(false) {
+}
+
+void UdpSendRing::Push(const void* _buf, size_t _len, const struct sockaddr* _addr, socklen_t _addr_len) {
+    if (size_ == slots_.size())
+        __Grow();
+
+    UdpDatagram& slot = __At(size_);
+    slot.data.Length(0, 0);
+    slot.data.Write(_buf, _len);
+    slot.addr_len = 0;
+    if (NULL != _addr && 0 < _addr_len && _addr_len <= (socklen_t)sizeof(slot.addr)) {
+        memcpy(&slot.addr, _addr, _addr_len);
+        slot.addr_len = _addr_len;
+    }
+    ++size_;
+}
+
+void UdpSendRing::Clear() {
+    head_ = 0;
+    size_ = 0;
+}
+
+void UdpSendRing::PopFront(size_t _count) {
+    xassert2(_count <= size_, TSF "pop %_ of %_", _count, size_);
+    if (_count > size_)
+        _count = size_;
+
+    head_ = (head_ + _count) % slots_.size();
+    size_ -= _count;
+}
+
+void UdpSendRing::__Grow() {
+    // rotate the queued datagrams to the front, the buffers move with their slots
+    std::vector<UdpDatagram> slots(slots_.size() * 2);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        UdpDatagram& from = __At(i);
+        UdpDatagram& to = slots[i];
+        to.data.Attach(from.data);
+        to.addr = from.addr;
+        to.addr_len = from.addr_len;
+    }
+    slots_.swap(slots);
+    head_ = 0;
+}
+
+bool UdpSendRing::EnableGso(SOCKET _fd) {
+#ifdef UDP_BATCH_MMSG
+    int segment = 0;
+    socklen_t len = sizeof(segment);
+    gso_ = 0 == getsockopt(_fd, IPPROTO_UDP, UDP_SEGMENT, &segment, &len);
+#endif
+    return gso_;
+}
+
+int UdpSendRing::Send(SOCKET _fd, const struct sockaddr* _default_addr, socklen_t _default_addr_len, int& _errno) {
+    if (0 == size_)
+        return 0;
+
+#ifdef UDP_BATCH_MMSG
+    struct mmsghdr msgs[kMaxBatch];
+    struct iovec iovs[kMaxBatch];
+    char controls[kMaxBatch][CMSG_SPACE(sizeof(uint16_t))];
+    size_t counts[kMaxBatch];
+
+    size_t taken = 0;
+    size_t nmsg = 0;
+    memset(msgs, 0, sizeof(msgs));
+
+    while (taken < size_ && taken < kMaxBatch) {
+        UdpDatagram& first = __At(taken);
+        size_t segment = first.data.Length();
+        size_t count = 1;
+        size_t bytes = segment;
+
+        // only the last segment of a run may be shorter than the others
+        while (gso_ && 0 < segment && taken + count < size_ && taken + count < kMaxBatch
+               && count < kMaxGsoSegments) {
+            UdpDatagram& next = __At(taken + count);
+            size_t len = next.data.Length();
+            if (0 == len || segment < len || kMaxGsoBytes < bytes + len || !__SameAddr(first, next))
+                break;
+
+            ++count;
+            bytes += len;
+            if (len < segment)
+                break;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            UdpDatagram& datagram = __At(taken + i);
+            iovs[taken + i].iov_base = datagram.data.Ptr();
+            iovs[taken + i].iov_len = datagram.data.Length();
+        }
+
+        struct msghdr& hdr = msgs[nmsg].msg_hdr;
+        hdr.msg_name = 0 < first.addr_len ? (void*)&first.addr : (void*)_default_addr;
+        hdr.msg_namelen = 0 < first.addr_len ? first.addr_len : _default_addr_len;
+        hdr.msg_iov = &iovs[taken];
+        hdr.msg_iovlen = count;
+
+        if (1 < count) {
+            hdr.msg_control = controls[nmsg];
+            hdr.msg_controllen = sizeof(controls[nmsg]);
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segment_size = (uint16_t)segment;
+            memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+        }
+
+        counts[nmsg++] = count;
+        taken += count;
+    }
+
+    int ret = sendmmsg(_fd, msgs, (unsigned int)nmsg, MSG_DONTWAIT);
+    if (ret < 0) {
+        _errno = socket_errno;
+        if (IS_NOBLOCK_SEND_ERRNO(_errno))
+            return 0;
+
+        if (gso_ && (EIO == _errno || EINVAL == _errno)) {
+            // the device can not checksum offloaded segments, send them one by one from now on
+            xwarn2(TSF "udp gso rejected: %_, disable it", socket_strerror(_errno));
+            gso_ = false;
+            return 0;
+        }
+        return -1;
+    }
+
+    size_t sent = 0;
+    for (int i = 0; i < ret; ++i) {
+        sent += counts[i];
+    }
+    PopFront(sent);
+    return (int)sent;
+#else
+    UdpDatagram& datagram = Front();
+    const struct sockaddr* addr = 0 < datagram.addr_len ? (const struct sockaddr*)&datagram.addr : _default_addr;
+    socklen_t addr_len = 0 < datagram.addr_len ? datagram.addr_len : _default_addr_len;
+
+    int ret = (int)sendto(_fd, (const char*)datagram.data.Ptr(), datagram.data.Length(), 0, addr, addr_len);
+    if (ret < 0) {
+        _errno = socket_errno;
+        return IS_NOBLOCK_SEND_ERRNO(_errno) ? 0 : -1;
+    }
+
+    PopFront(1);
+    return 1;
+#endif
+}
+
+UdpBatchReader::UdpBatchReader(size_t _batch, size_t _slot_size)
+: batch_(_batch), slot_size_(_slot_size), slab_(NULL), gro_(false), terminated_(NULL), terminated_byte_(0) {
+    if (slot_size_ < 2)
+        slot_size_ = 2;
+    if (0 == batch_)
+        batch_ = 1;
+    if (kMaxBatch < batch_)
+        batch_ = kMaxBatch;
+#ifndef UDP_BATCH_MMSG
+    batch_ = 1;
+#endif
+
+    slab_ = (char*)malloc(batch_ * slot_size_);
+    xassert2(NULL != slab_, TSF "udp slab %_ x %_", batch_, slot_size_);
+    addrs_.resize(batch_);
+    datagrams_.reserve(batch_ * kMaxGsoSegments);
+}
+
+UdpBatchReader::~UdpBatchReader() {
+    free(slab_);
+}
+
+bool UdpBatchReader::EnableGro(SOCKET _fd) {
+#ifdef UDP_BATCH_MMSG
+    int on = 1;
+    gro_ = 0 == setsockopt(_fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on));
+#endif
+    return gro_;
+}
+
+const UdpBatchReader::Datagram& UdpBatchReader::At(size_t _index) {
+    __RestoreTerminated();
+    const Datagram& datagram = datagrams_[_index];
+    terminated_ = (char*)datagram.buf + datagram.len;
+    terminated_byte_ = *terminated_;
+    *terminated_ = '\0';
+    return datagram;
+}
+
+void UdpBatchReader::__RestoreTerminated() {
+    if (NULL != terminated_)
+        *terminated_ = terminated_byte_;
+    terminated_ = NULL;
+}
+
+int UdpBatchReader::Read(SOCKET _fd, int& _errno) {
+    __RestoreTerminated();
+    datagrams_.clear();
+    if (NULL == slab_) {
+        _errno = ENOMEM;
+        return -1;
+    }
+
+#ifdef UDP_BATCH_MMSG
+    struct mmsghdr msgs[kMaxBatch];
+    struct iovec iovs[kMaxBatch];
+    char controls[kMaxBatch][CMSG_SPACE(sizeof(int))];
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * batch_);
+    for (size_t i = 0; i < batch_; ++i) {
+        iovs[i].iov_base = slab_ + i * slot_size_;
+        iovs[i].iov_len = slot_size_ - 1;
+        msgs[i].msg_hdr.msg_name = &addrs_[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(addrs_[i]);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        if (gro_) {
+            msgs[i].msg_hdr.msg_control = controls[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+        }
+    }
+
+    int ret = recvmmsg(_fd, msgs, (unsigned int)batch_, MSG_DONTWAIT, NULL);
+    if (ret < 0) {
+        _errno = socket_errno;
+        return IS_NOBLOCK_RECV_ERRNO(_errno) ? 0 : -1;
+    }
+
+    for (int i = 0; i < ret; ++i) {
+        struct msghdr& hdr = msgs[i].msg_hdr;
+        char* buf = (char*)iovs[i].iov_base;
+        size_t len = msgs[i].msg_len;
+        size_t segment = len;
+
+        if (hdr.msg_flags & MSG_TRUNC)
+            xwarn2(TSF "udp datagram truncated to %_", slot_size_ - 1);
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); gro_ && NULL != cmsg; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (IPPROTO_UDP == cmsg->cmsg_level && UDP_GRO == cmsg->cmsg_type) {
+                int gso_size = 0;
+                memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                if (0 < gso_size)
+                    segment = (size_t)gso_size;
+                break;
+            }
+        }
+
+        size_t offset = 0;
+        do {
+            Datagram datagram;
+            datagram.buf = buf + offset;
+            datagram.len = std::min(segment, len - offset);
+            datagram.addr = (const struct sockaddr*)&addrs_[i];
+            datagram.addr_len = hdr.msg_namelen;
+            datagrams_.push_back(datagram);
+            offset += datagram.len;
+        } while (offset < len && 0 < segment);
+    }
+#else
+    socklen_t addr_len = sizeof(addrs_[0]);
+    int ret = (int)recvfrom(_fd, slab_, slot_size_ - 1, 0, (struct sockaddr*)&addrs_[0], &addr_len);
+    if (ret < 0) {
+        _errno = socket_errno;
+        return IS_NOBLOCK_RECV_ERRNO(_errno) ? 0 : -1;
+    }
+
+    Datagram datagram;
+    datagram.buf = slab_;
+    datagram.len = (size_t)ret;
+    datagram.addr = (const struct sockaddr*)&addrs_[0];
+    datagram.addr_len = addr_len;
+    datagrams_.push_back(datagram);
+#endif
+
+    return (int)datagrams_.size();
+}
+
+}  // namespace comm
+}  // namespace mars
@@ -0,0 +1,135 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udp_batch.h
+ *
+ * Batched datagram I/O shared by UdpClient and UdpServer: recvmmsg/sendmmsg on linux,
+ * with UDP GRO/GSO when the kernel has them, one datagram per call elsewhere.
+ */
+
+#ifndef COMM_SOCKET_UDP_BATCH_H_
+#define COMM_SOCKET_UDP_BATCH_H_
+
+#include <vector>
+
+#include "comm/autobuffer.h"
+#include "comm/socket/unix_socket.h"
+
+namespace mars {
+namespace comm {
+
+struct UdpDatagram {
+    UdpDatagram() : addr_len(0) {
+        memset(&addr, 0, sizeof(addr));
+    }
+
+    AutoBuffer data;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;  // 0: send to the default address given to UdpSendRing::Send
+};
+
+// Send queue of datagrams. Slots are reused, so a datagram costs one memcpy into a buffer
+// that already has its capacity once the queue has warmed up. Grows when full, like the list it replaces.
+class UdpSendRing {
+ public:
+    explicit UdpSendRing(size_t _capacity = 64);
+
+    void Push(const void* _buf, size_t _len, const struct sockaddr* _addr = NULL, socklen_t _addr_len = 0);
+    void Clear();
+
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return 0 == size_;
+    }
+    UdpDatagram& Front() {
+        return slots_[head_];
+    }
+    void PopFront(size_t _count = 1);
+
+    /*
+     * sends as many queued datagrams as the socket takes without blocking, up to one batch.
+     * return the number of datagrams sent and popped, 0 if the socket is full, -1 on error (_errno is set)
+     */
+    int Send(SOCKET _fd, const struct sockaddr* _default_addr, socklen_t _default_addr_len, int& _errno);
+
+    // segmentation offload: runs of equal sized datagrams to one address go out as a single send
+    bool EnableGso(SOCKET _fd);
+
+ private:
+    UdpDatagram& __At(size_t _index) {
+        return slots_[(head_ + _index) % slots_.size()];
+    }
+    void __Grow();
+
+ private:
+    std::vector<UdpDatagram> slots_;
+    size_t head_;
+    size_t size_;
+    bool gso_;
+};
+
+// Receives into a slab of buffers allocated once, one batch per Read.
+// A datagram is at most _slot_size - 1 bytes, the last byte of a slot is kept for the NUL after it.
+class UdpBatchReader {
+ public:
+    struct Datagram {
+        void* buf;
+        size_t len;
+        const struct sockaddr* addr;
+        socklen_t addr_len;
+    };
+
+ public:
+    explicit UdpBatchReader(size_t _batch = 16, size_t _slot_size = 65536);
+    ~UdpBatchReader();
+
+    // receive offload: coalesced datagrams are split again before they are handed out
+    bool EnableGro(SOCKET _fd);
+
+    /*
+     * reads what is queued on the socket without blocking, at most one batch.
+     * return the number of datagrams, see At(); 0 if nothing was queued, -1 on error (_errno is set)
+     */
+    int Read(SOCKET _fd, int& _errno);
+
+    /*
+     * the datagram NUL-terminated in place, as the single recvfrom buffer was.
+     * a coalesced read has no gap between its datagrams, so the terminator takes the first byte
+     * of the next one, put back on the next At() or Read(): only the last one returned is terminated.
+     */
+    const Datagram& At(size_t _index);
+
+ private:
+    void __RestoreTerminated();
+
+ private:
+    UdpBatchReader(const UdpBatchReader&);
+    UdpBatchReader& operator=(const UdpBatchReader&);
+
+ private:
+    size_t batch_;
+    size_t slot_size_;
+    char* slab_;
+    std::vector<struct sockaddr_storage> addrs_;
+    std::vector<Datagram> datagrams_;
+    bool gro_;
+    char* terminated_;  // where the last NUL went, NULL if none
+    char terminated_byte_;  // what it replaced
+};
+
+}  // namespace comm
+}  // namespace mars
+
+#endif /* COMM_SOCKET_UDP_BATCH_H_ */
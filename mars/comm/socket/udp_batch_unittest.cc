@@ -0,0 +1,144 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udp_batch_unittest.cc
+ *
+ * Send ring order across wrap and growth, and datagrams over loopback,
+ * batched and with segmentation offload, in order and NUL-terminated.
+ */
+
+#include "gtest/gtest.h"
+#include "udp_batch.h"
+
+using namespace mars::comm;
+
+static const int kDatagrams = 2000;
+static const size_t kWindow = 64;
+static const size_t kPayload = 256;
+
+static SOCKET BindLoopback(struct sockaddr_in& _addr) {
+    SOCKET fd = socket(AF_INET, SOCK_DGRAM, 0);
+    bzero(&_addr, sizeof(_addr));
+    _addr.sin_family = AF_INET;
+    _addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    _addr.sin_port = 0;
+    bind(fd, (struct sockaddr*)&_addr, sizeof(_addr));
+    socklen_t len = sizeof(_addr);
+    getsockname(fd, (struct sockaddr*)&_addr, &len);
+    return fd;
+}
+
+TEST(udp_batch, ring_keeps_order) {
+    UdpSendRing ring(4);
+    int next_push = 0;
+    int next_pop = 0;
+
+    for (int round = 0; round < 10; ++round) {
+        // pushes more than it pops, so the ring wraps and then grows with datagrams queued
+        for (int i = 0; i < 3; ++i, ++next_push) {
+            ring.Push(&next_push, sizeof(next_push));
+        }
+        for (int i = 0; i < 2; ++i, ++next_pop) {
+            ASSERT_EQ(sizeof(int), ring.Front().data.Length());
+            EXPECT_EQ(next_pop, *(int*)ring.Front().data.Ptr());
+            ring.PopFront();
+        }
+    }
+    EXPECT_EQ((size_t)(next_push - next_pop), ring.Size());
+}
+
+static void RoundTrip(bool _offload) {
+    struct sockaddr_in to;
+    struct sockaddr_in from;
+    SOCKET rfd = BindLoopback(to);
+    SOCKET sfd = BindLoopback(from);
+
+    UdpSendRing ring(kWindow);
+    UdpBatchReader reader(16, 65536);
+    if (_offload) {
+        ring.EnableGso(sfd);
+        reader.EnableGro(rfd);
+    }
+    char payload[kPayload];
+    int received = 0;
+
+    while (received < kDatagrams) {
+        // a window at a time, so the loopback receive buffer never drops
+        int err = 0;
+        size_t window = 0;
+        for (; window < kWindow && received + (int)window < kDatagrams; ++window) {
+            memset(payload, 'a' + (received + window) % 26, sizeof(payload));
+            ring.Push(payload, sizeof(payload), (struct sockaddr*)&to, sizeof(to));
+        }
+        while (!ring.Empty()) {
+            ASSERT_LE(0, ring.Send(sfd, NULL, 0, err));
+        }
+
+        for (size_t got = 0; got < window;) {
+            int ret = reader.Read(rfd, err);
+            ASSERT_LE(0, ret);
+            for (int i = 0; i < ret; ++i, ++got) {
+                const UdpBatchReader::Datagram& datagram = reader.At(i);
+                ASSERT_EQ(kPayload, datagram.len);
+                EXPECT_EQ('a' + (received + got) % 26, ((char*)datagram.buf)[kPayload - 1]);
+                EXPECT_EQ('\0', ((char*)datagram.buf)[kPayload]);
+            }
+        }
+        received += window;
+    }
+
+    socket_close(rfd);
+    socket_close(sfd);
+}
+
+TEST(udp_batch, loopback_round_trip) {
+    RoundTrip(false);
+    RoundTrip(true);
+}
+
+TEST(udp_batch, gso_split_on_read) {
+    struct sockaddr_in to;
+    struct sockaddr_in from;
+    SOCKET rfd = BindLoopback(to);
+    SOCKET sfd = BindLoopback(from);
+
+    UdpSendRing ring;
+    UdpBatchReader reader(4, 65536);
+    ring.EnableGso(sfd);
+    reader.EnableGro(rfd);
+
+    // ten full segments and a short tail, which one gso send carries when the kernel has it
+    char payload[1000];
+    for (int i = 0; i < 11; ++i) {
+        memset(payload, 'a' + i, sizeof(payload));
+        ring.Push(payload, i < 10 ? sizeof(payload) : 100, (struct sockaddr*)&to, sizeof(to));
+    }
+    int err = 0;
+    while (!ring.Empty()) {
+        ASSERT_LE(0, ring.Send(sfd, NULL, 0, err));
+    }
+
+    int got = 0;
+    while (got < 11) {
+        int ret = reader.Read(rfd, err);
+        ASSERT_LE(0, ret);
+        for (int i = 0; i < ret; ++i, ++got) {
+            EXPECT_EQ(got < 10 ? 1000u : 100u, reader.At(i).len);
+            EXPECT_EQ('a' + got, ((char*)reader.At(i).buf)[0]);
+            EXPECT_EQ('\0', ((char*)reader.At(i).buf)[reader.At(i).len]);
+        }
+    }
+
+    socket_close(rfd);
+    socket_close(sfd);
+}
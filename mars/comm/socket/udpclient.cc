@@ -34,13 +34,7 @@
 namespace mars {
 namespace comm {
 
-struct UdpSendData {
-    UdpSendData() {
-    }
-    UdpSendData(const UdpSendData& rhs) {
-    }
-    AutoBuffer data;
-};
+static const size_t kRecvBatch = 8;
 
 UdpClient::UdpClient(const std::string& _ip, int _port)
 : fd_socket_(INVALID_SOCKET), event_(NULL), selector_(breaker_, true), thread_(NULL) {
@@ -63,7 +57,7 @@ UdpClient::~UdpClient() {
     breaker_.Break();
     DELETE_AND_NULL(thread_);
 
-    list_buffer_.clear();
+    send_ring_.Clear();
 
     if (fd_socket_ != INVALID_SOCKET)
         socket_close(fd_socket_);
@@ -89,7 +83,7 @@ int UdpClient::ReadBlock(void* _buf, size_t _len, int _timeOutMs) {
 
 bool UdpClient::HasBuuferToSend() {
     ScopedLock lock(mutex_);
-    return !list_buffer_.empty();
+    return !send_ring_.Empty();
 }
 
 void UdpClient::SendAsync(void* _buf, size_t _len) {
@@ -98,8 +92,7 @@ void UdpClient::SendAsync(void* _buf, size_t _len) {
         return;
 
     ScopedLock lock(mutex_);
-    list_buffer_.push_back(UdpSendData());
-    list_buffer_.back().data.Write(_buf, _len);
+    send_ring_.Push(_buf, _len);
 
     if (!thread_->isruning())
         thread_->start();
@@ -107,6 +100,7 @@ void UdpClient::SendAsync(void* _buf, size_t _len) {
 }
 
 void UdpClient::SetIpPort(const std::string& _ip, int _port) {
+    ScopedLock lock(mutex_);
     in6_addr addr6 = IN6ADDR_ANY_INIT;
     if (socket_inet_pton(AF_INET6, _ip.c_str(), &addr6)) {
         is_v6_ip_ = true;
@@ -156,6 +150,9 @@ void UdpClient::__InitSocket(const std::string& _ip, int _port) {
             return;
         }
     }
+
+    if (event_)
+        send_ring_.EnableGso(fd_socket_);
 }
 
 void UdpClient::__RunLoop() {
@@ -163,25 +160,16 @@ void UdpClient::__RunLoop() {
     if (fd_socket_ == INVALID_SOCKET)
         return;
 
-    char* readBuffer = new char[MAX_DATAGRAM];
-    void* buf = NULL;
-    size_t len = 0;
-    int ret = 0;
+    UdpBatchReader reader(kRecvBatch, MAX_DATAGRAM);
+    reader.EnableGro(fd_socket_);
+
     while (true) {
         mutex_.lock();
-        bool bWriteSet = list_buffer_.size() > 0;
-        if (bWriteSet) {
-            buf = list_buffer_.front().data.Ptr();
-            len = list_buffer_.front().data.Length();
-        } else {
-            bzero(readBuffer, MAX_DATAGRAM);
-            buf = readBuffer;
-            len = MAX_DATAGRAM - 1;
-        }
+        bool bWriteSet = !send_ring_.Empty();
         mutex_.unlock();
 
         int err = 0;
-        ret = __DoSelect(bWriteSet ? false : true, bWriteSet, buf, len, err, -1);  // only read or write can be true
+        int ret = __DoSelectBatch(bWriteSet, reader, err);
         if (ret == -1) {
             xerror2(TSF "select error");
             if (event_)
@@ -193,17 +181,7 @@ void UdpClient::__RunLoop() {
             xinfo2(TSF "normal break");
             break;
         }
-        if (ret == -2)
-            continue;
-
-        if (bWriteSet) {
-            ScopedLock lock(mutex_);
-            list_buffer_.pop_front();
-            continue;
-        }
     }
-
-    delete[] readBuffer;
 }
 
 /*
@@ -280,5 +258,76 @@ int UdpClient::__DoSelect(bool _bReadSet, bool _bWriteSet, void* _buf, size_t _l
     return -1;
 }
 
+/*
+ * return -2 break, -1 error, else the number of datagrams sent and read
+ */
+int UdpClient::__DoSelectBatch(bool _bWriteSet, UdpBatchReader& _reader, int& _errno) {
+    selector_.PreSelect();
+    if (_bWriteSet)
+        selector_.Write_FD_SET(fd_socket_);
+    selector_.Read_FD_SET(fd_socket_);
+    selector_.Exception_FD_SET(fd_socket_);
+
+    int ret = selector_.Select();
+    if (ret < 0) {
+        xerror2(TSF "udp select error: %0", socket_strerror(selector_.Errno()));
+        _errno = selector_.Errno();
+        return -1;
+    }
+
+    // user break
+    if (selector_.IsException()) {
+        _errno = selector_.Errno();
+        xerror2(TSF "sel exception");
+        return -1;
+    }
+    if (selector_.IsBreak()) {
+        xinfo2(TSF "sel breaker");
+        return -2;
+    }
+    if (selector_.Exception_FD_ISSET(fd_socket_)) {
+        _errno = socket_errno;
+        xerror2(TSF "socket exception error");
+        return -1;
+    }
+
+    int handled = 0;
+    if (selector_.Write_FD_ISSET(fd_socket_)) {
+        int sent = 0;
+        {
+            ScopedLock lock(mutex_);
+            if (is_v6_ip_) {
+                sent = send_ring_.Send(fd_socket_, (sockaddr*)&addr_v6_, sizeof(sockaddr_in6), _errno);
+            } else {
+                sent = send_ring_.Send(fd_socket_, (sockaddr*)&addr_, sizeof(sockaddr_in), _errno);
+            }
+        }
+
+        if (sent == -1) {
+            xerror2(TSF "sendto error: %0", socket_strerror(_errno));
+            return -1;
+        }
+        for (int i = 0; i < sent && event_; ++i) {
+            event_->OnDataSent(this);
+        }
+        handled += sent;
+    }
+
+    if (selector_.Read_FD_ISSET(fd_socket_)) {
+        int read = _reader.Read(fd_socket_, _errno);
+        if (read == -1) {
+            xerror2(TSF "recvfrom error: %0", socket_strerror(_errno));
+            return -1;
+        }
+
+        for (int i = 0; i < read && event_; ++i) {
+            event_->OnDataGramRead(this, _reader.At(i).buf, _reader.At(i).len);
+        }
+        handled += read;
+    }
+
+    return handled;
+}
+
 }  // namespace comm
 }  // namespace mars
@@ -20,11 +20,11 @@
 #ifndef UDPCLIENT_H_
 #define UDPCLIENT_H_
 
-#include <list>
 #include <string>
 
 #include "comm/autobuffer.h"
 #include "comm/socket/socketselect.h"
+#include "comm/socket/udp_batch.h"
 #include "comm/socket/unix_socket.h"
 #include "comm/thread/mutex.h"
 #include "comm/thread/thread.h"
@@ -34,7 +34,6 @@
 namespace mars {
 namespace comm {
 
-struct UdpSendData;
 class UdpClient;
 
 class IAsyncUdpClientEvent {
@@ -42,6 +41,7 @@ class IAsyncUdpClientEvent {
     virtual ~IAsyncUdpClientEvent() {
     }
     virtual void OnError(UdpClient* _this, int _errno) = 0;
+    // _buf holds _len bytes and a NUL after them, valid only until the callback returns
     virtual void OnDataGramRead(UdpClient* _this, void* _buf, size_t _len) = 0;
     virtual void OnDataSent(UdpClient* _this) = 0;
 };
@@ -70,6 +70,7 @@ class UdpClient {
  private:
     void __InitSocket(const std::string& _ip, int _port);
     int __DoSelect(bool _bReadSet, bool _bWriteSet, void* _buf, size_t _len, int& _errno, int _timeoutMs);
+    int __DoSelectBatch(bool _bWriteSet, UdpBatchReader& _reader, int& _errno);
     void __RunLoop();
 
  private:
@@ -83,7 +84,7 @@ class UdpClient {
     SocketSelect selector_;
     Thread* thread_;
 
-    std::list<UdpSendData> list_buffer_;
+    UdpSendRing send_ring_;
     Mutex mutex_;
 };
 
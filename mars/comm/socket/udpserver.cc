@@ -19,6 +19,8 @@
 
 #include "udpserver.h"
 
+#include <algorithm>
+
 #include "boost/bind.hpp"
 #include "socket/socket_address.h"
 #include "socket/udpclient.h"
@@ -35,15 +37,7 @@
 namespace mars {
 namespace comm {
 
-struct UdpServerSendData {
-    explicit UdpServerSendData(struct sockaddr_in* _addr) {
-        memcpy(&addr, _addr, sizeof(sockaddr_in));
-    }
-    UdpServerSendData(const UdpServerSendData& rhs) : addr(rhs.addr) {
-    }
-    AutoBuffer data;
-    struct sockaddr_in addr;
-};
+static const size_t kRecvBatch = 8;
 
 UdpServer::UdpServer(int _port, IAsyncUdpServerEvent* _event)
 : fd_socket_(INVALID_SOCKET), event_(_event), selector_(breaker_, true) {
@@ -63,7 +57,7 @@ UdpServer::~UdpServer() {
     breaker_.Break();
     DELETE_AND_NULL(thread_);
 
-    list_buffer_.clear();
+    send_ring_.Clear();
 
     if (fd_socket_ != INVALID_SOCKET)
         socket_close(fd_socket_);
@@ -98,8 +92,7 @@ void UdpServer::SendAsync(struct sockaddr_in* _addr, void* _buf, size_t _len) {
         return;
 
     ScopedLock lock(mutex_);
-    list_buffer_.push_back(UdpServerSendData(_addr));
-    list_buffer_.back().data.Write(_buf, _len);
+    send_ring_.Push(_buf, _len, (struct sockaddr*)_addr, sizeof(sockaddr_in));
 
     if (!thread_->isruning())
         thread_->start();
@@ -127,7 +120,11 @@ void UdpServer::__InitSocket(int _port) {
     if (bind(fd_socket_, (struct sockaddr*)&servAddr, sizeof(servAddr)) != 0) {
         errCode = socket_errno;
         xerror2(TSF "udp bind error, error: %0", socket_strerror(errCode));
+        return;
     }
+
+    bool gso = send_ring_.EnableGso(fd_socket_);
+    xinfo2(TSF "udp server port:%_, gso:%_", _port, gso);
 }
 
 void UdpServer::__RunLoop() {
@@ -136,31 +133,16 @@ void UdpServer::__RunLoop() {
     if (fd_socket_ == INVALID_SOCKET)
         return;
 
-    char* readBuffer = new char[MAX_DATAGRAM];
-    void* buf = NULL;
-    size_t len = 0;
-    int ret = 0;
-    struct sockaddr_in addr;
+    UdpBatchReader reader(kRecvBatch, MAX_DATAGRAM);
+    reader.EnableGro(fd_socket_);
 
     while (true) {
         mutex_.lock();
-        bool bWriteSet = list_buffer_.size() > 0;
-
-        if (bWriteSet) {
-            buf = list_buffer_.front().data.Ptr();
-            len = list_buffer_.front().data.Length();
-            memcpy(&addr, &list_buffer_.front().addr, sizeof(sockaddr_in));
-        } else {
-            bzero(readBuffer, MAX_DATAGRAM);
-            buf = readBuffer;
-            len = MAX_DATAGRAM - 1;
-            bzero(&addr, sizeof(sockaddr_in));
-        }
-
+        bool bWriteSet = !send_ring_.Empty();
         mutex_.unlock();
 
         int err = 0;
-        ret = __DoSelect(bWriteSet ? false : true, bWriteSet, buf, len, &addr, err);  // only read or write can be true
+        int ret = __DoSelect(bWriteSet, reader, err);
 
         if (ret == -1) {
             xerror2(TSF "select error");
@@ -175,18 +157,7 @@ void UdpServer::__RunLoop() {
             xinfo2(TSF "normal break");
             break;
         }
-
-        if (ret == -2)
-            continue;
-
-        if (bWriteSet) {
-            ScopedLock lock(mutex_);
-            list_buffer_.pop_front();
-            continue;
-        }
     }
-
-    delete[] readBuffer;
 }
 
 bool UdpServer::__SetBroadcastOpt() {
@@ -202,24 +173,15 @@ bool UdpServer::__SetBroadcastOpt() {
 }
 
 /*
- * return -2 break, -1 error, 0 timeout, else handle size
+ * return -2 break, -1 error, else the number of datagrams sent and read
  */
-int UdpServer::__DoSelect(bool _bReadSet,
-                          bool _bWriteSet,
-                          void* _buf,
-                          size_t _len,
-                          struct sockaddr_in* _addr,
-                          int& _errno) {
-    xassert2((!(_bReadSet && _bWriteSet) && (_bReadSet || _bWriteSet)), "only read or write can be true, not both");
-
+int UdpServer::__DoSelect(bool _bWriteSet, UdpBatchReader& _reader, int& _errno) {
     selector_.PreSelect();
 
     if (_bWriteSet)
         selector_.Write_FD_SET(fd_socket_);
 
-    if (_bReadSet)
-        selector_.Read_FD_SET(fd_socket_);
-
+    selector_.Read_FD_SET(fd_socket_);
     selector_.Exception_FD_SET(fd_socket_);
 
     int ret = selector_.Select();
@@ -230,12 +192,6 @@ int UdpServer::__DoSelect(bool _bReadSet,
         return -1;
     }
 
-    //    if (ret == 0)
-    //    {
-    //        xinfo2(TSF"udp select timeout:%0 ms", _timeoutMs);
-    //        return 0;
-    //    }
-
     // user break
     if (selector_.IsException()) {
         _errno = selector_.Errno();
@@ -254,35 +210,40 @@ int UdpServer::__DoSelect(bool _bReadSet,
         return -1;
     }
 
+    int handled = 0;
+
     if (selector_.Write_FD_ISSET(fd_socket_)) {
-        int ret = (int)sendto(fd_socket_, (const char*)_buf, _len, 0, (sockaddr*)_addr, sizeof(sockaddr_in));
+        ScopedLock lock(mutex_);
+        int sent = send_ring_.Send(fd_socket_, NULL, 0, _errno);
 
-        if (ret == -1) {
-            _errno = socket_errno;
+        if (sent == -1) {
             xerror2(TSF "sendto error: %0", socket_strerror(_errno));
             return -1;
         }
 
-        return ret;
+        handled += sent;
     }
 
     if (selector_.Read_FD_ISSET(fd_socket_)) {
-        socklen_t len = sizeof(sockaddr_in);
-        int ret = (int)recvfrom(fd_socket_, (char*)_buf, _len, 0, (sockaddr*)_addr, &len);
+        int read = _reader.Read(fd_socket_, _errno);
 
-        if (ret == -1) {
-            _errno = socket_errno;
+        if (read == -1) {
             xerror2(TSF "recvfrom error: %0", socket_strerror(_errno));
             return -1;
         }
 
-        if (event_)
-            event_->OnDataGramRead(this, _addr, _buf, ret);
+        for (int i = 0; i < read && event_; ++i) {
+            const UdpBatchReader::Datagram& datagram = _reader.At(i);
+            struct sockaddr_in addr;
+            bzero(&addr, sizeof(addr));
+            memcpy(&addr, datagram.addr, std::min((size_t)datagram.addr_len, sizeof(addr)));
+            event_->OnDataGramRead(this, &addr, datagram.buf, datagram.len);
+        }
 
-        return ret;
+        handled += read;
     }
 
-    return -1;
+    return handled;
 }
 
 }  // namespace comm
@@ -20,11 +20,11 @@
 #ifndef UDPSERVER_H_
 #define UDPSERVER_H_
 
-#include <list>
 #include <string>
 
 #include "comm/autobuffer.h"
 #include "comm/socket/socketselect.h"
+#include "comm/socket/udp_batch.h"
 #include "comm/socket/unix_socket.h"
 #include "comm/thread/lock.h"
 #include "comm/thread/mutex.h"
@@ -35,7 +35,6 @@
 namespace mars {
 namespace comm {
 
-struct UdpServerSendData;
 class UdpServer;
 
 class IAsyncUdpServerEvent {
@@ -43,6 +42,7 @@ class IAsyncUdpServerEvent {
     virtual ~IAsyncUdpServerEvent() {
     }
     virtual void OnError(UdpServer* _this, int _errno) = 0;
+    // _buf holds _len bytes and a NUL after them, valid only until the callback returns
     virtual void OnDataGramRead(UdpServer* _this, struct sockaddr_in* _addr, void* _buf, size_t _len) = 0;
 };
 
@@ -57,7 +57,7 @@ class UdpServer {
 
  private:
     void __InitSocket(int _port);
-    int __DoSelect(bool _bReadSet, bool _bWriteSet, void* _buf, size_t _len, struct sockaddr_in* _addr, int& _errno);
+    int __DoSelect(bool _bWriteSet, UdpBatchReader& _reader, int& _errno);
     void __RunLoop();
     bool __SetBroadcastOpt();
 
@@ -69,7 +69,7 @@ class UdpServer {
     SocketSelect selector_;
     Thread* thread_;
 
-    std::list<UdpServerSendData> list_buffer_;
+    UdpSendRing send_ring_;
     Mutex mutex_;
 };
 }  // namespace comm
@@ -31,11 +31,26 @@ int socket_set_nobio(SOCKET fd) {
 
     return ret;
 }
+
+int socket_set_bio(SOCKET fd) {
+    int ret = fcntl(fd, F_GETFL, 0);
+    if (ret >= 0) {
+        long flags = ret & ~O_NONBLOCK;
+        ret = fcntl(fd, F_SETFL, flags);
+    }
+
+    return ret;
+}
 #else
 int socket_set_nobio(SOCKET fd) {
     static const int noblock = 1;
     return ioctlsocket(fd, FIONBIO, (u_long*)&noblock);
 }
+
+int socket_set_bio(SOCKET fd) {
+    static const int block = 0;
+    return ioctlsocket(fd, FIONBIO, (u_long*)&block);
+}
 #endif
 
 #ifdef _WIN32
@@ -377,6 +392,14 @@ int socket_reuseaddr(SOCKET sock, int optval) {
     return setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&optval, sizeof(int));
 }
 
+int socket_reuseport(SOCKET sock, int optval) {
+#ifdef SO_REUSEPORT
+    return setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, (const char*)&optval, sizeof(int));
+#else
+    return -1;
+#endif
+}
+
 int socket_reserve_sendbuf(SOCKET sock, uint32_t buflen) {
     uint32_t prevsize = 0;
     socklen_t prevlen = sizeof(prevsize);
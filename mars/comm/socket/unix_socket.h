@@ -107,12 +107,14 @@ extern "C" {
 #endif
 
 int socket_set_nobio(SOCKET fd);
+int socket_set_bio(SOCKET fd);
 int socket_set_tcp_mss(SOCKET sockfd, int size);
 int socket_get_tcp_mss(SOCKET sockfd, int* size);
 int socket_fix_tcp_mss(SOCKET sockfd);  // make mss=mss-40
 int socket_disable_nagle(SOCKET sock, int nagle);
 int socket_error(SOCKET sock);
 int socket_reuseaddr(SOCKET sock, int optval);
+int socket_reuseport(SOCKET sock, int optval);  // -1 where the platform has no SO_REUSEPORT
 int socket_reserve_sendbuf(SOCKET sock, uint32_t buflen);
 
 int socket_get_nwrite(SOCKET _sock, int* _nwriteLen);
@@ -0,0 +1,109 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * autobuffer_bench.cc
+ *
+ * The stn buffer lifecycles, requests packed and dropped and a long-link read
+ * buffer unpacked from the front, timed with and without the size-class pool.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <string>
+
+#include "comm_bench.h"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/autobuffer_pool.h"
+
+using namespace mars::comm;
+
+namespace {
+
+// a request packed a header and a body at a time, then sent and dropped
+size_t PackAndDrop(size_t _body_len, const std::string& _piece) {
+    AutoBuffer buffer;
+    buffer.Write("0123456789abcdef", 16);
+    while (buffer.Length() < _body_len) buffer.Write(_piece.data(), _piece.size());
+    return buffer.Length();
+}
+
+// a long-link read buffer filled a recv at a time and unpacked from the front
+size_t ReceiveAndUnpack(size_t _total, size_t _chunk, size_t _packet) {
+    AutoBuffer buffer;
+    size_t unpacked = 0;
+    for (size_t received = 0; received < _total; received += _chunk) {
+        buffer.Reserve(buffer.Pos() + _chunk);
+        memset(buffer.PosPtr(), 'r', _chunk);
+        buffer.Length(buffer.Pos() + _chunk, buffer.Length() + _chunk);
+        while (buffer.Length() >= _packet) {
+            AutoBuffer body;
+            body.Write(buffer.Ptr(), _packet);
+            buffer.Move(-(off_t)_packet);
+            unpacked += body.Length();
+        }
+    }
+    return unpacked;
+}
+
+}  // namespace
+
+int AutoBufferBench(int argc, char* argv[]) {
+    int rounds = 2000;
+    size_t receive_mb = 64;
+
+    int opt = 0;
+    while (-1 != (opt = getopt(argc, argv, "n:r:h"))) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            case 'r':
+                receive_mb = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: autobuffer [-n pack_rounds] [-r receive_mb]\n");
+                return 2;
+        }
+    }
+
+    std::string piece(256, 'b');
+    for (int pooled = 0; pooled < 2; ++pooled) {
+        SizeClassPool pool;
+        AutoBuffer::SetPool(pooled ? &pool : NULL);
+        AutoBuffer::ResetStats();
+
+        uint64_t begin = BenchNowUs();
+        size_t bytes = 0;
+        for (int round = 0; round < rounds; ++round) {
+            bytes += PackAndDrop(4 * 1024 + round % 60 * 1024, piece);
+            bytes += PackAndDrop(2 * 1024 * 1024 * (0 == round % 200), piece);
+        }
+        bytes += ReceiveAndUnpack(receive_mb * 1024 * 1024, 16 * 1024, 6 * 1024);
+        uint64_t cost = BenchNowUs() - begin;
+
+        AutoBuffer::Stats stats = AutoBuffer::GetStats();
+        AutoBuffer::SetPool(NULL);
+        printf("%s: %.1f ms, %zu bytes, reallocs:%llu, pool hits:%llu, zeroed:%llu\n",
+               pooled ? "pooled" : "malloc",
+               cost / 1000.0,
+               bytes,
+               (unsigned long long)stats.reallocs,
+               (unsigned long long)stats.pool_hits,
+               (unsigned long long)stats.bytes_zeroed);
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * comm_bench.cc
+ *
+ * Timings of comm building blocks that are too slow or too machine-bound for
+ * the unit tests, run one by name:
+ *
+ *     comm_bench tcpserver -c 8 -n 500
+ */
+
+#include "comm_bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+struct Bench {
+    const char* name;
+    int (*run)(int argc, char* argv[]);
+    const char* what;
+};
+
+static const Bench kBenches[] = {
+    {"tcpserver", TcpServerBench, "loopback connections per second, one listen thread against sharded acceptors"},
+    {"autobuffer", AutoBufferBench, "stn buffer lifecycles with and without the size-class pool"},
+    {"event_signal", EventSignalBench, "emit cost with 0, 1 and 10 slots against boost::signals2"},
+    {"http", HttpBench, "multi-MB responses read staged through recv_buf against received in place"},
+    {"context", ContextBench, "boot Context manager lookup by type slot against by name, 1 to 8 threads at once"},
+    {"udp", UdpBench, "loopback datagrams per second, sendto/recvfrom against batched and gso/gro"},
+};
+
+uint64_t BenchNowUs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void Usage(const char* _name) {
+    fprintf(stderr, "usage: %s <bench> [options], -h after the bench for its options\n", _name);
+    for (size_t i = 0; i < sizeof(kBenches) / sizeof(kBenches[0]); ++i) {
+        fprintf(stderr, "  %-12s %s\n", kBenches[i].name, kBenches[i].what);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (2 > argc) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    for (size_t i = 0; i < sizeof(kBenches) / sizeof(kBenches[0]); ++i) {
+        if (0 == strcmp(argv[1], kBenches[i].name))
+            return kBenches[i].run(argc - 1, argv + 1);
+    }
+    Usage(argv[0]);
+    return 2;
+}
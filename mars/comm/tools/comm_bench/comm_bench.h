@@ -10,35 +10,25 @@
 // either express or implied. See the License for the specific language governing permissions and
 // limitations under the License.
 
-//
-//  dnschecker.h
-//  netchecker
-//
-//  Author: renlibin caoshaokun on 24/6/14.
-//  Copyright (c) 2014 Tencent. All rights reserved.
-//
+/*
+ * comm_bench.h
+ *
+ * The benchmarks comm_bench runs, one entry each, taking the arguments after
+ * its name. They print what they measured and return the exit code.
+ */
 
-#ifndef SDT_SRC_ACTIVECHECK_DNSCHEKCER_H_
-#define SDT_SRC_ACTIVECHECK_DNSCHEKCER_H_
+#ifndef COMM_TOOLS_COMM_BENCH_H_
+#define COMM_TOOLS_COMM_BENCH_H_
 
-#include "basechecker.h"
-#include "mars/sdt/sdt.h"
+#include <stdint.h>
 
-namespace mars {
-namespace sdt {
+uint64_t BenchNowUs();
 
-class DnsChecker : public BaseChecker {
- public:
-    DnsChecker();
-    virtual ~DnsChecker();
+int TcpServerBench(int argc, char* argv[]);
+int AutoBufferBench(int argc, char* argv[]);
+int EventSignalBench(int argc, char* argv[]);
+int HttpBench(int argc, char* argv[]);
+int ContextBench(int argc, char* argv[]);
+int UdpBench(int argc, char* argv[]);
 
-    virtual int StartDoCheck(CheckRequestProfile& _check_request);
-
- protected:
-    virtual void __DoCheck(CheckRequestProfile& _check_request);
-};
-
-}  // namespace sdt
-}  // namespace mars
-
-#endif  // SDT_SRC_ACTIVECHECK_DNSCHEKCER_H_
+#endif  // COMM_TOOLS_COMM_BENCH_H_
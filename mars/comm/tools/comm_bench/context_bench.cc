@@ -0,0 +1,106 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * context_bench.cc
+ *
+ * Manager lookup cost on 1 to 8 threads looking up at once, by type slot
+ * (GetManager<T>) against by name (GetManagerByName).
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+#include "comm_bench.h"
+#include "mars/boot/context.h"
+
+using namespace mars::boot;
+
+namespace {
+
+class FooManager : public BaseManager {
+ public:
+    std::string GetName() override {
+        return typeid(FooManager).name();
+    }
+};
+
+template <typename Lookup>
+double NanosPerLookup(int _threads, int _lookups, Lookup _lookup, std::atomic<int>* _wrong) {
+    std::vector<std::thread> threads;
+    uint64_t begin = BenchNowUs();
+    for (int i = 0; i < _threads; ++i) {
+        threads.push_back(std::thread([_lookups, _lookup, _wrong]() {
+            for (int j = 0; j < _lookups; ++j) {
+                if (!_lookup())
+                    ++*_wrong;
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+    return (BenchNowUs() - begin) * 1000.0 / ((double)_threads * _lookups);
+}
+
+}  // namespace
+
+int ContextBench(int argc, char* argv[]) {
+    int lookups = 200000;
+    int max_threads = 8;
+
+    int opt = 0;
+    while (-1 != (opt = getopt(argc, argv, "n:t:h"))) {
+        switch (opt) {
+            case 'n':
+                lookups = atoi(optarg);
+                break;
+            case 't':
+                max_threads = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: context [-n lookups_per_thread] [-t max_threads]\n");
+                return 2;
+        }
+    }
+    if (0 >= lookups)
+        lookups = 1;
+
+    auto context = make_context_ptr("comm_bench_context");
+    FooManager foo;
+    context->AddManagerWithName("com.tencent.mars.FooManager", &foo);
+
+    Context* raw = context.get();
+    std::atomic<int> wrong(0);
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double by_slot = NanosPerLookup(
+            threads, lookups, [raw, &foo]() { return raw->GetManager<FooManager>() == &foo; }, &wrong);
+        double by_name = NanosPerLookup(
+            threads,
+            lookups,
+            [raw, &foo]() { return raw->GetManagerByName("com.tencent.mars.FooManager") == &foo; },
+            &wrong);
+        printf("%d threads: GetManager<T> %.1f ns, GetManagerByName %.1f ns per lookup\n", threads, by_slot, by_name);
+    }
+
+    context->RemoveManagerWithName("com.tencent.mars.FooManager", &foo);
+    if (0 != wrong.load()) {
+        fprintf(stderr, "%d lookups returned the wrong manager\n", wrong.load());
+        return 1;
+    }
+    return 0;
+}
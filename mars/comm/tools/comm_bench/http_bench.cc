@@ -0,0 +1,143 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * http_bench.cc
+ *
+ * A multi-MB response over a socketpair read the staged way, every byte through
+ * recv_buf and the parser's buffer, against the in-place way ShortLink reads.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#include "comm_bench.h"
+#include "mars/comm/http.h"
+#include "mars/comm/socket/block_socket.h"
+#include "mars/comm/socket/socketselect.h"
+
+using namespace http;
+using namespace mars::comm;
+
+namespace {
+
+// what ShortLink did before: every byte through recv_buf and the parser's buffer, then into body
+size_t RecvStaged(SOCKET _fd, SocketBreaker& _breaker, AutoBuffer& _body) {
+    AutoBuffer recv_buf;
+    Parser parser(new MemoryBodyReceiver(_body), true);
+    int err = 0;
+    while (!parser.Success()) {
+        int ret = block_socket_recv(_fd, recv_buf, 8 * 1024, _breaker, err, 5000);
+        if (ret <= 0)
+            break;
+        parser.Recv(recv_buf.Ptr(recv_buf.Length() - ret), ret);
+    }
+    return recv_buf.Length();
+}
+
+// what it does now: the headers through the parser, the body received in place
+size_t RecvInPlace(SOCKET _fd, SocketBreaker& _breaker, AutoBuffer& _body) {
+    AutoBuffer recv_buf;
+    Parser parser(new MemoryBodyReceiver(_body), true);
+    int err = 0;
+    while (!parser.Success()) {
+        size_t pending = parser.BodyPending();
+        if (0 < pending) {
+            int ret = block_socket_recv(_fd, _body, std::min<size_t>(pending, 1024 * 1024), _breaker, err, 5000);
+            if (ret <= 0)
+                break;
+            _body.Seek(0, AutoBuffer::ESeekEnd);
+            parser.BodyReceived(ret);
+            continue;
+        }
+        int ret = block_socket_recv(_fd, recv_buf, 8 * 1024, _breaker, err, 5000);
+        if (ret <= 0)
+            break;
+        parser.Recv(recv_buf.Ptr(recv_buf.Length() - ret), ret);
+    }
+    return recv_buf.Length();
+}
+
+}  // namespace
+
+int HttpBench(int argc, char* argv[]) {
+    int rounds = 5;
+
+    int opt = 0;
+    while (-1 != (opt = getopt(argc, argv, "n:h"))) {
+        switch (opt) {
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: http [-n rounds]\n");
+                return 2;
+        }
+    }
+    if (0 >= rounds)
+        rounds = 1;
+
+    const size_t kBodySizes[] = {4 * 1024 * 1024, 16 * 1024 * 1024};
+    for (size_t size_index = 0; size_index < sizeof(kBodySizes) / sizeof(kBodySizes[0]); ++size_index) {
+        std::string head =
+            "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(kBodySizes[size_index]) + "\r\n\r\n";
+        std::string payload(kBodySizes[size_index], '\0');
+        for (size_t i = 0; i < payload.size(); ++i) {
+            payload[i] = (char)('a' + i % 26);
+        }
+
+        for (int in_place = 0; in_place < 2; ++in_place) {
+            uint64_t cost = 0;
+            size_t staged = 0;
+            for (int round = 0; round < rounds; ++round) {
+                int pair[2];
+                if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, pair)) {
+                    perror("socketpair");
+                    return 1;
+                }
+                std::thread server([&]() {
+                    SocketBreaker breaker;
+                    int err = 0;
+                    block_socket_sendv(pair[1], head.data(), head.size(), payload.data(), payload.size(), breaker, err);
+                });
+
+                SocketBreaker breaker;
+                AutoBuffer body;
+                uint64_t begin = BenchNowUs();
+                staged = in_place ? RecvInPlace(pair[0], breaker, body) : RecvStaged(pair[0], breaker, body);
+                cost += BenchNowUs() - begin;
+                server.join();
+                socket_close(pair[0]);
+                socket_close(pair[1]);
+
+                if (payload.size() != body.Length() || 0 != memcmp(payload.data(), body.Ptr(), body.Length())) {
+                    fprintf(stderr, "body mismatch, %zu of %zu bytes\n", body.Length(), payload.size());
+                    return 1;
+                }
+            }
+
+            printf("%zuMB body, %s: %.2f ms, %zu bytes through recv_buf\n",
+                   kBodySizes[size_index] / (1024 * 1024),
+                   in_place ? "in place" : "staged",
+                   cost / 1000.0 / rounds,
+                   staged);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * tcpserver_bench.cc
+ *
+ * Connections per second over loopback: the single listen thread against
+ * sharded acceptors draining in batches with a handler pool.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "comm_bench.h"
+#include "mars/comm/socket/tcpserver.h"
+
+namespace {
+
+class CountingServer : public MTcpServer {
+ public:
+    CountingServer() : accepted(0) {
+    }
+
+    virtual void OnCreate(TcpServer* _server) {
+    }
+    virtual void OnAccept(TcpServer* _server, SOCKET _sock, const sockaddr_in& _addr) {
+        socket_close(_sock);
+        ++accepted;
+    }
+    virtual void OnError(TcpServer* _server, int _error) {
+    }
+
+    std::atomic<int> accepted;
+};
+
+// connections per second, 0 if some were not accepted
+double ConnectsPerSecond(const TcpServerAcceptOptions& _options, int _clients, int _connects) {
+    CountingServer observer;
+    TcpServer server("127.0.0.1", 0, observer, 1024);
+    server.SetAcceptOptions(_options);
+    if (!server.StartAndWait())
+        return 0;
+
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(server.Socket(), (struct sockaddr*)&addr, &len);
+
+    uint64_t begin = BenchNowUs();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < _clients; ++i) {
+        clients.push_back(std::thread([addr, _connects]() {
+            for (int j = 0; j < _connects; ++j) {
+                SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+                if (0 != connect(sock, (const struct sockaddr*)&addr, sizeof(addr)))
+                    fprintf(stderr, "connect err:%d\n", socket_errno);
+                socket_close(sock);
+            }
+        }));
+    }
+    for (size_t i = 0; i < clients.size(); ++i) {
+        clients[i].join();
+    }
+
+    const int total = _clients * _connects;
+    while (observer.accepted < total && BenchNowUs() - begin < 30 * 1000 * 1000) {
+        usleep(1000);
+    }
+    uint64_t cost = BenchNowUs() - begin;
+    server.StopAndWait();
+
+    if (observer.accepted < total) {
+        fprintf(stderr, "%d of %d connections accepted\n", (int)observer.accepted, total);
+        return 0;
+    }
+    return (double)total * 1000000 / (double)(cost ? cost : 1);
+}
+
+}  // namespace
+
+int TcpServerBench(int argc, char* argv[]) {
+    int clients = 8;
+    int connects = 500;
+    TcpServerAcceptOptions sharded;
+    sharded.acceptors = 4;
+    sharded.accept_batch = 64;
+    sharded.handler_threads = 2;
+
+    int opt = 0;
+    while (-1 != (opt = getopt(argc, argv, "c:n:a:b:H:h"))) {
+        switch (opt) {
+            case 'c':
+                clients = atoi(optarg);
+                break;
+            case 'n':
+                connects = atoi(optarg);
+                break;
+            case 'a':
+                sharded.acceptors = atoi(optarg);
+                break;
+            case 'b':
+                sharded.accept_batch = atoi(optarg);
+                break;
+            case 'H':
+                sharded.handler_threads = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr,
+                        "usage: tcpserver [-c clients] [-n connects_per_client] [-a acceptors] [-b batch]"
+                        " [-H handlers]\n");
+                return 2;
+        }
+    }
+
+    double single_rate = ConnectsPerSecond(TcpServerAcceptOptions(), clients, connects);
+    double sharded_rate = ConnectsPerSecond(sharded, clients, connects);
+    printf("%d connections over loopback: single acceptor %ld conn/s, %d acceptors x batch %d + %d handlers %ld"
+           " conn/s\n",
+           clients * connects,
+           (long)single_rate,
+           sharded.acceptors,
+           sharded.accept_batch,
+           sharded.handler_threads,
+           (long)sharded_rate);
+    return 0 < single_rate && 0 < sharded_rate ? 0 : 1;
+}
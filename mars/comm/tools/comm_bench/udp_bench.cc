@@ -0,0 +1,151 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * udp_bench.cc
+ *
+ * Datagrams per second over loopback, one sendto/recvfrom per datagram against
+ * UdpSendRing and UdpBatchReader, then batched with GSO/GRO where the kernel
+ * has them.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "comm_bench.h"
+#include "mars/comm/socket/udp_batch.h"
+
+using namespace mars::comm;
+
+namespace {
+
+const size_t kWindow = 64;
+
+SOCKET BindLoopback(struct sockaddr_in& _addr) {
+    SOCKET fd = socket(AF_INET, SOCK_DGRAM, 0);
+    bzero(&_addr, sizeof(_addr));
+    _addr.sin_family = AF_INET;
+    _addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    _addr.sin_port = 0;
+    bind(fd, (struct sockaddr*)&_addr, sizeof(_addr));
+    socklen_t len = sizeof(_addr);
+    getsockname(fd, (struct sockaddr*)&_addr, &len);
+    return fd;
+}
+
+// datagrams per second, -1 if one was lost, cut or failed
+double Pps(int _datagrams, size_t _payload, bool _batched, bool _offload, bool* _offloaded) {
+    struct sockaddr_in to;
+    struct sockaddr_in from;
+    SOCKET rfd = BindLoopback(to);
+    SOCKET sfd = BindLoopback(from);
+
+    UdpSendRing ring(kWindow);
+    UdpBatchReader reader(16, 65536);
+    if (_offload) {
+        bool gso = ring.EnableGso(sfd);
+        bool gro = reader.EnableGro(rfd);
+        *_offloaded = gso && gro;
+    }
+    std::vector<char> payload(_payload, 'u');
+    std::vector<char> buffer(_payload + 1);
+    int received = 0;
+    bool broken = false;
+
+    uint64_t begin = BenchNowUs();
+    while (received < _datagrams && !broken) {
+        // a window at a time, so the loopback receive buffer never drops
+        int err = 0;
+        size_t window = 0;
+        for (; window < kWindow && received + (int)window < _datagrams; ++window) {
+            if (_batched) {
+                ring.Push(&payload[0], payload.size(), (struct sockaddr*)&to, sizeof(to));
+            } else {
+                sendto(sfd, &payload[0], payload.size(), 0, (struct sockaddr*)&to, sizeof(to));
+            }
+        }
+        while (_batched && !ring.Empty() && !broken) {
+            broken = 0 > ring.Send(sfd, NULL, 0, err);
+        }
+
+        for (size_t got = 0; got < window && !broken;) {
+            if (_batched) {
+                int ret = reader.Read(rfd, err);
+                broken = 0 > ret;
+                for (int i = 0; i < ret; ++i) {
+                    broken = broken || _payload != reader.At(i).len;
+                }
+                got += 0 < ret ? ret : 0;
+            } else {
+                broken = (ssize_t)_payload != recvfrom(rfd, &buffer[0], buffer.size(), 0, NULL, NULL);
+                ++got;
+            }
+        }
+        received += window;
+    }
+    uint64_t cost = BenchNowUs() - begin;
+
+    socket_close(rfd);
+    socket_close(sfd);
+    if (broken)
+        return -1;
+    return (double)_datagrams * 1000000 / (double)(cost ? cost : 1);
+}
+
+}  // namespace
+
+int UdpBench(int argc, char* argv[]) {
+    int datagrams = 200000;
+    size_t payload = 256;
+
+    int opt = 0;
+    while (-1 != (opt = getopt(argc, argv, "n:s:h"))) {
+        switch (opt) {
+            case 'n':
+                datagrams = atoi(optarg);
+                break;
+            case 's':
+                payload = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: udp [-n datagrams] [-s payload_bytes]\n");
+                return 2;
+        }
+    }
+    if (0 >= datagrams || 0 == payload || 65535 < payload) {
+        fprintf(stderr, "datagrams must be positive and a payload 1 to 65535 bytes\n");
+        return 2;
+    }
+
+    bool offloaded = false;
+    double single = Pps(datagrams, payload, false, false, NULL);
+    double batched = Pps(datagrams, payload, true, false, NULL);
+    double offload = Pps(datagrams, payload, true, true, &offloaded);
+    if (0 > single || 0 > batched || 0 > offload) {
+        fprintf(stderr, "a datagram was lost, cut or failed\n");
+        return 1;
+    }
+
+    printf("%d datagrams of %zu bytes over loopback: sendto/recvfrom %ld pps, batched %ld pps, "
+           "batched with gso/gro %ld pps%s\n",
+           datagrams,
+           payload,
+           (long)single,
+           (long)batched,
+           (long)offload,
+           offloaded ? "" : " (not offloaded on this kernel)");
+    return 0;
+}
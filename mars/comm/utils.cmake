@@ -111,6 +111,18 @@ elseif(UNIX)
     set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -std=gnu++14 -fPIC -ffunction-sections -fdata-sections -Os")
     set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -fPIC -ffunction-sections -fdata-sections -Os")
 endif()
+
+# coroutine/co_*: stackless coroutines. Only those sources are compiled as C++20, the rest of the tree
+# (boost signals2 among others) stays on C++14
+if(CXX20_COROUTINE)
+    message("C++20 coroutines enabled by option CXX20_COROUTINE")
+    add_definitions(-DCXX20_COROUTINE)
+    if(MSVC)
+        set(CXX20_COROUTINE_FLAGS "/std:c++20")
+    else()
+        set(CXX20_COROUTINE_FLAGS "-std=gnu++20")
+    endif()
+endif()
  
 macro(BuildWithUnitTest projname sourcefiles)
     set(SRCFILES "${sourcefiles}")
@@ -3,7 +3,7 @@
 
 #include <functional>
 
-#include "mars/comm/thread/thread.h"
+#include "mars/comm/executor.h"
 
 namespace mars {
 namespace comm {
@@ -14,7 +14,7 @@ XloggerCategory* XloggerCategory::NewInstance(
     return new XloggerCategory(_appender, _appender_func);
 }
 void XloggerCategory::DelayRelease(XloggerCategory* _category) {
-    Thread(std::bind(&__Release, _category)).start_after(5000);
+    Executor::Default().PostDelayed(std::bind(&__Release, _category), 5000, "xlog.category.release");
 }
 
 void XloggerCategory::__Release(XloggerCategory* _category) {
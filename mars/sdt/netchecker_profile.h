@@ -97,6 +97,7 @@ struct CheckRequestProfile {
         check_status = kCheckContinue;
 
         total_timeout = 0;
+        netcheck_cgi.clear();
     }
 
     CheckIPPorts longlink_items;
@@ -106,6 +107,7 @@ struct CheckRequestProfile {
     CheckStatus check_status;
 
     uint32_t total_timeout;
+    std::string netcheck_cgi;  // path of the http probes, appended to each shortlink host
 
     std::vector<CheckResultProfile> checkresult_profiles;
 };
@@ -111,6 +111,9 @@ class Callback {
     virtual ~Callback(){};
     virtual void ReportNetCheckResult(const std::vector<CheckResultProfile>& _check_results) {
     }
+    // one probe result as soon as it is in, ReportNetCheckResult still gets them all at the end
+    virtual void ReportNetCheckPartialResult(const CheckResultProfile& _check_result) {
+    }
 };
 
 // mars2
@@ -6,7 +6,6 @@
 
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/xlog/appender.h"
-#include "sdt/src/activecheck/httpchecker.h"
 #include "sdt/src/sdt_core.h"
 
 using namespace mars::boot;
@@ -73,6 +72,12 @@ void SdtManager::ReportNetCheckResult(const std::vector<CheckResultProfile>& _ch
     // call stn MMReportNetCheckResult
 }
 
+void SdtManager::ReportNetCheckPartialResult(const CheckResultProfile& _check_result) {
+    if (callback_) {
+        callback_->ReportNetCheckPartialResult(_check_result);
+    }
+}
+
 #ifdef NATIVE_CALLBACK
 void SdtManager::SetSdtNativeCallback(std::shared_ptr<SdtNativeCallback> _cb) {
     xdebug_function();
@@ -43,6 +43,7 @@ class SdtManager : public mars::boot::BaseManager {
                           int _timeout);
     void CancelActiveCheck();
     void ReportNetCheckResult(const std::vector<CheckResultProfile>& _check_results);
+    void ReportNetCheckPartialResult(const CheckResultProfile& _check_result);
 //    extern void (*ReportNetCheckResult)(const std::vector<CheckResultProfile>& _check_results);
 #ifdef NATIVE_CALLBACK
     void SetSdtNativeCallback(std::shared_ptr<SdtNativeCallback> _cb);
@@ -21,21 +21,18 @@
 #ifndef SDT_SRC_ACTIVECHECK_PINGCHEKER_H_
 #define SDT_SRC_ACTIVECHECK_PINGCHEKER_H_
 
-#include "basechecker.h"
-#include "mars/sdt/sdt.h"
+#include <string>
+
+#include "mars/sdt/netchecker_profile.h"
 
 namespace mars {
 namespace sdt {
 
-class PingChecker : public BaseChecker {
+// ping probes run as jobs of DiagnosisEngine, each one a call of PingHost
+class PingChecker {
  public:
-    PingChecker();
-    virtual ~PingChecker();
-
-    virtual int StartDoCheck(CheckRequestProfile& _check_request);
-
- protected:
-    virtual void __DoCheck(CheckRequestProfile& _check_request);
+    // one ping of _host, _timeout_s 0 for the ping default
+    static CheckResultProfile PingHost(const std::string& _host, int _timeout_s);
 };
 
 }  // namespace sdt
@@ -21,30 +21,22 @@
 #ifndef SDT_SRC_ACTIVECHECK_TCPCHEKER_H_
 #define SDT_SRC_ACTIVECHECK_TCPCHEKER_H_
 
-#include "basechecker.h"
 #include "mars/comm/autobuffer.h"
 #include "mars/sdt/sdt.h"
 
 namespace mars {
 namespace sdt {
 
-class TcpChecker : public BaseChecker {
+// tcp probes run on DiagnosisEngine, only the noop they exchange is here
+class TcpChecker {
  public:
-    TcpChecker();
-    virtual ~TcpChecker();
-
-    virtual int StartDoCheck(CheckRequestProfile& _check_request);
-
- protected:
-    virtual void __DoCheck(CheckRequestProfile& _check_request);
-
- private:
-    void __NoopReq(AutoBuffer& noop_send);
-    bool __NoopResp(const AutoBuffer& _packed,
-                    uint32_t& _cmdid,
-                    uint32_t& _seq,
-                    size_t& _package_len,
-                    AutoBuffer& _body);
+    // the noop a tcp probe sends, and whether a received buffer is its response
+    static void NoopReq(AutoBuffer& noop_send);
+    static bool NoopResp(const AutoBuffer& _packed,
+                         uint32_t& _cmdid,
+                         uint32_t& _seq,
+                         size_t& _package_len,
+                         AutoBuffer& _body);
 };
 
 }  // namespace sdt
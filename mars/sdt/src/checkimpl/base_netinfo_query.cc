@@ -8,8 +8,8 @@
 #include "base_netinfo_query.h"
 
 #include "mars/comm/network/getdnssvraddrs.h"
-#include "mars/comm/network/getgateway.h"
 #include "mars/comm/network/getifaddrs.h"
+#include "mars/comm/network/network_state.h"
 #include "mars/comm/platform_comm.h"
 #include "mars/comm/socket/local_ipstack.h"
 #include "mars/comm/socket/socket_address.h"
@@ -72,17 +72,14 @@ void BaseNetInfo::__QueryNetConfig() {
     xinfo_function();
     //默认网关
     XMessage xmsg1;
-    in6_addr addr6_gateway;
-    memset(&addr6_gateway, 0, sizeof(addr6_gateway));
-    if (0 == getdefaultgateway6(&addr6_gateway)) {
-        xmsg1(TSF "getdefaultgateway6:%_.", socket_address(addr6_gateway).ipv6());
+    std::shared_ptr<const mars::comm::NetworkStateSnapshot> network = mars::comm::NetworkState::Instance().Current();
+    if (network->has_gateway6) {
+        xmsg1(TSF "getdefaultgateway6:%_.", socket_address(network->gateway6).ipv6());
     } else {
         xmsg1(TSF "getdefaultgateway6:failed.");
     }
-    in_addr addr_gateway;
-    memset(&addr_gateway, 0, sizeof(addr_gateway));
-    if (0 == getdefaultgateway(&addr_gateway)) {
-        xmsg1(TSF "getdefaultgateway:%_.", socket_address(addr_gateway).ip());
+    if (network->has_gateway4) {
+        xmsg1(TSF "getdefaultgateway:%_.", socket_address(network->gateway4).ip());
     } else {
         xmsg1(TSF "getdefaultgateway:failed.");
     }
@@ -145,15 +145,10 @@ int socket_gethostbyname(const char* _host,
     if (_timeout <= 0)
         _timeout = DEFAULT_TIMEOUT;
 
-    std::vector<std::string> dns_servers;
-
-    if (_dnsserver && isValidIpAddress(_dnsserver)) {
-        xinfo2(TSF "DNS server: %0", _dnsserver);
-        dns_servers.push_back(_dnsserver);
-    } else {
-        xinfo2(TSF "use default DNS server.");
-        GetHostDnsServerIP(dns_servers);
-    }
+    std::string query;
+    struct sockaddr_in dest = {0};
+    if (!socket_dnsquery_prepare(_host, _dnsserver, query, dest))
+        return -1;
 
     SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);  // UDP packet for DNS queries
 
@@ -162,45 +157,22 @@ int socket_gethostbyname(const char* _host,
         return -1;
     }
 
-    struct sockaddr_in dest = {0};
-
-    if (dns_servers.empty()) {
-        xerror2(TSF "No dns servers error.");
-        ::socket_close(sock);
-        return -1;
-    }
-
-    std::vector<std::string>::iterator iter = dns_servers.begin();
-    // 配置DNS服务器的IP和端口号
-    dest = *(struct sockaddr_in*)(&socket_address((*iter).c_str(), DNS_PORT).address());
-
-    struct RES_RECORD answers[SOCKET_MAX_IP_COUNT];  // the replies from the DNS server
-    memset(answers, 0, sizeof(RES_RECORD) * SOCKET_MAX_IP_COUNT);
-
     int ret = -1;
 
     do {
-        const unsigned int BUF_LEN = 65536;
-        unsigned char send_buf[BUF_LEN] = {0};
-        unsigned char recv_buf[BUF_LEN] = {0};
-        struct DNS_HEADER* dns = (struct DNS_HEADER*)send_buf;
-        unsigned char* qname = (unsigned char*)&send_buf[sizeof(struct DNS_HEADER)];
-        PrepareDnsQueryPacket(send_buf, dns, qname, _host);
-        unsigned long send_packlen =
-            sizeof(struct DNS_HEADER) + (strlen((const char*)qname) + 1) + sizeof(struct QUESTION);
-
         if (NULL != _traffic_monitor) {
-            if (_traffic_monitor->sendLimitCheck(send_packlen)) {
+            if (_traffic_monitor->sendLimitCheck(query.size())) {
                 ret = TRAFFIC_LIMIT_RET_CODE;
                 break;
             }
         }
 
-        if (sendto(sock, (char*)send_buf, send_packlen, 0, (struct sockaddr*)&dest, sizeof(dest)) == -1) {
+        if (sendto(sock, query.data(), query.size(), 0, (struct sockaddr*)&dest, sizeof(dest)) == -1) {
             xerror2(TSF "send dns query error.");
             break;
         }
 
+        std::vector<unsigned char> recv_buf(SOCKET_DNS_REPLY_MAX, 0);
         struct sockaddr_in recv_src = {0};
 
         socklen_t recv_src_len = sizeof(recv_src);
@@ -208,8 +180,8 @@ int socket_gethostbyname(const char* _host,
         int recvPacketLen = 0;
 
         if ((recvPacketLen = RecvWithinTime(sock,
-                                            (char*)recv_buf,
-                                            BUF_LEN,
+                                            (char*)&recv_buf[0],
+                                            recv_buf.size(),
                                             (struct sockaddr*)&recv_src,
                                             &recv_src_len,
                                             _timeout / 1000,
@@ -226,39 +198,75 @@ int socket_gethostbyname(const char* _host,
             }
         }
 
-        // move ahead of the dns header and the query field
-        unsigned char* reader =
-            &recv_buf[sizeof(struct DNS_HEADER) + (strlen((const char*)qname) + 1) + sizeof(struct QUESTION)];
-        dns = (struct DNS_HEADER*)recv_buf;  // 指向recv_buf的header
-        ReadRecvAnswer(recv_buf, dns, reader, answers);
-
-        // 把查询到的IP放入返回参数_ipinfo结构体中
-        int answer_count = std::min(SOCKET_MAX_IP_COUNT, (int)ntohs(dns->ans_count));
-        _ipinfo->size = 0;
-
-        for (int i = 0; i < answer_count; ++i) {
-            if (1 == ntohs(answers[i].resource->type)) {  // IPv4 address
-                in_addr_t* p = (in_addr_t*)answers[i].rdata;
-                _ipinfo->ip[_ipinfo->size].s_addr = (*p);  // working without ntohl
-                _ipinfo->size++;
-            }
-        }
-
-        if (0 >= _ipinfo->size) {  // unkown host, dns->rcode == 3
-            xerror2(TSF "unknown host.");
-            break;
-        }
-
-        //      _ipinfo->dns = ;
-        ret = 0;
+        ret = socket_dnsquery_parse(query.size(), &recv_buf[0], _ipinfo);
     } while (false);
 
-    FreeAll(answers);
     xinfo2(TSF "close fd in dnsquery,sock=%0", sock);
     ::socket_close(sock);
     return ret;  //* 查询DNS服务器超时
 }
 
+bool socket_dnsquery_prepare(const char* _host,
+                             const char* _dnsserver,
+                             std::string& _query,
+                             struct sockaddr_in& _server) {
+    std::vector<std::string> dns_servers;
+
+    if (_dnsserver && isValidIpAddress(_dnsserver)) {
+        xinfo2(TSF "DNS server: %0", _dnsserver);
+        dns_servers.push_back(_dnsserver);
+    } else {
+        xinfo2(TSF "use default DNS server.");
+        GetHostDnsServerIP(dns_servers);
+    }
+
+    if (dns_servers.empty()) {
+        xerror2(TSF "No dns servers error.");
+        return false;
+    }
+
+    // 配置DNS服务器的IP和端口号
+    _server = *(struct sockaddr_in*)(&socket_address(dns_servers.front().c_str(), DNS_PORT).address());
+
+    const unsigned int BUF_LEN = 65536;
+    std::vector<unsigned char> send_buf(BUF_LEN, 0);
+    struct DNS_HEADER* dns = (struct DNS_HEADER*)&send_buf[0];
+    unsigned char* qname = &send_buf[sizeof(struct DNS_HEADER)];
+    PrepareDnsQueryPacket(&send_buf[0], dns, qname, _host);
+    size_t send_packlen = sizeof(struct DNS_HEADER) + (strlen((const char*)qname) + 1) + sizeof(struct QUESTION);
+    _query.assign((const char*)&send_buf[0], send_packlen);
+    return true;
+}
+
+int socket_dnsquery_parse(size_t _query_len, unsigned char* _reply, struct socket_ipinfo_t* _ipinfo) {
+    struct RES_RECORD answers[SOCKET_MAX_IP_COUNT];  // the replies from the DNS server
+    memset(answers, 0, sizeof(RES_RECORD) * SOCKET_MAX_IP_COUNT);
+
+    // move ahead of the dns header and the query field
+    unsigned char* reader = &_reply[_query_len];
+    struct DNS_HEADER* dns = (struct DNS_HEADER*)_reply;  // 指向recv_buf的header
+    ReadRecvAnswer(_reply, dns, reader, answers);
+
+    // 把查询到的IP放入返回参数_ipinfo结构体中
+    int answer_count = std::min(SOCKET_MAX_IP_COUNT, (int)ntohs(dns->ans_count));
+    _ipinfo->size = 0;
+
+    for (int i = 0; i < answer_count; ++i) {
+        if (NULL != answers[i].resource && 1 == ntohs(answers[i].resource->type)) {  // IPv4 address
+            in_addr_t* p = (in_addr_t*)answers[i].rdata;
+            _ipinfo->ip[_ipinfo->size].s_addr = (*p);  // working without ntohl
+            _ipinfo->size++;
+        }
+    }
+    FreeAll(answers);
+
+    if (0 >= _ipinfo->size) {  // unkown host, dns->rcode == 3
+        xerror2(TSF "unknown host.");
+        return -1;
+    }
+    return 0;
+}
+
 int socket_gethostbyname(const char* _host, socket_ipinfo_t* _ipinfo, int _timeout /*ms*/, const char* _dnsserver) {
     return socket_gethostbyname(_host, _ipinfo, _timeout, _dnsserver, NULL);
 }
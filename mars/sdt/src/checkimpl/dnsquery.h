@@ -46,12 +46,27 @@ int socket_gethostbyname(const char* _host,
 }
 
 ////////
+#include <string>
+
 class NetCheckTrafficMonitor;
 int socket_gethostbyname(const char* _host,
                          struct socket_ipinfo_t* _ipinfo,
                          int _timeout /*ms*/,
                          const char* _dnsserver,
                          NetCheckTrafficMonitor* _traffic_monitor);
+
+/**
+ * the two halves of socket_gethostbyname, for a caller polling the udp socket itself.
+ * socket_dnsquery_prepare: the query for _host and the server to send it to, false if no server is known.
+ * socket_dnsquery_parse: the ipv4 addresses in a reply to a _query_len bytes query, -1 if it has none;
+ * _reply is a zeroed buffer of 64KB, what a reply may be at most.
+ */
+bool socket_dnsquery_prepare(const char* _host,
+                             const char* _dnsserver,
+                             std::string& _query,
+                             struct sockaddr_in& _server);
+int socket_dnsquery_parse(size_t _query_len, unsigned char* _reply, struct socket_ipinfo_t* _ipinfo);
+#define SOCKET_DNS_REPLY_MAX (65536)
 #endif
 
 #endif  // SDT_SRC_CHECKIMPL_DNSQUERY_H_
@@ -35,43 +35,39 @@
 
 using namespace mars::sdt;
 
-static char* string_strnstr(const char* _src, const char* _sfind, int _pos) {
-    if (_src == NULL || _sfind == NULL)
-        return NULL;
-
-    int l1, l2;
-    l2 = (int)strlen(_sfind);
-
-    if (!l2)
-        return (char*)_src;
-
-    l1 = (int)strlen(_src);
-    _pos = (_pos > l1) ? l1 : _pos;
-
-    while (_pos >= l2) {
-        _pos--;
+void HttpQueryRequest(const std::string& _url, std::string& _request, std::string& _host, uint16_t& _port) {
+    HttpUrlParser http_url_parser(_url);
+    _host = http_url_parser.Host();
+    _port = http_url_parser.Port();
+    xdebug2(TSF "host=%0", _host);
 
-        if (!memcmp(_src, _sfind, l2))
-            return (char*)_src;
+    _request.clear();
+    http::RequestLine reqLine(http::RequestLine::kGet, http_url_parser.Path(), http::kVersion_1_1);
+    _request.append(reqLine.ToString());
 
-        _src++;
-    }
+    http::HeaderFields header;
+    header.HeaderFiled("Accept", "text/html, application/xhtml+xml, */*");
+    header.HeaderFiled("Accept-Language", "zh-CN");
+    header.HeaderFiled("User-Agent", USER_AGENT);
+    header.HeaderFiled("Accept-Encoding", "gzip, deflate");
+    header.HeaderFiled("Proxy-Connection", "Keep-Alive");
+    header.HeaderFiled("Host", _host.c_str());
+    _request.append(header.ToString());
+    _request.append("\r\n\r\n");  // important
 
-    return NULL;
+    xdebug2(TSF "str_req=%_", _request);
 }
 
-static int SplitHttpHeadAndBody(const AutoBuffer& buf, std::string& strHead) {
-    char* pBuf = (char*)buf.Ptr();
-    char* pos = string_strnstr(pBuf, "\r\n\r\n", (int)buf.Length());
-
-    if (pos == NULL)
-        return -1;
+int HttpQueryStatusCode(const void* _resp, size_t _len) {
+    std::string resp((const char*)_resp, _len);
+    size_t head_end = resp.find("\r\n\r\n");
+    if (std::string::npos == head_end)
+        return 0;
 
     //  '2' retain for '\r\n'.
-    ptrdiff_t headLength = (pos - pBuf) + 2;
-
-    strHead = std::string(pBuf, headLength);
-    return (int)headLength + 2;
+    http::StatusLine statusLine;
+    statusLine.FromString(resp.substr(0, head_end + 2));
+    return statusLine.StatusCode();
 }
 
 int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errmsg, int _timeout) {
@@ -86,31 +82,12 @@ int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errm
     if (_timeout <= 0) {
         _timeout = HTTP_DEFAULT_TIMEOUT;
     }
-    HttpUrlParser http_url_parser(_url);
-    std::string host = http_url_parser.Host();
-    xdebug2(TSF "host=%0", host);
-
-    std::string str_req("");
-    http::RequestLine reqLine(http::RequestLine::kGet, http_url_parser.Path(), http::kVersion_1_1);
-    str_req.append(reqLine.ToString());
-
-    http::HeaderFields header;
-    header.HeaderFiled("Accept", "text/html, application/xhtml+xml, */*");
-    header.HeaderFiled("Accept-Language", "zh-CN");
-    header.HeaderFiled("User-Agent", USER_AGENT);
-    header.HeaderFiled("Accept-Encoding", "gzip, deflate");
-    header.HeaderFiled("Proxy-Connection", "Keep-Alive");
-
+    std::string str_req;
+    std::string host;
+    uint16_t port = 0;
+    HttpQueryRequest(_url, str_req, host, port);
     bool domain_is_ipaddr = socket_address(host.c_str(), 0).valid();  // 判断strHost是否是一个点分十进制IP
 
-    header.HeaderFiled("Host", host.c_str());
-    str_req.append(header.ToString());
-    str_req.append("\r\n\r\n");  // important
-
-    xdebug2(TSF "str_req=%_", str_req);
-
-    unsigned int port = http_url_parser.Port();
-
     struct socket_ipinfo_t ipinfo;
 
     char ip[20] = {0};
@@ -193,11 +170,7 @@ int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errm
         }
 
         xdebug2(TSF "recvAutoBuf=%0", (char*)recv_autobuf.Ptr());
-        std::string str_statusline;
-        SplitHttpHeadAndBody(recv_autobuf, str_statusline);
-        http::StatusLine statusLine;
-        statusLine.FromString(str_statusline);
-        _status_code = statusLine.StatusCode();
+        _status_code = HttpQueryStatusCode(recv_autobuf.Ptr(), recv_autobuf.Length());
     } while (false);
 
     xdebug2(TSF "ret=%0", ret);
@@ -20,6 +20,9 @@
 #ifndef SDT_SRC_CHECKIMPL_HTTPQUERY_H_
 #define SDT_SRC_CHECKIMPL_HTTPQUERY_H_
 
+#include <stdint.h>
+#include <stdlib.h>
+
 #include <string>
 
 /**
@@ -30,4 +33,12 @@
  */
 int SendHttpQuery(const std::string& _url, int& _status_code, std::string& _errmsg, int _timeout /*ms*/);
 
+/**
+ *  the halves of SendHttpQuery for a caller polling the socket itself:
+ *  HttpQueryRequest: the GET for _url and the host and port to send it to
+ *  HttpQueryStatusCode: the status code of a response that starts with _resp, 0 until its headers are complete
+ */
+void HttpQueryRequest(const std::string& _url, std::string& _request, std::string& _host, uint16_t& _port);
+int HttpQueryStatusCode(const void* _resp, size_t _len);
+
 #endif /* SDT_SRC_CHECKIMPL_HTTPQUERY_H_ */
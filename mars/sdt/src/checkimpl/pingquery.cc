@@ -27,7 +27,7 @@
 #include <string.h>
 #include <unistd.h>
 
-#include "mars/comm/network/getgateway.h"
+#include "mars/comm/network/network_state.h"
 #include "mars/comm/socket/socket_address.h"
 #include "mars/comm/socket/socketselect.h"
 #include "mars/comm/xlogger/xlogger.h"
@@ -92,13 +92,13 @@ int PingQuery::RunPingQuery(int _querycount,
         timeout = DEFAULT_PING_TIMEOUT;
 
     if (NULL == dest || 0 == strlen(dest)) {
-        struct in_addr _addr;
-        int ret = getdefaultgateway(&_addr);
-
-        if (-1 == ret) {
+        std::shared_ptr<const mars::comm::NetworkStateSnapshot> network =
+            mars::comm::NetworkState::Instance().Current();
+        if (!network->has_gateway4) {
             xerror2(TSF "get default gateway error.");
             return -1;
         }
+        struct in_addr _addr = network->gateway4;
 
         dest = socket_address(_addr).ip();
 
@@ -773,13 +773,13 @@ int PingQuery::RunPingQuery(int _querycount,
     }
 
     if (NULL == _dest || 0 == strlen(_dest)) {
-        struct in_addr _addr;
-        int ret = getdefaultgateway(&_addr);
-
-        if (-1 == ret) {
+        std::shared_ptr<const mars::comm::NetworkStateSnapshot> network =
+            mars::comm::NetworkState::Instance().Current();
+        if (!network->has_gateway4) {
             xerror2(TSF "get default gateway error.");
             return -1;
         }
+        struct in_addr _addr = network->gateway4;
 
         _dest = inet_ntoa(_addr);
 
@@ -0,0 +1,598 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * diagnosis_engine.cc
+ */
+
+#include "diagnosis_engine.h"
+
+#include <algorithm>
+
+#include "activecheck/pingchecker.h"
+#include "activecheck/tcpchecker.h"
+#include "boost/bind.hpp"
+#include "mars/comm/platform_comm.h"
+#include "mars/comm/socket/socket_address.h"
+#include "mars/comm/socket/socketpoll.h"
+#include "mars/comm/strutil.h"
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+#include "mars/sdt/constants.h"
+#include "sdt/src/checkimpl/dnsquery.h"
+#include "sdt/src/checkimpl/httpquery.h"
+
+using namespace mars::comm;
+
+namespace mars {
+namespace sdt {
+
+static const size_t kTcpRecvSize = 64 * 1024;
+static const size_t kHttpRecvSize = 1024;  // what SendHttpQuery reads of a response
+
+struct DiagnosisEngine::SocketProbe {
+    enum State {
+        kResolving,  // udp, the dns query sent, its reply awaited
+        kConnecting,
+        kSending,
+        kReceiving,
+        kDone,
+    };
+
+    SocketProbe()
+    : fd(INVALID_SOCKET)
+    , state(kConnecting)
+    , port(0)
+    , query_len(0)
+    , sent(0)
+    , start_tick(0)
+    , connect_deadline(0)
+    , deadline(0) {
+    }
+
+    CheckResultProfile profile;
+    SOCKET fd;
+    State state;
+    std::string host;  // dns: the domain to resolve, http: the host of the url
+    uint16_t port;     // http: the port of the url
+    size_t query_len;
+    AutoBuffer send_buf;
+    size_t sent;
+    AutoBuffer recv_buf;
+    uint64_t start_tick;
+    uint64_t connect_deadline;
+    uint64_t deadline;
+};
+
+struct DiagnosisEngine::PingProbe {
+    std::string host;
+};
+
+DiagnosisEngine::DiagnosisEngine(CheckRequestProfile& _check_request, const ResultCallback& _on_result)
+: check_request_(_check_request)
+, on_result_(_on_result)
+, start_tick_(0)
+, deadline_(0)
+, pending_(0)
+, canceled_(false) {
+}
+
+DiagnosisEngine::~DiagnosisEngine() {
+    for (size_t i = 0; i < socket_probes_.size(); ++i) {
+        if (INVALID_SOCKET != socket_probes_[i]->fd)
+            socket_close(socket_probes_[i]->fd);
+        delete socket_probes_[i];
+    }
+}
+
+void DiagnosisEngine::Run() {
+    xinfo_function();
+    // timeout and finish net checker, as the checkers did before probing
+    if (check_request_.total_timeout <= 0) {
+        xinfo2(TSF "req.total_timeout_=%_, check finish!", check_request_.total_timeout);
+        check_request_.check_status = kCheckFinish;
+        return;
+    }
+
+    start_tick_ = ::gettickcount();
+    deadline_ = UNUSE_TIMEOUT == check_request_.total_timeout ? 0 : start_tick_ + check_request_.total_timeout;
+    __CollectProbes();
+
+    {
+        ScopedLock lock(mutex_);
+        pending_ = socket_probes_.size() + ping_probes_.size();
+        if (canceled_)
+            return;
+    }
+    xinfo2(TSF "diagnosis start, socket probes:%_, ping probes:%_, total_timeout:%_",
+           socket_probes_.size(),
+           ping_probes_.size(),
+           check_request_.total_timeout);
+
+    for (size_t i = 0; i < ping_probes_.size(); ++i) {
+        ping_jobs_.push_back(
+            Executor::Blocking().Post(boost::bind(&DiagnosisEngine::__RunPing, this, ping_probes_[i]), "sdt.ping"));
+    }
+
+    __RunSocketProbes();
+
+    {
+        ScopedLock lock(mutex_);
+        // the pings have budgets within the deadline, they all come back before long
+        while (0 < pending_ && !canceled_) {
+            cond_.wait(lock);
+        }
+    }
+
+    // a ping already running can't be stopped, it is waited for
+    for (size_t i = 0; i < ping_jobs_.size(); ++i) {
+        if (!ping_jobs_[i]->Cancel())
+            ping_jobs_[i]->Join();
+    }
+
+    xinfo2(TSF "diagnosis end, results:%_, cost:%_, canceled:%_",
+           check_request_.checkresult_profiles.size(),
+           ::gettickcount() - start_tick_,
+           canceled_);
+}
+
+void DiagnosisEngine::Cancel() {
+    ScopedLock lock(mutex_);
+    canceled_ = true;
+    breaker_.Break();
+    cond_.notifyAll();
+}
+
+void DiagnosisEngine::__CollectProbes() {
+    int mode = check_request_.mode;
+    CheckIPPorts* items[] = {&check_request_.longlink_items, &check_request_.shortlink_items};
+
+    if (MODE_BASIC(mode)) {
+#if defined(ANDROID) || defined(__APPLE__)
+        for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); ++i) {
+            for (CheckIPPorts_Iterator iter = items[i]->begin(); iter != items[i]->end(); ++iter) {
+                for (size_t j = 0; j < iter->second.size(); ++j) {
+                    PingProbe probe;
+                    probe.host = iter->second[j].ip.empty() ? DEFAULT_PING_HOST : iter->second[j].ip;
+                    ping_probes_.push_back(probe);
+                }
+            }
+        }
+#endif
+        for (size_t i = 0; i < sizeof(items) / sizeof(items[0]); ++i) {
+            for (CheckIPPorts_Iterator iter = items[i]->begin(); iter != items[i]->end(); ++iter) {
+                SocketProbe* probe = new SocketProbe();
+                probe->profile.netcheck_type = kDnsCheck;
+                probe->profile.domain_name = iter->first;
+                probe->profile.network_type = comm::getNetInfo();
+                probe->host = iter->first;
+                socket_probes_.push_back(probe);
+            }
+        }
+    }
+
+    if (MODE_SHORT(mode)) {
+        for (CheckIPPorts_Iterator iter = check_request_.shortlink_items.begin();
+             iter != check_request_.shortlink_items.end();
+             ++iter) {
+            for (size_t j = 0; j < iter->second.size(); ++j) {
+                SocketProbe* probe = new SocketProbe();
+                probe->profile.netcheck_type = kHttpCheck;
+                probe->profile.ip = iter->second[j].ip;
+                probe->profile.port = iter->second[j].port;
+                probe->profile.network_type = comm::getNetInfo();
+                probe->profile.url = iter->first.empty() ? DEFAULT_HTTP_HOST : iter->first;
+                probe->profile.url.append(check_request_.netcheck_cgi);
+                if (!strutil::StartsWith(probe->profile.url, "http://"))
+                    probe->profile.url = std::string("http://") + probe->profile.url;
+                socket_probes_.push_back(probe);
+            }
+        }
+    }
+
+    if (MODE_LONG(mode)) {
+        for (CheckIPPorts_Iterator iter = check_request_.longlink_items.begin();
+             iter != check_request_.longlink_items.end();
+             ++iter) {
+            for (size_t j = 0; j < iter->second.size(); ++j) {
+                SocketProbe* probe = new SocketProbe();
+                probe->profile.netcheck_type = kTcpCheck;
+                probe->profile.ip = iter->second[j].ip;
+                probe->profile.port = iter->second[j].port;
+                probe->profile.network_type = comm::getNetInfo();
+                socket_probes_.push_back(probe);
+            }
+        }
+    }
+}
+
+uint64_t DiagnosisEngine::__BudgetOf(uint64_t _default_ms, uint64_t _now) const {
+    if (0 == deadline_)
+        return _default_ms;
+    return _now < deadline_ ? std::min(_default_ms, deadline_ - _now) : 0;
+}
+
+void DiagnosisEngine::__RunSocketProbes() {
+    if (socket_probes_.empty())
+        return;
+
+    SocketPoll poll(breaker_, true);
+    uint64_t now = ::gettickcount();
+    for (size_t i = 0; i < socket_probes_.size(); ++i) {
+        __StartProbe(*socket_probes_[i], now);
+    }
+
+    while (true) {
+        {
+            ScopedLock lock(mutex_);
+            if (canceled_)
+                break;
+        }
+
+        now = ::gettickcount();
+        uint64_t next_tick = 0;
+        poll.ClearEvent();
+
+        for (size_t i = 0; i < socket_probes_.size(); ++i) {
+            SocketProbe& probe = *socket_probes_[i];
+            if (SocketProbe::kDone == probe.state)
+                continue;
+
+            uint64_t deadline = SocketProbe::kConnecting == probe.state ? probe.connect_deadline : probe.deadline;
+            if (deadline <= now) {
+                // data that came in before the budget ran out still counts, as in TcpQuery::tcp_receive
+                __Finish(probe, kTimeoutErr, now);
+                continue;
+            }
+
+            next_tick = 0 == next_tick ? deadline : std::min(next_tick, deadline);
+            bool reading = SocketProbe::kResolving == probe.state || SocketProbe::kReceiving == probe.state;
+            poll.AddEvent(probe.fd, reading, !reading, &probe);
+        }
+
+        if (0 == next_tick)
+            break;
+
+        int ret = poll.Poll((int)(next_tick - now));
+        if (0 > ret) {
+            xerror2(TSF "diagnosis poll error:%_", socket_strerror(poll.Errno()));
+            now = ::gettickcount();
+            for (size_t i = 0; i < socket_probes_.size(); ++i) {
+                if (SocketProbe::kDone != socket_probes_[i]->state)
+                    __Finish(*socket_probes_[i], kSelectErr, now);
+            }
+            break;
+        }
+
+        now = ::gettickcount();
+        const std::vector<PollEvent>& events = poll.TriggeredEvents();
+        for (size_t i = 0; i < events.size(); ++i) {
+            PollEvent event = events[i];
+            SocketProbe& probe = *(SocketProbe*)event.UserData();
+            __OnEvent(probe,
+                      event.Readable(),
+                      event.Writealbe(),
+                      event.Error() || event.HangUp() || event.Invalid(),
+                      now);
+        }
+    }
+}
+
+void DiagnosisEngine::__StartProbe(SocketProbe& _probe, uint64_t _now) {
+    _probe.start_tick = _now;
+
+    switch (_probe.profile.netcheck_type) {
+        case kDnsCheck: {
+            xinfo2(TSF "dns check host: %_", _probe.host);
+            _probe.deadline = _now + __BudgetOf(DEFAULT_DNS_TIMEOUT, _now);
+            if (!__StartResolve(_probe, _probe.host))
+                __Finish(_probe, -1, _now);
+            break;
+        }
+        case kHttpCheck: {
+            xinfo2(TSF "http check url: %_", _probe.profile.url);
+            _probe.deadline = _now + __BudgetOf(HTTP_DEFAULT_TIMEOUT, _now);
+            _probe.connect_deadline = _probe.deadline;
+
+            std::string request;
+            HttpQueryRequest(_probe.profile.url, request, _probe.host, _probe.port);
+            _probe.send_buf.Write(request.data(), request.size());
+
+            if (!socket_address(_probe.host.c_str(), 0).valid()) {
+                if (!__StartResolve(_probe, _probe.host))
+                    __Finish(_probe, -1, _now);
+            } else if (!__StartConnect(_probe, _probe.host, _probe.port)) {
+                __Finish(_probe, kConnectErr, _now);
+            }
+            break;
+        }
+        default: {
+            xinfo2(TSF "tcp check ip: %_, port: %_", _probe.profile.ip, _probe.profile.port);
+            _probe.connect_deadline = _now + __BudgetOf(DEFAULT_TCP_CONN_TIMEOUT, _now);
+            _probe.deadline = _now + __BudgetOf(DEFAULT_TCP_CONN_TIMEOUT + DEFAULT_TCP_RECV_TIMEOUT, _now);
+            TcpChecker::NoopReq(_probe.send_buf);
+            if (!__StartConnect(_probe, _probe.profile.ip, _probe.profile.port))
+                __Finish(_probe, kSndRcvErr, _now);
+            break;
+        }
+    }
+}
+
+bool DiagnosisEngine::__StartResolve(SocketProbe& _probe, const std::string& _host) {
+    std::string query;
+    struct sockaddr_in server;
+    if (!socket_dnsquery_prepare(_host.c_str(), NULL, query, server))
+        return false;
+
+    _probe.fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (INVALID_SOCKET == _probe.fd) {
+        xerror2(TSF "socket create error, socket_errno:%_", socket_strerror(socket_errno));
+        return false;
+    }
+
+    if (0 != socket_set_nobio(_probe.fd)) {
+        xerror2(TSF "nobio:%_", socket_strerror(socket_errno));
+        return false;
+    }
+
+    if (0 > sendto(_probe.fd, query.data(), query.size(), 0, (struct sockaddr*)&server, sizeof(server))) {
+        xerror2(TSF "send dns query of %_ error:%_", _host, socket_strerror(socket_errno));
+        return false;
+    }
+
+    _probe.query_len = query.size();
+    _probe.state = SocketProbe::kResolving;
+    return true;
+}
+
+bool DiagnosisEngine::__StartConnect(SocketProbe& _probe, const std::string& _ip, uint16_t _port) {
+    socket_address addr(_ip.c_str(), _port);
+    _probe.fd = socket(addr.address().sa_family, SOCK_STREAM, IPPROTO_TCP);
+    if (INVALID_SOCKET == _probe.fd) {
+        xerror2(TSF "socket create error, socket_errno:%_", socket_strerror(socket_errno));
+        return false;
+    }
+
+    if (0 != socket_set_nobio(_probe.fd)) {
+        xerror2(TSF "nobio:%_", socket_strerror(socket_errno));
+        return false;
+    }
+
+    if (0 != connect(_probe.fd, &addr.address(), addr.address_length()) && !IS_NOBLOCK_CONNECT_ERRNO(socket_errno)) {
+        xerror2(TSF "connect %_:%_ error, socket_errno:%_", _ip, _port, socket_strerror(socket_errno));
+        return false;
+    }
+
+    _probe.state = SocketProbe::kConnecting;
+    return true;
+}
+
+void DiagnosisEngine::__OnEvent(SocketProbe& _probe, bool _readable, bool _writable, bool _error, uint64_t _now) {
+    if (SocketProbe::kResolving == _probe.state) {
+        if (_readable || _error)
+            __OnResolved(_probe, _now);
+        return;
+    }
+
+    if (SocketProbe::kConnecting == _probe.state && (_writable || _error)) {
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (0 != getsockopt(_probe.fd, SOL_SOCKET, SO_ERROR, &error, &len) || 0 != error) {
+            xerror2(TSF "check connect %_:%_ error:%_", _probe.profile.ip, _probe.profile.port, error);
+            __Finish(_probe, kTcpCheck == _probe.profile.netcheck_type ? kSndRcvErr : kConnectErr, _now);
+            return;
+        }
+        if (kTcpCheck == _probe.profile.netcheck_type)
+            _probe.profile.conntime = _now - _probe.start_tick;
+        _probe.state = SocketProbe::kSending;
+    }
+
+    if (SocketProbe::kSending == _probe.state && _writable) {
+        int ret = (int)send(_probe.fd,
+                            (const char*)_probe.send_buf.Ptr(_probe.sent),
+                            _probe.send_buf.Length() - _probe.sent,
+                            0);
+        if (0 > ret && !IS_NOBLOCK_SEND_ERRNO(socket_errno)) {
+            xerror2(TSF "check send data error:%_", socket_strerror(socket_errno));
+            __Finish(_probe, kSndRcvErr, _now);
+            return;
+        }
+        _probe.sent += 0 < ret ? (size_t)ret : 0;
+        if (_probe.sent == _probe.send_buf.Length()) {
+            xinfo2(TSF "check send data success.");
+            _probe.state = SocketProbe::kReceiving;
+        }
+        return;
+    }
+
+    if (SocketProbe::kReceiving == _probe.state && (_readable || _error))
+        __OnReceived(_probe, _now);
+}
+
+void DiagnosisEngine::__OnResolved(SocketProbe& _probe, uint64_t _now) {
+    std::vector<unsigned char> reply(SOCKET_DNS_REPLY_MAX, 0);
+    int ret = (int)recvfrom(_probe.fd, (char*)&reply[0], reply.size(), 0, NULL, NULL);
+    if (0 > ret && IS_NOBLOCK_RECV_ERRNO(socket_errno))
+        return;
+
+    if (0 > ret) {
+        xerror2(TSF "receive dns reply of %_ error:%_", _probe.host, socket_strerror(socket_errno));
+        __Finish(_probe, -1, _now);
+        return;
+    }
+
+    struct socket_ipinfo_t ipinfo;
+    if (0 == ret || 0 != socket_dnsquery_parse(_probe.query_len, &reply[0], &ipinfo)) {
+        xerror2(TSF "resolve %_ no address", _probe.host);
+        __Finish(_probe, -1, _now);
+        return;
+    }
+
+    if (kDnsCheck == _probe.profile.netcheck_type) {
+        _probe.profile.ip1 = inet_ntoa(ipinfo.ip[0]);
+        if (2 <= ipinfo.size)
+            _probe.profile.ip2 = inet_ntoa(ipinfo.ip[1]);
+        __Finish(_probe, 0, _now);
+        return;
+    }
+
+    // http to a domain: on to its first address
+    socket_close(_probe.fd);
+    _probe.fd = INVALID_SOCKET;
+    if (!__StartConnect(_probe, socket_address(ipinfo.ip[0]).ip(), _probe.port))
+        __Finish(_probe, kConnectErr, _now);
+}
+
+void DiagnosisEngine::__OnReceived(SocketProbe& _probe, uint64_t _now) {
+    bool is_tcp = kTcpCheck == _probe.profile.netcheck_type;
+    if (is_tcp)
+        _probe.recv_buf.AddCapacity(kTcpRecvSize);
+    else if (0 == _probe.recv_buf.Capacity())
+        _probe.recv_buf.AddCapacity(kHttpRecvSize);
+
+    size_t room = is_tcp ? _probe.recv_buf.Capacity() - _probe.recv_buf.Length()
+                         : kHttpRecvSize - _probe.recv_buf.Length();
+    int ret = (int)recv(_probe.fd, (char*)_probe.recv_buf.Ptr(_probe.recv_buf.Length()), room, 0);
+    if (0 > ret && IS_NOBLOCK_RECV_ERRNO(socket_errno))
+        return;
+
+    if (0 >= ret) {
+        // closed or failed: whatever arrived before decides
+        if (is_tcp)
+            __Finish(_probe, 0 == _probe.recv_buf.Length() ? kSndRcvErr : kTimeoutErr, _now);
+        else
+            __Finish(_probe, 0 == _probe.recv_buf.Length() ? kSelectErr : 0, _now);
+        return;
+    }
+    _probe.recv_buf.Length(0, _probe.recv_buf.Length() + ret);
+
+    if (!is_tcp) {
+        // the status line is all the http probe reports
+        if (kHttpRecvSize <= _probe.recv_buf.Length()
+            || 0 != HttpQueryStatusCode(_probe.recv_buf.Ptr(), _probe.recv_buf.Length()))
+            __Finish(_probe, 0, _now);
+        return;
+    }
+
+    uint32_t cmdid = 0, seq = 0;
+    size_t packlen = 0;
+    AutoBuffer body;
+    if (TcpChecker::NoopResp(_probe.recv_buf, cmdid, seq, packlen, body))
+        __Finish(_probe, 0, _now);
+    else if (kTcpRecvSize <= _probe.recv_buf.Length())
+        __Finish(_probe, kTimeoutErr, _now);
+}
+
+void DiagnosisEngine::__Finish(SocketProbe& _probe, int _error_code, uint64_t _now) {
+    CheckResultProfile& profile = _probe.profile;
+
+    switch (profile.netcheck_type) {
+        case kDnsCheck: {
+            // socket_gethostbyname knows no failure but -1
+            profile.error_code = 0 == _error_code ? 0 : -1;
+            profile.rtt = _now - _probe.start_tick;
+            xinfo2(TSF "%_, check dns, host: %_, ret: %_",
+                   NET_CHECK_TAG,
+                   profile.domain_name,
+                   0 == profile.error_code ? CHECK_SUC : CHECK_FAIL);
+            break;
+        }
+        case kHttpCheck: {
+            if (kTimeoutErr == _error_code && 0 < _probe.recv_buf.Length())
+                _error_code = 0;
+            else if (kTimeoutErr == _error_code && SocketProbe::kSending > _probe.state)
+                _error_code = -1;  // not connected in time, as SendHttpQuery reports it
+            profile.error_code = _error_code;
+            profile.rtt = _now - _probe.start_tick;
+            if (0 < _probe.recv_buf.Length())
+                profile.status_code = HttpQueryStatusCode(_probe.recv_buf.Ptr(), _probe.recv_buf.Length());
+            xinfo2(TSF "http check, host: %_, ret: %_, status: %_",
+                   profile.url,
+                   profile.error_code,
+                   profile.status_code);
+            break;
+        }
+        default:
+            __FinishTcp(_probe, _error_code, _now);
+            break;
+    }
+
+    _probe.state = SocketProbe::kDone;
+    if (INVALID_SOCKET != _probe.fd) {
+        socket_close(_probe.fd);
+        _probe.fd = INVALID_SOCKET;
+    }
+
+    __OnResult(profile);
+}
+
+void DiagnosisEngine::__FinishTcp(SocketProbe& _probe, int _error_code, uint64_t _now) {
+    CheckResultProfile& profile = _probe.profile;
+
+    if (0 == _error_code) {
+        profile.rtt = _now - _probe.start_tick;
+    } else if (kTimeoutErr == _error_code && 0 < _probe.recv_buf.Length()) {
+        uint32_t cmdid = 0, seq = 0;
+        size_t packlen = 0;
+        AutoBuffer body;
+        profile.rtt = _now - _probe.start_tick;
+        if (!TcpChecker::NoopResp(_probe.recv_buf, cmdid, seq, packlen, body))  // not noop resp
+            profile.error_code = kTcpRespErr;
+    } else {
+        xerror2(TSF "tcp check %_:%_ failed:%_", profile.ip, profile.port, _error_code);
+        profile.error_code = kSndRcvErr;
+    }
+}
+
+void DiagnosisEngine::__RunPing(const PingProbe& _probe) {
+    {
+        ScopedLock lock(mutex_);
+        if (canceled_)
+            return;
+    }
+
+    uint64_t budget = __BudgetOf(DEFAULT_PING_TIMEOUT * 1000, ::gettickcount());
+    CheckResultProfile profile;
+    if (1000 > budget) {
+        profile.netcheck_type = kPingCheck;
+        profile.ip = _probe.host;
+        profile.error_code = kTimeoutErr;
+    } else {
+        profile = PingChecker::PingHost(_probe.host, (int)(budget / 1000));
+    }
+
+    __OnResult(profile);
+}
+
+void DiagnosisEngine::__OnResult(const CheckResultProfile& _profile) {
+    {
+        ScopedLock lock(mutex_);
+        if (canceled_)
+            return;
+
+        check_request_.checkresult_profiles.push_back(_profile);
+        // the checkers ran one after another and stopped at the first failure, so a failure sticks
+        if (0 != _profile.error_code)
+            check_request_.check_status = kCheckFinish;
+    }
+
+    // unlocked, the callback may Cancel()
+    if (on_result_)
+        on_result_(_profile);
+
+    ScopedLock lock(mutex_);
+    --pending_;
+    cond_.notifyAll();
+}
+
+}  // namespace sdt
+}  // namespace mars
@@ -0,0 +1,107 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * diagnosis_engine.h
+ *
+ * Runs all probes of a check request at the same time. Tcp, dns and http probes are non-blocking
+ * sockets on one poll reactor, the thread calling Run(); an http probe to a domain resolves it over
+ * udp on the same reactor first. Ping only has blocking implementations (popen, raw icmp), each ping
+ * probe is a job on comm::Executor::Blocking(). Every probe has its own budget, clamped to the deadline
+ * of the whole request; a ping whose job starts after the deadline is reported as timed out without running.
+ *
+ * check_status turns kCheckFinish on the first failed probe and stays there, whatever comes after.
+ */
+
+#ifndef SDT_SRC_DIAGNOSIS_ENGINE_H_
+#define SDT_SRC_DIAGNOSIS_ENGINE_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/executor.h"
+#include "mars/comm/socket/socketbreaker.h"
+#include "mars/comm/socket/unix_socket.h"
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/mutex.h"
+#include "mars/sdt/netchecker_profile.h"
+
+namespace mars {
+namespace sdt {
+
+class DiagnosisEngine {
+ public:
+    // called on the reactor or an executor worker as soon as a probe finishes, in completion order, without a lock held
+    typedef std::function<void(const CheckResultProfile&)> ResultCallback;
+
+ public:
+    DiagnosisEngine(CheckRequestProfile& _check_request, const ResultCallback& _on_result);
+    ~DiagnosisEngine();
+
+    /*
+     * blocks until every probe has its result, the request deadline passed or Cancel() was called.
+     * results are appended to checkresult_profiles of the request as they come in.
+     */
+    void Run();
+    void Cancel();
+
+ private:
+    struct SocketProbe;
+    struct PingProbe;
+
+    void __CollectProbes();
+    uint64_t __BudgetOf(uint64_t _default_ms, uint64_t _now) const;
+
+    void __RunSocketProbes();
+    void __StartProbe(SocketProbe& _probe, uint64_t _now);
+    bool __StartResolve(SocketProbe& _probe, const std::string& _host);
+    bool __StartConnect(SocketProbe& _probe, const std::string& _ip, uint16_t _port);
+    void __OnEvent(SocketProbe& _probe, bool _readable, bool _writable, bool _error, uint64_t _now);
+    void __OnResolved(SocketProbe& _probe, uint64_t _now);
+    void __OnReceived(SocketProbe& _probe, uint64_t _now);
+    void __Finish(SocketProbe& _probe, int _error_code, uint64_t _now);
+    void __FinishTcp(SocketProbe& _probe, int _error_code, uint64_t _now);
+
+    void __RunPing(const PingProbe& _probe);
+    void __OnResult(const CheckResultProfile& _profile);
+
+ private:
+    DiagnosisEngine(const DiagnosisEngine&);
+    DiagnosisEngine& operator=(const DiagnosisEngine&);
+
+ private:
+    CheckRequestProfile& check_request_;
+    ResultCallback on_result_;
+
+    uint64_t start_tick_;
+    uint64_t deadline_;  // 0: none, the probe budgets bound the check
+
+    std::vector<SocketProbe*> socket_probes_;
+    std::vector<PingProbe> ping_probes_;
+    std::vector<comm::ExecutorJobPtr> ping_jobs_;
+
+    comm::SocketBreaker breaker_;
+    comm::Mutex mutex_;
+    comm::Condition cond_;
+    size_t pending_;
+    bool canceled_;
+};
+
+}  // namespace sdt
+}  // namespace mars
+
+#endif  // SDT_SRC_DIAGNOSIS_ENGINE_H_
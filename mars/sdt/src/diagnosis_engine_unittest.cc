@@ -0,0 +1,176 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * diagnosis_engine_unittest.cc
+ *
+ * Tcp probes against silent loopback servers: all of them time out at the request deadline,
+ * each result is streamed before Run() returns, and the callback may cancel.
+ * An http probe against a loopback server gets its status line on the same reactor.
+ */
+
+#include <string>
+#include <vector>
+
+#include "diagnosis_engine.h"
+#include "gtest/gtest.h"
+#include "mars/comm/time_utils.h"
+#include "mars/sdt/constants.h"
+
+using namespace mars::sdt;
+
+static SOCKET ListenLoopback(uint16_t& _port) {
+    struct sockaddr_in addr;
+    bzero(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    SOCKET fd = socket(AF_INET, SOCK_STREAM, 0);
+    bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    listen(fd, 4);
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    return fd;
+}
+
+TEST(diagnosis_engine, probes_share_the_deadline) {
+    const int kServers = 4;
+    const uint32_t kTimeout = 1000;
+
+    std::vector<SOCKET> servers;
+    CheckRequestProfile request;
+    request.mode = NET_CHECK_LONG;
+    request.total_timeout = kTimeout;
+    for (int i = 0; i < kServers; ++i) {
+        uint16_t port = 0;
+        servers.push_back(ListenLoopback(port));
+        request.longlink_items["long.weixin.qq.com"].push_back(CheckIPPort("127.0.0.1", port));
+    }
+
+    size_t streamed = 0;
+    DiagnosisEngine engine(request, [&streamed](const CheckResultProfile& _result) {
+        EXPECT_EQ(kTcpCheck, _result.netcheck_type);
+        ++streamed;
+    });
+
+    engine.Run();
+
+    // the servers accept but never answer the noop: every probe runs into the deadline
+    EXPECT_EQ((size_t)kServers, streamed);
+    ASSERT_EQ((size_t)kServers, request.checkresult_profiles.size());
+    for (size_t i = 0; i < request.checkresult_profiles.size(); ++i) {
+        EXPECT_EQ(kSndRcvErr, request.checkresult_profiles[i].error_code);
+    }
+    EXPECT_EQ(kCheckFinish, request.check_status);
+
+    for (size_t i = 0; i < servers.size(); ++i) {
+        socket_close(servers[i]);
+    }
+}
+
+TEST(diagnosis_engine, http_probe_on_the_reactor) {
+    uint16_t port = 0;
+    SOCKET server = ListenLoopback(port);
+
+    std::string request_line;
+    mars::comm::Thread responder([server, &request_line]() {
+        SOCKET fd = accept(server, NULL, NULL);
+        std::string request;
+        char buf[1024];
+        while (std::string::npos == request.find("\r\n\r\n")) {
+            ssize_t len = recv(fd, buf, sizeof(buf), 0);
+            if (0 >= len)
+                break;
+            request.append(buf, len);
+        }
+        request_line = request.substr(0, request.find("\r\n"));
+
+        const char kResponse[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+        send(fd, kResponse, sizeof(kResponse) - 1, 0);
+        // kept open: the probe must stop at the end of the headers, not wait for the close
+        recv(fd, buf, sizeof(buf), 0);
+        socket_close(fd);
+    });
+    responder.start();
+
+    CheckRequestProfile request;
+    request.mode = NET_CHECK_SHORT;
+    request.total_timeout = 5000;
+    request.netcheck_cgi = "/netcheck";
+    request.shortlink_items["127.0.0.1:" + std::to_string(port)].push_back(CheckIPPort("127.0.0.1", port));
+
+    DiagnosisEngine engine(request, nullptr);
+    uint64_t start = ::gettickcount();
+    engine.Run();
+
+    ASSERT_EQ(1u, request.checkresult_profiles.size());
+    const CheckResultProfile& result = request.checkresult_profiles[0];
+    EXPECT_EQ(kHttpCheck, result.netcheck_type);
+    EXPECT_EQ(0, result.error_code);
+    EXPECT_EQ(200, result.status_code);
+    EXPECT_EQ("http://127.0.0.1:" + std::to_string(port) + "/netcheck", result.url);
+    EXPECT_EQ("GET /netcheck HTTP/1.1", request_line);
+    EXPECT_GT(2000u, ::gettickcount() - start);
+    EXPECT_EQ(kCheckContinue, request.check_status);
+
+    responder.join();
+    socket_close(server);
+}
+
+TEST(diagnosis_engine, cancel_returns_early) {
+    uint16_t port = 0;
+    SOCKET server = ListenLoopback(port);
+
+    CheckRequestProfile request;
+    request.mode = NET_CHECK_LONG;
+    request.total_timeout = 5000;
+    request.longlink_items["long.weixin.qq.com"].push_back(CheckIPPort("127.0.0.1", port));
+
+    DiagnosisEngine engine(request, nullptr);
+    mars::comm::Thread canceler([&engine]() {
+        usleep(100 * 1000);
+        engine.Cancel();
+    });
+    canceler.start();
+
+    engine.Run();
+    // the probe would only have had its result at the deadline
+    EXPECT_TRUE(request.checkresult_profiles.empty());
+
+    canceler.join();
+    socket_close(server);
+}
+
+TEST(diagnosis_engine, cancel_from_the_callback) {
+    std::vector<SOCKET> servers;
+    CheckRequestProfile request;
+    request.mode = NET_CHECK_LONG;
+    request.total_timeout = 200;
+    for (int i = 0; i < 2; ++i) {
+        uint16_t port = 0;
+        servers.push_back(ListenLoopback(port));
+        request.longlink_items["long.weixin.qq.com"].push_back(CheckIPPort("127.0.0.1", port));
+    }
+
+    DiagnosisEngine* engine = NULL;
+    DiagnosisEngine canceling(request, [&engine](const CheckResultProfile& _result) {
+        engine->Cancel();
+    });
+    engine = &canceling;
+    canceling.Run();
+    // the result that canceled is kept, the one after it dropped
+    EXPECT_EQ(1u, request.checkresult_profiles.size());
+
+    for (size_t i = 0; i < servers.size(); ++i) {
+        socket_close(servers[i]);
+    }
+}
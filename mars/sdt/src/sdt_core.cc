@@ -21,11 +21,8 @@
 
 #include <algorithm>
 
-#include "activecheck/dnschecker.h"
-#include "activecheck/httpchecker.h"
-#include "activecheck/pingchecker.h"
-#include "activecheck/tcpchecker.h"
 #include "boost/bind.hpp"
+#include "diagnosis_engine.h"
 #include "mars/comm/messagequeue/message_queue.h"
 #include "mars/comm/singleton.h"
 #include "mars/comm/thread/lock.h"
@@ -41,7 +38,7 @@ using namespace mars::boot;
 SdtCore::SdtCore(Context* context)
 : context_(context)
 , thread_(boost::bind(&SdtCore::__RunOn, this))
-, check_list_(std::list<BaseChecker*>())
+, engine_(NULL)
 , cancel_(false)
 , checking_(false) {
     xinfo_function();
@@ -81,23 +78,9 @@ void SdtCore::__InitCheckReq(CheckIPPorts& _longlink_items, CheckIPPorts& _short
     check_request_.mode = _mode;
     check_request_.total_timeout = _timeout;
 
-    if (MODE_BASIC(_mode)) {
-        PingChecker* ping_checker = new PingChecker();
-        check_list_.push_back(ping_checker);
-        DnsChecker* dns_checker = new DnsChecker();
-        check_list_.push_back(dns_checker);
-    }
-
     if (MODE_SHORT(_mode)) {
         check_request_.shortlink_items.insert(_shortlink_items.begin(), _shortlink_items.end());
-        HttpChecker* http_checker = new HttpChecker();
-        http_checker->SetHttpNetcheckCGI(netcheck_cgi_);
-        check_list_.push_back(http_checker);
-    }
-
-    if (MODE_LONG(_mode)) {
-        TcpChecker* tcp_checker = new TcpChecker();
-        check_list_.push_back(tcp_checker);
+        check_request_.netcheck_cgi = netcheck_cgi_;
     }
 }
 
@@ -106,39 +89,46 @@ void SdtCore::__Reset() {
 
     // check_request_.report
 
-    std::list<BaseChecker*>::iterator iter = check_list_.begin();
-
-    for (; iter != check_list_.end();) {
-        if (NULL != (*iter)) {
-            delete (*iter);
-            (*iter) = NULL;
-        }
-
-        iter = check_list_.erase(iter);
-    }
-
     checking_ = false;
 }
 
 void SdtCore::__RunOn() {
     xinfo_function();
 
-    for (std::list<BaseChecker*>::iterator iter = check_list_.begin(); iter != check_list_.end(); ++iter) {
-        if (cancel_ || check_request_.check_status == kCheckFinish)
-            break;
+    // every probe at once, the check takes about as long as its slowest probe
+    DiagnosisEngine engine(check_request_, boost::bind(&SdtCore::__OnCheckResult, this, _1));
+    {
+        comm::ScopedLock lock(checking_mutex_);
+        engine_ = &engine;
+        if (cancel_)
+            engine.Cancel();
+    }
+
+    engine.Run();
 
-        (*iter)->StartDoCheck(check_request_);
+    {
+        comm::ScopedLock lock(checking_mutex_);
+        engine_ = NULL;
     }
 
-    xinfo2(TSF "all checkers end! cancel_=%_, check_request_.check_status_=%_, check_list__size=%_",
+    xinfo2(TSF "all checkers end! cancel_=%_, check_request_.check_status_=%_, results=%_",
            cancel_,
            check_request_.check_status,
-           check_list_.size());
+           check_request_.checkresult_profiles.size());
 
     __DumpCheckResult();
     __Reset();
 }
 
+void SdtCore::__OnCheckResult(const CheckResultProfile& _result) {
+    SdtManager* sdt_manager = context_->GetManager<SdtManager>();
+    if (NULL == sdt_manager) {
+        xwarn2(TSF "sdt manager gone, result of type:%_ dropped", _result.netcheck_type);
+        return;
+    }
+    sdt_manager->ReportNetCheckPartialResult(_result);
+}
+
 void SdtCore::__DumpCheckResult() {
     std::vector<CheckResultProfile>::iterator iter = check_request_.checkresult_profiles.begin();
     for (; iter != check_request_.checkresult_profiles.end(); ++iter) {
@@ -179,15 +169,20 @@ void SdtCore::__DumpCheckResult() {
         }
     }
     // ReportNetCheckResult(check_request_.checkresult_profiles);
-    context_->GetManager<SdtManager>()->ReportNetCheckResult(check_request_.checkresult_profiles);
+    SdtManager* sdt_manager = context_->GetManager<SdtManager>();
+    if (NULL == sdt_manager) {
+        xwarn2(TSF "sdt manager gone, %_ results dropped", check_request_.checkresult_profiles.size());
+        return;
+    }
+    sdt_manager->ReportNetCheckResult(check_request_.checkresult_profiles);
 }
 
 void SdtCore::CancelCheck() {
     xinfo_function();
+    comm::ScopedLock lock(checking_mutex_);
     cancel_ = true;
-    for (std::list<BaseChecker*>::iterator iter = check_list_.begin(); iter != check_list_.end(); ++iter) {
-        (*iter)->CancelDoCheck();
-    }
+    if (engine_)
+        engine_->Cancel();
 }
 
 void SdtCore::CancelAndWait() {
@@ -197,5 +192,7 @@ void SdtCore::CancelAndWait() {
 }
 
 void SdtCore::SetHttpNetcheckCGI(std::string cgi) {
+    // read by __InitCheckReq under the same lock, a running check keeps the cgi it started with
+    comm::ScopedLock lock(checking_mutex_);
     netcheck_cgi_ = cgi;
 }
@@ -35,7 +35,7 @@
 namespace mars {
 namespace sdt {
 
-class BaseChecker;
+class DiagnosisEngine;
 
 class SdtCore {
  public:
@@ -60,6 +60,7 @@ class SdtCore {
     // Run on.
     void __RunOn();
 
+    void __OnCheckResult(const CheckResultProfile& _result);
     void __DumpCheckResult();
 
  public:
@@ -70,7 +71,7 @@ class SdtCore {
     //  MessageQueue::ScopeRegister     async_reg_;
     comm::Thread thread_;
 
-    std::list<BaseChecker*> check_list_;
+    DiagnosisEngine* engine_;
 
     CheckRequestProfile check_request_;
     volatile bool cancel_;
@@ -22,6 +22,8 @@
 #ifndef stn_config_h
 #define stn_config_h
 
+#include "mars/app/app_config.h"
+
 // if do not use newdns IP, comment the macro
 #define USE_LONG_LINK
 // task attribute max value
@@ -110,43 +112,68 @@ const static unsigned int kShortlinkConnInterval = 2.5 * 1000;
 #ifdef ANDROID
 const static char* const kKeyShortLinkWakeupLockEmptyCMD = "ShortLinkEmptyCMD";
 const static unsigned int kShortLinkWakeupLockEmptyCMD = 500;
+const static mars::app::ConfigKey<int> kConfigShortLinkWakeupLockEmptyCMD(
+    kKeyShortLinkWakeupLockEmptyCMD, kShortLinkWakeupLockEmptyCMD);
 
 const static char* const kKeyShortLinkWakeupLockRunCMD = "ShortLinkRunCMD";
 const static unsigned int kShortLinkWakeupLockRunCMD = 60 * 1000;
+const static mars::app::ConfigKey<int> kConfigShortLinkWakeupLockRunCMD(
+    kKeyShortLinkWakeupLockRunCMD, kShortLinkWakeupLockRunCMD);
 
 const static char* const kKeyLongLinkWakeupLockEmptyCMD = "LongLinkEmptyCMD";
 const static unsigned int kLongLinkWakeupLockEmptyCMD = 500;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockEmptyCMD(
+    kKeyLongLinkWakeupLockEmptyCMD, kLongLinkWakeupLockEmptyCMD);
 
 const static char* const kKeyLongLinkWakeupLockRunCMD = "LongLinkRunCMD";
 const static unsigned int kLongLinkWakeupLockRunCMD = 30 * 1000;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockRunCMD(
+    kKeyLongLinkWakeupLockRunCMD, kLongLinkWakeupLockRunCMD);
 
 const static char* const kKeyLongLinkWakeupLockOnAlarm = "LongLinkOnAlarm";
 const static unsigned int kLongLinkWakeupLockOnAlarm = 3 * 1000;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockOnAlarm(
+    kKeyLongLinkWakeupLockOnAlarm, kLongLinkWakeupLockOnAlarm);
 
 const static char* const kKeyLongLinkWakeupLockBeforeConnection = "LongLinkBeforeConnection";
 const static unsigned int kLongLinkWakeupLockBeforeConnection = 40 * 1000;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockBeforeConnection(
+    kKeyLongLinkWakeupLockBeforeConnection, kLongLinkWakeupLockBeforeConnection);
 
 const static char* const kKeyLongLinkWakeupLockAfterConnection = "LongLinkAfterConnection";
 const static unsigned int kLongLinkWakeupLockAfterConnection = 1000;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockAfterConnection(
+    kKeyLongLinkWakeupLockAfterConnection, kLongLinkWakeupLockAfterConnection);
 
 const static char* const kKeyLongLinkWakeupLockAfterReadWrite = "LongLinkAfterReadWrite";
 const static unsigned int kLongLinkWakeupLockAfterReadWrite = 1000;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockAfterReadWrite(
+    kKeyLongLinkWakeupLockAfterReadWrite, kLongLinkWakeupLockAfterReadWrite);
 
 const static char* const kKeyLongLinkWakeupLockNoopResp = "LongLinkNoopResp";
 const static unsigned int kLongLinkWakeupLockNoopResp = 500;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockNoopResp(
+    kKeyLongLinkWakeupLockNoopResp, kLongLinkWakeupLockNoopResp);
 
 const static char* const kKeyLongLinkWakeupLockNoopReq = "LongLinkNoopReq";
 const static unsigned int kLongLinkWakeupLockNoopReq = 8 * 1000;
+const static mars::app::ConfigKey<int> kConfigLongLinkWakeupLockNoopReq(
+    kKeyLongLinkWakeupLockNoopReq, kLongLinkWakeupLockNoopReq);
 
 const static char* const kKeyShortLinkWakeupLockBefroeCMD = "ShortLinkBefroeCMD";
 const static unsigned int kShortLinkWakeupLockBefroeCMD = 500;
+const static mars::app::ConfigKey<int> kConfigShortLinkWakeupLockBefroeCMD(
+    kKeyShortLinkWakeupLockBefroeCMD, kShortLinkWakeupLockBefroeCMD);
 
 const static char* const kKeyShortLinkWakeupLockNewDns = "ShortLinkNewDns";
 const static unsigned int kShortLinkWakeupLockNewDns = 5 * 1000;
+const static mars::app::ConfigKey<int> kConfigShortLinkWakeupLockNewDns(
+    kKeyShortLinkWakeupLockNewDns, kShortLinkWakeupLockNewDns);
 
 #endif
 
 // shortlink_task_manager
 const static char* const kKeyIsHandleReqRespBuffInWorker = "IsHandleReqRespBuffInWorker";
+const static mars::app::ConfigKey<bool> kConfigIsHandleReqRespBuffInWorker(kKeyIsHandleReqRespBuffInWorker, false);
 
 #endif /* stn_config_h */
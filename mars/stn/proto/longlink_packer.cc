@@ -29,6 +29,7 @@
 #include "mars/comm/xlogger/xlogger.h"
 #endif
 #include "mars/comm/autobuffer.h"
+#include "mars/stn/src/packet_compressor.h"
 #include "mars/stn/stn.h"
 
 static uint32_t sg_client_version = 0;
@@ -41,15 +42,42 @@ struct __STNetMsgXpHeader {
     uint32_t seq;
     uint32_t body_length;
 };
+
+// follows the header when the body is compressed, head_length covers it
+struct __STNetMsgXpCompression {
+    uint32_t algorithm;
+    uint32_t dict_id;  // 0: no dictionary
+};
 #pragma pack(pop)
 
+#define COMPRESSION_ZSTD (0x7a737464)  // "zstd"
+
 namespace mars {
 namespace stn {
 
 LongLinkEncoder gDefaultLongLinkEncoder;
 
-longlink_tracker* (*longlink_tracker::Create)() = []() {
-    return new longlink_tracker;
+namespace {
+// what Create makes by default: the compression contexts reused for every packet on its connection
+class compressing_tracker : public longlink_tracker {
+ public:
+    PacketCompressor* Compressor() override {
+        return &compressor_;
+    }
+
+ private:
+    PacketCompressor compressor_;
+};
+}  // namespace
+
+// a tracker the app made itself compresses with the contexts of the thread
+static PacketCompressor& __CompressorOf(longlink_tracker* _tracker) {
+    PacketCompressor* compressor = NULL != _tracker ? _tracker->Compressor() : NULL;
+    return NULL != compressor ? *compressor : PacketCompressor::ThreadLocal();
+}
+
+longlink_tracker* (*longlink_tracker::Create)() = []() -> longlink_tracker* {
+    return new compressing_tracker;
 };
 
 void SetClientVersion(uint32_t _client_version) {
@@ -109,18 +137,30 @@ LongLinkEncoder::LongLinkEncoder() {
                        const AutoBuffer& _extension,
                        AutoBuffer& _packed,
                        longlink_tracker* _tracker) {
+        PacketCompressor& compressor = __CompressorOf(_tracker);
+        AutoBuffer compressed;
+        __STNetMsgXpCompression ext = {0};
+        bool is_compressed = compressor.Compress(_cmdid, _body, compressed, ext.dict_id);
+        const AutoBuffer& body = is_compressed ? compressed : _body;
+        size_t head_len = sizeof(__STNetMsgXpHeader) + (is_compressed ? sizeof(ext) : 0);
+
         __STNetMsgXpHeader st = {0};
-        st.head_length = htonl(sizeof(__STNetMsgXpHeader));
+        st.head_length = htonl(head_len);
         st.client_version = htonl(sg_client_version);
         st.cmdid = htonl(_cmdid);
         st.seq = htonl(_seq);
-        st.body_length = htonl(_body.Length());
+        st.body_length = htonl(body.Length());
 
-        _packed.AllocWrite(sizeof(__STNetMsgXpHeader) + _body.Length());
+        _packed.AllocWrite(head_len + body.Length());
         _packed.Write(&st, sizeof(st));
+        if (is_compressed) {
+            ext.algorithm = htonl(COMPRESSION_ZSTD);
+            ext.dict_id = htonl(ext.dict_id);
+            _packed.Write(&ext, sizeof(ext));
+        }
 
-        if (NULL != _body.Ptr())
-            _packed.Write(_body.Ptr(), _body.Length());
+        if (NULL != body.Ptr())
+            _packed.Write(body.Ptr(), body.Length());
 
         _packed.Seek(0, AutoBuffer::ESeekStart);
     };
@@ -138,7 +178,21 @@ LongLinkEncoder::LongLinkEncoder() {
         if (LONGLINK_UNPACK_OK != ret)
             return ret;
 
-        _body.Write(AutoBuffer::ESeekCur, _packed.Ptr(_package_len - body_len), body_len);
+        size_t head_len = _package_len - body_len;
+        __STNetMsgXpCompression ext = {0};
+        if (head_len >= sizeof(__STNetMsgXpHeader) + sizeof(ext))
+            memcpy(&ext, _packed.Ptr(sizeof(__STNetMsgXpHeader)), sizeof(ext));
+
+        if (COMPRESSION_ZSTD != ntohl(ext.algorithm)) {
+            _body.Write(AutoBuffer::ESeekCur, _packed.Ptr(head_len), body_len);
+            return ret;
+        }
+
+        PacketCompressor& compressor = __CompressorOf(_tracker);
+        if (!compressor.Decompress(ntohl(ext.dict_id), _packed.Ptr(head_len), body_len, _body)) {
+            xerror2(TSF "decompress cmdid:%_, seq:%_ failed, len:%_", _cmdid, _seq, body_len);
+            return LONGLINK_UNPACK_FALSE;
+        }
 
         return ret;
     };
@@ -42,12 +42,19 @@ class AutoBuffer;
 namespace mars {
 namespace stn {
 
+class PacketCompressor;
+
 class longlink_tracker {
  public:
     static longlink_tracker* (*Create)();
 
  public:
     virtual ~longlink_tracker(){};
+
+    // the compression contexts kept for this connection, NULL to use the ones of the thread
+    virtual PacketCompressor* Compressor() {
+        return NULL;
+    }
 };
 
 class LongLinkEncoder {
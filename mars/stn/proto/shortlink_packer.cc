@@ -29,17 +29,10 @@ shortlink_tracker* (*shortlink_tracker::Create)() = []() {
     return new shortlink_tracker;
 };
 
-void (*shortlink_pack)(const std::string& _url,
-                       const std::map<std::string, std::string>& _headers,
-                       const AutoBuffer& _body,
-                       const AutoBuffer& _extension,
-                       AutoBuffer& _out_buff,
-                       shortlink_tracker* _tracker) = [](const std::string& _url,
-                                                         const std::map<std::string, std::string>& _headers,
-                                                         const AutoBuffer& _body,
-                                                         const AutoBuffer& _extension,
-                                                         AutoBuffer& _out_buff,
-                                                         shortlink_tracker* _tracker) {
+static void __PackHeader(const std::string& _url,
+                         const std::map<std::string, std::string>& _headers,
+                         const AutoBuffer& _body,
+                         AutoBuffer& _out_buff) {
     Builder req_builder(kRequest);
     req_builder.Request().Method(RequestLine::kPost);
     req_builder.Request().Version(kVersion_1_1);
@@ -60,8 +53,36 @@ void (*shortlink_pack)(const std::string& _url,
 
     req_builder.Request().Url(_url);
     req_builder.HeaderToBuffer(_out_buff);
+}
+
+static void __Pack(const std::string& _url,
+                   const std::map<std::string, std::string>& _headers,
+                   const AutoBuffer& _body,
+                   const AutoBuffer& _extension,
+                   AutoBuffer& _out_buff,
+                   shortlink_tracker* _tracker) {
+    __PackHeader(_url, _headers, _body, _out_buff);
     _out_buff.Write(_body.Ptr(), _body.Length());
-};
+}
+
+void (*shortlink_pack)(const std::string& _url,
+                       const std::map<std::string, std::string>& _headers,
+                       const AutoBuffer& _body,
+                       const AutoBuffer& _extension,
+                       AutoBuffer& _out_buff,
+                       shortlink_tracker* _tracker) = &__Pack;
+
+bool shortlink_pack_header(const std::string& _url,
+                           const std::map<std::string, std::string>& _headers,
+                           const AutoBuffer& _body,
+                           const AutoBuffer& _extension,
+                           AutoBuffer& _out_header,
+                           shortlink_tracker* _tracker) {
+    if (shortlink_pack != &__Pack)
+        return false;
+    __PackHeader(_url, _headers, _body, _out_header);
+    return true;
+}
 
 }  // namespace stn
 }  // namespace mars
@@ -43,6 +43,17 @@ extern void (*shortlink_pack)(const std::string& _url,
                               AutoBuffer& _out_buff,
                               shortlink_tracker* _tracker);
 
+/**
+ * What shortlink_pack would write before the body, so that the body can be sent from where it is.
+ * Returns false when shortlink_pack has been replaced: its output is opaque then and has to be sent whole.
+ */
+extern bool shortlink_pack_header(const std::string& _url,
+                                  const std::map<std::string, std::string>& _headers,
+                                  const AutoBuffer& _body,
+                                  const AutoBuffer& _extension,
+                                  AutoBuffer& _out_header,
+                                  shortlink_tracker* _tracker);
+
 }  // namespace stn
 }  // namespace mars
 
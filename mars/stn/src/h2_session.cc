@@ -0,0 +1,986 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * h2_session.cc
+ */
+
+#include "h2_session.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "boost/bind.hpp"
+#include "mars/comm/socket/block_socket.h"
+#include "mars/comm/socket/unix_socket.h"
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::comm;
+
+namespace mars {
+namespace stn {
+
+namespace {
+
+static const size_t kReadSize = 64 * 1024;
+static const int kSelectTimeout = 1000;  // ms, how often an idle connection is looked at
+static const uint32_t kLastStreamId = 0x7fffffff;
+
+static std::string __Hex(size_t _value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%zx", _value);
+    return buf;
+}
+
+static bool __IsHopByHop(const std::string& _name) {
+    return "connection" == _name || "keep-alive" == _name || "proxy-connection" == _name
+           || "transfer-encoding" == _name || "upgrade" == _name;
+}
+
+}  // namespace
+
+H2Session::Stream::Stream()
+: send_window(http2::kDefaultWindowSize)
+, recv_window(H2Session::kStreamWindow)
+, unacked(0)
+, uncredited(0)
+, headers_done(false)
+, local_closed(false)
+, remote_closed(false)
+, chunked(false)
+, error(0)
+, pending_pos(0) {
+}
+
+H2Session::H2Session(SOCKET _socket, const std::string& _destination)
+: socket_(_socket)
+, destination_(_destination)
+, thread_(boost::bind(&H2Session::__RunRead, this), "h2.read")
+, write_thread_(boost::bind(&H2Session::__RunWrite, this), "h2.write")
+, next_stream_id_(1)
+, reserved_(0)
+, alive_(true)
+, going_away_(false)
+, error_(0)
+, idle_since_(gettickcount())
+, peer_max_streams_(kDefaultMaxStreams)
+, peer_initial_window_(http2::kDefaultWindowSize)
+, peer_max_frame_(http2::kDefaultMaxFrameSize)
+, peer_table_size_(http2::kDefaultHeaderTableSize)
+, table_size_changed_(false)
+, send_window_(http2::kDefaultWindowSize)
+, recv_window_(kConnectionWindow)
+, unacked_(0)
+, header_stream_(0)
+, header_end_stream_(false) {
+}
+
+H2Session::~H2Session() {
+    __Fail(SOCKET_ERRNO(ECONNABORTED));
+    thread_.join();
+    write_thread_.join();
+    socket_close(socket_);
+
+    for (std::map<uint32_t, Stream*>::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+        delete it->second;
+    }
+    streams_.clear();
+}
+
+bool H2Session::Start(int& _errcode) {
+    // HEADERS and DATA of one request go out as separate writes, Nagle would hold the second back
+    socket_disable_nagle(socket_, 1);
+
+    http2::SettingList settings;
+    settings.push_back(std::make_pair((uint16_t)http2::kSettingsEnablePush, (uint32_t)0));
+    settings.push_back(std::make_pair((uint16_t)http2::kSettingsInitialWindowSize, kStreamWindow));
+    settings.push_back(std::make_pair((uint16_t)http2::kSettingsMaxHeaderListSize, kMaxHeaderListSize));
+
+    AutoBuffer out;
+    out.Write(http2::kConnectionPreface, http2::kConnectionPrefaceLength);
+    http2::PackSettings(settings, out);
+    http2::PackWindowUpdate(0, kConnectionWindow - http2::kDefaultWindowSize, out);
+
+    if (!__Write(out)) {
+        ScopedLock lock(mutex_);
+        _errcode = error_;
+        return false;
+    }
+
+    thread_.start();
+    write_thread_.start();
+    xinfo2(TSF "h2 session %_ started, sock:%_", destination_, socket_);
+    return true;
+}
+
+bool H2Session::Reserve() {
+    ScopedLock lock(mutex_);
+    if (!alive_ || going_away_)
+        return false;
+    if (streams_.size() + reserved_ >= std::min(peer_max_streams_, kDefaultMaxStreams))
+        return false;
+    // ids only go up; a long-lived connection makes way for a new one well before they run out
+    if (next_stream_id_ + 2 * reserved_ >= kLastStreamId - 2 * kDefaultMaxStreams)
+        return false;
+
+    ++reserved_;
+    return true;
+}
+
+void H2Session::Unreserve() {
+    ScopedLock lock(mutex_);
+    xassert2(0 < reserved_);
+    --reserved_;
+    if (streams_.empty() && 0 == reserved_) {
+        idle_since_ = gettickcount();
+    }
+}
+
+uint32_t H2Session::SendHeaders(const http2::HeaderList& _headers, bool _end_stream, int& _errcode) {
+    ScopedLock write_lock(write_mutex_);
+    ScopedLock lock(mutex_);
+    xassert2(0 < reserved_);
+    --reserved_;
+    if (!alive_) {
+        _errcode = error_;
+        return 0;
+    }
+
+    // registered before the HEADERS go out, the response may come back before this returns
+    uint32_t stream_id = next_stream_id_;
+    next_stream_id_ += 2;
+    Stream* stream = new Stream;
+    stream->send_window = peer_initial_window_;
+    stream->local_closed = _end_stream;
+    streams_[stream_id] = stream;
+
+    if (table_size_changed_) {
+        encoder_.SetMaxTableSize(peer_table_size_);
+        table_size_changed_ = false;
+    }
+    size_t max_frame = peer_max_frame_;
+    lock.unlock();
+
+    AutoBuffer block;
+    encoder_.Encode(_headers, block);
+
+    AutoBuffer frames;
+    size_t offset = 0;
+    do {
+        size_t length = std::min(block.Length() - offset, max_frame);
+        bool last = offset + length == block.Length();
+        uint8_t flags = (last ? http2::kFlagEndHeaders : 0) | (0 == offset && _end_stream ? http2::kFlagEndStream : 0);
+        http2::PackFrame(0 == offset ? http2::kFrameHeaders : http2::kFrameContinuation,
+                         flags,
+                         stream_id,
+                         block.Ptr(offset),
+                         length,
+                         frames);
+        offset += length;
+    } while (offset < block.Length());
+
+    bool written = __WriteLocked(frames.Ptr(), frames.Length(), NULL, 0);
+
+    lock.lock();
+    stats_.header_bytes += block.Length();
+    if (!written) {
+        _errcode = error_;
+        streams_.erase(stream_id);
+        delete stream;
+        return 0;
+    }
+    return stream_id;
+}
+
+int H2Session::SendData(uint32_t _stream_id,
+                        const void* _data,
+                        size_t _length,
+                        bool _end_stream,
+                        const std::atomic<bool>& _cancel,
+                        int _timeout,
+                        int& _errcode) {
+    _errcode = 0;
+    if (0 == _length && !_end_stream)
+        return 0;
+
+    uint64_t deadline = gettickcount() + (0 <= _timeout ? _timeout : kWriteTimeout);
+    size_t sent = 0;
+    do {
+        ScopedLock lock(mutex_);
+        Stream* stream = NULL;
+        size_t length = 0;
+        while (true) {
+            stream = __FindLocked(_stream_id);
+            if (!stream || stream->error) {
+                _errcode = stream ? stream->error : SOCKET_ERRNO(ECONNRESET);
+                return -1;
+            }
+            if (!alive_) {
+                _errcode = error_;
+                return -1;
+            }
+            // the server answered before taking all of the body, or it reset the stream; either way it's not wanted
+            if (stream->remote_closed || _cancel)
+                return (int)sent;
+            if (sent == _length)
+                break;
+
+            int64_t window = std::min(stream->send_window, send_window_);
+            if (0 < window) {
+                length = (size_t)std::min<int64_t>(std::min<int64_t>(window, peer_max_frame_), _length - sent);
+                break;
+            }
+
+            uint64_t now = gettickcount();
+            if (now >= deadline) {
+                xwarn2(TSF "h2 stream %_ blocked by flow control, window:%_/%_", _stream_id, stream->send_window,
+                       send_window_);
+                _errcode = SOCKET_ERRNO(ETIMEDOUT);
+                return -1;
+            }
+            cond_.wait(lock, (long)(deadline - now));
+        }
+
+        bool last = _end_stream && sent + length == _length;
+        stream->send_window -= length;
+        send_window_ -= length;
+        if (last) {
+            stream->local_closed = true;
+        }
+        lock.unlock();
+
+        uint8_t head[http2::kFrameHeaderLength];
+        http2::PackFrameHeader((uint32_t)length,
+                               http2::kFrameData,
+                               last ? http2::kFlagEndStream : 0,
+                               _stream_id,
+                               head);
+
+        ScopedLock write_lock(write_mutex_);
+        if (!__WriteLocked(head, sizeof(head), (const char*)_data + sent, length)) {
+            ScopedLock error_lock(mutex_);
+            _errcode = error_;
+            return -1;
+        }
+        sent += length;
+    } while (sent < _length);
+
+    return (int)sent;
+}
+
+int H2Session::Recv(uint32_t _stream_id,
+                    AutoBuffer& _buffer,
+                    size_t _max_size,
+                    const std::atomic<bool>& _cancel,
+                    int _timeout,
+                    int& _errcode) {
+    _errcode = 0;
+    uint64_t deadline = gettickcount() + _timeout;
+
+    ScopedLock lock(mutex_);
+    Stream* stream = NULL;
+    while (true) {
+        stream = __FindLocked(_stream_id);
+        if (!stream) {
+            _errcode = SOCKET_ERRNO(ECONNRESET);
+            return -1;
+        }
+        // what arrived before a reset or a broken connection is still handed out first
+        if (stream->pending_pos < stream->pending.size())
+            break;
+        if (stream->error) {
+            _errcode = stream->error;
+            return -1;
+        }
+        if (stream->remote_closed || _cancel)
+            return 0;
+
+        if (0 > _timeout) {
+            cond_.wait(lock);
+            continue;
+        }
+        uint64_t now = gettickcount();
+        if (now >= deadline) {
+            _errcode = SOCKET_ERRNO(ETIMEDOUT);
+            return 0;
+        }
+        cond_.wait(lock, (long)(deadline - now));
+    }
+
+    size_t length = std::min(_max_size, stream->pending.size() - stream->pending_pos);
+    if (_buffer.Capacity() - _buffer.Length() < length) {
+        _buffer.AddCapacity(length - (_buffer.Capacity() - _buffer.Length()));
+    }
+    memcpy(_buffer.Ptr(_buffer.Length()), stream->pending.data() + stream->pending_pos, length);
+    _buffer.Length(_buffer.Pos(), _buffer.Length() + length);
+
+    stream->pending_pos += length;
+    if (stream->pending_pos == stream->pending.size()) {
+        stream->pending.clear();
+        stream->pending_pos = 0;
+    }
+
+    // framing that isn't DATA is counted as data too; it only moves the credit a little ahead
+    uint32_t credit = std::min<uint32_t>(stream->uncredited, (uint32_t)length);
+    stream->uncredited -= credit;
+    AutoBuffer out;
+    __CreditLocked(_stream_id, stream, credit, out);
+    lock.unlock();
+
+    __SendControl(out);
+    return (int)length;
+}
+
+void H2Session::CloseStream(uint32_t _stream_id) {
+    ScopedLock lock(mutex_);
+    std::map<uint32_t, Stream*>::iterator it = streams_.find(_stream_id);
+    if (it == streams_.end())
+        return;
+
+    Stream* stream = it->second;
+    AutoBuffer out;
+    if (alive_ && (!stream->local_closed || !stream->remote_closed)) {
+        http2::PackRstStream(_stream_id, http2::kCancel, out);
+        ++stats_.resets;
+    }
+    // what nobody will read still counts against the connection window
+    __CreditLocked(0, NULL, stream->uncredited, out);
+
+    streams_.erase(it);
+    delete stream;
+    if (streams_.empty() && 0 == reserved_) {
+        idle_since_ = gettickcount();
+    }
+    lock.unlock();
+
+    __SendControl(out);
+}
+
+void H2Session::Wake() {
+    ScopedLock lock(mutex_);
+    cond_.notifyAll(lock);
+}
+
+bool H2Session::IsAlive() const {
+    ScopedLock lock(mutex_);
+    return alive_ && !going_away_;
+}
+
+SOCKET H2Session::Socket() const {
+    return socket_;
+}
+
+const std::string& H2Session::Destination() const {
+    return destination_;
+}
+
+size_t H2Session::StreamCount() const {
+    ScopedLock lock(mutex_);
+    return streams_.size();
+}
+
+H2SessionStats H2Session::Stats() const {
+    ScopedLock lock(mutex_);
+    return stats_;
+}
+
+void H2Session::__RunRead() {
+    std::string input;
+    size_t input_pos = 0;
+    char buffer[kReadSize];
+
+    while (true) {
+        SocketSelect sel(breaker_, true);
+        sel.PreSelect();
+        sel.Read_FD_SET(socket_);
+        sel.Exception_FD_SET(socket_);
+        int ret = sel.Select(kSelectTimeout);
+
+        if (0 > ret) {
+            __Fail(sel.Errno());
+            return;
+        }
+        if (sel.IsBreak())
+            return;
+
+        if (0 == ret) {
+            ScopedLock lock(mutex_);
+            bool idle = streams_.empty() && 0 == reserved_
+                        && (going_away_ || gettickcount() - idle_since_ >= (uint64_t)kIdleTimeout);
+            if (!idle)
+                continue;
+            going_away_ = true;
+            lock.unlock();
+
+            xinfo2(TSF "h2 session %_ idle, closing sock:%_", destination_, socket_);
+            AutoBuffer out;
+            http2::PackGoAway(0, http2::kNoError, out);
+            __Fail(SOCKET_ERRNO(ECONNABORTED), &out);
+            return;
+        }
+
+        if (sel.Exception_FD_ISSET(socket_)) {
+            __Fail(socket_error(socket_));
+            return;
+        }
+
+        ssize_t nrecv = ::recv(socket_, buffer, sizeof(buffer), 0);
+        if (0 > nrecv && IS_NOBLOCK_READ_ERRNO(socket_errno))
+            continue;
+        if (0 >= nrecv) {
+            xwarn2(TSF "h2 session %_ read %_, errno:%_", destination_, nrecv, 0 == nrecv ? 0 : socket_errno);
+            __Fail(0 == nrecv ? SOCKET_ERRNO(ECONNRESET) : socket_errno);
+            return;
+        }
+        input.append(buffer, nrecv);
+
+        // what the frames of this read call for goes to the writer in one piece
+        AutoBuffer out;
+        http2::FrameHeader header;
+        while (http2::UnpackFrameHeader(input.data() + input_pos, input.size() - input_pos, header)) {
+            if (http2::kDefaultMaxFrameSize < header.length) {
+                // we never raised SETTINGS_MAX_FRAME_SIZE
+                http2::PackGoAway(0, http2::kFrameSizeError, out);
+                __Fail(SOCKET_ERRNO(ECONNRESET), &out);
+                return;
+            }
+            if (input.size() - input_pos < http2::kFrameHeaderLength + header.length)
+                break;
+
+            const uint8_t* payload = (const uint8_t*)input.data() + input_pos + http2::kFrameHeaderLength;
+            bool ok = __OnFrame(header, payload, out);
+            input_pos += http2::kFrameHeaderLength + header.length;
+
+            if (!ok) {
+                xerror2(TSF "h2 session %_ connection error on frame type:%_, stream:%_", destination_, header.type,
+                        header.stream_id);
+                __Fail(SOCKET_ERRNO(ECONNRESET), &out);
+                return;
+            }
+        }
+        input.erase(0, input_pos);
+        input_pos = 0;
+        __SendControl(out);
+    }
+}
+
+bool H2Session::__OnFrame(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out) {
+    // a header block is contiguous: nothing may come between HEADERS and its last CONTINUATION
+    if (0 != header_stream_
+        && (http2::kFrameContinuation != _header.type || header_stream_ != _header.stream_id)) {
+        http2::PackGoAway(0, http2::kProtocolError, _out);
+        return false;
+    }
+
+    switch (_header.type) {
+        case http2::kFrameData:
+            return __OnData(_header, _payload, _out);
+
+        case http2::kFrameHeaders: {
+            size_t offset = 0;
+            size_t padding = 0;
+            if (_header.flags & http2::kFlagPadded) {
+                offset = 1;
+                padding = 0 < _header.length ? _payload[0] : 0;
+            }
+            if (_header.flags & http2::kFlagPriority) {
+                offset += 5;
+            }
+            if (0 == _header.stream_id || offset + padding > _header.length) {
+                http2::PackGoAway(0, http2::kProtocolError, _out);
+                return false;
+            }
+            if (_header.length - offset - padding > kMaxHeaderListSize) {
+                xerror2(TSF "h2 session %_ header block over %_, stream:%_", destination_, kMaxHeaderListSize,
+                        _header.stream_id);
+                http2::PackGoAway(0, http2::kEnhanceYourCalm, _out);
+                return false;
+            }
+
+            header_block_.Reset();
+            header_block_.Write(_payload + offset, _header.length - offset - padding);
+            header_stream_ = _header.stream_id;
+            header_end_stream_ = 0 != (_header.flags & http2::kFlagEndStream);
+            if (!(_header.flags & http2::kFlagEndHeaders))
+                return true;
+            if (!__OnHeaderBlock(header_stream_, header_end_stream_)) {
+                http2::PackGoAway(0, http2::kCompressionError, _out);
+                return false;
+            }
+            return true;
+        }
+
+        case http2::kFrameContinuation:
+            if (0 == header_stream_) {
+                http2::PackGoAway(0, http2::kProtocolError, _out);
+                return false;
+            }
+            // without a cap an endless run of CONTINUATIONs would grow the block as long as the peer likes
+            if (header_block_.Length() + _header.length > kMaxHeaderListSize) {
+                xerror2(TSF "h2 session %_ header block over %_, stream:%_", destination_, kMaxHeaderListSize,
+                        header_stream_);
+                http2::PackGoAway(0, http2::kEnhanceYourCalm, _out);
+                return false;
+            }
+            header_block_.Write(_payload, _header.length);
+            if (!(_header.flags & http2::kFlagEndHeaders))
+                return true;
+            if (!__OnHeaderBlock(header_stream_, header_end_stream_)) {
+                http2::PackGoAway(0, http2::kCompressionError, _out);
+                return false;
+            }
+            return true;
+
+        case http2::kFrameRstStream: {
+            if (4 != _header.length) {
+                http2::PackGoAway(0, http2::kFrameSizeError, _out);
+                return false;
+            }
+            uint32_t error_code = http2::ReadUint32(_payload);
+            ScopedLock lock(mutex_);
+            Stream* stream = __FindLocked(_header.stream_id);
+            if (!stream)
+                return true;
+
+            xwarn2_if(http2::kNoError != error_code || !stream->remote_closed,
+                      TSF "h2 stream %_ reset by peer, code:%_",
+                      _header.stream_id,
+                      error_code);
+            // after a complete response, RST_STREAM(NO_ERROR) only says the rest of the request isn't needed
+            if (!stream->remote_closed) {
+                stream->error =
+                    http2::kRefusedStream == error_code ? SOCKET_ERRNO(ECONNREFUSED) : SOCKET_ERRNO(ECONNRESET);
+                stream->remote_closed = true;
+            }
+            stream->local_closed = true;
+            cond_.notifyAll(lock);
+            return true;
+        }
+
+        case http2::kFrameSettings:
+            return __OnSettings(_header, _payload, _out);
+
+        case http2::kFramePushPromise:
+            // SETTINGS_ENABLE_PUSH is 0
+            http2::PackGoAway(0, http2::kProtocolError, _out);
+            return false;
+
+        case http2::kFramePing:
+            if (8 != _header.length || 0 != _header.stream_id) {
+                http2::PackGoAway(0, http2::kFrameSizeError, _out);
+                return false;
+            }
+            if (!(_header.flags & http2::kFlagAck)) {
+                http2::PackPing(true, _payload, _out);
+            }
+            return true;
+
+        case http2::kFrameGoAway:
+            if (8 > _header.length) {
+                http2::PackGoAway(0, http2::kFrameSizeError, _out);
+                return false;
+            }
+            __OnGoAway(_payload, _header.length);
+            return true;
+
+        case http2::kFrameWindowUpdate:
+            return __OnWindowUpdate(_header, _payload, _out);
+
+        default:
+            // PRIORITY, and frame types this end doesn't know, are ignored
+            return true;
+    }
+}
+
+bool H2Session::__OnData(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out) {
+    if (0 == _header.stream_id) {
+        http2::PackGoAway(0, http2::kProtocolError, _out);
+        return false;
+    }
+
+    const uint8_t* data = _payload;
+    size_t length = _header.length;
+    if (_header.flags & http2::kFlagPadded) {
+        if (0 == length || (size_t)_payload[0] >= length) {
+            http2::PackGoAway(0, http2::kProtocolError, _out);
+            return false;
+        }
+        data = _payload + 1;
+        length = _header.length - 1 - _payload[0];
+    }
+
+    ScopedLock lock(mutex_);
+    recv_window_ -= _header.length;
+    if (0 > recv_window_) {
+        http2::PackGoAway(0, http2::kFlowControlError, _out);
+        return false;
+    }
+
+    Stream* stream = __FindLocked(_header.stream_id);
+    if (!stream) {
+        // closed on our side already
+        __CreditLocked(0, NULL, _header.length, _out);
+        return true;
+    }
+    if (!stream->headers_done || stream->remote_closed) {
+        __CreditLocked(0, NULL, _header.length, _out);
+        if (!stream->remote_closed) {
+            __ResetLocked(_header.stream_id, *stream, http2::kProtocolError, _out);
+            cond_.notifyAll(lock);
+        }
+        return true;
+    }
+
+    stream->recv_window -= _header.length;
+    if (0 > stream->recv_window) {
+        __CreditLocked(0, NULL, _header.length, _out);
+        __ResetLocked(_header.stream_id, *stream, http2::kFlowControlError, _out);
+        cond_.notifyAll(lock);
+        return true;
+    }
+
+    if (0 < length) {
+        if (stream->chunked) {
+            stream->pending += __Hex(length);
+            stream->pending += "\r\n";
+            stream->pending.append((const char*)data, length);
+            stream->pending += "\r\n";
+        } else {
+            stream->pending.append((const char*)data, length);
+        }
+    }
+    stream->uncredited += (uint32_t)length;
+    // padding is nothing to wait for
+    __CreditLocked(_header.stream_id, stream, (uint32_t)(_header.length - length), _out);
+
+    if (_header.flags & http2::kFlagEndStream) {
+        __RemoteClose(*stream);
+    }
+    cond_.notifyAll(lock);
+    return true;
+}
+
+bool H2Session::__OnHeaderBlock(uint32_t _stream_id, bool _end_stream) {
+    header_stream_ = 0;
+
+    // decoded even for a stream that's gone, the dynamic table has to stay in step
+    http2::HeaderList headers;
+    if (!decoder_.Decode(header_block_.Ptr(), header_block_.Length(), headers)) {
+        xerror2(TSF "h2 session %_ hpack decode failed, stream:%_", destination_, _stream_id);
+        return false;
+    }
+
+    ScopedLock lock(mutex_);
+    Stream* stream = __FindLocked(_stream_id);
+    if (!stream || stream->remote_closed)
+        return true;
+
+    if (!stream->headers_done) {
+        std::string status;
+        for (size_t i = 0; i < headers.size(); ++i) {
+            if (":status" == headers[i].first) {
+                status = headers[i].second;
+            }
+        }
+        // 1xx are interim, the final response comes in the next block
+        if (!status.empty() && '1' == status[0] && !_end_stream)
+            return true;
+
+        __RenderHeaders(*stream, headers, _end_stream);
+        stream->headers_done = true;
+    }
+    // trailers are dropped, ShortLink has no use for them
+
+    if (_end_stream) {
+        __RemoteClose(*stream);
+    }
+    cond_.notifyAll(lock);
+    return true;
+}
+
+bool H2Session::__OnSettings(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out) {
+    if (0 != _header.stream_id) {
+        http2::PackGoAway(0, http2::kProtocolError, _out);
+        return false;
+    }
+    if (_header.flags & http2::kFlagAck) {
+        if (0 != _header.length) {
+            http2::PackGoAway(0, http2::kFrameSizeError, _out);
+            return false;
+        }
+        return true;
+    }
+
+    http2::SettingList settings;
+    if (!http2::UnpackSettings(_payload, _header.length, settings)) {
+        http2::PackGoAway(0, http2::kFrameSizeError, _out);
+        return false;
+    }
+
+    ScopedLock lock(mutex_);
+    for (size_t i = 0; i < settings.size(); ++i) {
+        uint32_t value = settings[i].second;
+        switch (settings[i].first) {
+            case http2::kSettingsHeaderTableSize:
+                peer_table_size_ = value;
+                table_size_changed_ = true;
+                break;
+            case http2::kSettingsMaxConcurrentStreams:
+                peer_max_streams_ = value;
+                break;
+            case http2::kSettingsInitialWindowSize: {
+                if (http2::kMaxWindowSize < value) {
+                    http2::PackGoAway(0, http2::kFlowControlError, _out);
+                    return false;
+                }
+                // applies to the streams already open as well
+                int64_t delta = (int64_t)value - peer_initial_window_;
+                for (std::map<uint32_t, Stream*>::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+                    it->second->send_window += delta;
+                }
+                peer_initial_window_ = value;
+                break;
+            }
+            case http2::kSettingsMaxFrameSize:
+                if (http2::kDefaultMaxFrameSize > value || 0xffffff < value) {
+                    http2::PackGoAway(0, http2::kProtocolError, _out);
+                    return false;
+                }
+                peer_max_frame_ = value;
+                break;
+            default:
+                break;
+        }
+    }
+    cond_.notifyAll(lock);
+    lock.unlock();
+
+    http2::PackSettingsAck(_out);
+    return true;
+}
+
+bool H2Session::__OnWindowUpdate(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out) {
+    if (4 != _header.length) {
+        http2::PackGoAway(0, http2::kFrameSizeError, _out);
+        return false;
+    }
+    uint32_t increment = http2::ReadUint32(_payload) & http2::kMaxWindowSize;
+
+    ScopedLock lock(mutex_);
+    if (0 == _header.stream_id) {
+        send_window_ += increment;
+        if (0 == increment || http2::kMaxWindowSize < send_window_) {
+            http2::PackGoAway(0, 0 == increment ? http2::kProtocolError : http2::kFlowControlError, _out);
+            return false;
+        }
+        cond_.notifyAll(lock);
+        return true;
+    }
+
+    Stream* stream = __FindLocked(_header.stream_id);
+    if (!stream)
+        return true;
+    stream->send_window += increment;
+    if (0 == increment || http2::kMaxWindowSize < stream->send_window) {
+        __ResetLocked(_header.stream_id,
+                      *stream,
+                      0 == increment ? http2::kProtocolError : http2::kFlowControlError,
+                      _out);
+    }
+    cond_.notifyAll(lock);
+    return true;
+}
+
+void H2Session::__OnGoAway(const uint8_t* _payload, size_t _length) {
+    uint32_t last_stream_id = http2::ReadUint32(_payload) & http2::kMaxWindowSize;
+    uint32_t error_code = http2::ReadUint32(_payload + 4);
+    xwarn2(TSF "h2 session %_ goaway, last stream:%_, code:%_, debug:%_",
+           destination_,
+           last_stream_id,
+           error_code,
+           std::string((const char*)_payload + 8, _length - 8));
+
+    // streams above last_stream_id were never processed and can be retried anywhere
+    ScopedLock lock(mutex_);
+    going_away_ = true;
+    for (std::map<uint32_t, Stream*>::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+        if (it->first > last_stream_id && !it->second->remote_closed) {
+            it->second->error = SOCKET_ERRNO(ECONNREFUSED);
+            it->second->remote_closed = true;
+            it->second->local_closed = true;
+        }
+    }
+    cond_.notifyAll(lock);
+}
+
+void H2Session::__RenderHeaders(Stream& _stream, const http2::HeaderList& _headers, bool _end_stream) {
+    std::string status = "200";
+    std::string fields;
+    bool has_length = false;
+    for (size_t i = 0; i < _headers.size(); ++i) {
+        const std::string& name = _headers[i].first;
+        if (":status" == name) {
+            status = _headers[i].second;
+            continue;
+        }
+        if (name.empty() || ':' == name[0] || __IsHopByHop(name))
+            continue;
+        if ("content-length" == name) {
+            has_length = true;
+        }
+        fields += name + ": " + _headers[i].second + "\r\n";
+    }
+
+    // HTTP/2 ends a body with END_STREAM; the HTTP/1.1 parser needs a length or chunks
+    if (!has_length) {
+        if (_end_stream) {
+            fields += "content-length: 0\r\n";
+        } else {
+            fields += "transfer-encoding: chunked\r\n";
+            _stream.chunked = true;
+        }
+    }
+    // HTTP/2 has no reason phrase, an empty one is valid HTTP/1.1
+    _stream.pending += "HTTP/1.1 " + status + " \r\n";
+    _stream.pending += fields;
+    _stream.pending += "\r\n";
+}
+
+void H2Session::__RemoteClose(Stream& _stream) {
+    if (_stream.chunked) {
+        _stream.pending += "0\r\n\r\n";
+    }
+    _stream.remote_closed = true;
+}
+
+void H2Session::__ResetLocked(uint32_t _stream_id, Stream& _stream, uint32_t _error_code, AutoBuffer& _out) {
+    xwarn2(TSF "h2 stream %_ reset, code:%_", _stream_id, _error_code);
+    http2::PackRstStream(_stream_id, _error_code, _out);
+    ++stats_.resets;
+    _stream.error = SOCKET_ERRNO(ECONNRESET);
+    _stream.local_closed = true;
+    _stream.remote_closed = true;
+}
+
+void H2Session::__CreditLocked(uint32_t _stream_id, Stream* _stream, uint32_t _length, AutoBuffer& _out) {
+    if (0 == _length)
+        return;
+
+    unacked_ += _length;
+    if (unacked_ >= kConnectionWindow / 2) {
+        http2::PackWindowUpdate(0, unacked_, _out);
+        recv_window_ += unacked_;
+        unacked_ = 0;
+        ++stats_.window_updates;
+    }
+
+    if (!_stream || _stream->remote_closed)
+        return;
+    _stream->unacked += _length;
+    if (_stream->unacked >= kStreamWindow / 2) {
+        http2::PackWindowUpdate(_stream_id, _stream->unacked, _out);
+        _stream->recv_window += _stream->unacked;
+        _stream->unacked = 0;
+        ++stats_.window_updates;
+    }
+}
+
+H2Session::Stream* H2Session::__FindLocked(uint32_t _stream_id) {
+    std::map<uint32_t, Stream*>::iterator it = streams_.find(_stream_id);
+    return it == streams_.end() ? NULL : it->second;
+}
+
+void H2Session::__RunWrite() {
+    while (true) {
+        ScopedLock lock(mutex_);
+        while (alive_ && 0 == control_out_.Length()) {
+            control_cond_.wait(lock);
+        }
+        AutoBuffer out;
+        out.Attach(control_out_);
+        bool alive = alive_;
+        lock.unlock();
+
+        if (alive) {
+            ScopedLock write_lock(write_mutex_);
+            if (!__WriteLocked(out.Ptr(), out.Length(), NULL, 0))
+                return;
+            continue;
+        }
+
+        // the connection is gone; the GOAWAY, if any, only goes out when nothing is mid-write and the socket takes it
+        if (0 < out.Length() && write_mutex_.trylock()) {
+            ::send(socket_, (const char*)out.Ptr(), (int)out.Length(), 0);
+            write_mutex_.unlock();
+        }
+        return;
+    }
+}
+
+bool H2Session::__Write(const AutoBuffer& _buffer) {
+    ScopedLock write_lock(write_mutex_);
+    return __WriteLocked(_buffer.Ptr(), _buffer.Length(), NULL, 0);
+}
+
+bool H2Session::__WriteLocked(const void* _head, size_t _head_len, const void* _body, size_t _body_len) {
+    int errcode = 0;
+    int ret = block_socket_sendv(socket_, _head, _head_len, _body, _body_len, breaker_, errcode, kWriteTimeout);
+    if (0 <= ret && (size_t)ret == _head_len + _body_len)
+        return true;
+
+    // a frame cut short leaves the connection unusable
+    xerror2(TSF "h2 session %_ write %_/%_, errno:%_", destination_, ret, _head_len + _body_len, errcode);
+    __Fail(0 != errcode ? errcode : SOCKET_ERRNO(ECONNRESET));
+    return false;
+}
+
+void H2Session::__SendControl(AutoBuffer& _out) {
+    if (0 == _out.Length())
+        return;
+
+    ScopedLock lock(mutex_);
+    if (!alive_)
+        return;
+    control_out_.Write(_out.Ptr(), _out.Length());
+    control_cond_.notifyAll(lock);
+}
+
+void H2Session::__Fail(int _errcode, AutoBuffer* _goaway) {
+    ScopedLock lock(mutex_);
+    if (!alive_)
+        return;
+
+    alive_ = false;
+    error_ = _errcode;
+    // queued and failed under one lock: the writer can't start a blocking write of it the breaker would cut short
+    control_out_.Reset();
+    if (_goaway) {
+        control_out_.Write(_goaway->Ptr(), _goaway->Length());
+    }
+    control_cond_.notifyAll(lock);
+    for (std::map<uint32_t, Stream*>::iterator it = streams_.begin(); it != streams_.end(); ++it) {
+        if (!it->second->remote_closed) {
+            it->second->error = _errcode;
+            it->second->remote_closed = true;
+        }
+    }
+    cond_.notifyAll(lock);
+    lock.unlock();
+
+    xinfo2(TSF "h2 session %_ closed, errno:%_", destination_, _errcode);
+    breaker_.Break();
+}
+
+}  // namespace stn
+}  // namespace mars
@@ -0,0 +1,187 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * h2_session.h
+ *
+ * One cleartext HTTP/2 connection carrying many short-link requests at once.
+ * A reader thread owns the socket's input; callers open a stream, send on it
+ * within the flow-control windows and read the response back as the HTTP/1.1
+ * message ShortLink already knows how to parse. Control frames (SETTINGS ACK,
+ * PING ACK, WINDOW_UPDATE, RST_STREAM) are queued for a writer thread, so the
+ * reader never waits behind a caller's DATA for the socket.
+ */
+
+#ifndef STN_SRC_H2_SESSION_H_
+#define STN_SRC_H2_SESSION_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/http2.h"
+#include "mars/comm/socket/socketselect.h"
+#include "mars/comm/socket/unix_socket.h"
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/mutex.h"
+#include "mars/comm/thread/thread.h"
+
+namespace mars {
+namespace stn {
+
+struct H2SessionStats {
+    uint64_t header_bytes = 0;  // HPACK output, what the plain headers shrank to
+    uint64_t window_updates = 0;
+    uint64_t resets = 0;        // RST_STREAM we sent
+};
+
+class H2Session {
+ public:
+    static const uint32_t kStreamWindow = 1024 * 1024;  // per stream, read by ShortLink as it parses
+    static const uint32_t kConnectionWindow = 16 * 1024 * 1024;
+    static const uint32_t kDefaultMaxStreams = 100;  // until the peer's SETTINGS say otherwise
+    static const int kIdleTimeout = 60 * 1000;       // ms without a stream before the connection is let go
+    static const int kWriteTimeout = 15 * 1000;
+    static const uint32_t kMaxHeaderListSize = 64 * 1024;  // advertised; a longer header block is a connection error
+
+ public:
+    H2Session(SOCKET _socket, const std::string& _destination);
+    ~H2Session();
+
+    // preface and SETTINGS out, reader running; false when the socket is unusable
+    bool Start(int& _errcode);
+    // takes a slot for a stream that is about to be opened; false when the connection is full or going away
+    bool Reserve();
+    void Unreserve();
+
+    // opens a stream on a reserved slot; 0 on failure
+    uint32_t SendHeaders(const http2::HeaderList& _headers, bool _end_stream, int& _errcode);
+    // sends as far as the windows allow, waiting for WINDOW_UPDATEs; -1 on error, short on cancel or timeout
+    int SendData(uint32_t _stream_id,
+                 const void* _data,
+                 size_t _length,
+                 bool _end_stream,
+                 const std::atomic<bool>& _cancel,
+                 int _timeout,
+                 int& _errcode);
+    // appends up to _max_size bytes of the response rendered as HTTP/1.1 behind _buffer's length;
+    // 0 with ETIMEDOUT on timeout, 0 with no error on cancel or once all of it has been read, -1 on a reset
+    int Recv(uint32_t _stream_id,
+             AutoBuffer& _buffer,
+             size_t _max_size,
+             const std::atomic<bool>& _cancel,
+             int _timeout,
+             int& _errcode);
+    // RST_STREAM(CANCEL) unless the response is complete, then forgets the stream
+    void CloseStream(uint32_t _stream_id);
+    // waiters recheck their cancel flags
+    void Wake();
+
+    bool IsAlive() const;
+    SOCKET Socket() const;
+    const std::string& Destination() const;
+    size_t StreamCount() const;
+    H2SessionStats Stats() const;
+
+ private:
+    struct Stream {
+        Stream();
+
+        int64_t send_window;
+        int64_t recv_window;
+        uint32_t unacked;     // read by the caller, not yet given back with a WINDOW_UPDATE
+        uint32_t uncredited;  // data bytes still in pending
+        bool headers_done;
+        bool local_closed;   // END_STREAM or RST_STREAM sent
+        bool remote_closed;  // END_STREAM or RST_STREAM received, or the connection is gone
+        bool chunked;  // no content-length: the body is rendered with chunked framing
+        int error;
+        std::string pending;  // rendered response not read yet, from pending_pos on
+        size_t pending_pos;
+    };
+
+    void __RunRead();
+    void __RunWrite();
+    bool __OnFrame(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out);
+    bool __OnData(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out);
+    bool __OnHeaderBlock(uint32_t _stream_id, bool _end_stream);
+    bool __OnSettings(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out);
+    bool __OnWindowUpdate(const http2::FrameHeader& _header, const uint8_t* _payload, AutoBuffer& _out);
+    void __OnGoAway(const uint8_t* _payload, size_t _length);
+    void __RenderHeaders(Stream& _stream, const http2::HeaderList& _headers, bool _end_stream);
+    void __RemoteClose(Stream& _stream);
+    void __ResetLocked(uint32_t _stream_id, Stream& _stream, uint32_t _error_code, AutoBuffer& _out);
+    // gives back _length consumed bytes, a WINDOW_UPDATE once half of a window is waiting
+    void __CreditLocked(uint32_t _stream_id, Stream* _stream, uint32_t _length, AutoBuffer& _out);
+
+    Stream* __FindLocked(uint32_t _stream_id);
+    bool __Write(const AutoBuffer& _buffer);
+    bool __WriteLocked(const void* _head, size_t _head_len, const void* _body, size_t _body_len);
+    // queues control frames for the writer thread, never waits for the socket
+    void __SendControl(AutoBuffer& _out);
+    // _goaway, if any, is the last thing the writer sends, and only if that needs no wait
+    void __Fail(int _errcode, AutoBuffer* _goaway = NULL);
+
+ private:
+    H2Session(const H2Session&);
+    H2Session& operator=(const H2Session&);
+
+ private:
+    SOCKET socket_;
+    const std::string destination_;
+    comm::SocketBreaker breaker_;
+    comm::Thread thread_;
+    comm::Thread write_thread_;
+
+    comm::Mutex write_mutex_;  // socket writes and the HPACK encoder, taken before mutex_ when both are needed
+    http2::HpackEncoder encoder_;
+    uint32_t next_stream_id_;
+
+    mutable comm::Mutex mutex_;
+    comm::Condition cond_;
+    std::map<uint32_t, Stream*> streams_;
+    size_t reserved_;
+    bool alive_;
+    bool going_away_;
+    int error_;
+    uint64_t idle_since_;
+    AutoBuffer control_out_;  // control frames waiting for the writer thread
+    comm::Condition control_cond_;
+
+    // peer settings and our send windows
+    uint32_t peer_max_streams_;
+    uint32_t peer_initial_window_;
+    uint32_t peer_max_frame_;
+    uint32_t peer_table_size_;  // applied to encoder_ before the next HEADERS
+    bool table_size_changed_;
+    int64_t send_window_;
+
+    // our receive side; decoder_ and the header block only on the reader thread
+    int64_t recv_window_;
+    uint32_t unacked_;
+    http2::HpackDecoder decoder_;
+    AutoBuffer header_block_;
+    uint32_t header_stream_;
+    bool header_end_stream_;
+
+    H2SessionStats stats_;
+};
+
+}  // namespace stn
+}  // namespace mars
+
+#endif  // STN_SRC_H2_SESSION_H_
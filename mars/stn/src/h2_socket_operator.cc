@@ -0,0 +1,383 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * h2_socket_operator.cc
+ */
+
+#include "h2_socket_operator.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#include "h2_session.h"
+#include "mars/comm/http.h"
+#include "mars/comm/strutil.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+using namespace mars::comm;
+
+namespace mars {
+namespace stn {
+
+namespace {
+
+// stream handles stay clear of real descriptors, so one handed to socket_close by mistake fails instead of closing
+// something else
+static const SOCKET kFirstStreamHandle = 0x40000000;
+
+struct StreamRef {
+    StreamRef() : stream_id(0) {
+    }
+
+    std::shared_ptr<H2Session> session;
+    uint32_t stream_id;  // 0 until the request is sent, the slot is only reserved
+};
+
+// process wide, the connections are shared by every ShortLink
+struct H2Registry {
+    H2Registry() : next_handle(kFirstStreamHandle) {
+    }
+
+    Mutex mutex;
+    std::map<std::string, std::vector<std::shared_ptr<H2Session>>> sessions;  // by "ip:port"
+    std::map<SOCKET, StreamRef> streams;
+    SOCKET next_handle;
+};
+
+static H2Registry& __Registry() {
+    static H2Registry* registry = new H2Registry;
+    return *registry;
+}
+
+static std::string __Destination(const socket_address& _address) {
+    return std::string(_address.ip()) + ":" + std::to_string(_address.port());
+}
+
+// drops the connections that are gone; they are destroyed by the caller, outside the registry lock
+static void __SweepLocked(H2Registry& _registry, std::vector<std::shared_ptr<H2Session>>& _dead) {
+    for (auto it = _registry.sessions.begin(); it != _registry.sessions.end();) {
+        std::vector<std::shared_ptr<H2Session>>& sessions = it->second;
+        for (auto session = sessions.begin(); session != sessions.end();) {
+            if (!(*session)->IsAlive() && 0 == (*session)->StreamCount()) {
+                _dead.push_back(*session);
+                session = sessions.erase(session);
+            } else {
+                ++session;
+            }
+        }
+        it = sessions.empty() ? _registry.sessions.erase(it) : ++it;
+    }
+}
+
+static SOCKET __OpenStreamLocked(H2Registry& _registry, const std::shared_ptr<H2Session>& _session) {
+    SOCKET handle = _registry.next_handle++;
+    if (INVALID_SOCKET == _registry.next_handle || 0 > _registry.next_handle) {
+        _registry.next_handle = kFirstStreamHandle;
+    }
+    _registry.streams[handle].session = _session;
+    return handle;
+}
+
+static bool __FindStream(SOCKET _sock, StreamRef& _ref) {
+    H2Registry& registry = __Registry();
+    ScopedLock lock(registry.mutex);
+    auto it = registry.streams.find(_sock);
+    if (it == registry.streams.end())
+        return false;
+    _ref = it->second;
+    return true;
+}
+
+// the packed HTTP/1.1 head as HTTP/2 fields; connection-specific ones have no meaning on a shared connection
+static bool __ToH2Headers(const void* _head, size_t _length, http2::HeaderList& _headers, size_t& _head_length) {
+    http::Parser parser;
+    size_t consumed = 0;
+    parser.Recv(_head, _length, &consumed, true);
+    if (!parser.FieldsReady() || http::kRequest != parser.CsMode()) {
+        xerror2(TSF "not a request head, status:%_", parser.RecvStatus());
+        return false;
+    }
+    _head_length = parser.FirstLineLength() + parser.HeaderLength();
+
+    std::string path = parser.Request().Url();
+    std::string authority;
+    if (0 == path.compare(0, 7, "http://")) {
+        size_t slash = path.find('/', 7);
+        authority = path.substr(7, slash == std::string::npos ? std::string::npos : slash - 7);
+        path = slash == std::string::npos ? "/" : path.substr(slash);
+    }
+
+    http2::HeaderList fields;
+    std::list<std::pair<const std::string, const std::string>> list = parser.Fields().GetAsList();
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        std::string name = it->first;
+        strutil::ToLower(name);
+        if ("host" == name) {
+            authority = it->second;
+            continue;
+        }
+        if ("connection" == name || "keep-alive" == name || "proxy-connection" == name || "transfer-encoding" == name
+            || "upgrade" == name || "te" == name)
+            continue;
+        fields.push_back(std::make_pair(name, it->second));
+    }
+
+    _headers.clear();
+    _headers.push_back(std::make_pair(std::string(":method"),
+                                      std::string(http::RequestLine::kHttpMethodString[parser.Request().Method()])));
+    _headers.push_back(std::make_pair(std::string(":scheme"), std::string("http")));
+    _headers.push_back(std::make_pair(std::string(":authority"), authority));
+    _headers.push_back(std::make_pair(std::string(":path"), path));
+    _headers.insert(_headers.end(), fields.begin(), fields.end());
+    return true;
+}
+
+}  // namespace
+
+class H2SocketOperator::H2Breaker : public OPBreaker {
+ public:
+    H2Breaker(H2SocketOperator& _operator) : operator_(_operator) {
+    }
+    bool IsBreak() {
+        return operator_.cancel_;
+    }
+    bool Break() {
+        operator_.cancel_ = true;
+        operator_.tcp_.Breaker().Break();
+
+        ScopedLock lock(operator_.mutex_);
+        if (operator_.session_) {
+            operator_.session_->Wake();
+        }
+        return true;
+    }
+
+ private:
+    H2SocketOperator& operator_;
+};
+
+H2SocketOperator::H2SocketOperator(std::shared_ptr<MComplexConnect> _observer)
+: SocketOperator(), tcp_(_observer), cancel_(false) {
+    breaker_ = std::make_unique<H2Breaker>(*this);
+}
+
+H2SocketOperator::~H2SocketOperator() {
+}
+
+SOCKET H2SocketOperator::Connect(const std::vector<socket_address>& _vecaddr,
+                                 mars::comm::ProxyType _proxy_type,
+                                 const socket_address* _proxy_addr,
+                                 const std::string& _proxy_username,
+                                 const std::string& _proxy_pwd) {
+    if (mars::comm::kProxyNone != _proxy_type) {
+        xerror2(TSF "h2 over a proxy is not supported, proxy type:%_", _proxy_type);
+        profile_.errorCode = SOCKET_ERRNO(EPROTONOSUPPORT);
+        return INVALID_SOCKET;
+    }
+
+    H2Registry& registry = __Registry();
+    std::vector<std::shared_ptr<H2Session>> dead;
+    ScopedLock lock(registry.mutex);
+    __SweepLocked(registry, dead);
+
+    // a connection with room to any of the addresses, in the order they would be tried
+    for (size_t i = 0; i < _vecaddr.size(); ++i) {
+        auto it = registry.sessions.find(__Destination(_vecaddr[i]));
+        if (it == registry.sessions.end())
+            continue;
+
+        for (size_t j = 0; j < it->second.size(); ++j) {
+            std::shared_ptr<H2Session> session = it->second[j];
+            if (!session->Reserve())
+                continue;
+
+            SOCKET handle = __OpenStreamLocked(registry, session);
+            lock.unlock();
+
+            profile_ = SocketProfile();
+            profile_.index = (int)i;
+            ScopedLock session_lock(mutex_);
+            session_ = session;
+            xinfo2(TSF "h2 stream %_ multiplexed on sock:%_ %_", handle, session->Socket(), session->Destination());
+            return handle;
+        }
+    }
+    lock.unlock();
+    dead.clear();
+
+    SOCKET sock = tcp_.Connect(_vecaddr);
+    profile_ = tcp_.Profile();
+    if (INVALID_SOCKET == sock)
+        return INVALID_SOCKET;
+
+    std::shared_ptr<H2Session> session =
+        std::make_shared<H2Session>(sock, __Destination(_vecaddr[profile_.index]));
+    int errcode = 0;
+    if (!session->Start(errcode)) {
+        xerror2(TSF "h2 session start fail, sock:%_, errno:%_", sock, errcode);
+        profile_.errorCode = errcode;
+        return INVALID_SOCKET;
+    }
+    session->Reserve();
+
+    lock.lock();
+    registry.sessions[session->Destination()].push_back(session);
+    SOCKET handle = __OpenStreamLocked(registry, session);
+    lock.unlock();
+
+    ScopedLock session_lock(mutex_);
+    session_ = session;
+    return handle;
+}
+
+void H2SocketOperator::Close(SOCKET _sock) {
+    CloseStream(_sock);
+    ScopedLock lock(mutex_);
+    session_.reset();
+}
+
+int H2SocketOperator::Send(SOCKET _sock, const void* _buffer, size_t _len, int& _errcode, int _timeout) {
+    http2::HeaderList headers;
+    size_t head_len = 0;
+    if (!__ToH2Headers(_buffer, _len, headers, head_len)) {
+        _errcode = SOCKET_ERRNO(EINVAL);
+        return -1;
+    }
+    return __SendRequest(_sock, _buffer, head_len, (const char*)_buffer + head_len, _len - head_len, _errcode, _timeout);
+}
+
+int H2SocketOperator::SendV(SOCKET _sock,
+                            const void* _head,
+                            size_t _head_len,
+                            const void* _body,
+                            size_t _body_len,
+                            int& _errcode,
+                            int _timeout) {
+    return __SendRequest(_sock, _head, _head_len, _body, _body_len, _errcode, _timeout);
+}
+
+int H2SocketOperator::Recv(SOCKET _sock,
+                           AutoBuffer& _buffer,
+                           size_t _max_size,
+                           int& _errcode,
+                           int _timeout,
+                           bool _wait_full_size) {
+    StreamRef ref;
+    if (!__FindStream(_sock, ref) || 0 == ref.stream_id) {
+        _errcode = SOCKET_ERRNO(ENOTCONN);
+        return -1;
+    }
+    return ref.session->Recv(ref.stream_id, _buffer, _max_size, cancel_, _timeout, _errcode);
+}
+
+std::string H2SocketOperator::ErrorDesc(int _errcode) {
+    return strerror(_errcode);
+}
+
+std::string H2SocketOperator::Identify(SOCKET _sock) const {
+    StreamRef ref;
+    char szmsg[64];
+    if (__FindStream(_sock, ref)) {
+        snprintf(szmsg, sizeof(szmsg), "%d@H2#%u", ref.session->Socket(), ref.stream_id);
+    } else {
+        snprintf(szmsg, sizeof(szmsg), "%d@H2", _sock);
+    }
+    return std::string(szmsg);
+}
+
+int H2SocketOperator::CloseStream(SOCKET _stream) {
+    H2Registry& registry = __Registry();
+    std::vector<std::shared_ptr<H2Session>> dead;
+    ScopedLock lock(registry.mutex);
+    auto it = registry.streams.find(_stream);
+    if (it == registry.streams.end())
+        return -1;
+
+    StreamRef ref = it->second;
+    registry.streams.erase(it);
+    lock.unlock();
+
+    if (0 == ref.stream_id) {
+        ref.session->Unreserve();
+    } else {
+        ref.session->CloseStream(ref.stream_id);
+    }
+
+    lock.lock();
+    __SweepLocked(registry, dead);
+    return 0;
+}
+
+size_t H2SocketOperator::SessionCount() {
+    H2Registry& registry = __Registry();
+    ScopedLock lock(registry.mutex);
+    size_t count = 0;
+    for (auto it = registry.sessions.begin(); it != registry.sessions.end(); ++it) {
+        for (size_t i = 0; i < it->second.size(); ++i) {
+            count += it->second[i]->IsAlive() ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+int H2SocketOperator::__SendRequest(SOCKET _sock,
+                                    const void* _head,
+                                    size_t _head_len,
+                                    const void* _body,
+                                    size_t _body_len,
+                                    int& _errcode,
+                                    int _timeout) {
+    _errcode = 0;
+    StreamRef ref;
+    if (!__FindStream(_sock, ref) || 0 != ref.stream_id) {
+        _errcode = SOCKET_ERRNO(EBADF);
+        return -1;
+    }
+
+    http2::HeaderList headers;
+    size_t head_len = 0;
+    if (!__ToH2Headers(_head, _head_len, headers, head_len)) {
+        ref.session->Unreserve();
+        H2Registry& registry = __Registry();
+        ScopedLock lock(registry.mutex);
+        registry.streams.erase(_sock);
+        _errcode = SOCKET_ERRNO(EINVAL);
+        return -1;
+    }
+
+    uint32_t stream_id = ref.session->SendHeaders(headers, 0 == _body_len, _errcode);
+    {
+        // the slot is used up either way; a failed stream is closed as one that never got an id
+        H2Registry& registry = __Registry();
+        ScopedLock lock(registry.mutex);
+        auto it = registry.streams.find(_sock);
+        if (it != registry.streams.end() && 0 != stream_id) {
+            it->second.stream_id = stream_id;
+        } else if (it != registry.streams.end()) {
+            registry.streams.erase(it);
+        }
+    }
+    if (0 == stream_id)
+        return -1;
+    if (0 == _body_len)
+        return (int)_head_len;
+
+    int ret = ref.session->SendData(stream_id, _body, _body_len, true, cancel_, _timeout, _errcode);
+    return 0 > ret ? ret : (int)_head_len + ret;
+}
+
+}  // namespace stn
+}  // namespace mars
@@ -0,0 +1,118 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * h2_socket_operator.h
+ *
+ * Short links over cleartext HTTP/2. Connect hands out a stream on a shared
+ * connection to the destination, opening one only when none has room; Send
+ * turns the packed HTTP/1.1 request into HEADERS and DATA, and Recv gives the
+ * response back as HTTP/1.1, so ShortLink runs unchanged on top of it.
+ */
+
+#ifndef STN_SRC_H2_SOCKET_OPERATOR_H_
+#define STN_SRC_H2_SOCKET_OPERATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mars/comm/thread/mutex.h"
+#include "mars/stn/stn.h"
+#include "socket_operator.h"
+#include "tcp_socket_operator.h"
+
+namespace mars {
+namespace stn {
+
+class H2Session;
+
+class H2SocketOperator : public SocketOperator {
+ public:
+    H2SocketOperator(std::shared_ptr<comm::MComplexConnect> _observer);
+    virtual ~H2SocketOperator() override;
+
+    // the SOCKET returned is a handle to a stream, only good for this operator's calls and CloseStream
+    virtual SOCKET Connect(const std::vector<socket_address>& _vecaddr,
+                           mars::comm::ProxyType _proxy_type = mars::comm::kProxyNone,
+                           const socket_address* _proxy_addr = NULL,
+                           const std::string& _proxy_username = "",
+                           const std::string& _proxy_pwd = "") override;
+
+    virtual void Close(SOCKET _sock) override;
+    SocketCloseFunc GetCloseFunction() const override {
+        return &H2SocketOperator::CloseStream;
+    }
+    CreateStreamFunc GetCreateStreamFunc() const override {
+        return nullptr;
+    }
+    IsSubStreamFunc GetIsSubStreamFunc() const override {
+        return nullptr;
+    }
+    // one packed request per stream: the first call carries the head, and the whole body
+    virtual int Send(SOCKET _sock, const void* _buffer, size_t _len, int& _errcode, int _timeout) override;
+    virtual int SendV(SOCKET _sock,
+                      const void* _head,
+                      size_t _head_len,
+                      const void* _body,
+                      size_t _body_len,
+                      int& _errcode,
+                      int _timeout) override;
+
+    virtual int Recv(SOCKET _sock,
+                     AutoBuffer& _buffer,
+                     size_t _max_size,
+                     int& _errcode,
+                     int _timeout,
+                     bool _wait_full_size) override;
+
+    virtual std::string ErrorDesc(int _errcode) override;
+
+    std::string Identify(SOCKET _sock) const override;
+    int Protocol() const override {
+        return Task::kTransportProtocolHTTP2;
+    }
+    virtual SOCKET CreateStream(SOCKET _sock) override {
+        return INVALID_SOCKET;
+    }
+    void SetIpConnectionTimeout(uint32_t _v4_timeout, uint32_t _v6_timeout) override {
+        tcp_.SetIpConnectionTimeout(_v4_timeout, _v6_timeout);
+    }
+
+    // resets the stream if it is still open and gives its slot back to the connection
+    static int CloseStream(SOCKET _stream);
+    // connections currently shared, for tests
+    static size_t SessionCount();
+
+ private:
+    class H2Breaker;
+
+    int __SendRequest(SOCKET _sock,
+                      const void* _head,
+                      size_t _head_len,
+                      const void* _body,
+                      size_t _body_len,
+                      int& _errcode,
+                      int _timeout);
+
+ private:
+    TcpSocketOperator tcp_;
+    std::atomic<bool> cancel_;
+    comm::Mutex mutex_;
+    std::shared_ptr<H2Session> session_;  // the one the current stream is on, woken by the breaker
+};
+
+}  // namespace stn
+}  // namespace mars
+
+#endif  // STN_SRC_H2_SOCKET_OPERATOR_H_
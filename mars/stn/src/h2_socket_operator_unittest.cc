@@ -0,0 +1,631 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * h2_socket_operator_unittest.cc
+ *
+ * Short-link exchanges over H2SocketOperator against a local h2c stand-in
+ * server: concurrent requests on one connection, HPACK on the repeated
+ * headers, flow control both ways, stream cancellation and resets, and a
+ * header block that never ends.
+ */
+
+#include "h2_socket_operator.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "h2_session.h"
+#include "mars/comm/http.h"
+#include "mars/comm/http2.h"
+
+using namespace mars::stn;
+
+namespace {
+
+std::string Payload(size_t _len, char _seed) {
+    std::string payload(_len, '\0');
+    for (size_t i = 0; i < _len; ++i) {
+        payload[i] = (char)(_seed + i % 23);
+    }
+    return payload;
+}
+
+// one connection of the stand-in server: a single thread reading frames and answering within the windows
+class H2StandInConnection {
+ public:
+    struct Request {
+        Request() : complete(false), answered(false), closed(false), send_window(0), body_pos(0) {
+        }
+        std::string path;
+        std::string body;
+        bool complete;
+        bool answered;
+        bool closed;
+        int64_t send_window;
+        std::string response;  // body still to send
+        size_t body_pos;
+    };
+
+    H2StandInConnection(int _fd, uint32_t _initial_window, size_t _barrier)
+    : fd_(_fd)
+    , initial_window_(_initial_window)
+    , barrier_(_barrier)
+    , stop_(false)
+    , peer_initial_window_(http2::kDefaultWindowSize)
+    , send_window_(http2::kDefaultWindowSize)
+    , open_(0)
+    , peak_open_(0)
+    , window_updates_(0)
+    , goaway_(kNoGoAway)
+    , header_stream_(0)
+    , thread_(&H2StandInConnection::Run, this) {
+    }
+
+    ~H2StandInConnection() {
+        stop_ = true;
+        thread_.join();
+        close(fd_);
+    }
+
+    size_t PeakOpen() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return peak_open_;
+    }
+    size_t WindowUpdates() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return window_updates_;
+    }
+    std::vector<size_t> HeaderBlocks() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return header_blocks_;
+    }
+    std::map<uint32_t, uint32_t> Resets() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return resets_;
+    }
+    // error code of the client's GOAWAY, kNoGoAway until one came
+    uint32_t GoAway() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return goaway_;
+    }
+
+    static const uint32_t kNoGoAway = 0xffffffff;
+
+ private:
+    void Run() {
+        std::string preface(http2::kConnectionPrefaceLength, '\0');
+        if (!ReadFull(&preface[0], preface.size()) || 0 != memcmp(preface.data(), http2::kConnectionPreface, preface.size()))
+            return;
+
+        http2::SettingList settings;
+        settings.push_back(std::make_pair((uint16_t)http2::kSettingsMaxConcurrentStreams, (uint32_t)100));
+        settings.push_back(std::make_pair((uint16_t)http2::kSettingsInitialWindowSize, initial_window_));
+        AutoBuffer out;
+        http2::PackSettings(settings, out);
+        Write(out);
+
+        std::string input;
+        while (!stop_) {
+            pollfd pfd = {fd_, POLLIN, 0};
+            if (0 < poll(&pfd, 1, 5)) {
+                char buf[64 * 1024];
+                ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+                if (0 >= n)
+                    return;
+                input.append(buf, n);
+            }
+
+            http2::FrameHeader header;
+            size_t pos = 0;
+            while (http2::UnpackFrameHeader(input.data() + pos, input.size() - pos, header)
+                   && input.size() - pos >= http2::kFrameHeaderLength + header.length) {
+                OnFrame(header, (const uint8_t*)input.data() + pos + http2::kFrameHeaderLength);
+                pos += http2::kFrameHeaderLength + header.length;
+            }
+            input.erase(0, pos);
+            Answer();
+        }
+    }
+
+    void OnFrame(const http2::FrameHeader& _header, const uint8_t* _payload) {
+        AutoBuffer out;
+        std::lock_guard<std::mutex> lock(mutex_);
+        switch (_header.type) {
+            case http2::kFrameSettings: {
+                if (_header.flags & http2::kFlagAck)
+                    break;
+                http2::SettingList settings;
+                http2::UnpackSettings(_payload, _header.length, settings);
+                for (size_t i = 0; i < settings.size(); ++i) {
+                    if (http2::kSettingsInitialWindowSize == settings[i].first) {
+                        peer_initial_window_ = settings[i].second;
+                    }
+                }
+                http2::PackSettingsAck(out);
+                break;
+            }
+            case http2::kFrameWindowUpdate: {
+                uint32_t increment = http2::ReadUint32(_payload);
+                ++window_updates_;
+                if (0 == _header.stream_id) {
+                    send_window_ += increment;
+                } else if (requests_.count(_header.stream_id)) {
+                    requests_[_header.stream_id].send_window += increment;
+                }
+                break;
+            }
+            case http2::kFrameHeaders:
+            case http2::kFrameContinuation: {
+                if (http2::kFrameHeaders == _header.type) {
+                    header_block_.assign((const char*)_payload, _header.length);
+                    header_stream_ = _header.stream_id;
+                    header_end_stream_ = 0 != (_header.flags & http2::kFlagEndStream);
+                } else {
+                    header_block_.append((const char*)_payload, _header.length);
+                }
+                if (!(_header.flags & http2::kFlagEndHeaders))
+                    break;
+
+                http2::HeaderList headers;
+                EXPECT_TRUE(decoder_.Decode(header_block_.data(), header_block_.size(), headers));
+                header_blocks_.push_back(header_block_.size());
+
+                Request& request = requests_[header_stream_];
+                request.send_window = peer_initial_window_;
+                for (size_t i = 0; i < headers.size(); ++i) {
+                    if (":path" == headers[i].first) {
+                        request.path = headers[i].second;
+                    }
+                    EXPECT_NE("connection", headers[i].first);
+                }
+                request.complete = header_end_stream_;
+                peak_open_ = std::max(peak_open_, ++open_);
+                header_stream_ = 0;
+                break;
+            }
+            case http2::kFrameData: {
+                Request& request = requests_[_header.stream_id];
+                request.body.append((const char*)_payload, _header.length);
+                request.complete = 0 != (_header.flags & http2::kFlagEndStream);
+                // read as it comes, so the client is only held back by the small initial window
+                if (0 < _header.length) {
+                    http2::PackWindowUpdate(0, _header.length, out);
+                    if (!request.complete) {
+                        http2::PackWindowUpdate(_header.stream_id, _header.length, out);
+                    }
+                }
+                break;
+            }
+            case http2::kFrameRstStream:
+                resets_[_header.stream_id] = http2::ReadUint32(_payload);
+                if (requests_.count(_header.stream_id) && !requests_[_header.stream_id].closed) {
+                    requests_[_header.stream_id].closed = true;
+                    --open_;
+                }
+                break;
+            case http2::kFramePing:
+                if (!(_header.flags & http2::kFlagAck)) {
+                    http2::PackPing(true, _payload, out);
+                }
+                break;
+            case http2::kFrameGoAway:
+                goaway_ = http2::ReadUint32(_payload + 4);
+                break;
+            default:
+                break;
+        }
+        Write(out);
+    }
+
+    void Answer() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t complete = 0;
+        for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+            complete += it->second.complete ? 1 : 0;
+        }
+        // with a barrier nothing is answered before that many requests are in flight together
+        if (complete < barrier_)
+            return;
+
+        for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+            uint32_t stream_id = it->first;
+            Request& request = it->second;
+            if (!request.complete || request.closed || "/hang" == request.path)
+                continue;
+
+            AutoBuffer out;
+            if (!request.answered) {
+                request.answered = true;
+                if ("/refuse" == request.path) {
+                    http2::PackRstStream(stream_id, http2::kRefusedStream, out);
+                    request.closed = true;
+                    --open_;
+                    Write(out);
+                    continue;
+                }
+                if ("/flood" == request.path) {
+                    // HEADERS without END_HEADERS, then CONTINUATIONs well past any sane header block
+                    std::string fragment(http2::kDefaultMaxFrameSize, 'h');
+                    http2::PackFrame(http2::kFrameHeaders, 0, stream_id, fragment.data(), fragment.size(), out);
+                    for (int i = 0; i < 8; ++i) {
+                        http2::PackFrame(http2::kFrameContinuation,
+                                         0,
+                                         stream_id,
+                                         fragment.data(),
+                                         fragment.size(),
+                                         out);
+                    }
+                    request.closed = true;
+                    --open_;
+                    Write(out);
+                    continue;
+                }
+                if (0 == request.path.compare(0, 6, "/size/")) {
+                    request.response = Payload(strtoul(request.path.c_str() + 6, NULL, 10), 'A');
+                } else {
+                    request.response = request.body;
+                }
+
+                http2::HeaderList headers;
+                headers.push_back(std::make_pair(":status", "200"));
+                headers.push_back(std::make_pair("content-type", "application/octet-stream"));
+                if ("/chunked" != request.path) {
+                    headers.push_back(std::make_pair("content-length", std::to_string(request.response.size())));
+                }
+                AutoBuffer block;
+                encoder_.Encode(headers, block);
+                http2::PackFrame(http2::kFrameHeaders,
+                                 http2::kFlagEndHeaders | (request.response.empty() ? http2::kFlagEndStream : 0),
+                                 stream_id,
+                                 block.Ptr(),
+                                 block.Length(),
+                                 out);
+                if (request.response.empty()) {
+                    request.closed = true;
+                    --open_;
+                }
+            }
+
+            while (!request.closed && 0 < send_window_ && 0 < request.send_window) {
+                size_t length = std::min<size_t>(request.response.size() - request.body_pos, http2::kDefaultMaxFrameSize);
+                length = (size_t)std::min<int64_t>(length, std::min(send_window_, request.send_window));
+                bool last = request.body_pos + length == request.response.size();
+                http2::PackFrame(http2::kFrameData,
+                                 last ? http2::kFlagEndStream : 0,
+                                 stream_id,
+                                 request.response.data() + request.body_pos,
+                                 length,
+                                 out);
+                request.body_pos += length;
+                request.send_window -= length;
+                send_window_ -= length;
+                if (last) {
+                    request.closed = true;
+                    --open_;
+                }
+            }
+            Write(out);
+        }
+    }
+
+    bool ReadFull(char* _buffer, size_t _length) {
+        size_t got = 0;
+        while (got < _length) {
+            ssize_t n = recv(fd_, _buffer + got, _length - got, 0);
+            if (0 >= n)
+                return false;
+            got += n;
+        }
+        return true;
+    }
+
+    void Write(const AutoBuffer& _out) {
+        size_t sent = 0;
+        while (sent < _out.Length()) {
+            ssize_t n = send(fd_, (const char*)_out.Ptr() + sent, _out.Length() - sent, MSG_NOSIGNAL);
+            if (0 >= n)
+                return;
+            sent += n;
+        }
+    }
+
+ private:
+    int fd_;
+    const uint32_t initial_window_;
+    const size_t barrier_;
+    std::atomic<bool> stop_;
+
+    std::mutex mutex_;
+    http2::HpackDecoder decoder_;
+    http2::HpackEncoder encoder_;
+    uint32_t peer_initial_window_;
+    int64_t send_window_;
+    std::map<uint32_t, Request> requests_;
+    size_t open_;
+    size_t peak_open_;
+    size_t window_updates_;
+    std::vector<size_t> header_blocks_;
+    std::map<uint32_t, uint32_t> resets_;
+    uint32_t goaway_;
+
+    std::string header_block_;
+    uint32_t header_stream_;
+    bool header_end_stream_;
+
+    std::thread thread_;
+};
+
+class H2StandIn {
+ public:
+    explicit H2StandIn(uint32_t _initial_window = http2::kDefaultWindowSize, size_t _barrier = 0)
+    : initial_window_(_initial_window), barrier_(_barrier), stop_(false) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, (sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd_, (sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+        listen(listen_fd_, 16);
+        thread_ = std::thread(&H2StandIn::Accept, this);
+    }
+
+    ~H2StandIn() {
+        stop_ = true;
+        thread_.join();
+        close(listen_fd_);
+        for (size_t i = 0; i < connections_.size(); ++i) {
+            delete connections_[i];
+        }
+    }
+
+    uint16_t Port() const {
+        return port_;
+    }
+    size_t Accepted() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connections_.size();
+    }
+    H2StandInConnection& Connection(size_t _index) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return *connections_[_index];
+    }
+
+ private:
+    void Accept() {
+        while (!stop_) {
+            pollfd pfd = {listen_fd_, POLLIN, 0};
+            if (0 >= poll(&pfd, 1, 10))
+                continue;
+            int fd = accept(listen_fd_, NULL, NULL);
+            if (0 > fd)
+                continue;
+            std::lock_guard<std::mutex> lock(mutex_);
+            connections_.push_back(new H2StandInConnection(fd, initial_window_, barrier_));
+        }
+    }
+
+ private:
+    const uint32_t initial_window_;
+    const size_t barrier_;
+    int listen_fd_;
+    uint16_t port_;
+    std::atomic<bool> stop_;
+    std::mutex mutex_;
+    std::vector<H2StandInConnection*> connections_;
+    std::thread thread_;
+};
+
+// what shortlink_pack puts in front of the body
+std::string Head(const std::string& _path, size_t _body_len) {
+    return "POST " + _path + " HTTP/1.1\r\n"
+           + "Accept: */*\r\n"
+             "User-Agent: MicroMessenger Client\r\n"
+             "Cache-Control: no-cache\r\n"
+             "Content-Type: application/octet-stream\r\n"
+             "Connection: close\r\n"
+             "Content-Length: "
+           + std::to_string(_body_len) + "\r\nHost: short.example.com\r\nX-Online-Host: short.example.com\r\n\r\n";
+}
+
+// Send then Recv until the response parses, the way ShortLink drives a SocketOperator
+int Exchange(SocketOperator& _operator,
+             SOCKET _sock,
+             const std::string& _path,
+             const std::string& _body,
+             std::string& _response,
+             int& _errcode) {
+    std::string head = Head(_path, _body.size());
+    if (0 > _operator.SendV(_sock, head.data(), head.size(), _body.data(), _body.size(), _errcode, 5000))
+        return -1;
+
+    AutoBuffer body;
+    http::Parser parser(new http::MemoryBodyReceiver(body), true);
+    AutoBuffer recv_buf;
+    while (!parser.Success()) {
+        int ret = _operator.Recv(_sock, recv_buf, 64 * 1024, _errcode, 5000, false);
+        if (0 >= ret)
+            return ret;
+        parser.Recv(recv_buf.Ptr(recv_buf.Length() - ret), ret);
+        if (parser.Error())
+            return -1;
+    }
+    _response.assign((const char*)body.Ptr(), body.Length());
+    return parser.Status().StatusCode();
+}
+
+std::vector<socket_address> Loopback(uint16_t _port) {
+    return std::vector<socket_address>(1, socket_address("127.0.0.1", _port));
+}
+
+}  // namespace
+
+TEST(h2_socket_operator, concurrent_requests_share_one_connection) {
+    const size_t kRequests = 8;
+    // nothing is answered until all of them are in flight at once
+    H2StandIn server(http2::kDefaultWindowSize, kRequests);
+
+    std::vector<std::unique_ptr<H2SocketOperator>> operators;
+    std::vector<SOCKET> socks;
+    for (size_t i = 0; i < kRequests; ++i) {
+        operators.emplace_back(new H2SocketOperator(nullptr));
+        socks.push_back(operators[i]->Connect(Loopback(server.Port())));
+        ASSERT_NE(INVALID_SOCKET, socks[i]);
+    }
+
+    std::vector<std::string> responses(kRequests);
+    std::vector<int> statuses(kRequests);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kRequests; ++i) {
+        threads.emplace_back([&, i]() {
+            int errcode = 0;
+            statuses[i] = Exchange(*operators[i], socks[i], "/echo", Payload(1000 + i, 'a' + i), responses[i], errcode);
+        });
+    }
+    for (size_t i = 0; i < kRequests; ++i) {
+        threads[i].join();
+        EXPECT_EQ(200, statuses[i]);
+        EXPECT_TRUE(Payload(1000 + i, 'a' + i) == responses[i]) << i;
+        operators[i]->Close(socks[i]);
+    }
+
+    EXPECT_EQ(1u, server.Accepted());
+    EXPECT_EQ(kRequests, server.Connection(0).PeakOpen());
+    EXPECT_TRUE(server.Connection(0).Resets().empty());
+}
+
+TEST(h2_socket_operator, repeated_headers_are_compressed) {
+    H2StandIn server;
+    H2SocketOperator op(nullptr);
+    std::string response;
+    int errcode = 0;
+    for (int i = 0; i < 5; ++i) {
+        SOCKET sock = op.Connect(Loopback(server.Port()));
+        ASSERT_NE(INVALID_SOCKET, sock);
+        EXPECT_EQ(200, Exchange(op, sock, "/cgi-bin/micromsg-bin/newsync", "body", response, errcode));
+        op.Close(sock);
+    }
+    ASSERT_EQ(1u, server.Accepted());
+
+    std::vector<size_t> blocks = server.Connection(0).HeaderBlocks();
+    ASSERT_EQ(5u, blocks.size());
+    EXPECT_LT(blocks[0], Head("/cgi-bin/micromsg-bin/newsync", 4).size());
+    // from the second request on the fields that repeat are one byte each
+    for (size_t i = 1; i < blocks.size(); ++i) {
+        EXPECT_LT(blocks[i] * 3, blocks[0]) << blocks[i] << " against " << blocks[0];
+    }
+}
+
+TEST(h2_socket_operator, flow_control) {
+    // the server's window makes the upload wait for WINDOW_UPDATEs, the download is bigger than the client's
+    H2StandIn server(16 * 1024);
+    H2SocketOperator op(nullptr);
+
+    SOCKET sock = op.Connect(Loopback(server.Port()));
+    ASSERT_NE(INVALID_SOCKET, sock);
+    std::string upload = Payload(300 * 1024, 'u');
+    std::string response;
+    int errcode = 0;
+    EXPECT_EQ(200, Exchange(op, sock, "/echo", upload, response, errcode));
+    EXPECT_TRUE(upload == response);
+    op.Close(sock);
+
+    const size_t kDownload = 3 * H2Session::kStreamWindow;
+    sock = op.Connect(Loopback(server.Port()));
+    EXPECT_EQ(200, Exchange(op, sock, "/size/" + std::to_string(kDownload), "", response, errcode));
+    EXPECT_EQ(kDownload, response.size());
+    EXPECT_TRUE(Payload(kDownload, 'A') == response);
+    op.Close(sock);
+
+    // no content-length: rendered as chunks for the HTTP/1.1 parser
+    sock = op.Connect(Loopback(server.Port()));
+    EXPECT_EQ(200, Exchange(op, sock, "/chunked", upload, response, errcode));
+    EXPECT_TRUE(upload == response);
+    op.Close(sock);
+
+    EXPECT_EQ(1u, server.Accepted());
+    EXPECT_LE(4u, server.Connection(0).WindowUpdates());
+}
+
+TEST(h2_socket_operator, cancel_resets_only_its_stream) {
+    H2StandIn server;
+    H2SocketOperator hanging(nullptr);
+    SOCKET sock = hanging.Connect(Loopback(server.Port()));
+    ASSERT_NE(INVALID_SOCKET, sock);
+
+    std::thread canceler([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        hanging.Breaker().Break();
+    });
+    std::string response;
+    int errcode = 0;
+    // the server never answers /hang, only the break ends the exchange
+    EXPECT_EQ(0, Exchange(hanging, sock, "/hang", "", response, errcode));
+    canceler.join();
+    EXPECT_TRUE(hanging.Breaker().IsBreak());
+    hanging.Close(sock);
+
+    // refused by the server: an error on that stream only
+    H2SocketOperator refused(nullptr);
+    sock = refused.Connect(Loopback(server.Port()));
+    EXPECT_EQ(-1, Exchange(refused, sock, "/refuse", "", response, errcode));
+    EXPECT_EQ(ECONNREFUSED, errcode);
+    refused.Close(sock);
+
+    H2SocketOperator next(nullptr);
+    sock = next.Connect(Loopback(server.Port()));
+    EXPECT_EQ(200, Exchange(next, sock, "/echo", "still there", response, errcode));
+    EXPECT_EQ("still there", response);
+    next.Close(sock);
+
+    for (int i = 0; i < 100 && server.Connection(0).Resets().empty(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::map<uint32_t, uint32_t> resets = server.Connection(0).Resets();
+    ASSERT_EQ(1u, resets.size());
+    EXPECT_EQ(1u, resets.begin()->first);
+    EXPECT_EQ((uint32_t)http2::kCancel, resets.begin()->second);
+    EXPECT_EQ(1u, server.Accepted());
+}
+
+TEST(h2_socket_operator, endless_header_block_is_a_connection_error) {
+    H2StandIn server;
+    H2SocketOperator op(nullptr);
+    SOCKET sock = op.Connect(Loopback(server.Port()));
+    ASSERT_NE(INVALID_SOCKET, sock);
+
+    std::string response;
+    int errcode = 0;
+    EXPECT_EQ(-1, Exchange(op, sock, "/flood", "", response, errcode));
+    EXPECT_EQ(ECONNRESET, errcode);
+    op.Close(sock);
+
+    for (int i = 0; i < 100 && H2StandInConnection::kNoGoAway == server.Connection(0).GoAway(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ((uint32_t)http2::kEnhanceYourCalm, server.Connection(0).GoAway());
+}
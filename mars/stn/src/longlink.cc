@@ -29,10 +29,12 @@
 #include "mars/comm/autobuffer.h"
 #include "mars/comm/comm_data.h"
 #include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/metrics.h"
 #include "mars/comm/platform_comm.h"
 #include "mars/comm/socket/complexconnect.h"
 #include "mars/comm/socket/local_ipstack.h"
 #include "mars/comm/socket/socket_address.h"
+#include "mars/comm/socket/stream_reader.h"
 #include "mars/comm/socket/unix_socket.h"
 #include "mars/comm/thread/lock.h"
 #include "mars/comm/xlogger/xlogger.h"
@@ -61,11 +63,61 @@ static const int kAlarmNoopInternalType = 103;
 static const int kAlarmNoopTimeOutType = 104;
 #endif
 
+static Counter sg_sent_bytes("stn.longlink.sent_bytes");
+static Counter sg_recv_bytes("stn.longlink.recv_bytes");
+
 namespace {
+// the items of one connect, which may still be resolving while it connects; a feed index is an
+// index into items
+class ResolvedItems {
+ public:
+    explicit ResolvedItems(bool _interleave_family) : finished_(false), feed_(_interleave_family) {
+    }
+
+    void Push(const std::vector<IPPortItem>& _items, const std::vector<socket_address>& _addrs) {
+        ScopedLock lock(mutex_);
+        items_.insert(items_.end(), _items.begin(), _items.end());
+        feed_.Push(_addrs);
+        cond_.notifyAll(lock);
+    }
+    void Finish() {
+        ScopedLock lock(mutex_);
+        finished_ = true;
+        feed_.Finish();
+        cond_.notifyAll(lock);
+    }
+    // until the first host is resolved, or all have failed
+    void WaitFirst() {
+        ScopedLock lock(mutex_);
+        while (items_.empty() && !finished_) {
+            cond_.wait(lock);
+        }
+    }
+
+    IPPortItem At(unsigned int _index) {
+        ScopedLock lock(mutex_);
+        return items_[_index];
+    }
+    std::vector<IPPortItem> Items() {
+        ScopedLock lock(mutex_);
+        return items_;
+    }
+    ConnectFeed& Feed() {
+        return feed_;
+    }
+
+ private:
+    Mutex mutex_;
+    Condition cond_;
+    bool finished_;
+    std::vector<IPPortItem> items_;
+    ConnectFeed feed_;
+};
+
 class LongLinkConnectObserver : public MComplexConnect {
  public:
-    LongLinkConnectObserver(LongLink& _longlink, const std::vector<IPPortItem>& _iplist)
-    : longlink_(_longlink), ip_items_(_iplist) {
+    LongLinkConnectObserver(LongLink& _longlink, ResolvedItems& _resolved)
+    : longlink_(_longlink), resolved_(_resolved) {
         memset(connecting_index_, 0, sizeof(connecting_index_));
     };
 
@@ -80,10 +132,8 @@ class LongLinkConnectObserver : public MComplexConnect {
                 connecting_index_[_index] = 0;
             }
         } else {
-            xwarn2(TSF "index:%_, connnet fail host:%_, iptype:%_",
-                   _index,
-                   ip_items_[_index].str_host,
-                   ip_items_[_index].source_type);
+            IPPortItem item = resolved_.At(_index);
+            xwarn2(TSF "index:%_, connnet fail host:%_, iptype:%_", _index, item.str_host, item.source_type);
             // xassert2(longlink_.fun_network_report_);
             connecting_index_[_index] = 0;
 
@@ -165,7 +215,7 @@ class LongLinkConnectObserver : public MComplexConnect {
 
  public:
     LongLink& longlink_;
-    const std::vector<IPPortItem>& ip_items_;
+    ResolvedItems& resolved_;
 };
 
 }  // namespace
@@ -198,6 +248,10 @@ LongLink::LongLink(Context* _context,
 LongLink::~LongLink() {
     xinfo_function(TSF "mars2");
     Disconnect(LongLinkErrCode::kReset);
+    if (resolve_job_) {
+        dns_util_.Cancel();
+        resolve_job_->Join();
+    }
     asyncreg_.CancelAndWait();
     if (NULL != smartheartbeat_) {
         delete smartheartbeat_, smartheartbeat_ = NULL;
@@ -209,7 +263,7 @@ LongLink::~LongLink() {
 #endif
 }
 
-bool LongLink::Send(const AutoBuffer& _body, const AutoBuffer& _extension, const Task& _task) {
+bool LongLink::Send(const AutoBuffer& _body, const AutoBuffer& _extension, const TaskDescriptor& _task) {
     ScopedLock lock(mutex_);
 
     if (kConnected != connectstatus_)
@@ -217,8 +271,9 @@ bool LongLink::Send(const AutoBuffer& _body, const AutoBuffer& _extension, const
 
     xassert2(tracker_.get());
 
+    // the task's own descriptor, shared by the send queue, the in-flight map and the nwrite log
     lstsenddata_.push_back(std::make_pair(_task, move_wrapper<AutoBuffer>(AutoBuffer())));
-    Encoder().longlink_pack(_task.cmdid, _task.taskid, _body, _extension, lstsenddata_.back().second, tracker_.get());
+    Encoder().longlink_pack(_task->cmdid, _task->taskid, _body, _extension, lstsenddata_.back().second, tracker_.get());
     lstsenddata_.back().second->Seek(0, AutoBuffer::ESeekStart);
 
     conn_profile_.start_read_packet_time = 0;
@@ -242,11 +297,11 @@ bool LongLink::SendWhenNoData(const AutoBuffer& _body,
 
     xassert2(tracker_.get());
 
-    Task task(_taskid);
-    task.send_only = true;
-    task.cmdid = _cmdid;
-    task.taskid = _taskid;
-    lstsenddata_.push_back(std::make_pair(task, move_wrapper<AutoBuffer>(AutoBuffer())));
+    std::shared_ptr<Task> task = std::make_shared<Task>(_taskid);
+    task->send_only = true;
+    task->cmdid = _cmdid;
+    task->taskid = _taskid;
+    lstsenddata_.push_back(std::make_pair(TaskDescriptor(task), move_wrapper<AutoBuffer>(AutoBuffer())));
     Encoder().longlink_pack(_cmdid, _taskid, _body, _extension, lstsenddata_.back().second, tracker_.get());
     lstsenddata_.back().second->Seek(0, AutoBuffer::ESeekStart);
 
@@ -265,7 +320,7 @@ bool LongLink::Stop(uint32_t _taskid) {
     ScopedLock lock(mutex_);
 
     for (auto it = lstsenddata_.begin(); it != lstsenddata_.end(); ++it) {
-        if (_taskid == it->first.taskid && 0 == it->second->Pos()) {
+        if (_taskid == it->first->taskid && 0 == it->second->Pos()) {
             lstsenddata_.erase(it);
             return true;
         }
@@ -362,8 +417,8 @@ bool LongLink::__NoopReq(XLogger& _log, Alarm& _alarm, bool need_active_timeout)
 #endif
     
     if (identifychecker_.GetIdentifyBuffer(buffer, req_cmdid)) {
-        Task task(Task::kLongLinkIdentifyCheckerTaskID);
-        task.cmdid = req_cmdid;
+        std::shared_ptr<Task> task = std::make_shared<Task>(Task::kLongLinkIdentifyCheckerTaskID);
+        task->cmdid = req_cmdid;
         suc = Send(buffer, KNullAtuoBuffer, task);
         identifychecker_.SetID(Task::kLongLinkIdentifyCheckerTaskID);
         xinfo2(TSF "start noop synccheck taskid:%0, cmdid:%1, ", Task::kLongLinkIdentifyCheckerTaskID, req_cmdid)
@@ -378,8 +433,7 @@ bool LongLink::__NoopReq(XLogger& _log, Alarm& _alarm, bool need_active_timeout)
         _alarm.Start(need_active_timeout ? (5 * 1000) : (8 * 1000));
 #ifdef ANDROID
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockNoopReq,
-                                                                               kLongLinkWakeupLockNoopReq));
+            wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockNoopReq));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakelock_->Lock(kLongLinkWakeupLockNoopReq);
@@ -424,8 +478,7 @@ bool LongLink::__NoopResp(uint32_t _cmdid,
         xinfo2(TSF "noop succ, interval:%_", lastheartbeat_);
 #ifdef ANDROID
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockNoopResp,
-                                                                               kLongLinkWakeupLockNoopResp));
+            wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockNoopResp));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakelock_->Lock(kLongLinkWakeupLockNoopResp);
@@ -483,8 +536,7 @@ void LongLink::__OnAlarm(bool _noop_timeout) {
     }
 #ifdef ANDROID
     if (context_->GetManager<AppManager>() != nullptr) {
-        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockOnAlarm,
-                                                                           kLongLinkWakeupLockOnAlarm));
+        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockOnAlarm));
     } else {
         xinfo2(TSF "appmanager no exist.");
         wakelock_->Lock(kLongLinkWakeupLockOnAlarm);
@@ -515,8 +567,7 @@ void LongLink::__Run() {
 
 #ifdef ANDROID
     if (context_->GetManager<AppManager>() != nullptr) {
-        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockBeforeConnection,
-                                                                           kLongLinkWakeupLockBeforeConnection));
+        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockBeforeConnection));
     } else {
         xinfo2(TSF "appmanager no exist.");
         wakelock_->Lock(kLongLinkWakeupLockBeforeConnection);
@@ -525,8 +576,7 @@ void LongLink::__Run() {
     SOCKET sock = __RunConnect(conn_profile);
 #ifdef ANDROID
     if (context_->GetManager<AppManager>() != nullptr) {
-        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockAfterConnection,
-                                                                           kLongLinkWakeupLockAfterConnection));
+        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockAfterConnection));
     } else {
         xinfo2(TSF "appmanager no exist.");
         wakelock_->Lock(kLongLinkWakeupLockAfterConnection);
@@ -564,8 +614,7 @@ void LongLink::__Run() {
 
 #ifdef ANDROID
     if (context_->GetManager<AppManager>() != nullptr) {
-        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockAfterReadWrite,
-                                                                           kLongLinkWakeupLockAfterReadWrite));
+        wakelock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockAfterReadWrite));
     } else {
         xinfo2(TSF "appmanager no exist.");
         wakelock_->Lock(kLongLinkWakeupLockAfterReadWrite);
@@ -580,9 +629,11 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
     _conn_profile.dns_time = ::gettickcount();
     __UpdateProfile(_conn_profile);
 
-    std::vector<IPPortItem> ip_items;
-    std::vector<socket_address> vecaddr;
-    netsource_->GetLongLinkItems(config_, dns_util_, ip_items, {});
+    if (resolve_job_) {  // the last connect's, which may have outlived it
+        resolve_job_->Join();
+        resolve_job_.reset();
+    }
+
     mars::comm::ProxyInfo proxy_info = context_->GetManager<AppManager>()->GetProxyInfo("");
     bool use_proxy = proxy_info.IsValid() && mars::comm::kProxyNone != proxy_info.type
                      && mars::comm::kProxyHttp != proxy_info.type && netsource_->GetLongLinkDebugIP().empty();
@@ -591,11 +642,6 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
         use_proxy = false;
     }
 
-    xinfo2(TSF "task socket dns ip:%_ proxytype:%_ useproxy:%_",
-           netsource_->DumpTable(ip_items),
-           proxy_info.type,
-           use_proxy);
-
     std::string log;
     std::string netInfo;
     getCurrNetLabel(netInfo);
@@ -603,15 +649,51 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
     bool isnat64 = ELocalIPStack_IPv6 == localstack;  // local_ipstack_detect();
     xinfo2(TSF "ipstack log:%_, netInfo:%_", log, netInfo);
 
-    for (unsigned int i = 0; i < ip_items.size(); ++i) {
-        if (use_proxy) {
+    // without a proxy, connecting starts on the first host resolved while the others still resolve
+    std::shared_ptr<ResolvedItems> resolved = std::make_shared<ResolvedItems>(!use_proxy);
+    std::vector<socket_address> vecaddr;
+    if (use_proxy) {
+        std::vector<IPPortItem> ip_items;
+        netsource_->GetLongLinkItems(config_, dns_util_, ip_items, {});
+        for (unsigned int i = 0; i < ip_items.size(); ++i) {
             vecaddr.push_back(socket_address(ip_items[i].str_ip.c_str(), ip_items[i].port));
-        } else {
-            vecaddr.push_back(socket_address(ip_items[i].str_ip.c_str(), ip_items[i].port).v4tov6_address(localstack));
         }
+        resolved->Push(ip_items, vecaddr);
+        resolved->Finish();
+    } else {
+        std::shared_ptr<NetSource> netsource = netsource_;
+        LonglinkConfig config = config_;
+        NetSource::DnsUtil* dns_util = &dns_util_;
+        resolve_job_ = Executor::Blocking().Post(
+            [resolved, netsource, config, dns_util, localstack]() {
+                std::vector<IPPortItem> ip_items;
+                netsource->GetLongLinkItems(config,
+                                            *dns_util,
+                                            ip_items,
+                                            {},
+                                            [&resolved, localstack](const std::vector<IPPortItem>& _items) {
+                                                std::vector<socket_address> addrs;
+                                                for (unsigned int i = 0; i < _items.size(); ++i) {
+                                                    addrs.push_back(
+                                                        socket_address(_items[i].str_ip.c_str(), _items[i].port)
+                                                            .v4tov6_address(localstack));
+                                                }
+                                                resolved->Push(_items, addrs);
+                                            });
+                resolved->Finish();
+            },
+            "longlink_dns");
     }
 
-    if (vecaddr.empty()) {
+    resolved->WaitFirst();
+    std::vector<IPPortItem> ip_items = resolved->Items();  // what has been resolved so far
+
+    xinfo2(TSF "task socket dns ip:%_ proxytype:%_ useproxy:%_",
+           netsource_->DumpTable(ip_items),
+           proxy_info.type,
+           use_proxy);
+
+    if (ip_items.empty()) {
         xerror2("task socket close sock:-1 vecaddr empty");
         __ConnectStatus(kConnectFailed);
         __RunResponseError(kEctDns, kEctDnsMakeSocketPrepared, _conn_profile);
@@ -664,19 +746,27 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
 
     // set the first ip info to the profiler, after connect, the ip info will be overwrriten by the real one
 
-    LongLinkConnectObserver connect_observer(*this, ip_items);
+    LongLinkConnectObserver connect_observer(*this, *resolved);
     ComplexConnect com_connect(kLonglinkConnTimeout, kLonglinkConnInteral, kLonglinkConnInteral, kLonglinkConnMax);
 
-    SOCKET sock = com_connect.ConnectImpatient(vecaddr,
-                                               connectbreak_,
-                                               &connect_observer,
-                                               proxy_info.type,
-                                               proxy_addr,
-                                               proxy_info.username,
-                                               proxy_info.password);
+    SOCKET sock = INVALID_SOCKET;
+    if (use_proxy) {
+        sock = com_connect.ConnectImpatient(vecaddr,
+                                            connectbreak_,
+                                            &connect_observer,
+                                            proxy_info.type,
+                                            proxy_addr,
+                                            proxy_info.username,
+                                            proxy_info.password);
+    } else {
+        sock = com_connect.ConnectImpatient(resolved->Feed(), connectbreak_, &connect_observer);
+    }
 
     delete proxy_addr;
 
+    ip_items = resolved->Items();
+    _conn_profile.ip_items = ip_items;
+
     _conn_profile.conn_time = gettickcount();
     _conn_profile.conn_errcode = com_connect.ErrorCode();
     _conn_profile.conn_rtt = com_connect.IndexRtt();
@@ -718,7 +808,7 @@ SOCKET LongLink::__RunConnect(ConnectProfile& _conn_profile) {
 
     if (_conn_profile.ip_index > 0) {
         for (int i = 0; i < com_connect.Index(); i++) {
-            uint16_t port = vecaddr[i].port();
+            uint16_t port = ip_items[i].port;
             if (port == 443) {
                 _conn_profile.tried_443port = 1;
             } else if (port == 80) {
@@ -779,6 +869,7 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
     std::vector<LongLinkNWriteData> nsent_datas;
 
     AutoBuffer bufrecv;
+    StreamReader reader;
     bool first_noop_sent = false;
     xgroup2_define(close_log);
 
@@ -953,25 +1044,26 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
             xinfo2(TSF"all send:%_, count:%_, ", writelen, lstsenddata_.size()) >> xlog_group;
             
             GetSignalOnNetworkDataChange()(XLOGGER_TAG, writelen, 0);
+            sg_sent_bytes.Add(writelen);
 
             auto it = lstsenddata_.begin();
 
             while (it != lstsenddata_.end() && 0 < writelen) {
                 if (0 == it->second->Pos() && OnSend)
-                    OnSend(it->first.taskid);
+                    OnSend(it->first->taskid);
 
                 if ((size_t)writelen >= it->second->PosLength()) {
                     xinfo2(TSF "sub send taskid:%_, cmdid:%_, %_, len(S:%_, %_/%_), ",
-                           it->first.taskid,
-                           it->first.cmdid,
-                           it->first.cgi,
+                           it->first->taskid,
+                           it->first->cmdid,
+                           it->first->cgi,
                            it->second->PosLength(),
                            it->second->PosLength(),
                            it->second->Length())
                         >> xlog_group;
                     writelen -= it->second->PosLength();
-                    if (!it->first.send_only) {
-                        sent_taskids[it->first.taskid].task = it->first;
+                    if (!it->first->send_only) {
+                        sent_taskids[it->first->taskid].task = it->first;
                     }
 
                     LongLinkNWriteData nwrite(it->second->Length(), it->first);
@@ -980,9 +1072,9 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
                     it = lstsenddata_.erase(it);
                 } else {
                     xinfo2(TSF "sub send taskid:%_, cmdid:%_, %_, len(S:%_, %_/%_), ",
-                           it->first.taskid,
-                           it->first.cmdid,
-                           it->first.cgi,
+                           it->first->taskid,
+                           it->first->cmdid,
+                           it->first->cgi,
                            writelen,
                            it->second->PosLength(),
                            it->second->Length())
@@ -996,10 +1088,11 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
         lock.unlock();
 
         if (sel.Read_FD_ISSET(_sock)) {
-            bufrecv.AllocWrite(64 * 1024, false);
-            ssize_t recvlen = recv(_sock, bufrecv.PosPtr(), 64 * 1024, 0);
+            size_t recvlen = 0;
+            int recverr = 0;
+            int drained = reader.Drain(_sock, bufrecv, recvlen, recverr);
 
-            if (0 == recvlen) {
+            if (StreamReader::kClosed == drained) {
                 _errtype = kEctSocket;
                 _errcode = kEctSocketShutdown;
                 svr_trig_off_ = true;
@@ -1007,24 +1100,17 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
                 goto End;
             }
 
-            if (0 > recvlen && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
+            if (StreamReader::kError == drained) {
                 _errtype = kEctSocket;
-                _errcode = socket_errno;
-                xerror2(TSF "task socket close sock:%0, recv len: %1 errno:%2(%3)",
-                        _sock,
-                        recvlen,
-                        socket_errno,
-                        socket_strerror(socket_errno))
+                _errcode = recverr;
+                xerror2(TSF "task socket close sock:%0, recv errno:%1(%2)", _sock, recverr, socket_strerror(recverr))
                     >> close_log;
                 goto End;
             }
 
-            if (0 > recvlen)
-                recvlen = 0;
-
             GetSignalOnNetworkDataChange()(XLOGGER_TAG, 0, recvlen);
+            sg_recv_bytes.Add((int64_t)recvlen);
 
-            bufrecv.Length(bufrecv.Pos() + recvlen, bufrecv.Length() + recvlen);
             xinfo2(TSF "task socket recv sock:%_, recv len:%_, buff len:%_", _sock, recvlen, bufrecv.Length());
 
             while (0 < bufrecv.Length()) {
@@ -1052,7 +1138,7 @@ void LongLink::__RunReadWrite(SOCKET _sock, ErrCmdType& _errtype, int& _errcode,
                        LONGLINK_UNPACK_CONTINUE == unpackret ? "continue" : "finish",
                        taskid,
                        cmdid,
-                       stream_resp.task.cgi,
+                       stream_resp.task->cgi,
                        LONGLINK_UNPACK_CONTINUE == unpackret ? bufrecv.Length() : packlen,
                        packlen);
                 lastrecvtime_.gettickcount();
@@ -1106,6 +1192,22 @@ End:
         __NotifySmartHeartbeatHeartResult(false, (_errcode == kEctSocketRecvErr), _profile);
     }
 
+    const StreamReader::Stats& read_stats = reader.GetStats();
+    _profile.recv_wakeups = read_stats.wakeups;
+    _profile.recv_calls = read_stats.reads;
+    _profile.recv_bytes = read_stats.bytes;
+    _profile.recv_budget_hits = read_stats.budget_hits;
+    _profile.recv_max_wakeup_bytes = read_stats.max_wakeup_bytes;
+    xinfo2(TSF ", recv wakeups:%_, calls:%_, bytes:%_, per wakeup:%_, max:%_, wakeups/s:%_, budget hits:%_",
+           read_stats.wakeups,
+           read_stats.reads,
+           read_stats.bytes,
+           (uint64_t)read_stats.BytesPerWakeup(),
+           read_stats.max_wakeup_bytes,
+           read_stats.WakeupsPerSecond(::gettickcount()),
+           read_stats.budget_hits)
+        >> close_log;
+
     std::string netInfo;
     getCurrNetLabel(netInfo);
     xinfo2(TSF ", net_type:%_", netInfo) >> close_log;
@@ -1118,12 +1220,12 @@ End:
         for (std::vector<LongLinkNWriteData>::reverse_iterator it = nsent_datas.rbegin(); it != nsent_datas.rend();
              ++it) {
             if (nwrite_size <= (maxnwrite + it->writelen)) {
-                xinfo2(TSF "taskid:%_, cmdid:%_, cgi:%_ ; ", it->task.taskid, it->task.cmdid, it->task.cgi)
+                xinfo2(TSF "taskid:%_, cmdid:%_, cgi:%_ ; ", it->task->taskid, it->task->cmdid, it->task->cgi)
                     >> close_log;
                 break;
             } else {
                 maxnwrite += it->writelen;
-                xinfo2(TSF "taskid:%_, cmdid:%_, cgi:%_ ; ", it->task.taskid, it->task.cmdid, it->task.cgi)
+                xinfo2(TSF "taskid:%_, cmdid:%_, cgi:%_ ; ", it->task->taskid, it->task->cmdid, it->task->cgi)
                     >> close_log;
             }
         }
@@ -1150,7 +1252,7 @@ End:
 
                 int unpackret =
                     Encoder().longlink_unpack(bufrecv, cmdid, taskid, packlen, body, extension, tracker_.get());
-                xinfo2(TSF "taskid:%_, cmdid:%_, cgi:%_; ", taskid, cmdid, sent_taskids[taskid].task.cgi) >> close_log;
+                xinfo2(TSF "taskid:%_, cmdid:%_, cgi:%_; ", taskid, cmdid, sent_taskids[taskid].task->cgi) >> close_log;
                 if (LONGLINK_UNPACK_CONTINUE == unpackret || LONGLINK_UNPACK_FALSE == unpackret) {
                     break;
                 } else {
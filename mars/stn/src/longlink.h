@@ -27,6 +27,8 @@
 #include "boost/signals2.hpp"
 #include "mars/boot/context.h"
 #include "mars/comm/alarm.h"
+#include "mars/comm/event_signal.h"
+#include "mars/comm/executor.h"
 #include "mars/comm/messagequeue/message_queue.h"
 #include "mars/comm/move_wrapper.h"
 #include "mars/comm/socket/socketselect.h"
@@ -55,19 +57,24 @@ class NetSource;
 class longlink_tracker;
 
 struct LongLinkNWriteData {
-    LongLinkNWriteData(ssize_t _writelen, const Task& _task) : writelen(_writelen), task(_task) {
+    LongLinkNWriteData(ssize_t _writelen, const TaskDescriptor& _task) : writelen(_writelen), task(_task) {
     }
 
     ssize_t writelen;
-    Task task;
+    TaskDescriptor task;
 };
 
 struct StreamResp {
-    StreamResp(const Task& _task = Task(Task::kInvalidTaskID))
-    : task(_task), stream(KNullAtuoBuffer), extension(KNullAtuoBuffer) {
+    StreamResp() : task(InvalidTask()), stream(KNullAtuoBuffer), extension(KNullAtuoBuffer) {
     }
 
-    Task task;
+    // pushes and unknown taskids still log the cgi of the response, so an empty task stands in for them
+    static const TaskDescriptor& InvalidTask() {
+        static const TaskDescriptor invalid_task = std::make_shared<const Task>(Task::kInvalidTaskID);
+        return invalid_task;
+    }
+
+    TaskDescriptor task;
     move_wrapper<AutoBuffer> stream;
     move_wrapper<AutoBuffer> extension;
 };
@@ -111,7 +118,7 @@ class LongLink {
     };
       */
  public:
-    boost::signals2::signal<void(TLongLinkStatus _connectStatus, const std::string& _channel_id)> SignalConnection;
+    comm::EventSignal<void(TLongLinkStatus _connectStatus, const std::string& _channel_id)> SignalConnection;
     boost::signals2::signal<void(const ConnectProfile& _connprofile)> broadcast_linkstatus_signal_;
 
     boost::function<void(uint32_t _tls_version, mars::stn::TlsHandshakeFrom _from)> OnHandshakeCompleted;
@@ -139,7 +146,7 @@ class LongLink {
              LongLinkEncoder& _encoder = gDefaultLongLinkEncoder);
     virtual ~LongLink();
 
-    bool Send(const AutoBuffer& _body, const AutoBuffer& _extension, const Task& _task);
+    bool Send(const AutoBuffer& _body, const AutoBuffer& _extension, const TaskDescriptor& _task);
     bool SendWhenNoData(const AutoBuffer& _body, const AutoBuffer& _extension, uint32_t _cmdid, uint32_t _taskid);
     bool Stop(uint32_t _taskid);
 
@@ -222,6 +229,7 @@ class LongLink {
 
     boost::scoped_ptr<longlink_tracker> tracker_;
     NetSource::DnsUtil dns_util_;
+    comm::ExecutorJobPtr resolve_job_;  // may still resolve the other hosts after __RunConnect
     comm::SocketBreaker connectbreak_;
     TLongLinkStatus connectstatus_;
     ConnectProfile conn_profile_;
@@ -229,7 +237,7 @@ class LongLink {
 
     comm::SocketBreaker readwritebreak_;
     LongLinkIdentifyChecker identifychecker_;
-    std::list<std::pair<Task, move_wrapper<AutoBuffer>>> lstsenddata_;
+    std::list<std::pair<TaskDescriptor, move_wrapper<AutoBuffer>>> lstsenddata_;
     tickcount_t lastrecvtime_;
     comm::Alarm alarmnooptimeout_;
     bool isnooping_ = false;
@@ -167,7 +167,7 @@ bool LongLinkTaskManager::HasTask(uint32_t _taskid) const {
 void LongLinkTaskManager::ClearTasks() {
     xverbose_function();
     MetaScopedLock lock(meta_mutex_);
-    for (auto item : longlink_metas_) {
+    for (const auto& item : longlink_metas_) {
         item.second->Channel()->Disconnect(LongLinkErrCode::kReset);
         MessageQueue::CancelMessage(asyncreg_.Get(), longlink_id_[item.second->Config().name]);
     }
@@ -179,7 +179,7 @@ void LongLinkTaskManager::ClearTasks() {
 
 unsigned int LongLinkTaskManager::GetTaskCount(const std::string& _name) {
     unsigned int count = 0;
-    for (auto item : lst_cmd_) {
+    for (const auto& item : lst_cmd_) {
         if (item.channel_name == _name)
             count += 1;
     }
@@ -274,8 +274,7 @@ void LongLinkTaskManager::__RunLoop() {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockEmptyCMD,
-                                                                                  kLongLinkWakeupLockEmptyCMD));
+            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockEmptyCMD));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakeup_lock_->Lock(kLongLinkWakeupLockEmptyCMD);
@@ -290,8 +289,7 @@ void LongLinkTaskManager::__RunLoop() {
     if (!lst_cmd_.empty()) {
 #ifdef ANDROID
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockRunCMD,
-                                                                                  kLongLinkWakeupLockRunCMD));
+            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockRunCMD));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakeup_lock_->Lock(kLongLinkWakeupLockRunCMD);
@@ -306,8 +304,7 @@ void LongLinkTaskManager::__RunLoop() {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyLongLinkWakeupLockEmptyCMD,
-                                                                                  kLongLinkWakeupLockEmptyCMD));
+            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigLongLinkWakeupLockEmptyCMD));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakeup_lock_->Lock(kLongLinkWakeupLockEmptyCMD);
@@ -391,7 +388,7 @@ void LongLinkTaskManager::__RunOnTimeout() {
         first = next;
     }
 
-    for (auto item : batchMap) {
+    for (const auto& item : batchMap) {
         if (item.second.first == kEctLongTaskTimeout) {
             __BatchErrorRespHandle(item.first,
                                    kEctNetMsgXP,
@@ -457,19 +454,24 @@ void LongLinkTaskManager::__RunOnStartTask() {
             continue;
         }
 
-        Task task = first->task;
-        if (get_real_host_) {
-            get_real_host_(task.user_id, task.longlink_host_list, /*_strict_match=*/false, task.extra_info);
-        }
         std::string host = "";
-        if (!task.longlink_host_list.empty()) {
-            host = task.longlink_host_list.front();
+        if (get_real_host_) {
+            // only the host list is rewritten, don't copy the whole task for it
+            std::vector<std::string> hosts = first->task.longlink_host_list;
+            get_real_host_(first->task.user_id, hosts, /*_strict_match=*/false, first->task.extra_info);
+            if (!hosts.empty()) {
+                host = hosts.front();
+            }
+        } else if (!first->task.longlink_host_list.empty()) {
+            host = first->task.longlink_host_list.front();
         }
         xinfo2(TSF "host ip to callback is %_, task's channel name:%_", host, first->channel_name);
 
         // make sure login
         if (first->task.need_authed) {
+            first->transfer_profile.begin_make_sure_auth_time = ::gettickcount();
             bool ismakesureauthsuccess = context_->GetManager<StnManager>()->MakesureAuthed(host, first->task.user_id);
+            first->transfer_profile.end_make_sure_auth_time = ::gettickcount();
             xinfo2(TSF "makesureauth host:%_, auth result:%_, cgi:%_, channal name:%_",
                    host,
                    ismakesureauthsuccess,
@@ -499,15 +501,18 @@ void LongLinkTaskManager::__RunOnStartTask() {
             // client_sequence_id 在buf2resp这里生成,防止重试sequence_id一样
             first->task.client_sequence_id = context_->GetManager<StnManager>()->GenSequenceId();
             xinfo2(TSF "client_sequence_id:%_", first->task.client_sequence_id);
-            if (!context_->GetManager<StnManager>()->Req2Buf(first->task.taskid,
-                                                             first->task.user_context,
-                                                             first->task.user_id,
-                                                             bufreq,
-                                                             buffer_extension,
-                                                             error_code,
-                                                             longlink->Config().link_type,
-                                                             host,
-                                                             first->task.client_sequence_id)) {
+            first->transfer_profile.begin_req2buf_time = ::gettickcount();
+            bool req2buf_ok = context_->GetManager<StnManager>()->Req2Buf(first->task.taskid,
+                                                                          first->task.user_context,
+                                                                          first->task.user_id,
+                                                                          bufreq,
+                                                                          buffer_extension,
+                                                                          error_code,
+                                                                          longlink->Config().link_type,
+                                                                          host,
+                                                                          first->task.client_sequence_id);
+            first->transfer_profile.end_req2buf_time = ::gettickcount();
+            if (!req2buf_ok) {
                 __SingleRespHandle(first,
                                    kEctEnDecode,
                                    error_code,
@@ -556,15 +561,18 @@ void LongLinkTaskManager::__RunOnStartTask() {
         }
 
         if (0 == bufreq.Length()) {
-            if (!context_->GetManager<StnManager>()->Req2Buf(first->task.taskid,
-                                                             first->task.user_context,
-                                                             first->task.user_id,
-                                                             bufreq,
-                                                             buffer_extension,
-                                                             error_code,
-                                                             longlink->Config().link_type,
-                                                             host,
-                                                             first->task.client_sequence_id)) {
+            first->transfer_profile.begin_req2buf_time = ::gettickcount();
+            bool req2buf_ok = context_->GetManager<StnManager>()->Req2Buf(first->task.taskid,
+                                                                          first->task.user_context,
+                                                                          first->task.user_id,
+                                                                          bufreq,
+                                                                          buffer_extension,
+                                                                          error_code,
+                                                                          longlink->Config().link_type,
+                                                                          host,
+                                                                          first->task.client_sequence_id);
+            first->transfer_profile.end_req2buf_time = ::gettickcount();
+            if (!req2buf_ok) {
                 __SingleRespHandle(first,
                                    kEctEnDecode,
                                    error_code,
@@ -598,6 +606,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
             first->transfer_profile.received_size = body.Length();
             first->transfer_profile.receive_data_size = body.Length();
             first->transfer_profile.last_receive_pkg_time = ::gettickcount();
+            first->transfer_profile.begin_buf2resp_time = ::gettickcount();
             int handle_type = context_->GetManager<StnManager>()->Buf2Resp(first->task.taskid,
                                                                            first->task.user_context,
                                                                            first->task.user_id,
@@ -607,6 +616,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
                                                                            flags,
                                                                            longlink->Config().link_type,
                                                                            server_sequence_id);
+            first->transfer_profile.end_buf2resp_time = ::gettickcount();
             xinfo2(TSF "server_sequence_id:%_", server_sequence_id);
             first->task.server_sequence_id = server_sequence_id;
             ConnectProfile profile;
@@ -624,7 +634,7 @@ void LongLinkTaskManager::__RunOnStartTask() {
             (first->task.server_process_cost <= 0) ? dynamic_timeout_.GetStatus() : kEValuating;
         first->transfer_profile.read_write_timeout = __ReadWriteTimeout(first->transfer_profile.first_pkg_timeout);
         first->transfer_profile.send_data_size = bufreq.Length();
-        first->running_id = longlink_channel->Send(bufreq, buffer_extension, first->task);
+        first->running_id = longlink_channel->Send(bufreq, buffer_extension, first->descriptor);
 
         if (!first->running_id) {
             xwarn2(TSF "task add into longlink readwrite fail cgi:%_, cmdid:%_, taskid:%_",
@@ -1006,6 +1016,7 @@ void LongLinkTaskManager::__OnResponse(const std::string& _name,
     uint64_t flags = 0;
     unsigned short server_sequence_id = 0;
 
+    it->transfer_profile.begin_buf2resp_time = ::gettickcount();
     int handle_type = context_->GetManager<StnManager>()->Buf2Resp(it->task.taskid,
                                                                    it->task.user_context,
                                                                    it->task.user_id,
@@ -1015,6 +1026,7 @@ void LongLinkTaskManager::__OnResponse(const std::string& _name,
                                                                    flags,
                                                                    longlink_meta->Config().link_type,
                                                                    server_sequence_id);
+    it->transfer_profile.end_buf2resp_time = ::gettickcount();
     if (should_intercept_result_ && should_intercept_result_(err_code)) {
         task_intercept_.AddInterceptTask(it->task.cgi, std::string((const char*)body->Ptr(), body->Length()));
     }
@@ -1246,7 +1258,7 @@ void LongLinkTaskManager::__ResetLongLink(const std::string& _name) {
 #endif
 
 ConnectProfile LongLinkTaskManager::GetConnectProfile(uint32_t _taskid) {
-    for (auto item : lst_cmd_) {
+    for (const auto& item : lst_cmd_) {
         if (item.task.taskid == _taskid) {
             auto longlink = GetLongLink(item.channel_name);
             if (longlink) {
@@ -1364,7 +1376,7 @@ void LongLinkTaskManager::ReleaseLongLink(std::shared_ptr<LongLinkMetaData> _lin
 }
 
 bool LongLinkTaskManager::DisconnectByTaskId(uint32_t _taskid, LongLinkErrCode::TDisconnectInternalCode _code) {
-    for (auto item : lst_cmd_) {
+    for (const auto& item : lst_cmd_) {
         if (item.task.taskid == _taskid) {
             auto longlink = GetLongLink(item.channel_name);
             if (longlink) {
@@ -41,7 +41,11 @@ ShortLinkInterface* (*Create)(boot::Context* _context,
        const Task& _task,
        const ShortlinkConfig& _config) -> ShortLinkInterface* {
     xdebug2(TSF "use weak func Create");
-    return new ShortLink(_context, _messagequeueid, _netsource, _task, _config.use_proxy);
+    ShortLinkInterface* shortlink = new ShortLink(_context, _messagequeueid, _netsource, _task, _config.use_proxy);
+    if (_config.use_http2) {
+        shortlink->SetUseProtocol(Task::kTransportProtocolHTTP2);
+    }
+    return shortlink;
 };
 
 void (*Destory)(ShortLinkInterface* _short_link_channel) = [](ShortLinkInterface* _short_link_channel) {
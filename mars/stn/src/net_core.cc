@@ -374,8 +374,7 @@ void NetCore::StartTask(const Task& _task) {
 #ifdef ANDROID
     /*cancel the last wakeuplock*/
     if (context_->GetManager<AppManager>() != nullptr) {
-        wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyShortLinkWakeupLockBefroeCMD,
-                                                                              kShortLinkWakeupLockBefroeCMD));
+        wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigShortLinkWakeupLockBefroeCMD));
     } else {
         xinfo2(TSF "appmanager no exist.");
         wakeup_lock_->Lock(kShortLinkWakeupLockBefroeCMD);
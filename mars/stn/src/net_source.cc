@@ -238,11 +238,15 @@ void NetSource::GetLonglinkPorts(std::vector<uint16_t>& _ports) {
 bool NetSource::GetLongLinkItems(const struct LonglinkConfig& _config,
                                  DnsUtil& _dns_util,
                                  std::vector<IPPortItem>& _ipport_items,
-                                 const std::map<std::string, std::string>& _extra_info) {
+                                 const std::map<std::string, std::string>& _extra_info,
+                                 const OnIPPortItems& _on_items) {
     xinfo_function();
     ScopedLock lock(sg_ip_mutex);
 
     if (__GetLonglinkDebugIPPort(_config, _ipport_items)) {
+        lock.unlock();
+        if (!_on_items.empty())
+            _on_items(_ipport_items);
         return true;
     }
 
@@ -257,7 +261,7 @@ bool NetSource::GetLongLinkItems(const struct LonglinkConfig& _config,
         return false;
     }
 
-    __GetIPPortItems(_ipport_items, longlink_hosts, _dns_util, true, _extra_info);
+    __GetIPPortItems(_ipport_items, longlink_hosts, _dns_util, true, _extra_info, _on_items);
     return !_ipport_items.empty();
 }
 
@@ -408,11 +412,26 @@ bool NetSource::__GetShortlinkDebugIPPort(const std::vector<std::string>& _hostl
     return !_ipport_items.empty();
 }
 
+// hands on what the last __MakeIPPorts appended
+static void __EmitIPPortItems(const std::vector<IPPortItem>& _ipport_items,
+                              size_t& _emitted,
+                              const NetSource::OnIPPortItems& _on_items) {
+    if (_ipport_items.size() <= _emitted) {
+        _emitted = _ipport_items.size();  // the backup pass may trim
+        return;
+    }
+    if (!_on_items.empty())
+        _on_items(std::vector<IPPortItem>(_ipport_items.begin() + _emitted, _ipport_items.end()));
+    _emitted = _ipport_items.size();
+}
+
 void NetSource::__GetIPPortItems(std::vector<IPPortItem>& _ipport_items,
                                  const std::vector<std::string>& _hostlist,
                                  DnsUtil& _dns_util,
                                  bool _islonglink,
-                                 const std::map<std::string, std::string>& _extra_info) {
+                                 const std::map<std::string, std::string>& _extra_info,
+                                 const OnIPPortItems& _on_items) {
+    size_t emitted = _ipport_items.size();
     if (active_logic_.IsActive()) {
         unsigned int merge_type_count = 0;
         unsigned int makelist_count = kNumMakeCount;
@@ -423,6 +442,7 @@ void NetSource::__GetIPPortItems(std::vector<IPPortItem>& _ipport_items,
 
             if (0 < __MakeIPPorts(_ipport_items, *iter, makelist_count, _dns_util, /*_isbackup=*/false, _islonglink, _extra_info))
                 merge_type_count++;
+            __EmitIPPortItems(_ipport_items, emitted, _on_items);
         }
 
         for (std::vector<std::string>::const_iterator iter = _hostlist.begin(); iter != _hostlist.end(); ++iter) {
@@ -431,6 +451,7 @@ void NetSource::__GetIPPortItems(std::vector<IPPortItem>& _ipport_items,
 
             if (0 < __MakeIPPorts(_ipport_items, *iter, makelist_count, _dns_util, /*_isbackup=*/true, _islonglink, _extra_info))
                 merge_type_count++;
+            __EmitIPPortItems(_ipport_items, emitted, _on_items);
         }
     } else {
         size_t host_count = _hostlist.size();
@@ -444,6 +465,7 @@ void NetSource::__GetIPPortItems(std::vector<IPPortItem>& _ipport_items,
              ++host_iter) {
             count += i < ret2 ? ret + 1 : ret;
             __MakeIPPorts(_ipport_items, *host_iter, count, _dns_util, /*_isbackup=*/false, _islonglink, _extra_info);
+            __EmitIPPortItems(_ipport_items, emitted, _on_items);
             i++;
         }
 
@@ -451,6 +473,7 @@ void NetSource::__GetIPPortItems(std::vector<IPPortItem>& _ipport_items,
              host_iter != _hostlist.end() && count < kNumMakeCount;
              ++host_iter) {
             __MakeIPPorts(_ipport_items, *host_iter, kNumMakeCount, _dns_util, /*_isbackup=*/true, _islonglink, _extra_info);
+            __EmitIPPortItems(_ipport_items, emitted, _on_items);
         }
     }
 }
@@ -122,11 +122,15 @@ class NetSource {
     ~NetSource();
 
  public:
+    // each host's items as soon as they are resolved, in the order they are appended to _ipport_items
+    typedef boost::function<void(const std::vector<IPPortItem>& _items)> OnIPPortItems;
+
     // for long link
     bool GetLongLinkItems(const struct LonglinkConfig& _config,
                           DnsUtil& _dns_util,
                           std::vector<IPPortItem>& _ipport_items,
-                          const std::map<std::string, std::string>& _extra_info);
+                          const std::map<std::string, std::string>& _extra_info,
+                          const OnIPPortItems& _on_items = OnIPPortItems());
 
     // for short link
     bool GetShortLinkItems(const std::vector<std::string>& _hostlist,
@@ -167,7 +171,8 @@ class NetSource {
                           const std::vector<std::string>& _hostlist,
                           DnsUtil& _dns_util,
                           bool _islonglink,
-                          const std::map<std::string, std::string>& _extra_info);
+                          const std::map<std::string, std::string>& _extra_info,
+                          const OnIPPortItems& _on_items = OnIPPortItems());
     size_t __MakeIPPorts(std::vector<IPPortItem>& _ip_items,
                          const std::string& _host,
                          size_t _count,
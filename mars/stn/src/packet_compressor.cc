@@ -0,0 +1,223 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * packet_compressor.cc
+ */
+
+#include "packet_compressor.h"
+
+#include <map>
+#include <memory>
+
+#ifdef __APPLE__
+#include "mars/xlog/xlogger.h"
+#else
+#include "mars/comm/xlogger/xlogger.h"
+#endif
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/thread/lock.h"
+#include "zstd/lib/zstd.h"
+#include "zstd/lib/dictBuilder/zdict.h"
+
+using namespace mars::comm;
+
+namespace mars {
+namespace stn {
+
+namespace {
+
+// digested once, shared read-only by every context
+struct Dictionary {
+    Dictionary() : cdict(NULL), ddict(NULL) {
+    }
+    ~Dictionary() {
+        ZSTD_freeCDict(cdict);
+        ZSTD_freeDDict(ddict);
+    }
+
+    ZSTD_CDict* cdict;
+    ZSTD_DDict* ddict;
+};
+
+// replaced whole on every change, so a packet works on one consistent view without holding the lock
+struct CompressionState {
+    CompressionPolicy policy;
+    std::map<uint32_t, std::shared_ptr<const Dictionary> > dictionaries;
+};
+
+struct CompressionRegistry {
+    Mutex mutex;
+    std::shared_ptr<const CompressionState> state = std::make_shared<CompressionState>();
+};
+
+CompressionRegistry& Registry() {
+    static CompressionRegistry* registry = new CompressionRegistry;  // leaked: packers may run during exit
+    return *registry;
+}
+
+std::shared_ptr<const CompressionState> CurrentState() {
+    ScopedLock lock(Registry().mutex);
+    return Registry().state;
+}
+
+}  // namespace
+
+uint32_t PacketCompressor::LoadDictionary(const void* _dict, size_t _len) {
+    uint32_t dict_id = ZDICT_getDictID(_dict, _len);
+    if (0 == dict_id) {
+        xerror2(TSF "not a zstd dictionary, len:%_", _len);
+        return 0;
+    }
+
+    std::shared_ptr<Dictionary> dictionary = std::make_shared<Dictionary>();
+    dictionary->cdict = ZSTD_createCDict(_dict, _len, kLevel);
+    dictionary->ddict = ZSTD_createDDict(_dict, _len);
+    if (NULL == dictionary->cdict || NULL == dictionary->ddict) {
+        xerror2(TSF "digest dictionary %_ failed, len:%_", dict_id, _len);
+        return 0;
+    }
+
+    CompressionRegistry& registry = Registry();
+    ScopedLock lock(registry.mutex);
+    std::shared_ptr<CompressionState> state = std::make_shared<CompressionState>(*registry.state);
+    state->dictionaries[dict_id] = dictionary;
+    registry.state = state;
+    xinfo2(TSF "dictionary %_ loaded, len:%_", dict_id, _len);
+    return dict_id;
+}
+
+void PacketCompressor::SetPolicy(const CompressionPolicy& _policy) {
+    CompressionRegistry& registry = Registry();
+    ScopedLock lock(registry.mutex);
+    std::shared_ptr<CompressionState> state = std::make_shared<CompressionState>(*registry.state);
+    state->policy = _policy;
+    registry.state = state;
+    xinfo2(TSF "compression enable:%_, dict:%_, size:[%_, %_], cmdids:%_",
+           _policy.enable,
+           _policy.dict_id,
+           _policy.min_size,
+           _policy.max_size,
+           _policy.cmdids.size());
+}
+
+CompressionPolicy PacketCompressor::Policy() {
+    return CurrentState()->policy;
+}
+
+uint32_t PacketCompressor::FrameDictionary(const void* _data, size_t _len) {
+    return ZSTD_getDictID_fromFrame(_data, _len);
+}
+
+PacketCompressor& PacketCompressor::ThreadLocal() {
+    static thread_local PacketCompressor compressor;
+    return compressor;
+}
+
+PacketCompressor::PacketCompressor() : cctx_(NULL), dctx_(NULL) {
+}
+
+PacketCompressor::~PacketCompressor() {
+    ZSTD_freeCCtx(cctx_);
+    ZSTD_freeDCtx(dctx_);
+}
+
+bool PacketCompressor::Compress(uint32_t _cmdid, const AutoBuffer& _body, AutoBuffer& _out, uint32_t& _dict_id) {
+    std::shared_ptr<const CompressionState> state = CurrentState();
+    const CompressionPolicy& policy = state->policy;
+    size_t len = _body.Length();
+    if (!policy.enable || 0 == len || len < policy.min_size || len > policy.max_size)
+        return false;
+    if (0 == policy.cmdids.count(_cmdid))
+        return false;
+
+    const Dictionary* dictionary = NULL;
+    if (0 != policy.dict_id) {
+        std::map<uint32_t, std::shared_ptr<const Dictionary> >::const_iterator it =
+            state->dictionaries.find(policy.dict_id);
+        if (it == state->dictionaries.end()) {
+            xwarn2(TSF "dictionary %_ agreed but not loaded, cmdid:%_", policy.dict_id, _cmdid);
+            return false;
+        }
+        dictionary = it->second.get();
+    }
+
+    if (NULL == cctx_)
+        cctx_ = ZSTD_createCCtx();
+    if (NULL == cctx_)
+        return false;
+
+    // anything not smaller than the body is not worth the peer's time to decompress
+    size_t capacity = len - 1;
+    _out.AddCapacity(capacity);
+    void* dst = _out.Ptr(_out.Length());
+    size_t ret = NULL != dictionary
+                     ? ZSTD_compress_usingCDict(cctx_, dst, capacity, _body.Ptr(), len, dictionary->cdict)
+                     : ZSTD_compressCCtx(cctx_, dst, capacity, _body.Ptr(), len, kLevel);
+    if (ZSTD_isError(ret)) {
+        xdebug2(TSF "cmdid:%_ sent plain, len:%_, %_", _cmdid, len, ZSTD_getErrorName(ret));
+        return false;
+    }
+
+    _out.Length(_out.Pos(), _out.Length() + ret);
+    _dict_id = policy.dict_id;
+    return true;
+}
+
+bool PacketCompressor::Decompress(uint32_t _dict_id,
+                                  const void* _data,
+                                  size_t _len,
+                                  AutoBuffer& _out,
+                                  size_t _max_size) {
+    std::shared_ptr<const CompressionState> state;
+    const Dictionary* dictionary = NULL;
+    if (0 != _dict_id) {
+        state = CurrentState();
+        std::map<uint32_t, std::shared_ptr<const Dictionary> >::const_iterator it = state->dictionaries.find(_dict_id);
+        if (it == state->dictionaries.end()) {
+            xerror2(TSF "unknown dictionary %_", _dict_id);
+            return false;
+        }
+        dictionary = it->second.get();
+    }
+
+    // the frame carries its size, which bounds what a corrupt or hostile one can make us allocate
+    unsigned long long size = ZSTD_getFrameContentSize(_data, _len);
+    if (ZSTD_CONTENTSIZE_UNKNOWN == size || ZSTD_CONTENTSIZE_ERROR == size || _max_size < size) {
+        xerror2(TSF "bad frame, len:%_, content size:%_, max:%_", _len, size, _max_size);
+        return false;
+    }
+
+    if (NULL == dctx_)
+        dctx_ = ZSTD_createDCtx();
+    if (NULL == dctx_)
+        return false;
+
+    _out.AddCapacity((size_t)size);
+    void* dst = _out.Ptr(_out.Length());
+    size_t ret = NULL != dictionary
+                     ? ZSTD_decompress_usingDDict(dctx_, dst, (size_t)size, _data, _len, dictionary->ddict)
+                     : ZSTD_decompressDCtx(dctx_, dst, (size_t)size, _data, _len);
+    if (ZSTD_isError(ret) || ret != size) {
+        xerror2(TSF "decompress failed: %_, dict:%_, len:%_",
+                ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "size mismatch",
+                _dict_id,
+                _len);
+        return false;
+    }
+
+    _out.Length(_out.Pos(), _out.Length() + ret);
+    return true;
+}
+
+}  // namespace stn
+}  // namespace mars
@@ -0,0 +1,96 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * packet_compressor.h
+ *
+ * Optional zstd compression of packed bodies. Small protobufs barely compress
+ * on their own, so the win comes from a dictionary trained on real traffic
+ * (see stn/tools/packer_dict) and loaded on both ends. The client only
+ * compresses once the peer has agreed on a dictionary id, only for the cmdids
+ * enabled, and only inside the size thresholds; it decompresses whatever
+ * arrives with a dictionary it has loaded.
+ */
+
+#ifndef STN_SRC_PACKET_COMPRESSOR_H_
+#define STN_SRC_PACKET_COMPRESSOR_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <set>
+
+class AutoBuffer;
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+namespace mars {
+namespace stn {
+
+struct CompressionPolicy {
+    CompressionPolicy() : enable(false), dict_id(0), min_size(64), max_size(256 * 1024) {
+    }
+
+    bool enable;                // set once the peer has said it takes zstd
+    uint32_t dict_id;           // the dictionary agreed with the peer, 0 for plain zstd
+    size_t min_size;            // below this the frame overhead eats the gain
+    size_t max_size;            // above this the body is most likely media, already compressed
+    std::set<uint32_t> cmdids;  // only these are compressed
+};
+
+class PacketCompressor {
+ public:
+    static const int kLevel = 3;
+    static const size_t kMaxDecompressedSize = 1024 * 1024;  // a long-link packet
+    static const size_t kMaxShortLinkDecompressedSize = 64 * 1024 * 1024;  // short-link responses run to many MB
+
+    // a trained dictionary, usable for both directions from now on; returns its id, 0 if it is not one
+    static uint32_t LoadDictionary(const void* _dict, size_t _len);
+    static void SetPolicy(const CompressionPolicy& _policy);
+    static CompressionPolicy Policy();
+
+    // the dictionary a frame was compressed with, 0 for none
+    static uint32_t FrameDictionary(const void* _data, size_t _len);
+
+    // one per thread, for callers without a connection to keep the contexts on
+    static PacketCompressor& ThreadLocal();
+
+ public:
+    PacketCompressor();
+    ~PacketCompressor();
+
+    /**
+     * compresses _body into _out under the current policy
+     * return: false if the body is to be sent as it is; _out is left untouched then
+     */
+    bool Compress(uint32_t _cmdid, const AutoBuffer& _body, AutoBuffer& _out, uint32_t& _dict_id);
+    // appends the decompressed body to _out; false if the dictionary is unknown, the frame is corrupt
+    // or it would decompress to more than _max_size
+    bool Decompress(uint32_t _dict_id,
+                    const void* _data,
+                    size_t _len,
+                    AutoBuffer& _out,
+                    size_t _max_size = kMaxDecompressedSize);
+
+ private:
+    PacketCompressor(const PacketCompressor&);
+    PacketCompressor& operator=(const PacketCompressor&);
+
+ private:
+    ZSTD_CCtx_s* cctx_;
+    ZSTD_DCtx_s* dctx_;
+};
+
+}  // namespace stn
+}  // namespace mars
+
+#endif  // STN_SRC_PACKET_COMPRESSOR_H_
@@ -0,0 +1,203 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * packet_compressor_unittest.cc
+ */
+
+#include "packet_compressor.h"
+
+#include <stdio.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mars/comm/autobuffer.h"
+#include "zstd/lib/dictBuilder/zdict.h"
+
+using namespace mars::stn;
+
+static const uint32_t kCmdId = 138;
+
+// small messages sharing most of their field names and values, like the CGI ones
+static std::string Message(int _i) {
+    char buffer[512];
+    int len = snprintf(buffer,
+                       sizeof(buffer),
+                       "\x0a\x10wxid_user%07d\x12\x08nickname\x1a\x05zh_CN\x22\x0a"
+                       "android-29\x2a\x0dMicroMessenger\x30%c\x3a\x18"
+                       "https://short.weixin.qq.com/cgi-bin/micromsg-bin/sync\x42\x08%08x",
+                       _i * 7919 % 10000000,
+                       (char)(_i % 100),
+                       (unsigned)(_i * 2654435761u));
+    return std::string(buffer, len);
+}
+
+static std::string TrainedDictionary() {
+    std::string flat;
+    std::vector<size_t> sizes;
+    for (int i = 0; i < 2000; ++i) {
+        std::string sample = Message(i);
+        flat += sample;
+        sizes.push_back(sample.size());
+    }
+    std::string dict(8 * 1024, '\0');
+    size_t len = ZDICT_trainFromBuffer(&dict[0], dict.size(), flat.data(), sizes.data(), (unsigned)sizes.size());
+    if (ZDICT_isError(len))
+        return std::string();
+    dict.resize(len);
+    return dict;
+}
+
+static CompressionPolicy Enabled(uint32_t _dict_id) {
+    CompressionPolicy policy;
+    policy.enable = true;
+    policy.dict_id = _dict_id;
+    policy.min_size = 16;
+    policy.cmdids.insert(kCmdId);
+    return policy;
+}
+
+class packet_compressor : public testing::Test {
+ protected:
+    void TearDown() override {
+        PacketCompressor::SetPolicy(CompressionPolicy());
+    }
+};
+
+TEST_F(packet_compressor, policy_gates_compression) {
+    PacketCompressor compressor;
+    std::string message = Message(1);
+    AutoBuffer body;
+    body.Write(message.data(), message.size());
+    AutoBuffer out;
+    uint32_t dict_id = 0;
+
+    EXPECT_FALSE(compressor.Compress(kCmdId, body, out, dict_id));  // off until the peer agrees
+
+    CompressionPolicy policy = Enabled(0);
+    PacketCompressor::SetPolicy(policy);
+    EXPECT_FALSE(compressor.Compress(kCmdId + 1, body, out, dict_id));
+
+    policy.min_size = message.size() + 1;
+    PacketCompressor::SetPolicy(policy);
+    EXPECT_FALSE(compressor.Compress(kCmdId, body, out, dict_id));
+
+    policy = Enabled(0xdeadbeef);  // agreed but never loaded
+    PacketCompressor::SetPolicy(policy);
+    EXPECT_FALSE(compressor.Compress(kCmdId, body, out, dict_id));
+    EXPECT_EQ(0u, out.Length());
+
+    // random bytes do not shrink, they go out plain
+    PacketCompressor::SetPolicy(Enabled(0));
+    std::mt19937 random(42);
+    AutoBuffer noise;
+    for (int i = 0; i < 1024; ++i) {
+        unsigned char c = (unsigned char)random();
+        noise.Write(&c, 1);
+    }
+    EXPECT_FALSE(compressor.Compress(kCmdId, noise, out, dict_id));
+    EXPECT_EQ(0u, out.Length());
+}
+
+TEST_F(packet_compressor, dictionary_round_trip) {
+    std::string dict = TrainedDictionary();
+    ASSERT_FALSE(dict.empty());
+    uint32_t loaded = PacketCompressor::LoadDictionary(dict.data(), dict.size());
+    ASSERT_NE(0u, loaded);
+    EXPECT_EQ(0u, PacketCompressor::LoadDictionary("not a dictionary", 16));
+
+    PacketCompressor sender;
+    PacketCompressor receiver;
+    size_t raw = 0;
+    size_t plain = 0;
+    size_t with_dict = 0;
+    for (int i = 5000; i < 5100; ++i) {
+        std::string message = Message(i);
+        AutoBuffer body;
+        body.Write(message.data(), message.size());
+        raw += message.size();
+
+        PacketCompressor::SetPolicy(Enabled(0));
+        AutoBuffer without;
+        uint32_t dict_id = 0;
+        if (sender.Compress(kCmdId, body, without, dict_id)) {
+            plain += without.Length();
+        } else {
+            plain += message.size();
+        }
+
+        PacketCompressor::SetPolicy(Enabled(loaded));
+        AutoBuffer compressed;
+        ASSERT_TRUE(sender.Compress(kCmdId, body, compressed, dict_id));
+        EXPECT_EQ(loaded, dict_id);
+        EXPECT_EQ(loaded, PacketCompressor::FrameDictionary(compressed.Ptr(), compressed.Length()));
+        with_dict += compressed.Length();
+
+        AutoBuffer restored;
+        ASSERT_TRUE(receiver.Decompress(dict_id, compressed.Ptr(), compressed.Length(), restored));
+        ASSERT_EQ(message, std::string((const char*)restored.Ptr(), restored.Length()));
+
+        // the wrong dictionary, or none, cannot read it
+        AutoBuffer wrong;
+        EXPECT_FALSE(receiver.Decompress(loaded + 1, compressed.Ptr(), compressed.Length(), wrong));
+        EXPECT_FALSE(receiver.Decompress(0, compressed.Ptr(), compressed.Length(), wrong));
+    }
+
+    EXPECT_LT(with_dict * 2, plain);
+}
+
+TEST_F(packet_compressor, rejects_corrupt_frames) {
+    PacketCompressor::SetPolicy(Enabled(0));
+    PacketCompressor compressor;
+    std::string message = Message(7) + Message(8);
+    AutoBuffer body;
+    body.Write(message.data(), message.size());
+    AutoBuffer compressed;
+    uint32_t dict_id = 0;
+    ASSERT_TRUE(compressor.Compress(kCmdId, body, compressed, dict_id));
+
+    AutoBuffer out;
+    EXPECT_FALSE(compressor.Decompress(0, compressed.Ptr(), compressed.Length() / 2, out));
+    EXPECT_FALSE(compressor.Decompress(0, "garbage!", 8, out));
+
+    // appends to what is already there
+    out.Write("head", 4);
+    ASSERT_TRUE(compressor.Decompress(0, compressed.Ptr(), compressed.Length(), out));
+    EXPECT_EQ("head" + message, std::string((const char*)out.Ptr(), out.Length()));
+}
+
+TEST_F(packet_compressor, caps_the_decompressed_size) {
+    CompressionPolicy policy = Enabled(0);
+    policy.max_size = 4 * 1024 * 1024;
+    PacketCompressor::SetPolicy(policy);
+    PacketCompressor compressor;
+    std::string message;
+    while (message.size() < 2 * PacketCompressor::kMaxDecompressedSize) message += Message((int)message.size());
+    AutoBuffer body;
+    body.Write(message.data(), message.size());
+    AutoBuffer compressed;
+    uint32_t dict_id = 0;
+    ASSERT_TRUE(compressor.Compress(kCmdId, body, compressed, dict_id));
+
+    // past a long-link packet, within what a short-link response may be
+    AutoBuffer out;
+    EXPECT_FALSE(compressor.Decompress(0, compressed.Ptr(), compressed.Length(), out));
+    ASSERT_TRUE(compressor.Decompress(0,
+                                      compressed.Ptr(),
+                                      compressed.Length(),
+                                      out,
+                                      PacketCompressor::kMaxShortLinkDecompressedSize));
+    EXPECT_EQ(message.size(), out.Length());
+}
@@ -43,10 +43,12 @@
 #include "mars/comm/socket/getsocktcpinfo.h"
 #endif
 #include "mars/app/app_manager.h"
+#include "mars/stn/src/packet_compressor.h"
 #include "mars/stn/proto/shortlink_packer.h"
 #include "mars/stn/src/dynamic_timeout.h"
 #include "mars/stn/src/socket_pool.h"
 #include "mars/stn/stn_manager.h"
+#include "h2_socket_operator.h"
 #include "tcp_socket_operator.h"
 #include "weak_network_logic.h"
 
@@ -59,6 +61,8 @@ using namespace mars::comm;
 using namespace http;
 
 static unsigned int KBufferSize = 8 * 1024;
+static const size_t KBodyRecvSize = 1024 * 1024;
+static const char* const KStringZstd = "zstd";
 
 namespace mars {
 namespace stn {
@@ -152,7 +156,6 @@ ShortLink::ShortLink(boot::Context* _context,
                       ? std::make_unique<TcpSocketOperator>(std::make_shared<ShortLinkConnectObserver>(*this))
                       : std::move(_operator))
 , task_(_task)
-, thread_(boost::bind(&ShortLink::__Run, this), internal::threadName(_task.cgi).c_str())
 , dns_util_(context_)
 , use_proxy_(_use_proxy)
 , tracker_(shortlink_tracker::Create())
@@ -176,12 +179,23 @@ ShortLink::~ShortLink() {
     dns_util_.Cancel();
 }
 
+void ShortLink::SetUseProtocol(int _protocol) {
+    if (Task::kTransportProtocolHTTP2 != _protocol || Task::kTransportProtocolHTTP2 == socketOperator_->Protocol())
+        return;
+
+    xinfo2(TSF "taskid:%_ over h2", task_.taskid);
+    socketOperator_ = std::make_unique<H2SocketOperator>(std::make_shared<ShortLinkConnectObserver>(*this));
+    // the connection is shared already, a stream is never handed to the socket pool
+    is_keep_alive_ = false;
+}
+
 void ShortLink::SendRequest() {
     xdebug_function();
+    if (worker_job_ && worker_job_->IsRunning())
+        return;
     is_start_req2buf_thread = true;
-    req2buf_thread_ = std::make_shared<comm::Thread>(boost::bind(&ShortLink::__Req2Buf, this),
-                                                     internal::threadName(task_.cgi + ".Req2Buf").c_str());
-    thread_.start();
+    req2buf_job_ = comm::Executor::Blocking().Post(boost::bind(&ShortLink::__Req2Buf, this), "shortlink.req2buf");
+    worker_job_ = comm::Executor::Blocking().Post(boost::bind(&ShortLink::__Run, this), "shortlink");
 }
 
 void ShortLink::SetSentCount(int _sent_count) {
@@ -193,17 +207,15 @@ void ShortLink::SendRequest(AutoBuffer& _buf_req, AutoBuffer& _buffer_extend) {
     xdebug2(XTHIS)(TSF "taskid:%_, cgi:%_ bufReq.size:%_", task_.taskid, task_.cgi, _buf_req.Length());
     send_body_.Attach(_buf_req);
     send_extend_.Attach(_buffer_extend);
-    thread_.start();
+    if (worker_job_ && worker_job_->IsRunning())
+        return;
+    worker_job_ = comm::Executor::Blocking().Post(boost::bind(&ShortLink::__Run, this), "shortlink");
 }
 
 void ShortLink::__Run() {
     xmessage2_define(message, TSF "taskid:%_, cgi:%_, @%_", task_.taskid, task_.cgi, this);
     xinfo_function(TSF "%_, net:%_, realtime:%_", message.String(), getNetInfo(), task_.need_realtime_netinfo);
 
-    if (is_start_req2buf_thread) {
-        req2buf_thread_->start();
-    }
-
     ConnectProfile conn_profile;
     int type = task_.need_realtime_netinfo ? getRealtimeNetLabel(conn_profile.net_type)
                                            : getCurrNetLabel(conn_profile.net_type);
@@ -310,10 +322,10 @@ SOCKET ShortLink::__RunConnect(ConnectProfile& _conn_profile) {
         _conn_profile.ip_items.insert(_conn_profile.ip_items.begin(), item);
         __UpdateProfile(_conn_profile);
     } else {
-        if (socketOperator_->Protocol() == Task::kTransportProtocolQUIC) {
+        if (socketOperator_->Protocol() != Task::kTransportProtocolTCP) {
             xassert2(!use_proxy);
             for (auto& ip : _conn_profile.ip_items) {
-                ip.transport_protocol = Task::kTransportProtocolQUIC;
+                ip.transport_protocol = socketOperator_->Protocol();
             }
         }
 
@@ -648,20 +660,49 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
         }
     }
 
-    AutoBuffer out_buff;
+    // compressed ahead of the packer, which has no cmdid to decide on
+    AutoBuffer compressed;
+    uint32_t dict_id = 0;
+    bool is_compressed = PacketCompressor::ThreadLocal().Compress(task_.cmdid, send_body_, compressed, dict_id);
+    if (is_compressed) {
+        headers[http::HeaderFields::kStringContentEncoding] = KStringZstd;
+        headers[http::HeaderFields::KStringAcceptEncoding] = KStringZstd;
+    }
+    const AutoBuffer& send_body = is_compressed ? compressed : send_body_;
 
-    shortlink_pack(url, headers, send_body_, send_extend_, out_buff, tracker_.get());
+    // with the default packer only the headers are built here, the body is sent from where it is
+    AutoBuffer out_buff;
+    bool gathered = shortlink_pack_header(url, headers, send_body, send_extend_, out_buff, tracker_.get());
+    if (!gathered) {
+        // a replaced packer may rewrite the body, the headers could not tell how it is encoded: it gets it plain
+        if (is_compressed) {
+            headers.erase(http::HeaderFields::kStringContentEncoding);
+            headers.erase(http::HeaderFields::KStringAcceptEncoding);
+            is_compressed = false;
+        }
+        shortlink_pack(url, headers, send_body_, send_extend_, out_buff, tracker_.get());
+    }
+    xdebug2_if(is_compressed, TSF "body %_ -> %_, dict:%_", send_body_.Length(), compressed.Length(), dict_id);
 
     // send request
     xgroup2_define(group_send);
-    xinfo2(TSF "task socket send sock:%_, %_ http len:%_, ", _socket, message.String(), out_buff.Length())
+    xinfo2(TSF "task socket send sock:%_, %_ http len:%_, ",
+           _socket,
+           message.String(),
+           out_buff.Length() + (gathered ? send_body.Length() : 0))
         >> group_send;
 
     _conn_profile.start_send_packet_time = ::gettickcount();
-    int send_ret = socketOperator_->Send(_socket,
-                                         (const unsigned char*)out_buff.Ptr(),
-                                         (unsigned int)out_buff.Length(),
-                                         _err_code);
+    int send_ret = gathered ? socketOperator_->SendV(_socket,
+                                                     out_buff.Ptr(),
+                                                     out_buff.Length(),
+                                                     send_body.Ptr(),
+                                                     send_body.Length(),
+                                                     _err_code)
+                            : socketOperator_->Send(_socket,
+                                                    (const unsigned char*)out_buff.Ptr(),
+                                                    (unsigned int)out_buff.Length(),
+                                                    _err_code);
     _conn_profile.send_request_cost = ::gettickcount() - _conn_profile.start_send_packet_time;
     xinfo2(TSF "sent %_", send_ret) >> group_send;
 
@@ -701,10 +742,10 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
 
     // recv response
     AutoBuffer body;
-    AutoBuffer recv_buf;
+    AutoBuffer recv_buf;  // what went through the parser: the headers, and the body when it can't go straight to body
     AutoBuffer extension;
     int status_code = -1;
-    off_t recv_pos = 0;
+    size_t recv_total = 0;
     MemoryBodyReceiver* receiver = new MemoryBodyReceiver(body);
     http::Parser parser(receiver, true);
 
@@ -722,7 +763,14 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
         getCurrNetLabel(_conn_profile.net_type);
     }
     while (true) {
-        int recv_ret = socketOperator_->Recv(_socket, recv_buf, KBufferSize, _err_code, timeout);
+        // once the headers announced a content-length, the body is received where it ends up
+        size_t body_pending = parser.BodyPending();
+        int recv_ret = 0 < body_pending ? socketOperator_->Recv(_socket,
+                                                                body,
+                                                                std::min(body_pending, KBodyRecvSize),
+                                                                _err_code,
+                                                                timeout)
+                                        : socketOperator_->Recv(_socket, recv_buf, KBufferSize, _err_code, timeout);
         xinfo2(TSF "socketOperator_ Recv %_/%_", recv_ret, _err_code);
 
         _conn_profile.rw_errcode = _err_code;
@@ -788,14 +836,20 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
             GetSignalOnNetworkDataChange()(XLOGGER_TAG, 0, recv_ret);
 
             xinfo2(TSF "recv len:%_ ", recv_ret) >> group_recv;
+            recv_total += recv_ret;
             if (OnRecv)
-                OnRecv(this, (unsigned int)(recv_buf.Length() - recv_pos), (unsigned int)recv_buf.Length());
+                OnRecv(this, (unsigned int)recv_total, (unsigned int)recv_total);
             else
                 xwarn2(TSF "OnRecv NULL.");
-            recv_pos = recv_buf.Pos();
         }
 
-        Parser::TRecvStatus parse_status = parser.Recv(recv_buf.Ptr(recv_buf.Length() - recv_ret), recv_ret);
+        Parser::TRecvStatus parse_status;
+        if (0 < body_pending && 0 < recv_ret) {
+            body.Seek(0, AutoBuffer::ESeekEnd);
+            parse_status = parser.BodyReceived(recv_ret);
+        } else {
+            parse_status = parser.Recv(recv_buf.Ptr(recv_buf.Length() - recv_ret), recv_ret);
+        }
         if (parser.FirstLineReady()) {
             status_code = parser.Status().StatusCode();
         }
@@ -849,6 +903,22 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
                 __RunResponseError(kEctHttp, status_code, _conn_profile, true);
             } else {
                 xinfo2(TSF "@%0, headers size:%_, ", this, parser.Fields().GetHeaders().size()) >> group_recv;
+                const char* encoding = parser.Fields().HeaderField(http::HeaderFields::kStringContentEncoding);
+                if (NULL != encoding && 0 == strcasecmp(encoding, KStringZstd)) {
+                    AutoBuffer decoded;
+                    uint32_t dict_id = PacketCompressor::FrameDictionary(body.Ptr(), body.Length());
+                    if (!PacketCompressor::ThreadLocal().Decompress(dict_id,
+                                                                    body.Ptr(),
+                                                                    body.Length(),
+                                                                    decoded,
+                                                                    PacketCompressor::kMaxShortLinkDecompressedSize)) {
+                        xerror2(TSF "@%0, decompress body failed, len:%_, dict:%_", this, body.Length(), dict_id)
+                            >> group_close;
+                        __RunResponseError(kEctHttp, kEctHttpSplitHttpHeadAndBody, _conn_profile, true);
+                        break;
+                    }
+                    body.Attach(decoded);
+                }
                 __OnResponse(kEctOK, status_code, body, extension, _conn_profile, true);
             }
             break;
@@ -857,7 +927,7 @@ void ShortLink::__RunReadWrite(SOCKET _socket, int& _err_type, int& _err_code, C
         }
     }
 
-    xdebug2(TSF "read with nonblock socket http response, length:%_, ", recv_buf.Length()) >> group_recv;
+    xdebug2(TSF "read with nonblock socket http response, length:%_, ", recv_total) >> group_recv;
 
     task_.priority >= 0 ? (xgroup2() << group_recv) : (group_recv.Clear());
 #if defined(__ANDROID__) || defined(__APPLE__)
@@ -1106,16 +1176,21 @@ void ShortLink::__CancelAndWaitWorkerThread() {
     // 先join req2buf, worker线程被req2buf阻塞
     __CancelAndWaitReq2BufThread();
 
-    if (!thread_.isruning()) {
+    if (!worker_job_ || !worker_job_->IsRunning()) {
         xinfo2(TSF "thread is no running.");
         return;
     }
 
+    if (worker_job_->Cancel()) {
+        xinfo2(TSF "worker canceled before it ran.");
+        return;
+    }
+
     if (!socketOperator_->Breaker().Break()) {
         xassert2(false, "breaker fail");
     }
-    int ret = thread_.join();
-    xdebug2(TSF "thread_ join %_ ret %_", this, ret);
+    worker_job_->Join();
+    xdebug2(TSF "worker joined %_", this);
 }
 
 void ShortLink::__CancelAndWaitReq2BufThread() {
@@ -1128,19 +1203,23 @@ void ShortLink::__CancelAndWaitReq2BufThread() {
         return;
     }
 
-    if (req2buf_thread_ == nullptr) {
+    if (req2buf_job_ == nullptr) {
         xinfo2(TSF "thread is null.");
         return;
     }
 
-    if (!req2buf_thread_->isruning()) {
+    if (!req2buf_job_->IsRunning()) {
         xinfo2(TSF "thread is no running.");
         return;
     }
 
-    int ret = req2buf_thread_->join();
-    req2buf_thread_.reset();
-    xdebug2(TSF "req2buf_thread_ join %_ ret %_", this, ret);
+    // the worker may still read req2buf_job_, so it stays set
+    if (req2buf_job_->Cancel()) {
+        xinfo2(TSF "req2buf canceled before it ran.");
+        return;
+    }
+    req2buf_job_->Join();
+    xdebug2(TSF "req2buf joined %_", this);
 }
 
 bool ShortLink::__Req2Buf() {
@@ -1257,6 +1336,11 @@ bool ShortLink::__WaitAsyncReq2buf() {
         return true;
     }
 
+    // no free worker took req2buf yet: run it here rather than wait for one
+    if (req2buf_job_ && req2buf_job_->TryRun()) {
+        xinfo2(TSF "req2buf ran on the worker");
+    }
+
     // 此时 req2buf_thread_ 还没跑完，阻塞worker线程等待。析构时确保on_destroy为true
     {
         std::unique_lock<std::mutex> lock(req2buf_ready_mtx);
@@ -31,6 +31,7 @@
 #include "boost/signals2.hpp"
 #include "mars/boot/context.h"
 #include "mars/comm/autobuffer.h"
+#include "mars/comm/executor.h"
 #include "mars/comm/http.h"
 #include "mars/comm/messagequeue/message_queue.h"
 #include "mars/comm/socket/socket_address.h"
@@ -70,6 +71,8 @@ class ShortLink : public ShortLinkInterface {
     virtual bool IsKeepAlive() const {
         return is_keep_alive_;
     }
+    // kTransportProtocolHTTP2 moves the request onto a stream of a shared h2c connection; before SendRequest only
+    virtual void SetUseProtocol(int _protocol);
 
     virtual void __Run();
     virtual SOCKET __RunConnect(ConnectProfile& _conn_profile);
@@ -109,8 +112,8 @@ class ShortLink : public ShortLinkInterface {
     std::shared_ptr<NetSource> net_source_;
     std::unique_ptr<SocketOperator> socketOperator_;
     Task task_;
-    comm::Thread thread_;
-    std::shared_ptr<comm::Thread> req2buf_thread_;
+    comm::ExecutorJobPtr worker_job_;
+    comm::ExecutorJobPtr req2buf_job_;
     std::mutex req2buf_ready_mtx;
     std::condition_variable req2buf_ready_cv;
     std::atomic<bool> is_req2buf_ready{false};
@@ -25,6 +25,7 @@
 #include "boost/bind.hpp"
 #include "mars/app/app.h"
 #include "mars/comm/autobuffer.h"
+#include "mars/comm/metrics.h"
 #include "mars/comm/move_wrapper.h"
 #include "mars/comm/platform_comm.h"
 #include "mars/comm/thread/lock.h"
@@ -49,6 +50,9 @@ using namespace mars::app;
 #define AYNC_HANDLER asyncreg_.Get()
 #define RETURN_SHORTLINK_SYNC2ASYNC_FUNC_TITLE(func, title) RETURN_SYNC2ASYNC_FUNC_TITLE(func, title, )
 
+static Counter sg_socket_reused("stn.shortlink.socket_reused");
+static Counter sg_socket_new("stn.shortlink.socket_new");
+
 ShortLinkTaskManager::ShortLinkTaskManager(boot::Context* _context,
                                            std::shared_ptr<NetSource> _netsource,
                                            DynamicTimeout& _dynamictimeout,
@@ -167,8 +171,7 @@ void ShortLinkTaskManager::__RunLoop() {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyShortLinkWakeupLockEmptyCMD,
-                                                                                  kShortLinkWakeupLockEmptyCMD));
+            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigShortLinkWakeupLockEmptyCMD));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakeup_lock_->Lock(kShortLinkWakeupLockEmptyCMD);
@@ -183,8 +186,7 @@ void ShortLinkTaskManager::__RunLoop() {
     if (!lst_cmd_.empty()) {
 #ifdef ANDROID
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyShortLinkWakeupLockRunCMD,
-                                                                                  kShortLinkWakeupLockRunCMD));
+            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigShortLinkWakeupLockRunCMD));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakeup_lock_->Lock(kShortLinkWakeupLockRunCMD);
@@ -199,8 +201,7 @@ void ShortLinkTaskManager::__RunLoop() {
 #ifdef ANDROID
         /*cancel the last wakeuplock*/
         if (context_->GetManager<AppManager>() != nullptr) {
-            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig<int>(kKeyShortLinkWakeupLockEmptyCMD,
-                                                                                  kShortLinkWakeupLockEmptyCMD));
+            wakeup_lock_->Lock(context_->GetManager<AppManager>()->GetConfig(kConfigShortLinkWakeupLockEmptyCMD));
         } else {
             xinfo2(TSF "appmanager no exist.");
             wakeup_lock_->Lock(kShortLinkWakeupLockEmptyCMD);
@@ -225,8 +226,8 @@ void ShortLinkTaskManager::__RunOnTimeout() {
         ErrCmdType err_type = kEctLocal;
         int socket_timeout_code = 0;
         // xinfo2(TSF"task is long-polling task:%_,%_, cgi:%_,%_, timeout:%_, id %_",first->task.long_polling,
-        // first->transfer_profile.task.long_polling, first->transfer_profile.task.cgi,first->task.cgi,
-        // first->transfer_profile.task.long_polling_timeout, (void*)first->running_id);
+        // first->transfer_profile.task->long_polling, first->transfer_profile.task->cgi,first->task.cgi,
+        // first->transfer_profile.task->long_polling_timeout, (void*)first->running_id);
 
         if (cur_time - first->start_task_time >= first->task_timeout) {
             err_type = kEctLocal;
@@ -346,7 +347,7 @@ void ShortLinkTaskManager::__RunOnStartTask() {
             first->task.shortlink_host_list = first->task.shortlink_fallback_hostlist;
         }
 
-        Task task = first->task;
+        const Task& task = first->task;
         std::vector<std::string> hosts = task.shortlink_host_list;
         ShortlinkConfig config(first->use_proxy, /*use_tls=*/true, m_tls_group_name_);
 #ifndef DISABLE_QUIC_PROTOCOL
@@ -396,6 +397,12 @@ void ShortLinkTaskManager::__RunOnStartTask() {
             first->transfer_profile.end_retry_get_host_time = gettickcount();
         }
 
+        // h2 on the first attempt only, a retry goes back to a connection of its own
+        if (!config.use_quic && !config.use_proxy && (task.transport_protocol & Task::kTransportProtocolHTTP2)
+            && 0 == first->err_code) {
+            config.use_http2 = true;
+        }
+
         first->task.shortlink_host_list = hosts;
 
         if (hosts.empty()) {
@@ -546,9 +553,9 @@ void ShortLinkTaskManager::__RunOnStartTask() {
                                                                           dynamic_timeout_.GetStatus());
             first->current_dyntime_status =
                 (first->task.server_process_cost <= 0) ? dynamic_timeout_.GetStatus() : kEValuating;
-            if (first->transfer_profile.task.long_polling) {
+            if (first->transfer_profile.task->long_polling) {
                 first->transfer_profile.read_write_timeout =
-                    __ReadWriteTimeout(first->transfer_profile.task.long_polling_timeout);
+                    __ReadWriteTimeout(first->transfer_profile.task->long_polling_timeout);
             } else {
                 first->transfer_profile.read_write_timeout =
                     __ReadWriteTimeout(first->transfer_profile.first_pkg_timeout);
@@ -983,7 +990,7 @@ void ShortLinkTaskManager::RedoTasks() {
     xinfo_function();
 
     is_handle_reqresp_buff_in_worker_ =
-        context_->GetManager<AppManager>()->GetConfig<bool>(kKeyIsHandleReqRespBuffInWorker, false);
+        context_->GetManager<AppManager>()->GetConfig(kConfigIsHandleReqRespBuffInWorker);
     xinfo2(TSF "is_handle_reqresp_buff_in_worker_ %_", is_handle_reqresp_buff_in_worker_);
 
     std::list<TaskProfile>::iterator first = lst_cmd_.begin();
@@ -1377,6 +1384,7 @@ void ShortLinkTaskManager::__OnAddInterceptTask(const std::string& _name, const
 }
 
 void ShortLinkTaskManager::__OnSocketPoolReport(bool _is_reused, bool _has_received, bool _is_decode_ok) {
+    (_is_reused ? sg_socket_reused : sg_socket_new).Add();
     socket_pool_.Report(_is_reused, _has_received, _is_decode_ok);
 }
 
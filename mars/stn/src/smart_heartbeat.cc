@@ -27,6 +27,8 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <map>
+#include <vector>
 
 #include "boost/filesystem.hpp"
 #include "mars/app/app.h"
@@ -37,15 +39,17 @@
 #include "mars/comm/time_utils.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/stn/config.h"
+#include "special_ini.h"
 
 using namespace mars::app;
 using namespace mars::comm;
 
 #define KV_KEY_SMARTHEART 11249
 
-static const std::string kFileName = "Heartbeat.ini";
+static const std::string kFileName = "Heartbeat.kv";
+static const std::string kINIFileName = "Heartbeat.ini";  // before Heartbeat.kv, imported once
 
-// INI key
+// keys under each net detail
 static const char* const kKeyModifyTime      = "modifyTime";
 static const char* const kKeyCurHeart        = "curHeart";
 static const char* const kKeyFailHeartCount  = "failHeartCount";
@@ -53,6 +57,11 @@ static const char* const kKeyStable          = "stable";
 static const char* const kKeyNetType         = "netType";
 static const char* const kKeyHeartType       = "hearttype";
 static const char* const kKeyMinHeartFail    = "minheartfail";
+static const char kKeySeparator = '\x1f';
+
+static std::string __Key(const std::string& _net_detail, const char* _key) {
+    return _net_detail + kKeySeparator + _key;
+}
 int SmartHeartbeat::outer_setted_heart_ = -1;
 
 SmartHeartbeat::SmartHeartbeat(mars::boot::Context* _context)
@@ -63,17 +72,18 @@ SmartHeartbeat::SmartHeartbeat(mars::boot::Context* _context)
 , last_heart_(MinHeartInterval)
 , pre_heart_(MinHeartInterval)
 , cur_heart_(MinHeartInterval)
-, ini_(_context->GetManager<AppManager>()->GetAppFilePath() + "/" + kFileName, false)
+, store_(_context->GetManager<AppManager>()->GetAppFilePath() + "/" + kFileName)
 , doze_mode_count_(0)
 , normal_mode_count_(0)
 , noop_start_tick_(false) {
     xinfo_function();
-    ini_.Parse();
+    __ImportINI(_context->GetManager<AppManager>()->GetAppFilePath() + "/" + kINIFileName);
 }
 
 SmartHeartbeat::~SmartHeartbeat() {
     xinfo_function();
-    __SaveINI();
+    __SaveHeartInfo();
+    store_.Flush();
 }
 
 void SmartHeartbeat::OnHeartbeatStart() {
@@ -85,7 +95,7 @@ void SmartHeartbeat::OnHeartbeatStart() {
 
 void SmartHeartbeat::OnLongLinkEstablished() {
     xdebug_function();
-    __LoadINI();
+    __LoadHeartInfo();
     success_heart_count_ = 0;
     pre_heart_ = cur_heart_ = MinHeartInterval;
 }
@@ -173,7 +183,7 @@ void SmartHeartbeat::OnHeartResult(bool _sucess, bool _fail_of_timeout) {
             current_net_heart_info_.fail_heart_count_ = 0;
             if (report_smart_heart_)
                 report_smart_heart_(context_, kActionReCalc, current_net_heart_info_, false);
-            __SaveINI();
+            __SaveHeartInfo();
         }
         return;
     }
@@ -241,7 +251,7 @@ void SmartHeartbeat::OnHeartResult(bool _sucess, bool _fail_of_timeout) {
     }
 
     __DumpHeartInfo();
-    __SaveINI();
+    __SaveHeartInfo();
 }
 
 #define MAX_JUDGE_TIMES (10)
@@ -300,7 +310,32 @@ unsigned int SmartHeartbeat::GetNextHeartbeatInterval() {  //
     return last_heart_;
 }
 
-void SmartHeartbeat::__LoadINI() {
+void SmartHeartbeat::__ImportINI(const std::string& _ini_path) {
+    if (0 != store_.Count() || !boost::filesystem::exists(_ini_path))
+        return;
+
+    SpecialINI ini(_ini_path);
+    SpecialINI::sections_t& sections = ini.Sections();
+    for (SpecialINI::sections_t::iterator iter = sections.begin(); iter != sections.end(); ++iter) {
+        // sections are named by the md5 of the net detail, which is kept under "name"
+        SpecialINI::keys_t::iterator name = iter->second.find("name");
+        if (name == iter->second.end() || name->second.empty())
+            continue;
+
+        for (SpecialINI::keys_t::iterator key = iter->second.begin(); key != iter->second.end(); ++key) {
+            if (key == name)
+                continue;
+            int64_t value = "true" == key->second ? 1 : number_cast<int64_t>(key->second.c_str());
+            store_.SetInt(__Key(name->second, key->first.c_str()), value);
+        }
+    }
+
+    xinfo2(TSF "imported %_ nets from %_", sections.size(), _ini_path);
+    boost::system::error_code ec;
+    boost::filesystem::remove(_ini_path, ec);
+}
+
+void SmartHeartbeat::__LoadHeartInfo() {
     xinfo_function();
     std::string net_info;
     int net_type = getCurrNetLabel(net_info);
@@ -317,18 +352,23 @@ void SmartHeartbeat::__LoadINI() {
     current_net_heart_info_.net_detail_ = net_info;
     current_net_heart_info_.net_type_ = net_type;
 
-    if (ini_.Select(net_info)) {
-        current_net_heart_info_.last_modify_time_ = ini_.Get(kKeyModifyTime, current_net_heart_info_.last_modify_time_);
-        current_net_heart_info_.cur_heart_ = ini_.Get(kKeyCurHeart, current_net_heart_info_.cur_heart_);
+    if (store_.Has(__Key(net_info, kKeyModifyTime))) {
+        current_net_heart_info_.last_modify_time_ =
+            (time_t)store_.GetInt(__Key(net_info, kKeyModifyTime), current_net_heart_info_.last_modify_time_);
+        current_net_heart_info_.cur_heart_ =
+            (unsigned int)store_.GetInt(__Key(net_info, kKeyCurHeart), current_net_heart_info_.cur_heart_);
         current_net_heart_info_.fail_heart_count_ =
-            ini_.Get(kKeyFailHeartCount, current_net_heart_info_.fail_heart_count_);
-        current_net_heart_info_.is_stable_ = ini_.Get(kKeyStable, current_net_heart_info_.is_stable_);
-        current_net_heart_info_.net_type_ = ini_.Get(kKeyNetType, current_net_heart_info_.net_type_);
-        current_net_heart_info_.heart_type_ = (TSmartHeartBeatType)ini_.Get(kKeyHeartType, 0);
-        current_net_heart_info_.min_heart_fail_count_ = ini_.Get(kKeyMinHeartFail, 0);
+            (unsigned int)store_.GetInt(__Key(net_info, kKeyFailHeartCount), current_net_heart_info_.fail_heart_count_);
+        current_net_heart_info_.is_stable_ =
+            0 != store_.GetInt(__Key(net_info, kKeyStable), current_net_heart_info_.is_stable_);
+        current_net_heart_info_.net_type_ =
+            (int)store_.GetInt(__Key(net_info, kKeyNetType), current_net_heart_info_.net_type_);
+        current_net_heart_info_.heart_type_ = (TSmartHeartBeatType)store_.GetInt(__Key(net_info, kKeyHeartType), 0);
+        current_net_heart_info_.min_heart_fail_count_ =
+            (unsigned int)store_.GetInt(__Key(net_info, kKeyMinHeartFail), 0);
 
         xassert2(net_type == current_net_heart_info_.net_type_,
-                 "cur:%d, INI:%d",
+                 "cur:%d, stored:%d",
                  net_type,
                  current_net_heart_info_.net_type_);
 
@@ -355,46 +395,44 @@ void SmartHeartbeat::__LoadINI() {
             current_net_heart_info_.last_modify_time_ = cur_time;
         }
     } else {
-        __LimitINISize();
-        bool ret = ini_.Create(net_info);
-        xassert2(ret);
-        __SaveINI();
+        __LimitNetCount();
+        __SaveHeartInfo();
     }
     __DumpHeartInfo();
 }
 
-#define MAX_INI_SECTIONS (20)
+#define MAX_NET_COUNT (20)
 
-void SmartHeartbeat::__LimitINISize() {
+void SmartHeartbeat::__LimitNetCount() {
     xinfo_function();
-    SpecialINI::sections_t& sections = ini_.Sections();
+    std::vector<std::string> keys;
+    store_.Keys(keys);
+
+    std::map<std::string, std::vector<std::string> > nets;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        std::string::size_type separator = keys[i].rfind(kKeySeparator);
+        if (std::string::npos != separator)
+            nets[keys[i].substr(0, separator)].push_back(keys[i]);
+    }
 
-    if (ini_.Sections().size() <= MAX_INI_SECTIONS)
+    if (nets.size() <= MAX_NET_COUNT)
         return;
 
-    xwarn2(TSF "sections.size=%0 > MAX_INI_SECTIONS=%1", sections.size(), MAX_INI_SECTIONS);
+    xwarn2(TSF "nets.size=%0 > MAX_NET_COUNT=%1", nets.size(), MAX_NET_COUNT);
 
     time_t cur_time = time(NULL);
 
     time_t min_time = 0;
-    SpecialINI::sections_t::iterator min_iter = sections.end();
-
-    for (SpecialINI::sections_t::iterator iter = sections.begin(); iter != sections.end();) {
-        SpecialINI::keys_t::iterator time_iter = iter->second.find(kKeyModifyTime);
-
-        if (time_iter == iter->second.end()) {
-            // remove dirty value
-            sections.erase(iter++);
-            xinfo2(TSF "remove dirty value because miss KEY_ModifyTime");
-            continue;
-        }
+    std::map<std::string, std::vector<std::string> >::iterator min_iter = nets.end();
 
-        time_t time_value = number_cast<time_t>(time_iter->second.c_str());
+    for (std::map<std::string, std::vector<std::string> >::iterator iter = nets.begin(); iter != nets.end(); ++iter) {
+        std::string time_key = __Key(iter->first, kKeyModifyTime);
+        time_t time_value = (time_t)store_.GetInt(time_key, -1);
 
-        if (time_value > cur_time) {
+        if (!store_.Has(time_key) || time_value > cur_time) {
             // remove dirty value
-            sections.erase(iter++);
-            xinfo2(TSF "remove dirty value because Wrong ModifyTime ");
+            xinfo2(TSF "remove dirty value because miss or wrong ModifyTime");
+            for (size_t i = 0; i < iter->second.size(); ++i) store_.Erase(iter->second[i]);
             continue;
         }
 
@@ -402,29 +440,29 @@ void SmartHeartbeat::__LimitINISize() {
             min_iter = iter;
             min_time = time_value;
         }
-
-        ++iter;
     }
 
-    if (min_iter != sections.end())
-        sections.erase(min_iter);
+    if (min_iter != nets.end()) {
+        for (size_t i = 0; i < min_iter->second.size(); ++i) store_.Erase(min_iter->second[i]);
+    }
 }
 
-void SmartHeartbeat::__SaveINI() {
+void SmartHeartbeat::__SaveHeartInfo() {
     xdebug_function();
     if (current_net_heart_info_.net_detail_.empty())
         return;
 
     current_net_heart_info_.last_modify_time_ = time(NULL);
 
-    ini_.Set<time_t>(kKeyModifyTime, current_net_heart_info_.last_modify_time_);
-    ini_.Set(kKeyCurHeart, current_net_heart_info_.cur_heart_);
-    ini_.Set(kKeyFailHeartCount, current_net_heart_info_.fail_heart_count_);
-    ini_.Set(kKeyStable, current_net_heart_info_.is_stable_);
-    ini_.Set(kKeyNetType, current_net_heart_info_.net_type_);
-    ini_.Set(kKeyHeartType, current_net_heart_info_.heart_type_);
-    ini_.Set(kKeyMinHeartFail, current_net_heart_info_.min_heart_fail_count_);
-    ini_.Save();
+    // only the values that changed are appended
+    const std::string& net = current_net_heart_info_.net_detail_;
+    store_.SetInt(__Key(net, kKeyModifyTime), current_net_heart_info_.last_modify_time_);
+    store_.SetInt(__Key(net, kKeyCurHeart), current_net_heart_info_.cur_heart_);
+    store_.SetInt(__Key(net, kKeyFailHeartCount), current_net_heart_info_.fail_heart_count_);
+    store_.SetInt(__Key(net, kKeyStable), current_net_heart_info_.is_stable_);
+    store_.SetInt(__Key(net, kKeyNetType), current_net_heart_info_.net_type_);
+    store_.SetInt(__Key(net, kKeyHeartType), current_net_heart_info_.heart_type_);
+    store_.SetInt(__Key(net, kKeyMinHeartFail), current_net_heart_info_.min_heart_fail_count_);
 }
 
 void SmartHeartbeat::__DumpHeartInfo() {
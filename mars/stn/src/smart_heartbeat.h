@@ -23,10 +23,10 @@
 #include <string>
 
 #include "mars/boot/context.h"
+#include "mars/comm/mmap_kv_store.h"
 #include "mars/comm/singleton.h"
 #include "mars/comm/tickcount.h"
 #include "mars/stn/config.h"
-#include "special_ini.h"
 
 enum HeartbeatReportType {
     kReportTypeCompute = 1,   // report info of compute smart heartbeat
@@ -95,9 +95,10 @@ class SmartHeartbeat {
 
     bool __IsDozeStyle();
 
-    void __LimitINISize();
-    void __LoadINI();
-    void __SaveINI();
+    void __ImportINI(const std::string& _ini_path);
+    void __LimitNetCount();
+    void __LoadHeartInfo();
+    void __SaveHeartInfo();
 
  private:
     mars::boot::Context* context_;
@@ -110,7 +111,7 @@ class SmartHeartbeat {
     unsigned int cur_heart_;
     NetHeartbeatInfo current_net_heart_info_;
 
-    SpecialINI ini_;
+    mars::comm::MmapKVStore store_;  // "<net detail>\x1f<key>" -> value, one record per changed value
 
     int doze_mode_count_;
     int normal_mode_count_;
@@ -47,6 +47,20 @@ class SocketOperator {
                            const std::string& _proxy_username = "",
                            const std::string& _proxy_pwd = "") = 0;
     virtual int Send(SOCKET _sock, const void* _buffer, size_t _len, int& _errcode, int _timeout = -1) = 0;
+    // _head then _body without joining them first; transports that can't gather send them one after the other
+    virtual int SendV(SOCKET _sock,
+                      const void* _head,
+                      size_t _head_len,
+                      const void* _body,
+                      size_t _body_len,
+                      int& _errcode,
+                      int _timeout = -1) {
+        int ret = Send(_sock, _head, _head_len, _errcode, _timeout);
+        if (ret < 0 || (size_t)ret < _head_len || 0 == _body_len)
+            return ret;
+        int body_ret = Send(_sock, _body, _body_len, _errcode, _timeout);
+        return body_ret < 0 ? body_ret : ret + body_ret;
+    }
     virtual int Recv(SOCKET _sock,
                      AutoBuffer& _buffer,
                      size_t _max_size,
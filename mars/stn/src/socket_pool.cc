@@ -0,0 +1,354 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * socket_pool.cc
+ */
+
+#include "socket_pool.h"
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace mars {
+namespace stn {
+
+SocketPool::SocketPool()
+: use_cache_(true)
+, idle_count_(0)
+, max_idle_per_destination_(kDefaultMaxIdlePerDestination)
+, max_idle_(kDefaultMaxIdle)
+, is_baned_(false) {
+}
+
+SocketPool::~SocketPool() {
+    Clear();
+}
+
+SOCKET SocketPool::GetSocket(const IPPortItem& _item) {
+    xverbose_function();
+    comm::ScopedLock lock(mutex_);
+    if (!use_cache_ || _isBaned() || 0 == idle_count_) {
+        ++stats_.misses;
+        return INVALID_SOCKET;
+    }
+
+    IdleMap::iterator found = socket_pool_.find(Key(_item));
+    if (found == socket_pool_.end()) {
+        ++stats_.misses;
+        xdebug2(TSF "can not find socket ip:%_, port:%_, host:%_, size:%_",
+                _item.str_ip,
+                _item.port,
+                _item.str_host,
+                idle_count_);
+        return INVALID_SOCKET;
+    }
+
+    IdleStack& stack = found->second;
+    SOCKET fd = INVALID_SOCKET;
+    while (!stack.empty()) {
+        CacheSocketItem& top = stack.back();
+        if (top.HasTimeout()
+            || (_item.transport_protocol == Task::kTransportProtocolTCP && _IsSocketClosed(top.socket_fd))) {
+            xinfo2(TSF "remove timeout or closed socket, is timeout:%_", top.HasTimeout());
+            ++(top.HasTimeout() ? stats_.timeouts : stats_.reaped);
+            top.CloseSocket();
+            stack.pop_back();
+            --idle_count_;
+            continue;
+        }
+
+        if (_item.transport_protocol == Task::kTransportProtocolTCP || top.IsSubStream()) {
+            fd = top.socket_fd;
+            stack.pop_back();
+            --idle_count_;
+            xinfo2(TSF "get from cache: ip:%_, port:%_, host:%_, fd:%_, size:%_",
+                   _item.str_ip,
+                   _item.port,
+                   _item.str_host,
+                   fd,
+                   idle_count_);
+            break;
+        }
+
+        // create sub stream for quic, the owner stays in the pool
+        xassert2(_item.transport_protocol == Task::kTransportProtocolQUIC);
+        int subfd = top.CreateStream();
+        if (subfd == INVALID_SOCKET) {
+            xwarn2(TSF "create substream failed. url %_:%_ fd %_", _item.str_ip, _item.port, top.socket_fd);
+            stack.pop_back();
+            --idle_count_;
+            break;
+        }
+        // recalc keepalive time
+        xinfo2(TSF "get from cache url %_:%_ owner %_ stream %_", _item.str_ip, _item.port, top.socket_fd, subfd);
+        top.ResetTimeout();
+        fd = subfd;
+        break;
+    }
+
+    if (stack.empty()) {
+        socket_pool_.erase(found);
+    }
+    ++(fd == INVALID_SOCKET ? stats_.misses : stats_.hits);
+    return fd;
+}
+
+bool SocketPool::AddCache(CacheSocketItem& item) {
+    comm::ScopedLock lock(mutex_);
+    xinfo2(TSF "add item to socket pool, ip:%_, port:%_, host:%_, fd:%_, timeout %_s size:%_",
+           item.address_info.str_ip,
+           item.address_info.port,
+           item.address_info.str_host,
+           item.socket_fd,
+           item.timeout,
+           idle_count_);
+    if (0 == max_idle_per_destination_ || 0 == max_idle_) {
+        ++stats_.evicted;
+        return false;
+    }
+
+    IdleStack& stack = socket_pool_[Key(item.address_info)];
+    if (stack.size() >= max_idle_per_destination_) {
+        xinfo2(TSF "destination full, evict fd:%_", stack.front().socket_fd);
+        stack.front().CloseSocket();
+        stack.erase(stack.begin());
+        --idle_count_;
+        ++stats_.evicted;
+    }
+    stack.push_back(item);
+    ++idle_count_;
+
+    if (idle_count_ > max_idle_) {
+        _EvictOldest();
+    }
+    return true;
+}
+
+void SocketPool::CleanTimeout() {
+    comm::ScopedLock lock(mutex_);
+    if (0 == idle_count_)
+        return;
+
+    IdleMap::iterator it = socket_pool_.begin();
+    while (it != socket_pool_.end()) {
+        IdleStack& stack = it->second;
+        IdleStack::iterator kept = stack.begin();
+        for (IdleStack::iterator item = stack.begin(); item != stack.end(); ++item) {
+            if (item->HasTimeout()) {
+                xinfo2(TSF "remove timeout socket: ip:%_, port:%_, host:%_, fd:%_",
+                       item->address_info.str_ip,
+                       item->address_info.port,
+                       item->address_info.str_host,
+                       item->socket_fd);
+                item->CloseSocket();
+                --idle_count_;
+                ++stats_.timeouts;
+                continue;
+            }
+            if (kept != item) {
+                *kept = *item;
+            }
+            ++kept;
+        }
+        stack.erase(kept, stack.end());
+
+        if (stack.empty()) {
+            it = socket_pool_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    _Reap();
+    xinfo2(TSF "after clean, size:%_, destinations:%_, hit:%_, miss:%_, reaped:%_, timeout:%_, evicted:%_",
+           idle_count_,
+           socket_pool_.size(),
+           stats_.hits,
+           stats_.misses,
+           stats_.reaped,
+           stats_.timeouts,
+           stats_.evicted);
+}
+
+void SocketPool::Clear() {
+    comm::ScopedLock lock(mutex_);
+    xinfo2(TSF "clear cache sockets");
+    for (IdleMap::iterator it = socket_pool_.begin(); it != socket_pool_.end(); ++it) {
+        for (IdleStack::iterator item = it->second.begin(); item != it->second.end(); ++item) {
+            if (item->socket_fd != INVALID_SOCKET)
+                item->CloseSocket();
+        }
+    }
+    socket_pool_.clear();
+    idle_count_ = 0;
+}
+
+void SocketPool::Report(bool _is_reused, bool _has_received, bool _is_decode_ok) {
+    if (_is_reused && (!_has_received || !_is_decode_ok)) {
+        ban_start_tick_.gettickcount();
+        is_baned_ = true;
+        xinfo2(TSF "report ban");
+    } else if (_is_reused && _has_received && _is_decode_ok) {
+        is_baned_ = false;
+    }
+}
+
+void SocketPool::SetLimits(size_t _max_idle_per_destination, size_t _max_idle) {
+    comm::ScopedLock lock(mutex_);
+    xinfo2(TSF "limits per destination:%_, total:%_", _max_idle_per_destination, _max_idle);
+    max_idle_per_destination_ = _max_idle_per_destination;
+    max_idle_ = _max_idle;
+
+    for (IdleMap::iterator it = socket_pool_.begin(); it != socket_pool_.end();) {
+        IdleStack& stack = it->second;
+        while (stack.size() > max_idle_per_destination_) {
+            stack.front().CloseSocket();
+            stack.erase(stack.begin());
+            --idle_count_;
+            ++stats_.evicted;
+        }
+        if (stack.empty()) {
+            it = socket_pool_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    while (idle_count_ > max_idle_) {
+        _EvictOldest();
+    }
+}
+
+SocketPoolStats SocketPool::GetStats() {
+    comm::ScopedLock lock(mutex_);
+    SocketPoolStats stats = stats_;
+    stats.idle = idle_count_;
+    stats.destinations = socket_pool_.size();
+    return stats;
+}
+
+bool SocketPool::_isBaned() {
+    bool ret = is_baned_ && ban_start_tick_.isValid() && ban_start_tick_.gettickspan() <= BAN_INTERVAL;
+    xverbose2_if(ret, TSF "isban:%_", ret);
+    return ret;
+}
+
+bool SocketPool::_IsSocketClosed(SOCKET fd) {
+    char buff[2];
+#ifndef WIN32
+    ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK | MSG_DONTWAIT);
+#else
+    ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK);
+#endif
+    if (0 == nrecv) {
+        xerror2(TSF "socket already closed");
+        return true;
+    }
+
+    if (0 > nrecv && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
+        xerror2(TSF "socket error:(%_, %_)", socket_errno, strerror(socket_errno));
+        return true;
+    }
+    return false;
+}
+
+void SocketPool::_EvictOldest() {
+    IdleMap::iterator oldest = socket_pool_.end();
+    tickcountdiff_t oldest_span = -1;
+    for (IdleMap::iterator it = socket_pool_.begin(); it != socket_pool_.end(); ++it) {
+        tickcountdiff_t span = it->second.front().start_tick.gettickspan();
+        if (span > oldest_span) {
+            oldest_span = span;
+            oldest = it;
+        }
+    }
+    if (oldest == socket_pool_.end())
+        return;
+
+    xinfo2(TSF "pool full, evict fd:%_", oldest->second.front().socket_fd);
+    oldest->second.front().CloseSocket();
+    oldest->second.erase(oldest->second.begin());
+    if (oldest->second.empty()) {
+        socket_pool_.erase(oldest);
+    }
+    --idle_count_;
+    ++stats_.evicted;
+}
+
+void SocketPool::_Reap() {
+#ifndef _WIN32
+    // an idle keep-alive socket has nothing to read: any event on it is a fin, a reset or an error
+    std::vector<pollfd> fds;
+    fds.reserve(idle_count_);
+    for (IdleMap::iterator it = socket_pool_.begin(); it != socket_pool_.end(); ++it) {
+        if (it->first.transport_protocol != Task::kTransportProtocolTCP)
+            continue;
+        for (IdleStack::iterator item = it->second.begin(); item != it->second.end(); ++item) {
+            pollfd pfd;
+            pfd.fd = item->socket_fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+        }
+    }
+    if (fds.empty())
+        return;
+
+    int ret = ::poll(&fds[0], (nfds_t)fds.size(), 0);
+    if (ret <= 0) {
+        xwarn2_if(ret < 0, TSF "poll err:(%_, %_)", socket_errno, strerror(socket_errno));
+        return;
+    }
+
+    // both walks visit the tcp sockets in the same order
+    size_t index = 0;
+    for (IdleMap::iterator it = socket_pool_.begin(); it != socket_pool_.end();) {
+        if (it->first.transport_protocol != Task::kTransportProtocolTCP) {
+            ++it;
+            continue;
+        }
+
+        IdleStack& stack = it->second;
+        IdleStack::iterator kept = stack.begin();
+        for (IdleStack::iterator item = stack.begin(); item != stack.end(); ++item, ++index) {
+            short revents = fds[index].revents;
+            if ((revents & (POLLERR | POLLHUP | POLLNVAL))
+                || ((revents & POLLIN) && _IsSocketClosed(item->socket_fd))) {
+                xinfo2(TSF "reap closed socket: ip:%_, port:%_, fd:%_, revents:%_",
+                       item->address_info.str_ip,
+                       item->address_info.port,
+                       item->socket_fd,
+                       revents);
+                item->CloseSocket();
+                --idle_count_;
+                ++stats_.reaped;
+                continue;
+            }
+            if (kept != item) {
+                *kept = *item;
+            }
+            ++kept;
+        }
+        stack.erase(kept, stack.end());
+
+        if (stack.empty()) {
+            it = socket_pool_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#endif
+}
+
+}  // namespace stn
+}  // namespace mars
@@ -20,7 +20,9 @@
 #ifndef SOCKET_POOL_
 #define SOCKET_POOL_
 
-#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "mars/comm/socket/unix_socket.h"
 #include "mars/comm/thread/lock.h"
@@ -92,165 +94,81 @@ class CacheSocketItem {
     bool (*issubstream_func)(SOCKET) = nullptr;
 };
 
+struct SocketPoolStats {
+    SocketPoolStats() : hits(0), misses(0), reaped(0), timeouts(0), evicted(0), idle(0), destinations(0) {
+    }
+
+    uint64_t hits;      // GetSocket served from cache
+    uint64_t misses;    // GetSocket found nothing usable
+    uint64_t reaped;    // idle sockets found closed by the peer
+    uint64_t timeouts;  // idle sockets past their keep-alive
+    uint64_t evicted;   // dropped by AddCache because a limit was reached
+    size_t idle;
+    size_t destinations;
+};
+
 class SocketPool {
  public:
     const int DEFAULT_MAX_KEEPALIVE_TIME = 5 * 1000;  // same as apache default
+    static const size_t kDefaultMaxIdlePerDestination = 16;
+    static const size_t kDefaultMaxIdle = 256;
 
-    SocketPool() : use_cache_(true), is_baned_(false) {
-    }
-    ~SocketPool() {
-        Clear();
-    }
+    SocketPool();
+    ~SocketPool();
 
-    SOCKET GetSocket(const IPPortItem& _item) {
-        xverbose_function();
-        comm::ScopedLock lock(mutex_);
-        if (!use_cache_ || _isBaned() || socket_pool_.empty()) {
-            return INVALID_SOCKET;
-        }
-
-        auto iter = socket_pool_.begin();
-        while (iter != socket_pool_.end()) {
-            if (iter->IsSame(_item)) {
-                if (iter->HasTimeout()
-                    || (_item.transport_protocol == Task::kTransportProtocolTCP && _IsSocketClosed(iter->socket_fd))) {
-                    xinfo2(TSF "remove timeout or closed socket, is timeout:%_", iter->HasTimeout());
-                    iter->CloseSocket();
-                    iter = socket_pool_.erase(iter);
-                    continue;
-                }
+    SOCKET GetSocket(const IPPortItem& _item);
+    bool AddCache(CacheSocketItem& item);
+    // drops timed out sockets and, with one poll over every idle tcp socket, the ones the peer has closed
+    void CleanTimeout();
+    void Clear();
+    void Report(bool _is_reused, bool _has_received, bool _is_decode_ok);
 
-                if (_item.transport_protocol == Task::kTransportProtocolTCP || iter->IsSubStream()) {
-                    SOCKET fd = iter->socket_fd;
-                    socket_pool_.erase(iter);
-                    xinfo2(TSF "get from cache: ip:%_, port:%_, host:%_, fd:%_, size:%_",
-                           _item.str_ip,
-                           _item.port,
-                           _item.str_host,
-                           fd,
-                           socket_pool_.size());
-                    return fd;
-                }
+    // the oldest idle socket of a destination, or of the whole pool, makes room for a new one
+    void SetLimits(size_t _max_idle_per_destination, size_t _max_idle);
+    SocketPoolStats GetStats();
 
-                // create sub stream for quic
-                xassert2(_item.transport_protocol == Task::kTransportProtocolQUIC);
-                int subfd = iter->CreateStream();
-                if (subfd == INVALID_SOCKET) {
-                    xwarn2(TSF "create substream failed. url %_:%_ fd %_", _item.str_ip, _item.port, iter->socket_fd);
-                    socket_pool_.erase(iter);
-                    return INVALID_SOCKET;
-                }
-                // recalc keepalive time
-                xinfo2(TSF "get from cache url %_:%_ owner %_ stream %_",
-                       _item.str_ip,
-                       _item.port,
-                       iter->socket_fd,
-                       subfd);
-                iter->ResetTimeout();
-                return subfd;
-            }
-            iter++;
+ private:
+    struct Key {
+        explicit Key(const IPPortItem& _item)
+        : transport_protocol(_item.transport_protocol), str_ip(_item.str_ip), port(_item.port), str_host(_item.str_host) {
         }
-        xdebug2(TSF "can not find socket ip:%_, port:%_, host:%_, size:%_",
-                _item.str_ip,
-                _item.port,
-                _item.str_host,
-                socket_pool_.size());
-        return INVALID_SOCKET;
-    }
-
-    bool AddCache(CacheSocketItem& item) {
-        comm::ScopedLock lock(mutex_);
-        xinfo2(TSF "add item to socket pool, ip:%_, port:%_, host:%_, fd:%_, timeout %_s size:%_",
-               item.address_info.str_ip,
-               item.address_info.port,
-               item.address_info.str_host,
-               item.socket_fd,
-               item.timeout,
-               socket_pool_.size());
-        socket_pool_.push_front(item);
-        return true;
-    }
-
-    void CleanTimeout() {
-        comm::ScopedLock lock(mutex_);
-        if (socket_pool_.empty())
-            return;
-
-        auto iter = socket_pool_.begin();
-        while (iter != socket_pool_.end()) {
-            if (iter->HasTimeout()) {
-                xinfo2(TSF "remove timeout socket: ip:%_, port:%_, host:%_, fd:%_",
-                       iter->address_info.str_ip,
-                       iter->address_info.port,
-                       iter->address_info.str_host,
-                       iter->socket_fd);
-                iter->CloseSocket();
-                iter = socket_pool_.erase(iter);
-                continue;
-            }
-            iter++;
+        bool operator==(const Key& _other) const {
+            return transport_protocol == _other.transport_protocol && port == _other.port && str_ip == _other.str_ip
+                   && str_host == _other.str_host;
         }
-        xinfo2(TSF "after clean, size:%_", socket_pool_.size());
-    }
 
-    void Clear() {
-        comm::ScopedLock lock(mutex_);
-        xinfo2(TSF "clear cache sockets");
-        std::for_each(socket_pool_.begin(), socket_pool_.end(), [](CacheSocketItem& value) {
-            if (value.socket_fd != INVALID_SOCKET)
-                value.CloseSocket();
-        });
-        socket_pool_.clear();
-    }
-
-    void Report(bool _is_reused, bool _has_received, bool _is_decode_ok) {
-        if (_is_reused && (!_has_received || !_is_decode_ok)) {
-            ban_start_tick_.gettickcount();
-            is_baned_ = true;
-            xinfo2(TSF "report ban");
-        } else if (_is_reused && _has_received && _is_decode_ok) {
-            is_baned_ = false;
+        int transport_protocol;
+        std::string str_ip;
+        uint16_t port;
+        std::string str_host;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& _key) const {
+            size_t seed = std::hash<std::string>()(_key.str_ip);
+            seed ^= std::hash<std::string>()(_key.str_host) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            seed ^= ((size_t)_key.port << 8 | (size_t)_key.transport_protocol) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+            return seed;
         }
-    }
+    };
 
- private:
-    bool _isBaned() {
-        bool ret = is_baned_ && ban_start_tick_.isValid() && ban_start_tick_.gettickspan() <= BAN_INTERVAL;
-        xverbose2_if(ret, TSF "isban:%_", ret);
-        return ret;
-    }
-
-    bool _IsSocketClosed(SOCKET fd) {
-        char buff[2];
-        int try_count = 0;
-        while (try_count < 2) {
-            try_count++;
-#ifndef WIN32
-            ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK | MSG_DONTWAIT);
-#else
-            ssize_t nrecv = ::recv(fd, buff, 1, MSG_PEEK);
-#endif
-            if (0 == nrecv) {
-                xerror2(TSF "socket already closed");
-                return true;
-            }
+    // idle sockets of one destination, oldest first; reuse takes the back
+    typedef std::vector<CacheSocketItem> IdleStack;
+    typedef std::unordered_map<Key, IdleStack, KeyHash> IdleMap;
 
-            if (0 > nrecv && !IS_NOBLOCK_READ_ERRNO(socket_errno)) {
-                xerror2(TSF "socket error:(%_, %_)", socket_errno, strerror(socket_errno));
-                return true;
-            } else {
-                return false;
-            }
-        }
-
-        return true;
-    }
+    bool _isBaned();
+    bool _IsSocketClosed(SOCKET fd);
+    void _EvictOldest();
+    void _Reap();
 
  private:
     comm::Mutex mutex_;
     bool use_cache_;
-    std::list<CacheSocketItem> socket_pool_;
+    IdleMap socket_pool_;
+    size_t idle_count_;
+    size_t max_idle_per_destination_;
+    size_t max_idle_;
+    SocketPoolStats stats_;
     bool is_baned_;
     tickcount_t ban_start_tick_;
 };
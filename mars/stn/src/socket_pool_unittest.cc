@@ -0,0 +1,170 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * socket_pool_unittest.cc
+ *
+ * LIFO reuse per destination, limits, the bulk reaper, and reuse with a few
+ * hundred sockets parked in the pool.
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "socket_pool.h"
+
+using namespace mars::stn;
+
+static int CloseFd(SOCKET _fd) {
+    return socket_close(_fd);
+}
+
+static IPPortItem Destination(int _index) {
+    IPPortItem item;
+    item.str_ip = "10.0.0." + std::to_string(_index % 250);
+    item.port = 80 + _index / 250;
+    item.source_type = kIPSourceDNS;
+    item.str_host = "short.weixin.qq.com";
+    return item;
+}
+
+// the pool keeps one end, the test holds the other as the "server"
+static SOCKET Park(SocketPool& _pool, const IPPortItem& _item, std::vector<SOCKET>& _peers) {
+    int pair[2];
+    EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair));
+    _peers.push_back(pair[1]);
+    CacheSocketItem cache(_item, pair[0], 60, CloseFd, nullptr, nullptr);
+    EXPECT_TRUE(_pool.AddCache(cache));
+    return pair[0];
+}
+
+static void CloseAll(std::vector<SOCKET>& _peers) {
+    for (size_t i = 0; i < _peers.size(); ++i) {
+        socket_close(_peers[i]);
+    }
+    _peers.clear();
+}
+
+TEST(socket_pool, lifo_per_destination) {
+    SocketPool pool;
+    std::vector<SOCKET> peers;
+    SOCKET a1 = Park(pool, Destination(1), peers);
+    SOCKET b1 = Park(pool, Destination(2), peers);
+    SOCKET a2 = Park(pool, Destination(1), peers);
+
+    EXPECT_EQ(a2, pool.GetSocket(Destination(1)));
+    EXPECT_EQ(a1, pool.GetSocket(Destination(1)));
+    EXPECT_EQ(INVALID_SOCKET, pool.GetSocket(Destination(1)));
+    EXPECT_EQ(b1, pool.GetSocket(Destination(2)));
+
+    SocketPoolStats stats = pool.GetStats();
+    EXPECT_EQ(3u, stats.hits);
+    EXPECT_EQ(1u, stats.misses);
+    EXPECT_EQ(0u, stats.idle);
+    EXPECT_EQ(0u, stats.destinations);
+
+    socket_close(a1);
+    socket_close(a2);
+    socket_close(b1);
+    CloseAll(peers);
+}
+
+TEST(socket_pool, limits_evict_oldest) {
+    SocketPool pool;
+    pool.SetLimits(2, 3);
+    std::vector<SOCKET> peers;
+    // apart by a few ticks, so "oldest" is not a tie
+    Park(pool, Destination(1), peers);
+    usleep(5 * 1000);
+    SOCKET a2 = Park(pool, Destination(1), peers);
+    usleep(5 * 1000);
+    SOCKET a3 = Park(pool, Destination(1), peers);
+    usleep(5 * 1000);
+    SOCKET b1 = Park(pool, Destination(2), peers);
+    usleep(5 * 1000);
+    SOCKET c1 = Park(pool, Destination(3), peers);
+
+    // a1 went for the destination limit, a2 for the total one
+    SocketPoolStats stats = pool.GetStats();
+    EXPECT_EQ(3u, stats.idle);
+    EXPECT_EQ(2u, stats.evicted);
+    EXPECT_EQ(a3, pool.GetSocket(Destination(1)));
+    EXPECT_EQ(INVALID_SOCKET, pool.GetSocket(Destination(1)));
+    EXPECT_EQ(b1, pool.GetSocket(Destination(2)));
+    EXPECT_EQ(c1, pool.GetSocket(Destination(3)));
+    (void)a2;
+
+    socket_close(a3);
+    socket_close(b1);
+    socket_close(c1);
+    CloseAll(peers);
+}
+
+TEST(socket_pool, reaper_drops_peer_closed) {
+    SocketPool pool;
+    std::vector<SOCKET> peers;
+    const int kParked = 200;
+    for (int i = 0; i < kParked; ++i) {
+        Park(pool, Destination(i), peers);
+    }
+    // every other "server" goes away
+    for (int i = 0; i < kParked; i += 2) {
+        socket_close(peers[i]);
+        peers[i] = INVALID_SOCKET;
+    }
+
+    pool.CleanTimeout();
+    SocketPoolStats stats = pool.GetStats();
+    EXPECT_EQ((uint64_t)kParked / 2, stats.reaped);
+    EXPECT_EQ((size_t)kParked / 2, stats.idle);
+    EXPECT_EQ(INVALID_SOCKET, pool.GetSocket(Destination(0)));
+    SOCKET alive = pool.GetSocket(Destination(1));
+    EXPECT_NE(INVALID_SOCKET, alive);
+
+    socket_close(alive);
+    pool.Clear();
+    for (size_t i = 0; i < peers.size(); ++i) {
+        if (peers[i] != INVALID_SOCKET)
+            socket_close(peers[i]);
+    }
+}
+
+TEST(socket_pool, reuse_with_hundreds_parked) {
+    SocketPool pool;
+    pool.SetLimits(4, 1024);
+    std::vector<SOCKET> peers;
+    std::vector<SOCKET> parked;
+    const int kDestinations = 500;
+    const int kRounds = 2 * kDestinations;
+    for (int i = 0; i < kDestinations; ++i) {
+        parked.push_back(Park(pool, Destination(i), peers));
+    }
+
+    // each destination gets back its own socket, whatever else is parked
+    for (int round = 0; round < kRounds; ++round) {
+        IPPortItem item = Destination(round % kDestinations);
+        SOCKET fd = pool.GetSocket(item);
+        ASSERT_EQ(parked[round % kDestinations], fd);
+        CacheSocketItem cache(item, fd, 60, CloseFd, nullptr, nullptr);
+        pool.AddCache(cache);
+    }
+
+    SocketPoolStats stats = pool.GetStats();
+    EXPECT_EQ((uint64_t)kRounds, stats.hits);
+    EXPECT_EQ((size_t)kDestinations, stats.idle);
+
+    pool.Clear();
+    CloseAll(peers);
+}
@@ -0,0 +1,130 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * task_profile_unittest.cc
+ *
+ * What queueing 10k tasks and running their attempts, the way the task managers do, costs in Task copies
+ * and in heap.
+ */
+
+#include <stdlib.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mars/stn/task_profile.h"
+
+using namespace mars::stn;
+
+// mallinfo2() sums the whole heap, no hook into the allocator, so it holds for any binary the test links into
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define TASK_PROFILE_HEAP_IN_USE
+static size_t HeapInUse() {
+    return mallinfo2().uordblks;
+}
+#endif
+
+static const size_t kTaskCount = 10000;
+static const int kAttempts = 3;
+
+static Task MakeTask(uint32_t _taskid) {
+    // every string is longer than the small string buffer, so each one is a heap allocation
+    Task task(_taskid);
+    task.cgi = "/cgi-bin/micromsg-bin/newsendmsg";
+    task.channel_name = "default_shortlink_channel";
+    task.user_id = "wxid_0123456789abcdef0123";
+    task.report_arg = "report_arg_for_unittest_only";
+    task.headers["Content-Type"] = "application/octet-stream";
+    task.headers["Accept-Encoding"] = "identity_for_unittest";
+    task.extra_info["region"] = "region_shanghai_unittest";
+    for (int i = 0; i < 3; ++i) {
+        std::string host = "short" + std::to_string(i) + ".weixin.qq.com.unittest";
+        task.shortlink_host_list.push_back(host);
+        task.shortlink_fallback_hostlist.push_back(host);
+        task.longlink_host_list.push_back("long" + std::to_string(i) + ".weixin.qq.com.unittest");
+    }
+    task.retry_count = kAttempts - 1;
+    return task;
+}
+
+static void RunAttempts(std::list<TaskProfile>& _queue) {
+    for (int attempt = 0; attempt < kAttempts; ++attempt) {
+        for (auto& profile : _queue) {
+            profile.task.client_sequence_id = attempt;
+            profile.PushHistory();
+            profile.InitSendParam();
+        }
+    }
+}
+
+TEST(task_profile, attempts_share_the_descriptor) {
+    std::vector<Task> tasks;
+    tasks.reserve(kTaskCount);
+    for (size_t i = 0; i < kTaskCount; ++i) {
+        tasks.push_back(MakeTask((uint32_t)(i + 1)));
+    }
+
+    std::list<TaskProfile> queue;
+    for (const auto& task : tasks) {
+        queue.push_back(TaskProfile(task, PrepareProfile()));
+    }
+    RunAttempts(queue);
+
+    // the profile, its transfer profile and each history entry hold the one descriptor, no Task copy of their own
+    for (const auto& profile : queue) {
+        ASSERT_EQ((size_t)kAttempts, profile.history_transfer_profiles.size());
+        for (const auto& transfer : profile.history_transfer_profiles) {
+            EXPECT_EQ(profile.descriptor.get(), transfer.task.get());
+        }
+        EXPECT_EQ(profile.descriptor.get(), profile.transfer_profile.task.get());
+        EXPECT_EQ(2 + kAttempts, profile.descriptor.use_count());
+        EXPECT_EQ(kAttempts - 1, profile.task.client_sequence_id);
+        EXPECT_EQ(0, profile.descriptor->client_sequence_id);
+    }
+}
+
+TEST(task_profile, attempts_add_no_task_copies_to_the_heap) {
+#ifndef TASK_PROFILE_HEAP_IN_USE
+    GTEST_SKIP() << "no mallinfo2()";
+#else
+    std::vector<Task> tasks;
+    tasks.reserve(kTaskCount);
+    for (size_t i = 0; i < kTaskCount; ++i) {
+        tasks.push_back(MakeTask((uint32_t)(i + 1)));
+    }
+
+    size_t before_copy = HeapInUse();
+    std::unique_ptr<Task> copy(new Task(tasks.front()));
+    size_t bytes_per_copy = HeapInUse() - before_copy;
+    copy.reset();
+    ASSERT_GT(bytes_per_copy, sizeof(Task));
+
+    std::list<TaskProfile> queue;
+    for (const auto& task : tasks) {
+        queue.push_back(TaskProfile(task, PrepareProfile()));
+    }
+    size_t queued = HeapInUse();
+    RunAttempts(queue);
+    size_t run = HeapInUse();
+
+    // the history's own TransferProfiles, in a vector grown to 4, and nothing of the Task behind them
+    size_t grown_per_task = (run - queued) / kTaskCount;
+    EXPECT_LT(grown_per_task, 4 * sizeof(TransferProfile) + bytes_per_copy / 2);
+#endif
+}
@@ -0,0 +1,267 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * task_tracer.cc
+ */
+
+#include "task_tracer.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <set>
+
+#include "mars/comm/time_utils.h"
+#include "mars/comm/xlogger/xlogger.h"
+
+namespace mars {
+namespace stn {
+
+namespace {
+
+const char* const kPhaseNames[TaskTracer::kPhaseCount] = {
+    "task",
+    "queue",
+    "auth",
+    "req2buf",
+    "dns",
+    "connect",
+    "tls",
+    "send",
+    "first byte",
+    "last byte",
+    "response",
+    "buf2resp",
+    "callback",
+};
+
+// collects one task's spans; a span that ended before the attempt could run, like the connect of a long link
+// that was up before the task came, is not the task's time and is left out, one running into it is cut there
+class SpanBuilder {
+ public:
+    SpanBuilder(const TaskProfile& _profile, std::vector<TaskTracer::Span>& _spans)
+    : profile_(_profile), spans_(_spans), attempt_(0), ready_(_profile.start_task_time), attempt_end_(ready_) {
+    }
+
+    // what comes next waits for everything so far
+    void Settle() {
+        ready_ = attempt_end_;
+    }
+
+    void NextAttempt() {
+        Settle();
+        if (attempt_ < 255)
+            ++attempt_;
+    }
+
+    uint64_t Ready() const {
+        return ready_;
+    }
+
+    void Add(int _phase, uint64_t _begin, uint64_t _end) {
+        if (0 == _begin || _end < _begin || _end < ready_)
+            return;
+
+        TaskTracer::Span span;
+        span.taskid = profile_.task.taskid;
+        span.cmdid = profile_.task.cmdid;
+        span.phase = (uint8_t)_phase;
+        span.attempt = attempt_;
+        span.channel_select = (int16_t)profile_.task.channel_select;
+        span.err_type = 0;
+        span.err_code = 0;
+        span.begin = std::max(_begin, ready_);
+        span.end = _end;
+        spans_.push_back(span);
+        if (TaskTracer::kTask != _phase)
+            attempt_end_ = std::max(attempt_end_, _end);
+    }
+
+ private:
+    const TaskProfile& profile_;
+    std::vector<TaskTracer::Span>& spans_;
+    uint8_t attempt_;
+    uint64_t ready_;
+    uint64_t attempt_end_;
+};
+
+uint64_t Earliest(uint64_t _a, uint64_t _b) {
+    if (0 == _a)
+        return _b;
+    if (0 == _b)
+        return _a;
+    return std::min(_a, _b);
+}
+
+}  // namespace
+
+TaskTracer& TaskTracer::Shared() {
+    static TaskTracer* tracer = new TaskTracer();
+    return *tracer;
+}
+
+const char* TaskTracer::PhaseName(int _phase) {
+    if (0 > _phase || kPhaseCount <= _phase)
+        return "unknown";
+    return kPhaseNames[_phase];
+}
+
+TaskTracer::TaskTracer() : enabled_(false), written_(0) {
+}
+
+void TaskTracer::SetCapacity(size_t _spans) {
+    comm::ScopedLock lock(mutex_);
+    enabled_.store(0 < _spans, std::memory_order_relaxed);
+    std::vector<Span>(_spans).swap(ring_);
+    written_ = 0;
+    xinfo2(TSF "task trace capacity:%_", _spans);
+}
+
+void TaskTracer::__Record(const TaskProfile& _profile) {
+    uint64_t task_end = 0 != _profile.end_task_time ? _profile.end_task_time : ::gettickcount();
+
+    std::vector<Span> spans;
+    spans.reserve(8 + 12 * _profile.history_transfer_profiles.size());
+    SpanBuilder builder(_profile, spans);
+    builder.Add(kTask, _profile.start_task_time, task_end);
+    if (!spans.empty()) {
+        spans.back().err_type = _profile.err_type;
+        spans.back().err_code = _profile.err_code;
+    }
+
+    for (size_t i = 0; i < _profile.history_transfer_profiles.size(); ++i) {
+        const TransferProfile& transfer = _profile.history_transfer_profiles[i];
+        const ConnectProfile& connect = transfer.connect_profile;
+        if (0 < i)
+            builder.NextAttempt();
+
+        uint64_t picked = Earliest(Earliest(transfer.begin_first_get_host_time, transfer.begin_make_sure_auth_time),
+                                   Earliest(transfer.begin_req2buf_time, transfer.loop_start_task_time));
+        builder.Add(kQueue, builder.Ready(), picked);
+        builder.Add(kAuth, transfer.begin_make_sure_auth_time, transfer.end_make_sure_auth_time);
+        builder.Add(kReq2Buf, transfer.begin_req2buf_time, transfer.end_req2buf_time);
+        builder.Add(kDns, connect.dns_time, connect.dns_endtime);
+        builder.Add(kConnect, connect.start_connect_time, connect.connect_successful_time);
+        builder.Add(kTls, connect.start_tls_handshake_time, connect.tls_handshake_successful_time);
+
+        if (0 != connect.start_send_packet_time) {
+            // a short link times its own send and read
+            uint64_t sent = connect.start_send_packet_time + connect.send_request_cost;
+            builder.Add(kSend, connect.start_send_packet_time, sent);
+            builder.Add(kFirstByte, sent, connect.start_read_packet_time);
+            builder.Add(kLastByte, connect.start_read_packet_time, connect.read_packet_finished_time);
+        } else {
+            // the long link reports the packet written and each read, not which read was the first byte
+            builder.Add(kSend, transfer.loop_start_task_time, transfer.start_send_time);
+            builder.Add(kResponse, transfer.start_send_time, transfer.last_receive_pkg_time);
+        }
+        builder.Add(kBuf2Resp, transfer.begin_buf2resp_time, transfer.end_buf2resp_time);
+    }
+    if (!_profile.history_transfer_profiles.empty()) {
+        builder.Settle();
+        builder.Add(kCallback, builder.Ready(), task_end);
+    }
+
+    comm::ScopedLock lock(mutex_);
+    if (ring_.empty())
+        return;
+    for (size_t i = 0; i < spans.size(); ++i) {
+        ring_[written_ % ring_.size()] = spans[i];
+        ++written_;
+    }
+}
+
+void TaskTracer::Snapshot(std::vector<Span>& _spans) const {
+    comm::ScopedLock lock(mutex_);
+    _spans.clear();
+    if (ring_.empty())
+        return;
+
+    size_t count = (size_t)std::min<uint64_t>(written_, ring_.size());
+    _spans.reserve(count);
+    for (uint64_t i = written_ - count; i < written_; ++i) {
+        _spans.push_back(ring_[i % ring_.size()]);
+    }
+}
+
+void TaskTracer::Clear() {
+    comm::ScopedLock lock(mutex_);
+    written_ = 0;
+}
+
+std::string TaskTracer::ChromeTraceJson() const {
+    std::vector<Span> spans;
+    Snapshot(spans);
+
+    std::string json;
+    json.reserve(64 + spans.size() * 160);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"stn tasks\"}}";
+
+    char event[256];
+    std::set<uint32_t> named;
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const Span& span = spans[i];
+        // a row per task, a span nests in the ones containing it on the same row
+        if (named.insert(span.taskid).second) {
+            snprintf(event,
+                     sizeof(event),
+                     ",{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                     "\"args\":{\"name\":\"task %u cmdid %u\"}}",
+                     span.taskid,
+                     span.taskid,
+                     span.cmdid);
+            json += event;
+        }
+
+        int len = snprintf(event,
+                           sizeof(event),
+                           ",{\"name\":\"%s\",\"cat\":\"stn\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                           "\"ts\":%llu,\"dur\":%llu,\"args\":{\"attempt\":%u",
+                           PhaseName(span.phase),
+                           span.taskid,
+                           (unsigned long long)span.begin * 1000,
+                           (unsigned long long)(span.end - span.begin) * 1000,
+                           (unsigned)span.attempt);
+        json.append(event, len);
+        if (kTask == span.phase) {
+            len = snprintf(event,
+                           sizeof(event),
+                           ",\"cmdid\":%u,\"channel\":%d,\"err_type\":%d,\"err_code\":%d",
+                           span.cmdid,
+                           (int)span.channel_select,
+                           (int)span.err_type,
+                           (int)span.err_code);
+            json.append(event, len);
+        }
+        json += "}}";
+    }
+    json += "]}";
+    return json;
+}
+
+bool TaskTracer::DumpChromeTrace(const std::string& _path) const {
+    std::string json = ChromeTraceJson();
+    FILE* file = fopen(_path.c_str(), "wb");
+    if (NULL == file) {
+        xerror2(TSF "open %_ failed", _path);
+        return false;
+    }
+    bool ok = json.size() == fwrite(json.data(), 1, json.size(), file);
+    ok = 0 == fclose(file) && ok;
+    xinfo2(TSF "dump task trace to %_, %_ bytes, ok:%_", _path, json.size(), ok);
+    return ok;
+}
+
+}  // namespace stn
+}  // namespace mars
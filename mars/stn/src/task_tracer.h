@@ -0,0 +1,117 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * task_tracer.h
+ *
+ * Turns the timestamps a finished TaskProfile carries into spans, one per
+ * phase of every attempt: queue wait, auth, req2buf, dns, connect, tls,
+ * send, first byte, last byte, buf2resp and the end callback. The spans go
+ * to a ring of the last few thousand and export as Chrome trace JSON, which
+ * chrome://tracing and Perfetto open, one row per task.
+ *
+ * Off until a capacity is set. Off, Record is one relaxed load.
+ */
+
+#ifndef STN_SRC_TASK_TRACER_H_
+#define STN_SRC_TASK_TRACER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "mars/comm/thread/lock.h"
+#include "mars/stn/task_profile.h"
+
+namespace mars {
+namespace stn {
+
+class TaskTracer {
+ public:
+    enum Phase {
+        kTask,       // StartTask to the end callback returning
+        kQueue,      // waiting to be picked up, or to be retried
+        kAuth,       // MakesureAuthed
+        kReq2Buf,
+        kDns,
+        kConnect,
+        kTls,
+        kSend,
+        kFirstByte,  // request sent to the first response byte
+        kLastByte,   // first response byte to the last
+        kResponse,   // request sent to the last byte, where the link doesn't tell the first byte apart
+        kBuf2Resp,
+        kCallback,   // OnTaskEnd
+        kPhaseCount,
+    };
+
+    // the profile's own resolution, milliseconds of gettickcount
+    struct Span {
+        uint32_t taskid;
+        uint32_t cmdid;
+        uint8_t phase;
+        uint8_t attempt;
+        int16_t channel_select;
+        int32_t err_type;  // kTask only
+        int32_t err_code;  // kTask only
+        uint64_t begin;
+        uint64_t end;
+    };
+
+ public:
+    // the one StnManager records into
+    static TaskTracer& Shared();
+    static const char* PhaseName(int _phase);
+
+    TaskTracer();
+
+    // keeps the last _spans spans, 0 turns recording off and drops them
+    void SetCapacity(size_t _spans);
+    bool IsEnabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // every attempt in _profile's history, so call it once the task has ended
+    void Record(const TaskProfile& _profile) {
+        if (!IsEnabled())
+            return;
+        __Record(_profile);
+    }
+
+    // oldest first
+    void Snapshot(std::vector<Span>& _spans) const;
+    void Clear();
+
+    // {"traceEvents": [...]}, timestamps in microseconds of gettickcount
+    std::string ChromeTraceJson() const;
+    bool DumpChromeTrace(const std::string& _path) const;
+
+ private:
+    void __Record(const TaskProfile& _profile);
+
+ private:
+    TaskTracer(const TaskTracer&);
+    TaskTracer& operator=(const TaskTracer&);
+
+ private:
+    std::atomic<bool> enabled_;
+    mutable comm::Mutex mutex_;
+    std::vector<Span> ring_;
+    uint64_t written_;  // spans ever written, the next goes to written_ % ring_.size()
+};
+
+}  // namespace stn
+}  // namespace mars
+
+#endif  // STN_SRC_TASK_TRACER_H_
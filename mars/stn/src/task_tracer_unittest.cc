@@ -0,0 +1,225 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * task_tracer_unittest.cc
+ *
+ * Phase spans built from hand-filled task profiles, the ring, and the Chrome trace JSON.
+ */
+
+#include "task_tracer.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mars/rapidjson/document.h"
+
+using namespace mars::stn;
+
+namespace {
+
+Task MakeTask(uint32_t _taskid) {
+    Task task(_taskid);
+    task.cmdid = 42;
+    task.channel_select = Task::kChannelLong;
+    return task;
+}
+
+// a short link attempt starting at _at: dns 5, connect 10, tls 20, send 2, wait 30, read 8
+void FillShortLink(TransferProfile& _transfer, uint64_t _at) {
+    ConnectProfile& connect = _transfer.connect_profile;
+    _transfer.begin_first_get_host_time = _at;
+    _transfer.begin_req2buf_time = _at + 1;
+    _transfer.end_req2buf_time = _at + 2;
+    connect.dns_time = _at + 2;
+    connect.dns_endtime = _at + 7;
+    connect.start_connect_time = _at + 7;
+    connect.connect_successful_time = _at + 17;
+    connect.start_tls_handshake_time = _at + 17;
+    connect.tls_handshake_successful_time = _at + 37;
+    connect.start_send_packet_time = _at + 37;
+    connect.send_request_cost = 2;
+    connect.start_read_packet_time = _at + 69;
+    connect.read_packet_finished_time = _at + 77;
+    _transfer.begin_buf2resp_time = _at + 77;
+    _transfer.end_buf2resp_time = _at + 79;
+}
+
+const TaskTracer::Span* Find(const std::vector<TaskTracer::Span>& _spans, int _phase, int _attempt) {
+    for (size_t i = 0; i < _spans.size(); ++i) {
+        if (_phase == _spans[i].phase && _attempt == _spans[i].attempt)
+            return &_spans[i];
+    }
+    return NULL;
+}
+
+}  // namespace
+
+TEST(TaskTracerTest, OffRecordsNothing) {
+    TaskTracer tracer;
+    TaskProfile profile(MakeTask(1), PrepareProfile());
+    profile.end_task_time = profile.start_task_time + 10;
+    tracer.Record(profile);
+
+    std::vector<TaskTracer::Span> spans;
+    tracer.Snapshot(spans);
+    EXPECT_FALSE(tracer.IsEnabled());
+    EXPECT_TRUE(spans.empty());
+}
+
+TEST(TaskTracerTest, ShortLinkRetryPhases) {
+    TaskTracer tracer;
+    tracer.SetCapacity(100);
+
+    TaskProfile profile(MakeTask(7), PrepareProfile());
+    const uint64_t kStart = profile.start_task_time;
+    FillShortLink(profile.transfer_profile, kStart + 3);
+    profile.transfer_profile.connect_profile.read_packet_finished_time = 0;  // the first attempt timed out reading
+    profile.transfer_profile.begin_buf2resp_time = 0;
+    profile.PushHistory();
+    profile.transfer_profile.Reset();
+    FillShortLink(profile.transfer_profile, kStart + 200);
+    profile.PushHistory();
+    profile.end_task_time = kStart + 285;
+    profile.err_type = kEctOK;
+    tracer.Record(profile);
+
+    std::vector<TaskTracer::Span> spans;
+    tracer.Snapshot(spans);
+
+    const TaskTracer::Span* task = Find(spans, TaskTracer::kTask, 0);
+    ASSERT_TRUE(NULL != task);
+    EXPECT_EQ(7u, task->taskid);
+    EXPECT_EQ(42u, task->cmdid);
+    EXPECT_EQ(kStart, task->begin);
+    EXPECT_EQ(kStart + 285, task->end);
+
+    const TaskTracer::Span* queue = Find(spans, TaskTracer::kQueue, 0);
+    ASSERT_TRUE(NULL != queue);
+    EXPECT_EQ(3u, queue->end - queue->begin);
+    EXPECT_EQ(5u, Find(spans, TaskTracer::kDns, 0)->end - Find(spans, TaskTracer::kDns, 0)->begin);
+    EXPECT_EQ(30u, Find(spans, TaskTracer::kFirstByte, 0)->end - Find(spans, TaskTracer::kFirstByte, 0)->begin);
+    EXPECT_TRUE(NULL == Find(spans, TaskTracer::kLastByte, 0));
+    EXPECT_TRUE(NULL == Find(spans, TaskTracer::kBuf2Resp, 0));
+
+    // the retry waits from where the first attempt stopped, at its first byte
+    const TaskTracer::Span* requeue = Find(spans, TaskTracer::kQueue, 1);
+    ASSERT_TRUE(NULL != requeue);
+    EXPECT_EQ(kStart + 3 + 69, requeue->begin);
+    EXPECT_EQ(kStart + 200, requeue->end);
+    EXPECT_EQ(20u, Find(spans, TaskTracer::kTls, 1)->end - Find(spans, TaskTracer::kTls, 1)->begin);
+    EXPECT_EQ(8u, Find(spans, TaskTracer::kLastByte, 1)->end - Find(spans, TaskTracer::kLastByte, 1)->begin);
+
+    const TaskTracer::Span* callback = Find(spans, TaskTracer::kCallback, 1);
+    ASSERT_TRUE(NULL != callback);
+    EXPECT_EQ(kStart + 279, callback->begin);
+    EXPECT_EQ(kStart + 285, callback->end);
+}
+
+TEST(TaskTracerTest, LongLinkConnectedBeforeTask) {
+    TaskTracer tracer;
+    tracer.SetCapacity(100);
+
+    TaskProfile profile(MakeTask(9), PrepareProfile());
+    const uint64_t kStart = profile.start_task_time;
+    TransferProfile& transfer = profile.transfer_profile;
+    transfer.connect_profile.start_connect_time = kStart - 5000;
+    transfer.connect_profile.connect_successful_time = kStart - 4900;
+    transfer.begin_make_sure_auth_time = kStart + 1;
+    transfer.end_make_sure_auth_time = kStart + 2;
+    transfer.begin_req2buf_time = kStart + 2;
+    transfer.end_req2buf_time = kStart + 4;
+    transfer.loop_start_task_time = kStart + 4;
+    transfer.start_send_time = kStart + 5;
+    transfer.last_receive_pkg_time = kStart + 45;
+    transfer.begin_buf2resp_time = kStart + 45;
+    transfer.end_buf2resp_time = kStart + 46;
+    profile.PushHistory();
+    profile.end_task_time = kStart + 47;
+    tracer.Record(profile);
+
+    std::vector<TaskTracer::Span> spans;
+    tracer.Snapshot(spans);
+    EXPECT_TRUE(NULL == Find(spans, TaskTracer::kConnect, 0));
+    EXPECT_TRUE(NULL == Find(spans, TaskTracer::kFirstByte, 0));
+    ASSERT_TRUE(NULL != Find(spans, TaskTracer::kAuth, 0));
+    EXPECT_EQ(1u, Find(spans, TaskTracer::kQueue, 0)->end - Find(spans, TaskTracer::kQueue, 0)->begin);
+    EXPECT_EQ(1u, Find(spans, TaskTracer::kSend, 0)->end - Find(spans, TaskTracer::kSend, 0)->begin);
+    EXPECT_EQ(40u, Find(spans, TaskTracer::kResponse, 0)->end - Find(spans, TaskTracer::kResponse, 0)->begin);
+    EXPECT_EQ(1u, Find(spans, TaskTracer::kCallback, 0)->end - Find(spans, TaskTracer::kCallback, 0)->begin);
+}
+
+TEST(TaskTracerTest, RingKeepsTheLatest) {
+    TaskTracer tracer;
+    tracer.SetCapacity(5);
+    for (uint32_t taskid = 1; taskid <= 8; ++taskid) {
+        TaskProfile profile(MakeTask(taskid), PrepareProfile());
+        profile.end_task_time = profile.start_task_time + taskid;
+        tracer.Record(profile);
+    }
+
+    std::vector<TaskTracer::Span> spans;
+    tracer.Snapshot(spans);
+    ASSERT_EQ(5u, spans.size());
+    for (size_t i = 0; i < spans.size(); ++i) {
+        EXPECT_EQ(4 + i, spans[i].taskid);
+    }
+
+    tracer.Clear();
+    tracer.Snapshot(spans);
+    EXPECT_TRUE(spans.empty());
+
+    tracer.SetCapacity(0);
+    EXPECT_FALSE(tracer.IsEnabled());
+}
+
+TEST(TaskTracerTest, ChromeTraceJson) {
+    TaskTracer tracer;
+    tracer.SetCapacity(100);
+
+    TaskProfile profile(MakeTask(3), PrepareProfile());
+    const uint64_t kStart = profile.start_task_time;
+    FillShortLink(profile.transfer_profile, kStart);
+    profile.PushHistory();
+    profile.end_task_time = kStart + 80;
+    profile.err_type = kEctHttp;
+    profile.err_code = 404;
+    tracer.Record(profile);
+
+    std::string json = tracer.ChromeTraceJson();
+    rapidjson::Document doc;
+    ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError()) << json;
+    ASSERT_TRUE(doc.HasMember("traceEvents"));
+    const rapidjson::Value& events = doc["traceEvents"];
+    ASSERT_TRUE(events.IsArray());
+
+    bool found_task = false;
+    size_t complete = 0;
+    for (rapidjson::SizeType i = 0; i < events.Size(); ++i) {
+        const rapidjson::Value& event = events[i];
+        if (std::string("X") != event["ph"].GetString())
+            continue;
+        ++complete;
+        EXPECT_EQ(3u, event["tid"].GetUint());
+        if (std::string("task") == event["name"].GetString()) {
+            found_task = true;
+            EXPECT_EQ(kStart * 1000, event["ts"].GetUint64());
+            EXPECT_EQ(80000u, event["dur"].GetUint64());
+            EXPECT_EQ(404, event["args"]["err_code"].GetInt());
+        }
+    }
+    EXPECT_TRUE(found_task);
+    std::vector<TaskTracer::Span> spans;
+    tracer.Snapshot(spans);
+    EXPECT_EQ(spans.size(), complete);
+}
@@ -89,6 +89,16 @@ int TcpSocketOperator::Send(SOCKET _sock, const void* _buffer, size_t _len, int&
     return block_socket_send(_sock, _buffer, _len, sBreaker_, _errcode);
 }
 
+int TcpSocketOperator::SendV(SOCKET _sock,
+                             const void* _head,
+                             size_t _head_len,
+                             const void* _body,
+                             size_t _body_len,
+                             int& _errcode,
+                             int _timeout) {
+    return block_socket_sendv(_sock, _head, _head_len, _body, _body_len, sBreaker_, _errcode);
+}
+
 int TcpSocketOperator::Recv(SOCKET _sock,
                             AutoBuffer& _buffer,
                             size_t _max_size,
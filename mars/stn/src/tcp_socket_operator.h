@@ -38,6 +38,13 @@ class TcpSocketOperator : public SocketOperator {
         return nullptr;
     }
     virtual int Send(SOCKET _sock, const void* _buffer, size_t _len, int& _errcode, int _timeout) override;
+    virtual int SendV(SOCKET _sock,
+                      const void* _head,
+                      size_t _head_len,
+                      const void* _body,
+                      size_t _body_len,
+                      int& _errcode,
+                      int _timeout) override;
 
     virtual int Recv(SOCKET _sock,
                      AutoBuffer& _buffer,
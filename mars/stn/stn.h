@@ -75,6 +75,7 @@ struct Task {
     static const int kTransportProtocolTCP = 1;      // TCP
     static const int kTransportProtocolQUIC = 2;     // QUIC
     static const int kTransportProtocolMixed = 3;    // TCP or QUIC
+    static const int kTransportProtocolHTTP2 = 4;    // cleartext HTTP/2 over TCP, short links only
 
     static const int kTaskPriorityHighest = 0;
     static const int kTaskPriority0 = 0;
@@ -224,6 +225,7 @@ struct ShortlinkConfig {
     bool use_proxy = false;
     bool use_tls = true;
     bool use_quic = false;
+    bool use_http2 = false;  // h2c streams on a connection shared with the other tasks to the same host
     QuicParameters quic;
     std::string tls_group;
 };
@@ -14,7 +14,9 @@
 #include "mars/baseevent/baseevent.h"
 #include "mars/boost/config.hpp"
 #include "mars/comm/alarm.h"
+#include "mars/comm/autobuffer_pool.h"
 #include "mars/comm/messagequeue/message_queue.h"
+#include "mars/comm/metrics.h"
 #include "mars/comm/thread/atomic_oper.h"
 #include "mars/comm/xlogger/xlogger.h"
 #include "mars/stn/stn.h"
@@ -23,6 +25,7 @@
 #include "stn/src/net_core.h"  //一定要放这里，Mac os 编译
 #include "stn/src/proxy_test.h"
 #include "stn/src/signalling_keeper.h"
+#include "stn/src/task_tracer.h"
 
 #ifdef WIN32
 #include <locale>
@@ -44,6 +47,10 @@ static const std::string kLibName = "stn";
 static uint32_t gs_taskid = 1;
 
 static uint32_t gs_sequence_id = 1;
+
+static comm::Counter sg_tasks_ok("stn.task.ok");
+static comm::Counter sg_tasks_failed("stn.task.failed");
+static comm::Histogram sg_task_cost_ms("stn.task.cost_ms");
 static std::random_device rd;
 static std::mt19937 mt_seed(rd());
 static std::uniform_int_distribution<int> dist(0, 65535);
@@ -79,6 +86,8 @@ void StnManager::OnCreate() {
     signal(SIGPIPE, SIG_IGN);
 #endif
     xinfo_function(TSF "mars2");
+    // the link send and receive buffers are mostly 4KB-64KB and live for one packet
+    AutoBuffer::SetPool(&comm::SizeClassPool::Shared());
     ActiveLogic::Instance();
     if (!net_core_) {
         net_core_ = std::make_shared<NetCore>(context_,
@@ -390,6 +399,13 @@ void StnManager::RequestNetCheckShortLinkHosts(std::vector<std::string>& _hostli
 
 // 底层向上层上报cgi执行结果
 void StnManager::ReportTaskProfile(const TaskProfile& _task_profile) {
+    TaskTracer::Shared().Record(_task_profile);
+    if (kEctOK == _task_profile.err_type)
+        sg_tasks_ok.Add();
+    else
+        sg_tasks_failed.Add();
+    if (_task_profile.end_task_time >= _task_profile.start_task_time)
+        sg_task_cost_ms.Record(_task_profile.end_task_time - _task_profile.start_task_time);
     xassert2(callback_bridge_ != NULL);
     if (callback_bridge_) {
         callback_bridge_->ReportTaskProfile(_task_profile);
@@ -609,6 +625,14 @@ bool StnManager::LongLinkIsConnected() {
     return false;
 }
 
+void StnManager::SetTaskTraceCapacity(size_t _spans) {
+    TaskTracer::Shared().SetCapacity(_spans);
+}
+
+bool StnManager::DumpTaskTrace(const std::string& _path) {
+    return TaskTracer::Shared().DumpChromeTrace(_path);
+}
+
 uint32_t StnManager::getNoopTaskID() {
     return Task::kNoopTaskID;
 }
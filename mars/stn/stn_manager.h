@@ -207,6 +207,11 @@ class StnManager : public mars::boot::BaseManager {
 
     bool LongLinkIsConnected();
 
+    // keeps the phase spans of the last ended tasks, about a dozen a task, 0 turns it off (the default)
+    void SetTaskTraceCapacity(size_t _spans);
+    // writes them as Chrome trace JSON, for chrome://tracing or Perfetto
+    bool DumpTaskTrace(const std::string& _path);
+
     std::shared_ptr<LongLink> DefaultLongLink();
 
     bool ProxyIsAvailable(const mars::comm::ProxyInfo& _proxy_info,
@@ -158,6 +158,12 @@ struct ConnectProfile {
         is_pack_mmtls = false;
         start_pack_mmtls_time = 0;
         end_pack_mmtls_time = 0;
+
+        recv_wakeups = 0;
+        recv_calls = 0;
+        recv_bytes = 0;
+        recv_budget_hits = 0;
+        recv_max_wakeup_bytes = 0;
     }
 
     std::string net_type;
@@ -264,10 +270,21 @@ struct ConnectProfile {
     bool is_pack_mmtls;
     uint64_t start_pack_mmtls_time;
     uint64_t end_pack_mmtls_time;
+
+    // long link reads, see comm::StreamReader::Stats
+    uint64_t recv_wakeups;
+    uint64_t recv_calls;
+    uint64_t recv_bytes;
+    uint64_t recv_budget_hits;
+    uint64_t recv_max_wakeup_bytes;
 };
 
+// Snapshot of a Task as it was handed to StartTask. It never changes afterwards, so it is shared by
+// reference count between the task profile, its transfer history and the link send queues.
+typedef std::shared_ptr<const Task> TaskDescriptor;
+
 struct TransferProfile {
-    TransferProfile(const Task& _task) : task(_task) {
+    TransferProfile(const TaskDescriptor& _task) : task(_task) {
         Reset();
     }
 
@@ -304,7 +321,7 @@ struct TransferProfile {
         end_check_auth_time = 0;
     }
 
-    const Task task;  // change "const Task& task" to "const Task task". fix a memory reuse bug.
+    TaskDescriptor task;  // shared, not "const Task&": the history outlives the TaskProfile it came from
     ConnectProfile connect_profile;
 
     uint64_t loop_start_task_time;   // ms
@@ -400,9 +417,10 @@ struct TaskProfile {
     }
 
     TaskProfile(const Task& _task, PrepareProfile _profile)
-    : task(_task)
+    : descriptor(std::make_shared<const Task>(_task))
+    , task(_task)
     , prepare_profile(_profile)
-    , transfer_profile(task)
+    , transfer_profile(descriptor)
     , task_timeout(ComputeTaskTimeout(_task))
     , start_task_time(::gettickcount()) {
         remain_retry_count = task.retry_count;
@@ -464,7 +482,8 @@ struct TaskProfile {
         return kStepOther;
     }
 
-    Task task;
+    const TaskDescriptor descriptor;
+    Task task;  // working copy, the per-attempt fields (hosts, protocol, sequence ids) are rewritten here
     PrepareProfile prepare_profile;
     TransferProfile transfer_profile;
     intptr_t running_id;
@@ -0,0 +1,299 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * packer_dict.cc
+ *
+ * Trains the zstd dictionary PacketCompressor loads from captured packet
+ * bodies, one body per file, and measures what it buys: ratio and time per
+ * packet, against plain zstd, compressed the way the packers do it.
+ */
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "zstd/lib/zstd.h"
+#define ZDICT_STATIC_LINKING_ONLY
+#include "zstd/lib/dictBuilder/zdict.h"
+
+// keep in step with PacketCompressor::kLevel
+static const int kLevel = 3;
+
+static uint64_t NowUs() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static bool ReadFile(const std::string& _path, std::string& _content) {
+    FILE* file = fopen(_path.c_str(), "rb");
+    if (NULL == file)
+        return false;
+
+    char buffer[64 * 1024];
+    size_t n = 0;
+    _content.clear();
+    while (0 < (n = fread(buffer, 1, sizeof(buffer), file))) {
+        _content.append(buffer, n);
+    }
+    fclose(file);
+    return true;
+}
+
+static void LoadSamples(const std::string& _path, std::vector<std::string>& _samples) {
+    struct stat st;
+    if (0 != stat(_path.c_str(), &st)) {
+        fprintf(stderr, "skip %s\n", _path.c_str());
+        return;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        std::string content;
+        if (ReadFile(_path, content) && !content.empty())
+            _samples.push_back(content);
+        return;
+    }
+
+    DIR* dir = opendir(_path.c_str());
+    if (NULL == dir)
+        return;
+    struct dirent* entry = NULL;
+    while (NULL != (entry = readdir(dir))) {
+        if ('.' == entry->d_name[0])
+            continue;
+        LoadSamples(_path + "/" + entry->d_name, _samples);
+    }
+    closedir(dir);
+}
+
+static int Train(const std::vector<std::string>& _samples, const char* _out, size_t _capacity, unsigned _dict_id) {
+    std::string flat;
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < _samples.size(); ++i) {
+        flat.append(_samples[i]);
+        sizes.push_back(_samples[i].size());
+    }
+
+    // what ZDICT_trainFromBuffer does, only with the id given
+    ZDICT_fastCover_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.d = 8;
+    params.steps = 4;
+    params.nbThreads = 1;
+    params.zParams.compressionLevel = kLevel;
+    params.zParams.dictID = _dict_id;
+
+    std::string dict(_capacity, '\0');
+    size_t ret = ZDICT_optimizeTrainFromBuffer_fastCover(&dict[0],
+                                                         dict.size(),
+                                                         flat.data(),
+                                                         sizes.data(),
+                                                         (unsigned)sizes.size(),
+                                                         &params);
+    if (ZDICT_isError(ret)) {
+        fprintf(stderr,
+                "train failed: %s (%zu samples, %zu bytes)\n",
+                ZDICT_getErrorName(ret),
+                sizes.size(),
+                flat.size());
+        return -1;
+    }
+
+    FILE* file = fopen(_out, "wb");
+    if (NULL == file || ret != fwrite(dict.data(), 1, ret, file)) {
+        fprintf(stderr, "write %s failed\n", _out);
+        if (NULL != file)
+            fclose(file);
+        return -1;
+    }
+    fclose(file);
+    printf("dictionary %u: %zu bytes from %zu samples, %zu bytes, k=%u d=%u\n",
+           ZDICT_getDictID(dict.data(), ret),
+           ret,
+           sizes.size(),
+           flat.size(),
+           params.k,
+           params.d);
+    return 0;
+}
+
+// one pass as the packers see it: contexts reused, bodies that do not shrink sent plain
+static void Bench(const char* _name,
+                  const std::vector<std::string>& _samples,
+                  const ZSTD_CDict* _cdict,
+                  const ZSTD_DDict* _ddict,
+                  int _rounds) {
+    ZSTD_CCtx* cctx = ZSTD_createCCtx();
+    ZSTD_DCtx* dctx = ZSTD_createDCtx();
+    std::string compressed;
+    std::string decompressed;
+    size_t raw_bytes = 0;
+    size_t sent_bytes = 0;
+    size_t plain = 0;
+    size_t corrupt = 0;
+    uint64_t compress_us = 0;
+    uint64_t decompress_us = 0;
+
+    for (size_t i = 0; i < _samples.size(); ++i) {
+        const std::string& sample = _samples[i];
+        compressed.resize(ZSTD_compressBound(sample.size()));
+
+        uint64_t begin = NowUs();
+        size_t len = 0;
+        for (int r = 0; r < _rounds; ++r) {
+            len = NULL != _cdict ? ZSTD_compress_usingCDict(cctx,
+                                                            &compressed[0],
+                                                            compressed.size(),
+                                                            sample.data(),
+                                                            sample.size(),
+                                                            _cdict)
+                                 : ZSTD_compressCCtx(cctx,
+                                                     &compressed[0],
+                                                     compressed.size(),
+                                                     sample.data(),
+                                                     sample.size(),
+                                                     kLevel);
+        }
+        compress_us += NowUs() - begin;
+
+        raw_bytes += sample.size();
+        if (ZSTD_isError(len) || len >= sample.size()) {
+            sent_bytes += sample.size();
+            ++plain;
+            continue;
+        }
+        sent_bytes += len;
+
+        decompressed.resize(sample.size());
+        begin = NowUs();
+        size_t out = 0;
+        for (int r = 0; r < _rounds; ++r) {
+            out = NULL != _ddict ? ZSTD_decompress_usingDDict(dctx,
+                                                              &decompressed[0],
+                                                              decompressed.size(),
+                                                              compressed.data(),
+                                                              len,
+                                                              _ddict)
+                                 : ZSTD_decompressDCtx(dctx,
+                                                       &decompressed[0],
+                                                       decompressed.size(),
+                                                       compressed.data(),
+                                                       len);
+        }
+        decompress_us += NowUs() - begin;
+        if (out != sample.size() || decompressed != sample)
+            ++corrupt;
+    }
+
+    double packets = (double)_samples.size() * _rounds;
+    printf("%-12s raw %10zu  sent %10zu  ratio %6.3f  plain %6zu  compress %8.2f us/pkt  decompress %8.2f us/pkt%s\n",
+           _name,
+           raw_bytes,
+           sent_bytes,
+           0 == sent_bytes ? 0.0 : (double)raw_bytes / sent_bytes,
+           plain,
+           compress_us / packets,
+           decompress_us / packets,
+           0 == corrupt ? "" : "  MISMATCH");
+
+    ZSTD_freeCCtx(cctx);
+    ZSTD_freeDCtx(dctx);
+}
+
+static void Usage(const char* _self) {
+    fprintf(stderr,
+            "usage:\n"
+            "  %s -t dict_out [-i dict_id] [-s max_dict_size] samples...\n"
+            "  %s -b dict [-r rounds] samples...\n"
+            "samples are files holding one packet body each, or directories of them\n",
+            _self,
+            _self);
+}
+
+int main(int argc, char* argv[]) {
+    const char* train_out = NULL;
+    const char* bench_dict = NULL;
+    unsigned dict_id = 0;
+    size_t capacity = 110 * 1024;
+    int rounds = 100;
+
+    int opt = 0;
+    while (-1 != (opt = getopt(argc, argv, "t:b:i:s:r:"))) {
+        switch (opt) {
+            case 't':
+                train_out = optarg;
+                break;
+            case 'b':
+                bench_dict = optarg;
+                break;
+            case 'i':
+                dict_id = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                capacity = (size_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            default:
+                Usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if ((NULL == train_out) == (NULL == bench_dict) || optind >= argc || 0 >= rounds) {
+        Usage(argv[0]);
+        return -1;
+    }
+
+    std::vector<std::string> samples;
+    for (int i = optind; i < argc; ++i) {
+        LoadSamples(argv[i], samples);
+    }
+    if (samples.empty()) {
+        fprintf(stderr, "no samples\n");
+        return -1;
+    }
+
+    if (NULL != train_out)
+        return Train(samples, train_out, capacity, dict_id);
+
+    std::string dict;
+    if (!ReadFile(bench_dict, dict) || 0 == ZDICT_getDictID(dict.data(), dict.size())) {
+        fprintf(stderr, "%s is not a zstd dictionary\n", bench_dict);
+        return -1;
+    }
+    ZSTD_CDict* cdict = ZSTD_createCDict(dict.data(), dict.size(), kLevel);
+    ZSTD_DDict* ddict = ZSTD_createDDict(dict.data(), dict.size());
+
+    printf("%zu samples, %d rounds, level %d, dictionary %u (%zu bytes)\n",
+           samples.size(),
+           rounds,
+           kLevel,
+           ZDICT_getDictID(dict.data(), dict.size()),
+           dict.size());
+    Bench("zstd", samples, NULL, NULL, rounds);
+    Bench("zstd+dict", samples, cdict, ddict, rounds);
+
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+    return 0;
+}
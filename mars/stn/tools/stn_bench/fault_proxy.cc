@@ -0,0 +1,243 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * fault_proxy.cc
+ */
+
+#include "fault_proxy.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "boost/bind.hpp"
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/thread.h"
+#include "mock_server.h"
+
+using namespace mars::comm;
+
+namespace {
+
+uint64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+struct Chunk {
+    uint64_t due_us;
+    std::string data;
+};
+
+// one direction of a relayed connection: a reader stamps chunks with when they arrive, a writer delivers them then
+struct Pipe {
+    Pipe() : from(-1), to(-1), last_due_us(0), eof(false) {
+    }
+    int from;
+    int to;
+    Mutex mutex;
+    Condition cond;
+    std::deque<Chunk> chunks;
+    uint64_t last_due_us;  // a stream delivers in order, nothing overtakes a stalled chunk
+    bool eof;
+    std::minstd_rand random;
+};
+
+class Connection {
+ public:
+    Connection(int _client_fd, int _server_fd, const FaultProxy::Faults& _faults)
+    : faults_(_faults), client_fd_(_client_fd), server_fd_(_server_fd), closed_(false) {
+        pipes_[0].from = _client_fd;
+        pipes_[0].to = _server_fd;
+        pipes_[0].random.seed((unsigned)NowUs());
+        pipes_[1].from = _server_fd;
+        pipes_[1].to = _client_fd;
+        pipes_[1].random.seed((unsigned)NowUs() + 1);
+    }
+
+    ~Connection() {
+        close(client_fd_);
+        close(server_fd_);
+    }
+
+    static void Relay(const std::shared_ptr<Connection>& _conn) {
+        for (int i = 0; i < 2; ++i) {
+            Thread(boost::bind(&Connection::__Read, _conn, i), "fault_proxy_read").start();
+            Thread(boost::bind(&Connection::__Write, _conn, i), "fault_proxy_write").start();
+        }
+    }
+
+ private:
+    // the sockets close with the last thread, by then linger 0 turns the close into a reset
+    void __Reset() {
+        struct linger lg = {1, 0};
+        setsockopt(client_fd_, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        setsockopt(server_fd_, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        __Abort();
+    }
+
+    void __Abort() {
+        closed_ = true;
+        for (int i = 0; i < 2; ++i) {
+            ScopedLock lock(pipes_[i].mutex);
+            pipes_[i].cond.notifyAll(lock);
+        }
+    }
+
+    void __Read(int _index) {
+        Pipe& pipe = pipes_[_index];
+        std::uniform_real_distribution<double> chance(0, 1);
+        char buffer[64 * 1024];
+
+        while (!closed_) {
+            struct pollfd pfd = {pipe.from, POLLIN, 0};
+            int ret = poll(&pfd, 1, 100);
+            if (0 > ret && EINTR != errno) {
+                __Abort();
+                return;
+            }
+            if (0 >= ret)
+                continue;
+
+            ssize_t n = recv(pipe.from, buffer, sizeof(buffer), 0);
+            if (0 > n && EINTR == errno)
+                continue;
+
+            ScopedLock lock(pipe.mutex);
+            if (0 >= n) {
+                pipe.eof = true;
+                pipe.cond.notifyAll(lock);
+                return;
+            }
+            if (0 < faults_.reset && chance(pipe.random) < faults_.reset) {
+                lock.unlock();
+                __Reset();
+                return;
+            }
+
+            uint64_t due_us = NowUs() + faults_.delay_ms * 1000ULL;
+            if (0 < faults_.jitter_ms)
+                due_us += pipe.random() % (faults_.jitter_ms * 1000ULL);
+            if (0 < faults_.loss && chance(pipe.random) < faults_.loss)
+                due_us += faults_.rto_ms * 1000ULL;
+            if (due_us < pipe.last_due_us)
+                due_us = pipe.last_due_us;
+            pipe.last_due_us = due_us;
+
+            Chunk chunk;
+            chunk.due_us = due_us;
+            chunk.data.assign(buffer, n);
+            pipe.chunks.push_back(chunk);
+            pipe.cond.notifyAll(lock);
+        }
+    }
+
+    void __Write(int _index) {
+        Pipe& pipe = pipes_[_index];
+        ScopedLock lock(pipe.mutex);
+
+        while (!closed_) {
+            if (pipe.chunks.empty()) {
+                if (pipe.eof) {
+                    // pass the half close on, the other direction may still be talking
+                    shutdown(pipe.to, SHUT_WR);
+                    return;
+                }
+                pipe.cond.wait(lock, 100);
+                continue;
+            }
+
+            uint64_t now_us = NowUs();
+            if (now_us < pipe.chunks.front().due_us) {
+                pipe.cond.wait(lock, (long)((pipe.chunks.front().due_us - now_us) / 1000 + 1));
+                continue;
+            }
+
+            std::string data;
+            data.swap(pipe.chunks.front().data);
+            pipe.chunks.pop_front();
+            lock.unlock();
+            if (!BenchSendAll(pipe.to, data.data(), data.size())) {
+                __Abort();
+                return;
+            }
+            lock.lock();
+        }
+    }
+
+ private:
+    const FaultProxy::Faults faults_;
+    const int client_fd_;
+    const int server_fd_;
+    std::atomic<bool> closed_;
+    Pipe pipes_[2];
+};
+
+}  // namespace
+
+FaultProxy::FaultProxy(uint16_t _target_port, const Faults& _faults)
+: target_port_(_target_port), faults_(_faults), listen_fd_(-1), port_(0) {
+}
+
+FaultProxy::~FaultProxy() {
+    Stop();
+}
+
+bool FaultProxy::Start(uint16_t _port) {
+    port_ = _port;
+    listen_fd_ = BenchListen(port_);
+    if (0 > listen_fd_)
+        return false;
+
+    Thread(boost::bind(&FaultProxy::__Accept, this), "fault_proxy").start();
+    return true;
+}
+
+void FaultProxy::Stop() {
+    if (0 <= listen_fd_) {
+        shutdown(listen_fd_, SHUT_RDWR);
+        listen_fd_ = -1;
+    }
+}
+
+void FaultProxy::__Accept() {
+    int listen_fd = listen_fd_;
+    int fd = -1;
+    while (0 <= (fd = accept(listen_fd, NULL, NULL)) || EINTR == errno) {
+        if (0 > fd)
+            continue;
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        int server_fd = BenchConnect(target_port_);
+        if (0 > server_fd) {
+            fprintf(stderr, "fault proxy: connect to %u failed\n", target_port_);
+            close(fd);
+            continue;
+        }
+        Connection::Relay(std::make_shared<Connection>(fd, server_fd, faults_));
+    }
+    close(listen_fd);
+}
@@ -0,0 +1,67 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * fault_proxy.h
+ *
+ * A TCP relay between stn and the mock server that makes loopback look like
+ * a mobile network. Every chunk read is held for the one-way delay plus a
+ * random jitter, in order, the way a stream delivers. The relay only sees
+ * the byte stream, so a lost segment shows up as what TCP makes of it: the
+ * chunk, and everything behind it, stalls for a retransmission timeout.
+ * Connections can also be reset at random, as NAT timeouts and handovers do.
+ */
+
+#ifndef STN_TOOLS_STN_BENCH_FAULT_PROXY_H_
+#define STN_TOOLS_STN_BENCH_FAULT_PROXY_H_
+
+#include <stdint.h>
+
+class FaultProxy {
+ public:
+    struct Faults {
+        Faults() : delay_ms(0), jitter_ms(0), loss(0), rto_ms(200), reset(0) {
+        }
+        int delay_ms;   // one way, both directions
+        int jitter_ms;  // uniform in [0, jitter_ms) on top of delay_ms
+        double loss;    // chance a chunk is lost and retransmitted
+        int rto_ms;     // what a loss costs
+        double reset;   // chance a chunk resets the connection instead
+    };
+
+ public:
+    FaultProxy(uint16_t _target_port, const Faults& _faults);
+    ~FaultProxy();
+
+    // 0 picks a free port, read it back with Port
+    bool Start(uint16_t _port);
+    void Stop();
+
+    uint16_t Port() const {
+        return port_;
+    }
+
+ private:
+    void __Accept();
+
+ private:
+    FaultProxy(const FaultProxy&);
+    FaultProxy& operator=(const FaultProxy&);
+
+ private:
+    const uint16_t target_port_;
+    const Faults faults_;
+    int listen_fd_;
+    uint16_t port_;
+};
+
+#endif  // STN_TOOLS_STN_BENCH_FAULT_PROXY_H_
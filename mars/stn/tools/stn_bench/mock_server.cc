@@ -0,0 +1,258 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * mock_server.cc
+ */
+
+#include "mock_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "boost/bind.hpp"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/thread/thread.h"
+#include "mars/stn/proto/longlink_packer.h"
+#include "mars/stn/stn.h"
+
+using namespace mars::comm;
+using namespace mars::stn;
+
+int BenchListen(uint16_t& _port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > fd)
+        return -1;
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(_port);
+    if (0 != bind(fd, (struct sockaddr*)&addr, sizeof(addr)) || 0 != listen(fd, 128)) {
+        fprintf(stderr, "listen on %u failed: %s\n", _port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    return fd;
+}
+
+int BenchConnect(uint16_t _port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > fd)
+        return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(_port);
+    if (0 != connect(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return fd;
+}
+
+bool BenchSendAll(int _fd, const void* _data, size_t _len) {
+    const char* p = (const char*)_data;
+    while (0 < _len) {
+        ssize_t n = send(_fd, p, _len, MSG_NOSIGNAL);
+        if (0 > n && EINTR == errno)
+            continue;
+        if (0 >= n)
+            return false;
+        p += n;
+        _len -= n;
+    }
+    return true;
+}
+
+MockServer::MockServer(int _process_ms)
+: process_ms_(_process_ms), longlink_fd_(-1), shortlink_fd_(-1), longlink_port_(0), shortlink_port_(0) {
+}
+
+MockServer::~MockServer() {
+    Stop();
+}
+
+bool MockServer::Start(uint16_t _longlink_port, uint16_t _shortlink_port) {
+    longlink_port_ = _longlink_port;
+    shortlink_port_ = _shortlink_port;
+    longlink_fd_ = BenchListen(longlink_port_);
+    shortlink_fd_ = BenchListen(shortlink_port_);
+    if (0 > longlink_fd_ || 0 > shortlink_fd_) {
+        Stop();
+        return false;
+    }
+
+    Thread(boost::bind(&MockServer::__AcceptLongLink, this), "mock_longlink").start();
+    Thread(boost::bind(&MockServer::__AcceptShortLink, this), "mock_shortlink").start();
+    return true;
+}
+
+void MockServer::Stop() {
+    // wakes the accept threads, connections being served run to their end
+    if (0 <= longlink_fd_) {
+        shutdown(longlink_fd_, SHUT_RDWR);
+        longlink_fd_ = -1;
+    }
+    if (0 <= shortlink_fd_) {
+        shutdown(shortlink_fd_, SHUT_RDWR);
+        shortlink_fd_ = -1;
+    }
+}
+
+void MockServer::__AcceptLongLink() {
+    int listen_fd = longlink_fd_;
+    int fd = -1;
+    while (0 <= (fd = accept(listen_fd, NULL, NULL)) || EINTR == errno) {
+        if (0 > fd)
+            continue;
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        Thread(boost::bind(&MockServer::__ServeLongLink, this, fd), "mock_longlink_conn").start();
+    }
+    close(listen_fd);
+}
+
+void MockServer::__AcceptShortLink() {
+    int listen_fd = shortlink_fd_;
+    int fd = -1;
+    while (0 <= (fd = accept(listen_fd, NULL, NULL)) || EINTR == errno) {
+        if (0 > fd)
+            continue;
+        Thread(boost::bind(&MockServer::__ServeShortLink, this, fd), "mock_shortlink_conn").start();
+    }
+    close(listen_fd);
+}
+
+void MockServer::__ServeLongLink(int _fd) {
+    std::unique_ptr<longlink_tracker> tracker(longlink_tracker::Create());
+    AutoBuffer recv_buf;
+    char chunk[64 * 1024];
+
+    while (true) {
+        ssize_t n = recv(_fd, chunk, sizeof(chunk), 0);
+        if (0 > n && EINTR == errno)
+            continue;
+        if (0 >= n)
+            break;
+        recv_buf.Write(AutoBuffer::ESeekEnd, chunk, n);
+
+        bool broken = false;
+        while (0 < recv_buf.Length()) {
+            uint32_t cmdid = 0;
+            uint32_t seq = 0;
+            size_t package_len = 0;
+            AutoBuffer body;
+            AutoBuffer extension;
+            int ret = gDefaultLongLinkEncoder
+                          .longlink_unpack(recv_buf, cmdid, seq, package_len, body, extension, tracker.get());
+            if (LONGLINK_UNPACK_CONTINUE == ret)
+                break;
+            if (LONGLINK_UNPACK_OK != ret) {
+                fprintf(stderr, "mock longlink: bad packet, %zu bytes buffered\n", recv_buf.Length());
+                broken = true;
+                break;
+            }
+            recv_buf.Move(-(off_t)package_len);
+
+            if (0 < process_ms_)
+                usleep(process_ms_ * 1000);
+
+            AutoBuffer packed;
+            gDefaultLongLinkEncoder.longlink_pack(cmdid, seq, body, extension, packed, tracker.get());
+            if (!BenchSendAll(_fd, packed.Ptr(), packed.Length())) {
+                broken = true;
+                break;
+            }
+        }
+        if (broken)
+            break;
+    }
+    close(_fd);
+}
+
+void MockServer::__ServeShortLink(int _fd) {
+    std::string request;
+    char chunk[16 * 1024];
+    size_t header_end = std::string::npos;
+    size_t content_length = 0;
+
+    while (std::string::npos == header_end || request.size() < header_end + 4 + content_length) {
+        ssize_t n = recv(_fd, chunk, sizeof(chunk), 0);
+        if (0 > n && EINTR == errno)
+            continue;
+        if (0 >= n) {
+            close(_fd);
+            return;
+        }
+        request.append(chunk, n);
+
+        if (std::string::npos != header_end)
+            continue;
+        header_end = request.find("\r\n\r\n");
+        if (std::string::npos == header_end)
+            continue;
+
+        // header names are case-insensitive, the builder writes Content-Length
+        size_t line = request.find("\r\n");
+        while (line < header_end) {
+            const char* field = request.c_str() + line + 2;
+            if (0 == strncasecmp(field, "Content-Length:", 15)) {
+                content_length = strtoul(field + 15, NULL, 10);
+                break;
+            }
+            line = request.find("\r\n", line + 2);
+        }
+    }
+
+    if (0 < process_ms_)
+        usleep(process_ms_ * 1000);
+
+    char header[256];
+    int header_len = snprintf(header,
+                              sizeof(header),
+                              "HTTP/1.1 200 OK\r\n"
+                              "Content-Type: application/octet-stream\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n",
+                              content_length);
+    if (BenchSendAll(_fd, header, header_len))
+        BenchSendAll(_fd, request.data() + header_end + 4, content_length);
+    shutdown(_fd, SHUT_WR);
+    // drain until the client closes, so the close doesn't turn into a reset over unread bytes
+    while (0 < recv(_fd, chunk, sizeof(chunk), 0)) {
+    }
+    close(_fd);
+}
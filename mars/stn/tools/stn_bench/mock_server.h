@@ -0,0 +1,71 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * mock_server.h
+ *
+ * The server end of stn_bench, on 127.0.0.1. The long-link side unpacks
+ * every packet with the default LongLinkEncoder and packs the body back with
+ * the same cmdid and seq, so noops and tasks both get their response. The
+ * short-link side answers each HTTP/1.1 POST with its body and closes, as
+ * the short-link packer asks with Connection: close.
+ */
+
+#ifndef STN_TOOLS_STN_BENCH_MOCK_SERVER_H_
+#define STN_TOOLS_STN_BENCH_MOCK_SERVER_H_
+
+#include <stdint.h>
+
+#include <string>
+
+class MockServer {
+ public:
+    // _process_ms: how long the server sits on each request before answering
+    explicit MockServer(int _process_ms);
+    ~MockServer();
+
+    // 0 picks a free port, read it back with LongLinkPort/ShortLinkPort
+    bool Start(uint16_t _longlink_port, uint16_t _shortlink_port);
+    void Stop();
+
+    uint16_t LongLinkPort() const {
+        return longlink_port_;
+    }
+    uint16_t ShortLinkPort() const {
+        return shortlink_port_;
+    }
+
+ private:
+    void __AcceptLongLink();
+    void __AcceptShortLink();
+    void __ServeLongLink(int _fd);
+    void __ServeShortLink(int _fd);
+
+ private:
+    MockServer(const MockServer&);
+    MockServer& operator=(const MockServer&);
+
+ private:
+    const int process_ms_;
+    int longlink_fd_;
+    int shortlink_fd_;
+    uint16_t longlink_port_;
+    uint16_t shortlink_port_;
+};
+
+// listening socket on 127.0.0.1:_port, _port is updated with the bound one; -1 on failure
+int BenchListen(uint16_t& _port);
+// connected socket to 127.0.0.1:_port; -1 on failure
+int BenchConnect(uint16_t _port);
+bool BenchSendAll(int _fd, const void* _data, size_t _len);
+
+#endif  // STN_TOOLS_STN_BENCH_MOCK_SERVER_H_
@@ -0,0 +1,571 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * stn_bench.cc
+ *
+ * Drives a mix of long-link and short-link tasks through StnManager::StartTask
+ * against MockServer, optionally through FaultProxy, keeping a fixed number
+ * in flight. Reports throughput, task latency percentiles from StartTask to
+ * OnTaskEnd, CPU and allocations per task and the thread count. The servers
+ * run in a forked child, so everything measured is stn's own.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "fault_proxy.h"
+#include "mars/app/app_manager.h"
+#include "mars/boot/context.h"
+#include "mars/comm/autobuffer.h"
+#include "mars/comm/metrics.h"
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/stn/proto/stnproto_logic.h"
+#include "mars/stn/stn_manager.h"
+#include "mock_server.h"
+
+using namespace mars::comm;
+using namespace mars::stn;
+
+static std::atomic<uint64_t> sg_news(0);
+
+// every C++ allocation in the process, the servers are not in it
+void* operator new(size_t _size) {
+    sg_news.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(0 == _size ? 1 : _size);
+    if (NULL == p)
+        abort();
+    return p;
+}
+
+void operator delete(void* _p) noexcept {
+    free(_p);
+}
+
+static const uint32_t kClientVersion = 0x10000001;
+static const uint32_t kBenchCmdId = 1001;
+
+struct Options {
+    Options()
+    : tasks(10000)
+    , warmup(200)
+    , concurrency(32)
+    , long_percent(100)
+    , body_size(1024)
+    , timeout_ms(15000)
+    , process_ms(0)
+    , use_proxy(false)
+    , max_p99_us(0)
+    , print_metrics(false) {
+    }
+    int tasks;
+    int warmup;
+    int concurrency;
+    int long_percent;
+    size_t body_size;
+    int timeout_ms;
+    int process_ms;
+    bool use_proxy;
+    FaultProxy::Faults faults;
+    uint64_t max_p99_us;  // exit 1 above it, for release gates
+    bool print_metrics;
+};
+
+struct Sample {
+    uint64_t latency_us;
+    int channel_select;
+    bool ok;
+};
+
+static uint64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static int ThreadCount() {
+#ifdef __linux__
+    DIR* dir = opendir("/proc/self/task");
+    if (NULL == dir)
+        return -1;
+    int count = 0;
+    struct dirent* entry = NULL;
+    while (NULL != (entry = readdir(dir))) {
+        if ('.' != entry->d_name[0])
+            ++count;
+    }
+    closedir(dir);
+    return count;
+#else
+    return -1;
+#endif
+}
+
+class BenchAppCallback : public mars::app::Callback {
+ public:
+    explicit BenchAppCallback(const std::string& _file_path) : file_path_(_file_path) {
+    }
+    std::string GetAppFilePath() override {
+        return file_path_;
+    }
+    mars::app::AccountInfo GetAccountInfo() override {
+        return mars::app::AccountInfo();
+    }
+    unsigned int GetClientVersion() override {
+        return kClientVersion;
+    }
+    mars::app::DeviceInfo GetDeviceInfo() override {
+        return mars::app::DeviceInfo();
+    }
+
+ private:
+    std::string file_path_;
+};
+
+class BenchStnCallback : public Callback {
+ public:
+    explicit BenchStnCallback(size_t _body_size) : payload_(_body_size, 'b'), inflight_(0) {
+    }
+
+    void Begin(uint32_t _taskid, int _channel_select) {
+        ScopedLock lock(mutex_);
+        Sample& sample = running_[_taskid];
+        sample.latency_us = NowUs();
+        sample.channel_select = _channel_select;
+        sample.ok = false;
+        ++inflight_;
+    }
+
+    // StartTask refused it, OnTaskEnd won't come
+    void Cancel(uint32_t _taskid) {
+        ScopedLock lock(mutex_);
+        if (0 != running_.erase(_taskid))
+            --inflight_;
+    }
+
+    // waits until fewer than _limit tasks are in flight; false if none ended within _timeout_ms
+    bool WaitBelow(int _limit, long _timeout_ms) {
+        ScopedLock lock(mutex_);
+        while (inflight_ >= _limit) {
+            if (ETIMEDOUT == cond_.wait(lock, _timeout_ms))
+                return false;
+        }
+        return true;
+    }
+
+    void TakeSamples(std::vector<Sample>& _samples) {
+        ScopedLock lock(mutex_);
+        _samples.swap(samples_);
+        samples_.clear();
+    }
+
+ public:
+    bool MakesureAuthed(const std::string& _host, const std::string& _user_id) override {
+        return true;
+    }
+    void TrafficData(int64_t _send, int64_t _recv) override {
+    }
+    std::vector<std::string> OnNewDns(const std::string& _host, bool _longlink_host) override {
+        return std::vector<std::string>(1, "127.0.0.1");
+    }
+    void OnPush(const std::string& _channel_id,
+                uint32_t _cmdid,
+                uint32_t _taskid,
+                const AutoBuffer& _body,
+                const AutoBuffer& _extend) override {
+    }
+    bool Req2Buf(uint32_t _taskid,
+                 void* const _user_context,
+                 const std::string& _user_id,
+                 AutoBuffer& _outbuffer,
+                 AutoBuffer& _extend,
+                 int& _error_code,
+                 const int _channel_select,
+                 const std::string& _host,
+                 const uint16_t _client_sequence_id) override {
+        _outbuffer.Write(payload_.data(), payload_.size());
+        return true;
+    }
+    int Buf2Resp(uint32_t _taskid,
+                 void* const _user_context,
+                 const std::string& _user_id,
+                 const AutoBuffer& _inbuffer,
+                 const AutoBuffer& _extend,
+                 int& _error_code,
+                 uint64_t& _flags,
+                 const int _channel_select,
+                 uint16_t& _server_sequence_id) override {
+        // the mock server echoes, anything else is a corrupted response
+        if (_inbuffer.Length() != payload_.size()
+            || 0 != memcmp(_inbuffer.Ptr(), payload_.data(), payload_.size()))
+            return kTaskFailHandleTaskEnd;
+        return kTaskFailHandleNoError;
+    }
+    int OnTaskEnd(uint32_t _taskid,
+                  void* const _user_context,
+                  const std::string& _user_id,
+                  int _error_type,
+                  int _error_code,
+                  const CgiProfile& _profile) override {
+        uint64_t now_us = NowUs();
+        ScopedLock lock(mutex_);
+        std::map<uint32_t, Sample>::iterator it = running_.find(_taskid);
+        if (running_.end() == it)
+            return 0;
+
+        Sample sample = it->second;
+        running_.erase(it);
+        sample.latency_us = now_us - sample.latency_us;
+        sample.ok = kEctOK == _error_type;
+        samples_.push_back(sample);
+        --inflight_;
+        cond_.notifyAll(lock);
+        return 0;
+    }
+    void ReportConnectStatus(int _status, int _longlink_status) override {
+    }
+    int GetLonglinkIdentifyCheckBuffer(const std::string& _channel_id,
+                                       AutoBuffer& _identify_buffer,
+                                       AutoBuffer& _buffer_hash,
+                                       int32_t& _cmdid) override {
+        return kCheckNever;
+    }
+    bool OnLonglinkIdentifyResponse(const std::string& _channel_id,
+                                    const AutoBuffer& _response_buffer,
+                                    const AutoBuffer& _identify_buffer_hash) override {
+        return true;
+    }
+    void RequestSync() override {
+    }
+    void RequestNetCheckShortLinkHosts(std::vector<std::string>& _hostlist) override {
+    }
+    void ReportTaskProfile(const TaskProfile& _task_profile) override {
+    }
+    void ReportTaskLimited(int _check_type, const Task& _task, unsigned int& _param) override {
+    }
+    void ReportDnsProfile(const DnsProfile& _dns_profile) override {
+    }
+
+ private:
+    const std::string payload_;
+    Mutex mutex_;
+    Condition cond_;
+    std::map<uint32_t, Sample> running_;  // latency_us holds the start until the task ends
+    std::vector<Sample> samples_;
+    int inflight_;
+};
+
+// starts _count tasks keeping _options.concurrency in flight, returns once all have ended
+static bool RunTasks(StnManager* _stn,
+                     BenchStnCallback& _callback,
+                     const Options& _options,
+                     int _count,
+                     int& _peak_threads) {
+    for (int i = 0; i < _count; ++i) {
+        if (!_callback.WaitBelow(_options.concurrency, _options.timeout_ms * 2)) {
+            fprintf(stderr, "no task ended in %d ms\n", _options.timeout_ms * 2);
+            return false;
+        }
+
+        Task task;
+        task.cmdid = kBenchCmdId;
+        task.cgi = "/mars/bench";
+        task.limit_flow = false;
+        task.limit_frequency = false;
+        task.total_timeout = _options.timeout_ms;
+        if (i % 100 < _options.long_percent) {
+            task.channel_select = Task::kChannelLong;
+        } else {
+            task.channel_select = Task::kChannelShort;
+            task.shortlink_host_list.push_back("bench.shortlink");
+        }
+
+        _callback.Begin(task.taskid, task.channel_select);
+        if (!_stn->StartTask(task))
+            _callback.Cancel(task.taskid);
+
+        if (0 == i % 256)
+            _peak_threads = std::max(_peak_threads, ThreadCount());
+    }
+    return _callback.WaitBelow(1, _options.timeout_ms * 2);
+}
+
+static uint64_t Percentile(const std::vector<uint64_t>& _sorted, double _p) {
+    if (_sorted.empty())
+        return 0;
+    size_t index = std::min(_sorted.size() - 1, (size_t)(_p * _sorted.size()));
+    return _sorted[index];
+}
+
+static uint64_t PrintLatency(const char* _name, const std::vector<Sample>& _samples, int _channel_select) {
+    std::vector<uint64_t> latencies;
+    for (size_t i = 0; i < _samples.size(); ++i) {
+        if (_samples[i].ok && (0 == _channel_select || _channel_select == _samples[i].channel_select))
+            latencies.push_back(_samples[i].latency_us);
+    }
+    if (latencies.empty())
+        return 0;
+
+    std::sort(latencies.begin(), latencies.end());
+    uint64_t p99 = Percentile(latencies, 0.99);
+    printf("  %-6s %8zu %10llu %10llu %10llu %10llu\n",
+           _name,
+           latencies.size(),
+           (unsigned long long)Percentile(latencies, 0.5),
+           (unsigned long long)p99,
+           (unsigned long long)Percentile(latencies, 0.999),
+           (unsigned long long)latencies.back());
+    return p99;
+}
+
+static double CpuUs(const struct rusage& _usage, bool _user) {
+    const struct timeval& tv = _user ? _usage.ru_utime : _usage.ru_stime;
+    return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+// the child: servers and proxies until the parent goes away
+static void RunServers(const Options& _options, int _report_fd) {
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    MockServer server(_options.process_ms);
+    uint16_t ports[2] = {0, 0};
+    if (server.Start(0, 0)) {
+        ports[0] = server.LongLinkPort();
+        ports[1] = server.ShortLinkPort();
+    }
+
+    FaultProxy longlink_proxy(server.LongLinkPort(), _options.faults);
+    FaultProxy shortlink_proxy(server.ShortLinkPort(), _options.faults);
+    if (_options.use_proxy && 0 != ports[0]) {
+        ports[0] = longlink_proxy.Start(0) ? longlink_proxy.Port() : 0;
+        ports[1] = shortlink_proxy.Start(0) ? shortlink_proxy.Port() : 0;
+    }
+
+    if (sizeof(ports) != write(_report_fd, ports, sizeof(ports)))
+        _exit(1);
+    close(_report_fd);
+    while (true) pause();
+}
+
+static void Usage(const char* _name) {
+    fprintf(stderr,
+            "usage: %s [-n tasks] [-W warmup] [-c concurrency] [-m long_percent] [-b body_bytes]\n"
+            "          [-t timeout_ms] [-w server_ms] [-d delay_ms] [-j jitter_ms] [-l loss] [-r reset]\n"
+            "          [-R rto_ms] [-P max_p99_us] [-M]\n",
+            _name);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    int opt = 0;
+    while (-1 != (opt = getopt(argc, argv, "n:W:c:m:b:t:w:d:j:l:r:R:P:Mh"))) {
+        switch (opt) {
+            case 'n':
+                options.tasks = atoi(optarg);
+                break;
+            case 'W':
+                options.warmup = atoi(optarg);
+                break;
+            case 'c':
+                options.concurrency = std::max(1, atoi(optarg));
+                break;
+            case 'm':
+                options.long_percent = std::min(100, std::max(0, atoi(optarg)));
+                break;
+            case 'b':
+                options.body_size = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                options.timeout_ms = atoi(optarg);
+                break;
+            case 'w':
+                options.process_ms = atoi(optarg);
+                break;
+            case 'd':
+                options.faults.delay_ms = atoi(optarg);
+                options.use_proxy = true;
+                break;
+            case 'j':
+                options.faults.jitter_ms = atoi(optarg);
+                options.use_proxy = true;
+                break;
+            case 'l':
+                options.faults.loss = atof(optarg);
+                options.use_proxy = true;
+                break;
+            case 'r':
+                options.faults.reset = atof(optarg);
+                options.use_proxy = true;
+                break;
+            case 'R':
+                options.faults.rto_ms = atoi(optarg);
+                break;
+            case 'P':
+                options.max_p99_us = strtoull(optarg, NULL, 10);
+                break;
+            case 'M':
+                options.print_metrics = true;
+                break;
+            default:
+                Usage(argv[0]);
+                return -1;
+        }
+    }
+
+    // both ends pack with it, and the fork below hands it to the server
+    SetClientVersion(kClientVersion);
+
+    int report[2];
+    if (0 != pipe(report))
+        return 1;
+    pid_t server_pid = fork();
+    if (0 > server_pid)
+        return 1;
+    if (0 == server_pid) {
+        close(report[0]);
+        RunServers(options, report[1]);
+    }
+    close(report[1]);
+    uint16_t ports[2] = {0, 0};
+    if (sizeof(ports) != read(report[0], ports, sizeof(ports)) || 0 == ports[0] || 0 == ports[1]) {
+        fprintf(stderr, "servers failed to start\n");
+        kill(server_pid, SIGKILL);
+        return 1;
+    }
+    close(report[0]);
+
+    char file_path[] = "/tmp/stn_bench_XXXXXX";
+    if (NULL == mkdtemp(file_path))
+        return 1;
+
+    mars::boot::Context* context = mars::boot::Context::CreateContext("default");
+    BenchAppCallback app_callback(file_path);
+    mars::app::AppManager* app = new mars::app::AppManager(context);
+    app->SetCallback(&app_callback);
+    context->AddManager(app);
+
+    BenchStnCallback callback(options.body_size);
+    StnManager* stn = new StnManager(context);
+    context->AddManager(stn);
+    stn->SetCallback(&callback);
+    context->Init();
+    stn->OnCreate();
+    stn->SetLonglinkSvrAddr("bench.longlink", std::vector<uint16_t>(1, ports[0]), "127.0.0.1");
+    stn->SetShortlinkSvrAddr(ports[1], "127.0.0.1");
+
+    if (0 < options.long_percent) {
+        stn->MakesureLonglinkConnected();
+        for (int i = 0; i < 500 && !stn->LongLinkIsConnected(); ++i) usleep(10 * 1000);
+    }
+
+    int peak_threads = ThreadCount();
+    std::vector<Sample> samples;
+    bool finished = RunTasks(stn, callback, options, options.warmup, peak_threads);
+    callback.TakeSamples(samples);
+
+    struct rusage usage_begin, usage_end;
+    AutoBuffer::ResetStats();
+    mars::comm::MetricsSnapshot metrics_begin;
+    mars::comm::MetricsRegistry::Shared().Snapshot(metrics_begin);
+    uint64_t news_begin = sg_news.load();
+    getrusage(RUSAGE_SELF, &usage_begin);
+    uint64_t begin_us = NowUs();
+
+    finished = finished && RunTasks(stn, callback, options, options.tasks, peak_threads);
+
+    uint64_t wall_us = NowUs() - begin_us;
+    getrusage(RUSAGE_SELF, &usage_end);
+    uint64_t news = sg_news.load() - news_begin;
+    AutoBuffer::Stats buffer_stats = AutoBuffer::GetStats();
+    mars::comm::MetricsSnapshot metrics_end;
+    mars::comm::MetricsRegistry::Shared().Snapshot(metrics_end);
+    int end_threads = ThreadCount();
+    peak_threads = std::max(peak_threads, end_threads);
+    callback.TakeSamples(samples);
+
+    size_t ok = 0;
+    for (size_t i = 0; i < samples.size(); ++i) ok += samples[i].ok ? 1 : 0;
+    double per_task = samples.empty() ? 1 : (double)samples.size();
+
+    printf("%d tasks, %d%% long link, %zu B body, %d in flight, server %d ms\n",
+           options.tasks,
+           options.long_percent,
+           options.body_size,
+           options.concurrency,
+           options.process_ms);
+    if (options.use_proxy)
+        printf("faults: delay %d ms, jitter %d ms, loss %.3f (rto %d ms), reset %.3f\n",
+               options.faults.delay_ms,
+               options.faults.jitter_ms,
+               options.faults.loss,
+               options.faults.rto_ms,
+               options.faults.reset);
+    printf("ended %zu, ok %zu, failed %zu%s, %.3f s, %.1f tasks/s\n",
+           samples.size(),
+           ok,
+           samples.size() - ok,
+           finished ? "" : " (timed out waiting)",
+           wall_us / 1e6,
+           ok * 1e6 / std::max<uint64_t>(wall_us, 1));
+    printf("latency us    tasks        p50        p99       p999        max\n");
+    uint64_t p99 = PrintLatency("all", samples, 0);
+    if (0 < options.long_percent && 100 > options.long_percent) {
+        PrintLatency("long", samples, Task::kChannelLong);
+        PrintLatency("short", samples, Task::kChannelShort);
+    }
+    printf("cpu %.1f us/task (user %.1f, sys %.1f)\n",
+           (CpuUs(usage_end, true) + CpuUs(usage_end, false) - CpuUs(usage_begin, true) - CpuUs(usage_begin, false))
+               / per_task,
+           (CpuUs(usage_end, true) - CpuUs(usage_begin, true)) / per_task,
+           (CpuUs(usage_end, false) - CpuUs(usage_begin, false)) / per_task);
+    printf("allocations %.1f new/task, AutoBuffer %.2f realloc %.2f pooled/task\n",
+           news / per_task,
+           buffer_stats.reallocs / per_task,
+           buffer_stats.pool_hits / per_task);
+    printf("threads %d peak, %d at end\n", peak_threads, end_threads);
+    if (options.print_metrics)
+        printf("metrics over the run:\n%s", metrics_end.Diff(metrics_begin).ToText().c_str());
+
+    stn->OnDestroy();
+    kill(server_pid, SIGKILL);
+    waitpid(server_pid, NULL, 0);
+
+    // resets may end a task for good, nothing else should
+    if (!finished || (0 == options.faults.reset && ok != samples.size()))
+        return 1;
+    if (0 < options.max_p99_us && p99 > options.max_p99_us) {
+        fprintf(stderr, "p99 %llu us over %llu us\n", (unsigned long long)p99, (unsigned long long)options.max_p99_us);
+        return 1;
+    }
+    return 0;
+}
@@ -15,10 +15,16 @@
  */
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -48,8 +54,6 @@ const int MAGIC_ASYNC_NO_CRYPT_ZSTD_START = 0x0D;
 const int MAGIC_END = 0x00;
 const int BASE_KEY = 0xCC;
 
-int lastseq = 0;
-
 const char* PRIV_KEY = "";
 const char* PUB_KEY = "";
 
@@ -144,16 +148,40 @@ bool isGoodLogBuffer(const char* buffer, size_t bufferSize, size_t offset, int c
     return true;
 }
 
+// Word-at-a-time test for a byte x with m < x < n in an 8-byte word, see
+// https://graphics.stanford.edu/~seander/bithacks.html#HasBetweenInWord
+#define ONES_8 (~(uint64_t)0 / 255)
+#define HAS_BETWEEN(x, m, n) \
+    ((ONES_8 * (127 + (n)) - ((x)&ONES_8 * 127) & ~(x) & ((x)&ONES_8 * 127) + ONES_8 * (127 - (m))) & ONES_8 * 128)
+
+// Returns the offset of the first byte that may be a block magic number, or bufferSize if there is none.
+size_t findMagicCandidate(const char* buffer, size_t bufferSize, size_t offset) {
+    while (offset + sizeof(uint64_t) <= bufferSize) {
+        uint64_t word;
+        memcpy(&word, buffer + offset, sizeof(word));
+        if (HAS_BETWEEN(word, MAGIC_END, MAGIC_ASYNC_NO_CRYPT_ZSTD_START + 1)) {
+            break;
+        }
+        offset += sizeof(word);
+    }
+    while (offset < bufferSize) {
+        if (buffer[offset] >= MAGIC_CRYPT_START && buffer[offset] <= MAGIC_ASYNC_NO_CRYPT_ZSTD_START) {
+            break;
+        }
+        offset += 1;
+    }
+    return offset;
+}
+
 size_t getLogStartPos(const char* buffer, size_t bufferSize, int count) {
     size_t offset = 0;
     while (1) {
+        offset = findMagicCandidate(buffer, bufferSize, offset);
         if (offset >= bufferSize) {
             break;
         }
-        if (buffer[offset] >= MAGIC_CRYPT_START && buffer[offset] <= MAGIC_ASYNC_NO_CRYPT_ZSTD_START) {
-            if (isGoodLogBuffer(buffer, bufferSize, offset, count)) {
-                return offset;
-            }
+        if (isGoodLogBuffer(buffer, bufferSize, offset, count)) {
+            return offset;
         }
         offset += 1;
     }
@@ -178,32 +206,43 @@ void appendBuffer(char** outBuffer, size_t* outBufferSize, size_t* writePos, con
     *writePos = (*writePos) + bufferSize;
 }
 
-bool zstdDecompress(const char* compressedBytes, size_t compressedBytesSize, char** outBuffer, size_t* outBufferSize) {
+char* growBuffer(char* buffer, size_t* bufferSize) {
+    size_t newSize = (*bufferSize) + (*bufferSize) / 2;
+    char* newBuffer = (char*)realloc(buffer, newSize);
+    if (NULL == newBuffer) {
+        free(buffer);
+        fputs("Error reallocating memory", stderr);
+        exit(5);
+    }
+    *bufferSize = newSize;
+    return newBuffer;
+}
+
+bool zstdDecompress(ZSTD_DCtx* dctx,
+                    const char* compressedBytes,
+                    size_t compressedBytesSize,
+                    char** outBuffer,
+                    size_t* outBufferSize) {
     *outBuffer = NULL;
     *outBufferSize = 0;
     if (compressedBytesSize == 0) {
         return true;
     }
 
-    unsigned fullLength = compressedBytesSize;
-    unsigned halfLength = compressedBytesSize / 2;
-
-    unsigned uncompLength = fullLength;
-    char* uncomp = (char*)calloc(sizeof(char), uncompLength);
+    // logs usually compress 5-10x, start there and grow geometrically so big blocks don't copy quadratically
+    size_t uncompLength = compressedBytesSize * 4;
+    char* uncomp = (char*)malloc(uncompLength);
 
-    ZSTD_DCtx* const dctx = ZSTD_createDCtx();
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
 
     ZSTD_inBuffer input = {compressedBytes, compressedBytesSize, 0};
     ZSTD_outBuffer output = {NULL, compressedBytesSize, 0};
+    size_t lastPos = (size_t)-1;
     bool done = false;
 
     while (!done) {
         if (output.pos >= uncompLength) {
-            char* uncomp2 = (char*)calloc(sizeof(char), uncompLength + halfLength);
-            memcpy(uncomp2, uncomp, uncompLength);
-            uncompLength += halfLength;
-            free(uncomp);
-            uncomp = uncomp2;
+            uncomp = growBuffer(uncomp, &uncompLength);
         }
 
         output.size = uncompLength;
@@ -227,8 +266,6 @@ bool zstdDecompress(const char* compressedBytes, size_t compressedBytesSize, cha
         }
     }
 
-    ZSTD_freeDCtx(dctx);
-
     *outBuffer = uncomp;
     *outBufferSize = output.pos;
     return true;
@@ -241,11 +278,9 @@ bool zlibDecompress(const char* compressedBytes, size_t compressedBytesSize, cha
         return true;
     }
 
-    unsigned fullLength = compressedBytesSize;
-    unsigned halfLength = compressedBytesSize / 2;
-
-    unsigned uncompLength = fullLength;
-    char* uncomp = (char*)calloc(sizeof(char), uncompLength);
+    // logs usually compress 5-10x, start there and grow geometrically so big blocks don't copy quadratically
+    size_t uncompLength = compressedBytesSize * 4;
+    char* uncomp = (char*)malloc(uncompLength);
 
     z_stream strm;
     strm.next_in = (Bytef*)compressedBytes;
@@ -282,11 +317,7 @@ bool zlibDecompress(const char* compressedBytes, size_t compressedBytesSize, cha
         // If our output buffer is too small
         if (strm.total_out >= uncompLength) {
             // Increase size of output buffer
-            char* uncomp2 = (char*)calloc(sizeof(char), uncompLength + halfLength);
-            memcpy(uncomp2, uncomp, uncompLength);
-            uncompLength += halfLength;
-            free(uncomp);
-            uncomp = uncomp2;
+            uncomp = growBuffer(uncomp, &uncompLength);
         }
     }
 
@@ -300,79 +331,169 @@ bool zlibDecompress(const char* compressedBytes, size_t compressedBytesSize, cha
     return true;
 }
 
-int decodeBuffer(const char* buffer,
-                 size_t bufferSize,
-                 size_t offset,
-                 char** outBuffer,
-                 size_t* outBufferSize,
-                 size_t* writePos) {
-    if (offset >= bufferSize) {
-        return -1;
+typedef struct {
+    size_t offset;
+    size_t headerLen;
+    size_t cryptKeyLen;
+    uint32_t length;
+    char* note;  // diagnostics written before the block (resync, missing seq), NULL if none
+} LogBlock;
+
+typedef struct {
+    ZSTD_DCtx* zstdCtx;
+    bool hasPrivKey;
+    unsigned char svrPriKey[32];
+    bool hasTeaKey;
+    unsigned char clientPubKey[64];  // the async blocks of one process share a pubkey, so cache its ECDH result
+    uint32_t teaKey[4];
+} DecodeContext;
+
+void initDecodeContext(DecodeContext* ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->zstdCtx = ZSTD_createDCtx();
+}
+
+void freeDecodeContext(DecodeContext* ctx) {
+    ZSTD_freeDCtx(ctx->zstdCtx);
+}
+
+size_t getHeaderLen(char magic, size_t* cryptKeyLen) {
+    *cryptKeyLen = 0;
+    if (MAGIC_CRYPT_START == magic || MAGIC_COMPRESS_CRYPT_START == magic) {
+        return 1 + 4;
+    } else if (NEW_MAGIC_CRYPT_START == magic || NEW_MAGIC_COMPRESS_CRYPT_START == magic
+               || NEW_MAGIC_COMPRESS_CRYPT_START1 == magic) {
+        return 1 + 2 + 1 + 1 + 4;
+    } else {
+        *cryptKeyLen = 64;
+        return 1 + 2 + 1 + 1 + 4 + 64;
     }
+}
 
-    if (!isGoodLogBuffer(buffer, bufferSize, offset, 1)) {
-        size_t fixpos = getLogStartPos(buffer + offset, bufferSize - offset, 1);
-        if (-1 == fixpos) {
-            return -1;
-        } else {
+void appendNote(char** note, const char* text) {
+    size_t oldLen = NULL == *note ? 0 : strlen(*note);
+    char* newNote = (char*)realloc(*note, oldLen + strlen(text) + 1);
+    if (NULL == newNote) {
+        fputs("Memory error", stderr);
+        exit(2);
+    }
+    memcpy(newNote + oldLen, text, strlen(text) + 1);
+    *note = newNote;
+}
+
+// Walks the block chain sequentially. Only headers are touched here, so this is cheap compared with decoding,
+// and everything order dependent (resync and seq gap diagnostics) is resolved before blocks go to the workers.
+size_t scanLogBlocks(const char* buffer, size_t bufferSize, size_t offset, LogBlock** outBlocks) {
+    size_t capacity = 1024;
+    size_t count = 0;
+    LogBlock* blocks = (LogBlock*)malloc(capacity * sizeof(LogBlock));
+    int lastseq = 0;
+
+    while (offset < bufferSize && NULL != blocks) {
+        char* note = NULL;
+        if (!isGoodLogBuffer(buffer, bufferSize, offset, 1)) {
+            size_t fixpos = getLogStartPos(buffer + offset, bufferSize - offset, 1);
+            if (-1 == fixpos) {
+                break;
+            }
             char text[128];
             snprintf(text, sizeof(text), "[F]decode_log_file.py decode error len=%d\n", (int)fixpos);
-            appendBuffer(outBuffer, outBufferSize, writePos, text, strlen(text));
+            appendNote(&note, text);
             offset += fixpos;
         }
+
+        size_t cryptKeyLen;
+        size_t headerLen = getHeaderLen(buffer[offset], &cryptKeyLen);
+        uint32_t length;
+        memcpy(&length, &buffer[offset + headerLen - cryptKeyLen - 4], 4);
+
+        if (MAGIC_COMPRESS_CRYPT_START != buffer[offset] && MAGIC_CRYPT_START != buffer[offset]) {
+            unsigned short seq;
+            memcpy(&seq, &buffer[offset + headerLen - cryptKeyLen - 4 - 2 - 2], 2);
+            if (seq != 0 && seq != 1 && lastseq != 0 && seq != (lastseq + 1)) {
+                char text[128];
+                snprintf(text, sizeof(text), "[F]decode_log_file.py log seq:%d-%d is missing\n", lastseq + 1, seq - 1);
+                appendNote(&note, text);
+            }
+            if (seq != 0) {
+                lastseq = seq;
+            }
+        }
+
+        if (count == capacity) {
+            capacity *= 2;
+            LogBlock* newBlocks = (LogBlock*)realloc(blocks, capacity * sizeof(LogBlock));
+            if (NULL == newBlocks) {
+                free(blocks);
+                blocks = NULL;
+                break;
+            }
+            blocks = newBlocks;
+        }
+
+        LogBlock* block = &blocks[count++];
+        block->offset = offset;
+        block->headerLen = headerLen;
+        block->cryptKeyLen = cryptKeyLen;
+        block->length = length;
+        block->note = note;
+
+        offset += headerLen + length + 1;
+    }
+
+    if (NULL == blocks) {
+        fputs("Memory error", stderr);
+        exit(2);
+    }
+
+    *outBlocks = blocks;
+    return count;
+}
+
+bool getTeaKey(DecodeContext* ctx, const unsigned char* clientPubKey, uint32_t teaKey[4]) {
+    if (ctx->hasTeaKey && 0 == memcmp(ctx->clientPubKey, clientPubKey, sizeof(ctx->clientPubKey))) {
+        memcpy(teaKey, ctx->teaKey, sizeof(ctx->teaKey));
+        return true;
+    }
+
+    if (!ctx->hasPrivKey) {
+        if (!Hex2Buffer(PRIV_KEY, 64, ctx->svrPriKey)) {
+            fputs("Get PRIV KEY error", stderr);
+            exit(7);
+        }
+        ctx->hasPrivKey = true;
     }
 
-    size_t cryptKeyLen = 0;
-    size_t headerLen = 0;
-    if (MAGIC_CRYPT_START == buffer[offset] || MAGIC_COMPRESS_CRYPT_START == buffer[offset]) {
-        headerLen = 1 + 4;
-    } else if (NEW_MAGIC_CRYPT_START == buffer[offset] || NEW_MAGIC_COMPRESS_CRYPT_START == buffer[offset]
-               || NEW_MAGIC_COMPRESS_CRYPT_START1 == buffer[offset]) {
-        headerLen = 1 + 2 + 1 + 1 + 4;
-    } else if (MAGIC_ASYNC_ZLIB_START == buffer[offset] || MAGIC_SYNC_ZLIB_START == buffer[offset]
-               || MAGIC_SYNC_NO_CRYPT_ZLIB_START == buffer[offset] || MAGIC_ASYNC_NO_CRYPT_ZLIB_START == buffer[offset]
-               || MAGIC_ASYNC_ZSTD_START == buffer[offset] || MAGIC_SYNC_ZSTD_START == buffer[offset]
-               || MAGIC_SYNC_NO_CRYPT_ZSTD_START == buffer[offset]
-               || MAGIC_ASYNC_NO_CRYPT_ZSTD_START == buffer[offset]) {
-        headerLen = 1 + 2 + 1 + 1 + 4 + 64;
-        cryptKeyLen = 64;
-    } else {
-        char text[128];
-        snprintf(text, sizeof(text), "in DecodeBuffer _buffer[%zu]:%d != MAGIC_NUM_START", offset, (int)buffer[offset]);
-        appendBuffer(outBuffer, outBufferSize, writePos, text, strlen(text));
-        return -1;
+    unsigned char ecdhKey[32] = {0};
+    if (0 == uECC_shared_secret(clientPubKey, ctx->svrPriKey, ecdhKey, uECC_secp256k1())) {
+        return false;
     }
 
-    uint32_t length;
-    memcpy(&length, &buffer[offset + headerLen - cryptKeyLen - 4], 4);
+    memcpy(ctx->teaKey, ecdhKey, sizeof(ctx->teaKey));
+    memcpy(ctx->clientPubKey, clientPubKey, sizeof(ctx->clientPubKey));
+    ctx->hasTeaKey = true;
+    memcpy(teaKey, ctx->teaKey, sizeof(ctx->teaKey));
+    return true;
+}
 
-    int key;
+// Decodes one block found by scanLogBlocks into a fresh buffer. Safe to call from several threads with
+// distinct contexts.
+void decodeBlock(const char* buffer, const LogBlock* block, DecodeContext* ctx, char** outBuffer, size_t* outSize) {
+    size_t offset = block->offset;
+    size_t headerLen = block->headerLen;
+    size_t cryptKeyLen = block->cryptKeyLen;
+    uint32_t length = block->length;
 
+    int key;
     if (MAGIC_COMPRESS_CRYPT_START == buffer[offset] || MAGIC_CRYPT_START == buffer[offset]) {
         key = BASE_KEY ^ (0xff & length) ^ buffer[offset];
     } else {
         unsigned short seq;
         memcpy(&seq, &buffer[offset + headerLen - cryptKeyLen - 4 - 2 - 2], 2);
-        char beginHour;
-        memcpy(&beginHour, &buffer[offset + headerLen - cryptKeyLen - 4 - 1 - 1], 1);
-        char endHour;
-        memcpy(&endHour, &buffer[offset + headerLen - cryptKeyLen - 4 - 1], 1);
-
         key = BASE_KEY ^ (0xff & seq) ^ buffer[offset];
-
-        if (seq != 0 && seq != 1 && lastseq != 0 && seq != (lastseq + 1)) {
-            char text[128];
-            snprintf(text, sizeof(text), "[F]decode_log_file.py log seq:%d-%d is missing\n", lastseq + 1, seq - 1);
-            appendBuffer(outBuffer, outBufferSize, writePos, text, strlen(text));
-        }
-
-        if (seq != 0) {
-            lastseq = seq;
-        }
     }
 
-    char* tmpBuffer = (char*)realloc(NULL, length);
-    memset(tmpBuffer, 0, length);
+    char* tmpBuffer = (char*)malloc(length + 1);
     size_t tmpBufferSize = length;
     if (tmpBuffer == NULL) {
         fputs("Memory error", stderr);
@@ -396,28 +517,27 @@ int decodeBuffer(const char* buffer,
         tmpBufferSize = decompBufferSize;
     } else if (NEW_MAGIC_COMPRESS_CRYPT_START1 == buffer[offset]) {
         size_t readPos = 0;
-        size_t readSize = 0;
         size_t tmpBufferWritePos = 0;
+        size_t tmpBufferCapacity = length + 1;
         while (readPos < length) {
             uint16_t singleLogLen;
             memcpy(&singleLogLen, buffer + offset + headerLen + readPos, 2);
             appendBuffer(&tmpBuffer,
-                         &tmpBufferSize,
+                         &tmpBufferCapacity,
                          &tmpBufferWritePos,
                          buffer + offset + headerLen + readPos + 2,
                          singleLogLen);
-            readSize += singleLogLen;
             readPos += singleLogLen + 2;
         }
 
         size_t i;
-        for (i = 0; i < readSize; i++) {
+        for (i = 0; i < tmpBufferWritePos; i++) {
             tmpBuffer[i] = key ^ tmpBuffer[i];
         }
 
         char* decompBuffer;
         size_t decompBufferSize;
-        if (!zlibDecompress(tmpBuffer, tmpBufferSize, &decompBuffer, &decompBufferSize)) {
+        if (!zlibDecompress(tmpBuffer, tmpBufferWritePos, &decompBuffer, &decompBufferSize)) {
             fputs("Decompress error", stderr);
             exit(6);
         }
@@ -430,32 +550,18 @@ int decodeBuffer(const char* buffer,
         memcpy(tmpBuffer, buffer + offset + headerLen, length);
     } else if (MAGIC_ASYNC_ZLIB_START == buffer[offset] || MAGIC_ASYNC_ZSTD_START == buffer[offset]) {
         memcpy(tmpBuffer, buffer + offset + headerLen, length);
-        unsigned char clientPubKey[cryptKeyLen];
-        memcpy(clientPubKey, buffer + offset + headerLen - cryptKeyLen, cryptKeyLen);
-
-        unsigned char svrPriKey[32] = {0};
-        if (!Hex2Buffer(PRIV_KEY, 64, svrPriKey)) {
-            fputs("Get PRIV KEY error", stderr);
-            exit(7);
-        }
-
-        unsigned char ecdhKey[32] = {0};
-        if (0 == uECC_shared_secret(clientPubKey, svrPriKey, ecdhKey, uECC_secp256k1())) {
-            char* err = "Get ECDH key error";
 
+        uint32_t teaKey[4];
+        if (!getTeaKey(ctx, (const unsigned char*)buffer + offset + headerLen - cryptKeyLen, teaKey)) {
+            const char* err = "Get ECDH key error";
             memcpy(tmpBuffer, err, strnlen(err, 128));
-            tmpBufferSize = strnlen(err, 128);
-            appendBuffer(outBuffer, outBufferSize, writePos, tmpBuffer, tmpBufferSize);
-            free(tmpBuffer);
+            *outBuffer = tmpBuffer;
+            *outSize = strnlen(err, 128);
 
             fputs("Get ECDH key error\n", stderr);
-            //            return -1;
-            return offset + headerLen + length + 1;
-            //            exit(8);
+            return;
         }
 
-        uint32_t teaKey[4];
-        memcpy(teaKey, ecdhKey, sizeof(teaKey));
         uint32_t tmp[2] = {0};
         size_t cnt = length / TEA_BLOCK_LEN;
 
@@ -473,8 +579,8 @@ int decodeBuffer(const char* buffer,
                 fputs("Decompress error", stderr);
                 exit(6);
             }
-        } else if (MAGIC_ASYNC_ZSTD_START == buffer[offset]) {
-            if (!zstdDecompress(tmpBuffer, tmpBufferSize, &decompBuffer, &decompBufferSize)) {
+        } else {
+            if (!zstdDecompress(ctx->zstdCtx, tmpBuffer, tmpBufferSize, &decompBuffer, &decompBufferSize)) {
                 fputs("Decompress error", stderr);
                 exit(6);
             }
@@ -484,16 +590,17 @@ int decodeBuffer(const char* buffer,
         tmpBuffer = decompBuffer;
         tmpBufferSize = decompBufferSize;
     } else if (MAGIC_ASYNC_NO_CRYPT_ZLIB_START == buffer[offset] || MAGIC_ASYNC_NO_CRYPT_ZSTD_START == buffer[offset]) {
-        memcpy(tmpBuffer, buffer + offset + headerLen, length);
+        // decompress straight from the input, the block is neither masked nor encrypted
+        const char* compressed = buffer + offset + headerLen;
         char* decompBuffer;
         size_t decompBufferSize;
         if (MAGIC_ASYNC_NO_CRYPT_ZLIB_START == buffer[offset]) {
-            if (!zlibDecompress(tmpBuffer, tmpBufferSize, &decompBuffer, &decompBufferSize)) {
+            if (!zlibDecompress(compressed, length, &decompBuffer, &decompBufferSize)) {
                 fputs("Decompress error", stderr);
                 exit(6);
             }
-        } else if (MAGIC_ASYNC_NO_CRYPT_ZSTD_START == buffer[offset]) {
-            if (!zstdDecompress(tmpBuffer, tmpBufferSize, &decompBuffer, &decompBufferSize)) {
+        } else {
+            if (!zstdDecompress(ctx->zstdCtx, compressed, length, &decompBuffer, &decompBufferSize)) {
                 fputs("Decompress error", stderr);
                 exit(6);
             }
@@ -509,66 +616,193 @@ int decodeBuffer(const char* buffer,
         }
     }
 
-    appendBuffer(outBuffer, outBufferSize, writePos, tmpBuffer, tmpBufferSize);
-    free(tmpBuffer);
-
-    return offset + headerLen + length + 1;
+    *outBuffer = tmpBuffer;
+    *outSize = tmpBufferSize;
 }
 
-void parseFile(const char* path, const char* outPath) {
-    FILE* file;
-    size_t bufferSize;
-    char* buffer;
-    size_t result;
+typedef struct {
+    char* data;
+    size_t size;
+    bool done;
+} DecodedBlock;
+
+typedef struct {
+    const char* buffer;
+    const LogBlock* blocks;
+    size_t blockCount;
+    DecodedBlock* results;
+    size_t nextDecode;  // next block handed out to a worker
+    size_t nextWrite;   // next block the writer is waiting for
+    size_t window;      // max blocks decoded ahead of the writer, bounds memory
+    pthread_mutex_t mutex;
+    pthread_cond_t decodedCond;
+    pthread_cond_t writtenCond;
+} DecodeJob;
+
+void* decodeWorker(void* arg) {
+    DecodeJob* job = (DecodeJob*)arg;
+    DecodeContext ctx;
+    initDecodeContext(&ctx);
 
-    file = fopen(path, "rb");
-    if (file == NULL) {
-        fputs("File error", stderr);
-        exit(1);
+    while (1) {
+        pthread_mutex_lock(&job->mutex);
+        while (job->nextDecode < job->blockCount && job->nextDecode >= job->nextWrite + job->window) {
+            pthread_cond_wait(&job->writtenCond, &job->mutex);
+        }
+        if (job->nextDecode >= job->blockCount) {
+            pthread_mutex_unlock(&job->mutex);
+            break;
+        }
+        size_t index = job->nextDecode++;
+        pthread_mutex_unlock(&job->mutex);
+
+        char* data = NULL;
+        size_t size = 0;
+        decodeBlock(job->buffer, &job->blocks[index], &ctx, &data, &size);
+
+        pthread_mutex_lock(&job->mutex);
+        job->results[index].data = data;
+        job->results[index].size = size;
+        job->results[index].done = true;
+        pthread_cond_broadcast(&job->decodedCond);
+        pthread_mutex_unlock(&job->mutex);
     }
 
-    fseek(file, 0, SEEK_END);
-    bufferSize = (size_t)ftell(file);
-    rewind(file);
+    freeDecodeContext(&ctx);
+    return NULL;
+}
 
-    buffer = (char*)malloc(sizeof(char) * bufferSize);
-    if (buffer == NULL) {
+void writeBlock(FILE* outFile, const LogBlock* block, char* data, size_t size) {
+    if (NULL != block->note) {
+        fwrite(block->note, sizeof(char), strlen(block->note), outFile);
+    }
+    fwrite(data, sizeof(char), size, outFile);
+    free(data);
+}
+
+// Decodes blocks on `jobs` threads while the calling thread writes them out in file order.
+void decodeBlocks(const char* buffer, const LogBlock* blocks, size_t blockCount, int jobs, FILE* outFile) {
+    if (jobs <= 1 || blockCount <= 1) {
+        DecodeContext ctx;
+        initDecodeContext(&ctx);
+        size_t i;
+        for (i = 0; i < blockCount; i++) {
+            char* data = NULL;
+            size_t size = 0;
+            decodeBlock(buffer, &blocks[i], &ctx, &data, &size);
+            writeBlock(outFile, &blocks[i], data, size);
+        }
+        freeDecodeContext(&ctx);
+        return;
+    }
+
+    DecodeJob job;
+    memset(&job, 0, sizeof(job));
+    job.buffer = buffer;
+    job.blocks = blocks;
+    job.blockCount = blockCount;
+    job.results = (DecodedBlock*)calloc(blockCount, sizeof(DecodedBlock));
+    job.window = (size_t)jobs * 4;
+    if (NULL == job.results) {
         fputs("Memory error", stderr);
         exit(2);
     }
+    pthread_mutex_init(&job.mutex, NULL);
+    pthread_cond_init(&job.decodedCond, NULL);
+    pthread_cond_init(&job.writtenCond, NULL);
+
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * jobs);
+    int i;
+    for (i = 0; i < jobs; i++) {
+        if (0 != pthread_create(&threads[i], NULL, decodeWorker, &job)) {
+            fputs("Create thread error", stderr);
+            exit(9);
+        }
+    }
+
+    size_t index;
+    for (index = 0; index < blockCount; index++) {
+        pthread_mutex_lock(&job.mutex);
+        while (!job.results[index].done) {
+            pthread_cond_wait(&job.decodedCond, &job.mutex);
+        }
+        pthread_mutex_unlock(&job.mutex);
+
+        writeBlock(outFile, &blocks[index], job.results[index].data, job.results[index].size);
+
+        pthread_mutex_lock(&job.mutex);
+        job.nextWrite = index + 1;
+        pthread_cond_broadcast(&job.writtenCond);
+        pthread_mutex_unlock(&job.mutex);
+    }
 
-    result = fread(buffer, 1, bufferSize, file);
-    if (result != bufferSize) {
+    for (i = 0; i < jobs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    free(job.results);
+    pthread_cond_destroy(&job.writtenCond);
+    pthread_cond_destroy(&job.decodedCond);
+    pthread_mutex_destroy(&job.mutex);
+}
+
+void parseFile(const char* path, const char* outPath, int jobs) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fputs("File error", stderr);
+        exit(1);
+    }
+
+    struct stat fileStat;
+    if (0 != fstat(fd, &fileStat)) {
         fputs("Reading error", stderr);
         exit(3);
     }
-    fclose(file);
+    size_t bufferSize = (size_t)fileStat.st_size;
+    if (0 == bufferSize) {
+        close(fd);
+        return;
+    }
+
+    char* buffer = (char*)mmap(NULL, bufferSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == buffer) {
+        fputs("Memory error", stderr);
+        exit(2);
+    }
+    madvise(buffer, bufferSize, MADV_SEQUENTIAL);
 
     size_t startPos;
     startPos = getLogStartPos(buffer, bufferSize, 2);
     if (-1 == startPos) {
+        munmap(buffer, bufferSize);
         return;
     }
 
-    size_t outBufferSize = bufferSize * 6;
-    char* outBuffer = (char*)realloc(NULL, outBufferSize);
-    size_t writePos = 0;
-    while (1) {
-        startPos = decodeBuffer(buffer, bufferSize, startPos, &outBuffer, &outBufferSize, &writePos);
-        if (-1 == startPos) {
-            break;
-        }
-    }
+    LogBlock* blocks = NULL;
+    size_t blockCount = scanLogBlocks(buffer, bufferSize, startPos, &blocks);
 
     FILE* outFile = fopen(outPath, "wb");
-    outBuffer[writePos] = '\0';
-    fwrite(outBuffer, sizeof(char), writePos, outFile);
+    if (NULL == outFile) {
+        fputs("Open output file error", stderr);
+        exit(1);
+    }
+    setvbuf(outFile, NULL, _IOFBF, 1024 * 1024);
+
+    decodeBlocks(buffer, blocks, blockCount, jobs, outFile);
+
     fclose(outFile);
-    free(buffer);
-    free(outBuffer);
+
+    size_t i;
+    for (i = 0; i < blockCount; i++) {
+        free(blocks[i].note);
+    }
+    free(blocks);
+    munmap(buffer, bufferSize);
 }
 
-void parseDir(const char* path) {
+void parseDir(const char* path, int jobs) {
     DIR* dir;
     struct dirent* ent;
     if ((dir = opendir(path)) != NULL) {
@@ -578,8 +812,7 @@ void parseDir(const char* path) {
                 char outPath[260] = {0};
                 snprintf(inPath, sizeof(inPath), "%s/%s", path, ent->d_name);
                 snprintf(outPath, sizeof(outPath), "%s/%s.log", path, ent->d_name);
-                lastseq = 0;
-                parseFile(inPath, outPath);
+                parseFile(inPath, outPath, jobs);
             }
         }
         closedir(dir);
@@ -589,28 +822,164 @@ void parseDir(const char* path) {
     }
 }
 
+// Writes `sizeMB` of MAGIC_ASYNC_NO_CRYPT_ZLIB_START blocks, roughly what the appender produces for a busy day.
+void writeBenchmarkLog(const char* path, size_t sizeMB) {
+    FILE* file = fopen(path, "wb");
+    if (NULL == file) {
+        fputs("Open benchmark file error", stderr);
+        exit(1);
+    }
+    setvbuf(file, NULL, _IOFBF, 1024 * 1024);
+
+    const size_t plainBlockSize = 150 * 1024;
+    char* plain = (char*)malloc(plainBlockSize);
+    uLong compressBound = deflateBound(NULL, plainBlockSize) + 64;
+    unsigned char* compressed = (unsigned char*)malloc(compressBound);
+    unsigned char header[1 + 2 + 1 + 1 + 4 + 64] = {0};
+
+    size_t written = 0;
+    unsigned short seq = 1;
+    unsigned int line = 0;
+    while (written < sizeMB * 1024 * 1024) {
+        size_t plainSize = 0;
+        while (plainSize + 256 < plainBlockSize) {
+            plainSize += snprintf(plain + plainSize,
+                                  plainBlockSize - plainSize,
+                                  "[I][2016-10-19 +8.0 12:%02u:%02u.%03u][%u, %u][mars::stn][longlink.cc, __RunReadWrite, "
+                                  "%u][task(%u) recv %u bytes, cmdid:%u\n",
+                                  (line / 60000) % 60,
+                                  (line / 1000) % 60,
+                                  line % 1000,
+                                  1234 + line % 7,
+                                  5678 + line % 31,
+                                  300 + line % 900,
+                                  line,
+                                  (line * 2654435761u) % 65536,
+                                  line % 100);
+            line++;
+        }
+
+        z_stream strm;
+        memset(&strm, 0, sizeof(strm));
+        deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        strm.next_in = (Bytef*)plain;
+        strm.avail_in = plainSize;
+        strm.next_out = compressed;
+        strm.avail_out = compressBound;
+        deflate(&strm, Z_FINISH);
+        uint32_t length = (uint32_t)strm.total_out;
+        deflateEnd(&strm);
+
+        header[0] = MAGIC_ASYNC_NO_CRYPT_ZLIB_START;
+        memcpy(header + 1, &seq, 2);
+        memcpy(header + 1 + 2 + 1 + 1, &length, 4);
+        unsigned char end = MAGIC_END;
+        fwrite(header, 1, sizeof(header), file);
+        fwrite(compressed, 1, length, file);
+        fwrite(&end, 1, 1, file);
+
+        written += sizeof(header) + length + 1;
+        seq = 0xFFFF == seq ? 1 : seq + 1;
+    }
+
+    free(compressed);
+    free(plain);
+    fclose(file);
+}
+
+double nowSeconds() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Decodes a synthetic log with 1, 2, 4 ... `jobs` threads and prints the input throughput of each run.
+void runBenchmark(const char* path, size_t sizeMB, int jobs) {
+    char outPath[260] = {0};
+    snprintf(outPath, sizeof(outPath), "%s.log", path);
+
+    writeBenchmarkLog(path, sizeMB);
+    struct stat fileStat;
+    stat(path, &fileStat);
+
+    int threads = 1;
+    while (1) {
+        double begin = nowSeconds();
+        parseFile(path, outPath, threads);
+        double cost = nowSeconds() - begin;
+
+        struct stat outStat;
+        stat(outPath, &outStat);
+        printf("jobs:%d input:%.1fMB output:%.1fMB cost:%.3fs throughput:%.1fMB/s\n",
+               threads,
+               fileStat.st_size / 1048576.0,
+               outStat.st_size / 1048576.0,
+               cost,
+               fileStat.st_size / 1048576.0 / cost);
+
+        if (threads >= jobs) {
+            break;
+        }
+        threads = threads * 2 > jobs ? jobs : threads * 2;
+    }
+
+    unlink(outPath);
+    unlink(path);
+}
+
+void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [-j jobs] [file.xlog [out.log] | dir]\n"
+            "       %s -b sizeMB [-j jobs] [bench.xlog]\n",
+            name,
+            name);
+}
+
 int main(int argc, char* argv[]) {
-    if (argc == 2) {
-        char* path = argv[1];
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    size_t benchSizeMB = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:b:h")) != -1) {
+        switch (opt) {
+            case 'j':
+                jobs = atoi(optarg);
+                break;
+            case 'b':
+                benchSizeMB = (size_t)atol(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+
+    int argLeft = argc - optind;
+    if (benchSizeMB > 0) {
+        runBenchmark(argLeft >= 1 ? argv[optind] : "decode_bench.xlog", benchSizeMB, jobs);
+    } else if (argLeft == 1) {
+        char* path = argv[optind];
         struct stat path_stat;
         stat(path, &path_stat);
 
         if (S_ISREG(path_stat.st_mode)) {
             char outPath[260] = {0};
             snprintf(outPath, sizeof(outPath), "%s.log", path);
-            parseFile(path, outPath);
+            parseFile(path, outPath, jobs);
         } else if (S_ISDIR(path_stat.st_mode)) {
-            parseDir(path);
+            parseDir(path, jobs);
         } else {
             fputs("openfile failed", stderr);
             return 1;
         }
-    } else if (argc == 3) {
-        char* inPath = argv[1];
-        char* outPath = argv[2];
-        parseFile(inPath, outPath);
+    } else if (argLeft == 2) {
+        char* inPath = argv[optind];
+        char* outPath = argv[optind + 1];
+        parseFile(inPath, outPath, jobs);
     } else {
-        parseDir(".");
+        parseDir(".", jobs);
     }
     return 0;
 }
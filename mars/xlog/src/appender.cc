@@ -57,6 +57,8 @@
 #include "boost/iostreams/device/mapped_file.hpp"
 #include "mars/comm/autobuffer.h"
 #include "mars/comm/bootrun.h"
+#include "mars/comm/executor.h"
+#include "mars/comm/metrics.h"
 #include "mars/comm/mmap_util.h"
 #include "mars/comm/ptrbuffer.h"
 #include "mars/comm/strutil.h"
@@ -67,11 +69,13 @@
 #include "mars/comm/time_utils.h"
 #include "mars/comm/verinfo.h"
 #include "mars/comm/xlogger/xloggerbase.h"
+#include "xlog/crypt/log_crypt.h"
 
 #ifdef __APPLE__
 #include "mars/comm/objc/data_protect_attr.h"
 #endif
 
+#include "appender_scheduler.h"
 #include "log_base_buffer.h"
 #include "log_zlib_buffer.h"
 #include "log_zstd_buffer.h"
@@ -94,6 +98,10 @@ static const long kMinLogAliveTime = 24 * 60 * 60;  // 1 days in second
 
 static Mutex sg_mutex_dir_attr;
 
+static Counter sg_lines("xlog.lines");
+static Counter sg_bytes("xlog.bytes");
+static Histogram sg_write_ns("xlog.write_ns");
+
 void (*g_log_write_callback)(const XLoggerInfo*, const char*) = nullptr;
 
 namespace {
@@ -132,6 +140,20 @@ static void SetConvertToUseUtf8() {
 }
 #endif
 
+// Reads just the header, so an empty mmap doesn't cost more than one small read at startup.
+static bool __HasPendingMmapBlock(const char* _mmap_file_path) {
+    FILE* file = fopen(_mmap_file_path, "rb");
+    if (nullptr == file) {
+        return false;
+    }
+
+    char header[128] = {0};
+    size_t header_len = std::min<size_t>(LogCrypt::GetHeaderLen(), sizeof(header));
+    bool pending = header_len == fread(header, 1, header_len, file) && 0 != LogCrypt::GetLogLen(header, header_len);
+    fclose(file);
+    return pending;
+}
+
 XloggerAppender* XloggerAppender::NewInstance(const XLogConfig& _config, uint64_t _max_byte_size) {
     return new XloggerAppender(_config, _max_byte_size);
 }
@@ -145,7 +167,7 @@ void XloggerAppender::DelayRelease(XloggerAppender* _appender) {
         return;
     }
     _appender->Close();
-    Thread(boost::bind(&Release, _appender)).start_after(5000);
+    Executor::Default().PostDelayed(boost::bind(&Release, _appender), 5000, "xlog.release");
 }
 
 void XloggerAppender::Release(XloggerAppender*& _appender) {
@@ -155,12 +177,12 @@ void XloggerAppender::Release(XloggerAppender*& _appender) {
 }
 
 XloggerAppender::XloggerAppender(const XLogConfig& _config, uint64_t _max_byte_size)
-: thread_async_(boost::bind(&XloggerAppender::__AsyncLogThread, this)), max_file_size_(_max_byte_size) {
+: max_file_size_(_max_byte_size) {
     Open(_config);
 }
 
 XloggerAppender::XloggerAppender(const XLogConfig& _config, uint64_t _max_byte_size, bool _one_shot)
-: thread_async_(boost::bind(&XloggerAppender::__AsyncLogThread, this)), max_file_size_(_max_byte_size) {
+: max_file_size_(_max_byte_size) {
     config_ = _config;
 }
 
@@ -169,6 +191,8 @@ void XloggerAppender::Write(const XLoggerInfo* _info, const char* _log) {
         return;
 
     SCOPE_ERRNO();
+    sg_lines.Add();
+    Histogram::ScopedTimer write_timer(sg_write_ns);
 
     thread_local uint32_t recursion_count = 0;
     thread_local std::string recursion_str;
@@ -223,15 +247,14 @@ void XloggerAppender::Write(const XLoggerInfo* _info, const char* _log) {
 void XloggerAppender::SetMode(TAppenderMode _mode) {
     config_.mode_ = _mode;
 
-    cond_buffer_async_.notifyAll();
-
-    if (kAppenderAsync == config_.mode_ && !thread_async_.isruning()) {
-        thread_async_.start();
+    if (kAppenderAsync == config_.mode_) {
+        AppenderScheduler::Instance().Register(this);
     }
+    AppenderScheduler::Instance().Notify(this, 0, true);
 }
 
 void XloggerAppender::Flush() {
-    cond_buffer_async_.notifyAll();
+    AppenderScheduler::Instance().Notify(this, 0, true);
 }
 
 void XloggerAppender::FlushSync() {
@@ -254,15 +277,8 @@ void XloggerAppender::FlushSync() {
 }
 
 void XloggerAppender::Close() {
-    if (thread_timeout_cache_ && thread_timeout_cache_->isruning())
-        thread_timeout_cache_->cancel_after();
-    if (thread_moveold_ && thread_moveold_->isruning())
-        thread_moveold_->cancel_after();
-    if (thread_timeout_log_ && thread_timeout_log_->isruning())
-        thread_timeout_log_->cancel_after();
-    thread_timeout_cache_ = nullptr;
-    thread_moveold_ = nullptr;
-    thread_timeout_log_ = nullptr;
+    // drops the maintenance jobs too, and waits if the scheduler is working on this appender right now
+    bool scheduled = AppenderScheduler::Instance().Unregister(this);
 
     if (log_close_) return;
 
@@ -274,10 +290,8 @@ void XloggerAppender::Close() {
 
     log_close_ = true;
 
-    cond_buffer_async_.notifyAll();
-
-    if (thread_async_.isruning())
-        thread_async_.join();
+    if (scheduled)
+        __AsyncFlush();
 
     ScopedLock buffer_lock(mutex_buffer_async_);
     if (mmap_file_.is_open()) {
@@ -310,23 +324,24 @@ void XloggerAppender::Open(const XLogConfig& _config) {
     if (!config_.cachedir_.empty()) {
         boost::filesystem::create_directories(config_.cachedir_);
 
-        thread_timeout_cache_ =
-            std::make_unique<comm::Thread>(boost::bind(&XloggerAppender::__DelTimeoutFile, this, config_.cachedir_));
-        thread_timeout_cache_->start_after(2 * 60 * 1000);
-        thread_moveold_ = std::make_unique<comm::Thread>(boost::bind(&XloggerAppender::__MoveOldFiles,
-                                                                     this,
-                                                                     config_.cachedir_,
-                                                                     config_.logdir_,
-                                                                     config_.nameprefix_));
-        thread_moveold_->start_after(3 * 60 * 1000);
+        AppenderScheduler::Instance().Schedule(this,
+                                               boost::bind(&XloggerAppender::__DelTimeoutFile, this, config_.cachedir_),
+                                               2 * 60 * 1000);
+        AppenderScheduler::Instance().Schedule(this,
+                                               boost::bind(&XloggerAppender::__MoveOldFiles,
+                                                           this,
+                                                           config_.cachedir_,
+                                                           config_.logdir_,
+                                                           config_.nameprefix_),
+                                               3 * 60 * 1000);
 #ifdef __APPLE__
         setAttrProtectionNone(config_.cachedir_.c_str());
 #endif
     }
 
-    thread_timeout_log_ =
-        std::make_unique<comm::Thread>(boost::bind(&XloggerAppender::__DelTimeoutFile, this, config_.logdir_));
-    thread_timeout_log_->start_after(2 * 60 * 1000);
+    AppenderScheduler::Instance().Schedule(this,
+                                           boost::bind(&XloggerAppender::__DelTimeoutFile, this, config_.logdir_),
+                                           2 * 60 * 1000);
     boost::filesystem::create_directories(config_.logdir_);
 #ifdef __APPLE__
     setAttrProtectionNone(config_.logdir_.c_str());
@@ -342,26 +357,25 @@ void XloggerAppender::Open(const XLogConfig& _config) {
              "%s/%s.mmap3",
              config_.cachedir_.empty() ? config_.logdir_.c_str() : config_.cachedir_.c_str(),
              config_.nameprefix_.c_str());
+
+    // A block left by the last session is renamed aside and written out by the async thread, so Open neither
+    // copies it nor waits for the log file. A leftover from a recovery that didn't finish goes out first.
+    std::string mmap_recover_path = std::string(mmap_file_path) + ".recover";
+    bool stale_recover = boost::filesystem::exists(mmap_recover_path);
+    bool detached = false;
+    if (!stale_recover && __HasPendingMmapBlock(mmap_file_path)) {
+        boost::system::error_code ec;
+        boost::filesystem::rename(mmap_file_path, mmap_recover_path, ec);
+        detached = !ec;
+    }
+
     bool use_mmap = false;
     if (OpenMmapFile(mmap_file_path, kBufferBlockLength, mmap_file_)) {
-        if (_config.compress_mode_ == kZstd) {
-            log_buff_ = new LogZstdBuffer(mmap_file_.data(),
-                                          kBufferBlockLength,
-                                          true,
-                                          _config.pub_key_.c_str(),
-                                          _config.compress_level_);
-        } else {
-            log_buff_ = new LogZlibBuffer(mmap_file_.data(), kBufferBlockLength, true, _config.pub_key_.c_str());
-        }
+        log_buff_ = __NewLogBuffer(mmap_file_.data());
         use_mmap = true;
     } else {
         char* buffer = new char[kBufferBlockLength];
-        if (_config.compress_mode_ == kZstd) {
-            log_buff_ =
-                new LogZstdBuffer(buffer, kBufferBlockLength, true, _config.pub_key_.c_str(), _config.compress_level_);
-        } else {
-            log_buff_ = new LogZlibBuffer(buffer, kBufferBlockLength, true, _config.pub_key_.c_str());
-        }
+        log_buff_ = __NewLogBuffer(buffer);
         use_mmap = false;
     }
 
@@ -371,23 +385,30 @@ void XloggerAppender::Open(const XLogConfig& _config) {
         return;
     }
 
-    AutoBuffer buffer;
-    log_buff_->Flush(buffer);
+    if (stale_recover) {
+        __RecoverMmapFile(mmap_recover_path);
+    }
+
+    // nothing else touches log_buff_ before SetMode, so the block can be written straight from the mapping
+    if (__RecoverLogBuffer(log_buff_, "")) {
+        log_buff_->Clear();
+    }
 
     ScopedLock lock(mutex_log_file_);
     log_close_ = false;
+    if (detached && kAppenderAsync == config_.mode_) {
+        mmap_recover_path_ = mmap_recover_path;
+    }
     SetMode(config_.mode_);
     lock.unlock();
 
+    if (detached && kAppenderSync == config_.mode_) {
+        __RecoverMmapFile(mmap_recover_path);
+    }
+
     char mark_info[512] = {0};
     __GetMarkInfo(mark_info, sizeof(mark_info));
 
-    if (buffer.Ptr()) {
-        WriteTips2File("~~~~~ begin of mmap ~~~~~\n");
-        __Log2File(buffer.Ptr(), buffer.Length(), false);
-        WriteTips2File("~~~~~ end of mmap ~~~~~%s\n", mark_info);
-    }
-
     tickcountdiff_t get_mmap_time = tickcount_t().gettickcount() - tick;
 
     char appender_info[728] = {0};
@@ -918,6 +939,49 @@ void XloggerAppender::__Log2File(const void* _data, size_t _len, bool _move_file
     }
 }
 
+LogBaseBuffer* XloggerAppender::__NewLogBuffer(void* _buffer) {
+    if (config_.compress_mode_ == kZstd) {
+        return new LogZstdBuffer(_buffer, kBufferBlockLength, true, config_.pub_key_.c_str(), config_.compress_level_);
+    }
+    return new LogZlibBuffer(_buffer, kBufferBlockLength, true, config_.pub_key_.c_str());
+}
+
+bool XloggerAppender::__RecoverLogBuffer(LogBaseBuffer* _buffer, const char* _source) {
+    PtrBuffer block;
+    if (!_buffer->Seal(block)) {
+        return false;
+    }
+
+    char mark_info[512] = {0};
+    __GetMarkInfo(mark_info, sizeof(mark_info));
+
+    WriteTips2File("~~~~~ begin of mmap%s ~~~~~\n", _source);
+    __Log2File(block.Ptr(), block.Length(), false);
+    WriteTips2File("~~~~~ end of mmap%s ~~~~~%s\n", _source, mark_info);
+    return true;
+}
+
+bool XloggerAppender::__RecoverMmapFile(const std::string& _mmap_file_path) {
+    boost::system::error_code ec;
+    if (kBufferBlockLength != boost::filesystem::file_size(_mmap_file_path, ec)) {
+        boost::filesystem::remove(_mmap_file_path, ec);
+        return false;
+    }
+
+    boost::iostreams::mapped_file mmap_file;
+    if (!OpenMmapFile(_mmap_file_path.c_str(), kBufferBlockLength, mmap_file)) {
+        return false;
+    }
+
+    std::unique_ptr<LogBaseBuffer> buffer(__NewLogBuffer(mmap_file.data()));
+    bool recovered = __RecoverLogBuffer(buffer.get(), "");
+    buffer.reset();
+    CloseMmapFile(mmap_file);
+
+    boost::filesystem::remove(_mmap_file_path, ec);
+    return recovered;
+}
+
 void XloggerAppender::WriteTips2File(const char* _tips_format, ...) {
     if (nullptr == _tips_format) {
         return;
@@ -935,31 +999,30 @@ void XloggerAppender::WriteTips2File(const char* _tips_format, ...) {
     __Log2File(tmp_buff.Ptr(), tmp_buff.Length(), false);
 }
 
-void XloggerAppender::__AsyncLogThread() {
-    while (true) {
-        ScopedLock lock_buffer(mutex_buffer_async_);
-
-        if (nullptr == log_buff_)
-            break;
+void XloggerAppender::__AsyncFlush() {
+    if (!mmap_recover_path_.empty()) {
+        __RecoverMmapFile(mmap_recover_path_);
+        mmap_recover_path_.clear();
+    }
 
-        AutoBuffer tmp;
-        log_buff_->Flush(tmp);
-        lock_buffer.unlock();
+    ScopedLock lock_buffer(mutex_buffer_async_);
 
-        if (nullptr != tmp.Ptr())
-            __Log2File(tmp.Ptr(), tmp.Length(), true);
+    if (nullptr == log_buff_)
+        return;
 
-        if (log_close_)
-            break;
+    AutoBuffer tmp;
+    log_buff_->Flush(tmp);
+    lock_buffer.unlock();
 
-        cond_buffer_async_.wait(15 * 60 * 1000);
-    }
+    if (nullptr != tmp.Ptr())
+        __Log2File(tmp.Ptr(), tmp.Length(), true);
 }
 
 void XloggerAppender::__WriteSync(const XLoggerInfo* _info, const char* _log) {
     char temp[16 * 1024] = {0};  // tell perry,ray if you want modify size.
     PtrBuffer log(temp, 0, sizeof(temp));
     log_formater(_info, _log, log);
+    sg_bytes.Add((int64_t)log.Length());
 
     AutoBuffer tmp_buff;
     if (!log_buff_->Write(log.Ptr(), log.Length(), tmp_buff))
@@ -972,6 +1035,7 @@ void XloggerAppender::__WriteAsync(const XLoggerInfo* _info, const char* _log) {
     char temp[16 * 1024] = {0};  // tell perry,ray if you want modify size.
     PtrBuffer log_buff(temp, 0, sizeof(temp));
     log_formater(_info, _log, log_buff);
+    sg_bytes.Add((int64_t)log_buff.Length());
 
     ScopedLock lock(mutex_buffer_async_);
     if (nullptr == log_buff_)
@@ -988,9 +1052,9 @@ void XloggerAppender::__WriteAsync(const XLoggerInfo* _info, const char* _log) {
     if (!log_buff_->Write(log_buff.Ptr(), (unsigned int)log_buff.Length()))
         return;
 
-    if (log_buff_->GetData().Length() >= kBufferBlockLength * 1 / 3
-        || (nullptr != _info && kLevelFatal == _info->level)) {
-        cond_buffer_async_.notifyAll();
+    bool urgent = nullptr != _info && kLevelFatal == _info->level;
+    if (log_buff_->GetData().Length() >= kBufferBlockLength * 1 / 3 || urgent) {
+        AppenderScheduler::Instance().Notify(this, log_buff_->GetData().Length(), urgent);
     }
 }
 
@@ -1199,7 +1263,7 @@ void XloggerAppender::TreatMappingAsFileAndFlush(TFileIOAction* _result) {
         return;
     }
 
-    // read buffer
+    // the owning process may still be writing the file, so recover from a private copy and leave the file as it is
     FILE* treat_mapping_as_file = fopen(mmap_file_path, "rb");
     if (!treat_mapping_as_file) {
         if (_result)
@@ -1218,36 +1282,29 @@ void XloggerAppender::TreatMappingAsFileAndFlush(TFileIOAction* _result) {
     fclose(treat_mapping_as_file);
 
     // init and set flag
-    if (config_.compress_mode_ == kZstd) {
-        log_buff_ = new LogZstdBuffer(data.release(),
-                                      kBufferBlockLength,
-                                      true,
-                                      config_.pub_key_.c_str(),
-                                      config_.compress_level_);
-    } else {
-        log_buff_ = new LogZlibBuffer(data.release(), kBufferBlockLength, true, config_.pub_key_.c_str());
-    }
-	
+    log_buff_ = __NewLogBuffer(data.get());
     log_close_ = false;
 
-    // try write mapping to logfile
-    AutoBuffer buffer;
-    log_buff_->Flush(buffer);
+    // try write the copy to logfile, sealing it in place
+    bool recovered = __RecoverLogBuffer(log_buff_, " from other process");
+
+    ScopedLock buffer_lock(mutex_buffer_async_);
+    log_close_ = true;
+    delete log_buff_;
+    log_buff_ = nullptr;
+    buffer_lock.unlock();
+
+    ScopedLock file_lock(mutex_log_file_);
+    __CloseLogFile();
+    file_lock.unlock();
 
     // invalid data or empty
-    if (!buffer.Ptr() || !buffer.Length()) {
+    if (!recovered) {
         if (_result)
             *_result = kActionUnnecessary;
         return;
     }
 
-    char mark_info[512] = {0};
-    __GetMarkInfo(mark_info, sizeof(mark_info));
-
-    WriteTips2File("~~~~~ begin of mmap from other process ~~~~~\n");
-    __Log2File(buffer.Ptr(), buffer.Length(), false);
-    WriteTips2File("~~~~~ end of mmap from other process ~~~~~%s\n", mark_info);
-
     // clean mmaping
     if (!boost::filesystem::remove(mmap_file_path)) {
         if (_result)
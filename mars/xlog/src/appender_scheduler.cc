@@ -0,0 +1,170 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * appender_scheduler.cc
+ */
+
+#include "appender_scheduler.h"
+
+#include <algorithm>
+
+#include "boost/bind.hpp"
+#include "mars/comm/time_utils.h"
+#include "xlogger_appender.h"
+
+using namespace mars::comm;
+
+namespace mars {
+namespace xlog {
+
+static const uint64_t kMaxFlushInterval = 15 * 60 * 1000;
+
+AppenderScheduler& AppenderScheduler::Instance() {
+    // never destroyed, appenders may still be closed from static destructors
+    static AppenderScheduler* scheduler = new AppenderScheduler();
+    return *scheduler;
+}
+
+AppenderScheduler::AppenderScheduler() : thread_(boost::bind(&AppenderScheduler::__Run, this), "xlog_flush") {
+}
+
+void AppenderScheduler::Register(XloggerAppender* _appender) {
+    ScopedLock lock(mutex_);
+    for (auto& entry : entries_) {
+        if (entry.appender == _appender) {
+            return;
+        }
+    }
+
+    // flush once right away, like the dedicated thread used to when it started
+    Entry entry = {_appender, 0, false, true, gettickcount() + kMaxFlushInterval};
+    entries_.push_back(entry);
+
+    if (!thread_.isruning()) {
+        thread_.start();
+    }
+    cond_work_.notifyAll();
+}
+
+bool AppenderScheduler::Unregister(XloggerAppender* _appender) {
+    ScopedLock lock(mutex_);
+    jobs_.erase(std::remove_if(jobs_.begin(),
+                               jobs_.end(),
+                               [_appender](const Job& _job) {
+                                   return _job.owner == _appender;
+                               }),
+                jobs_.end());
+
+    auto it = std::find_if(entries_.begin(), entries_.end(), [_appender](const Entry& _entry) {
+        return _entry.appender == _appender;
+    });
+    bool registered = it != entries_.end();
+    if (registered) {
+        entries_.erase(it);
+    }
+
+    while (running_ == _appender) {
+        cond_idle_.wait(lock);
+    }
+    return registered;
+}
+
+void AppenderScheduler::Notify(XloggerAppender* _appender, size_t _fill_len, bool _urgent) {
+    ScopedLock lock(mutex_);
+    for (auto& entry : entries_) {
+        if (entry.appender == _appender) {
+            entry.dirty = true;
+            entry.urgent = entry.urgent || _urgent;
+            entry.fill_len = std::max(entry.fill_len, _fill_len);
+            cond_work_.notifyAll();
+            return;
+        }
+    }
+}
+
+void AppenderScheduler::Schedule(XloggerAppender* _appender, const std::function<void()>& _job, uint64_t _after_ms) {
+    ScopedLock lock(mutex_);
+    Job job = {_appender, gettickcount() + _after_ms, _job};
+    jobs_.push_back(job);
+
+    if (!thread_.isruning()) {
+        thread_.start();
+    }
+    cond_work_.notifyAll();
+}
+
+void AppenderScheduler::__Run() {
+    ScopedLock lock(mutex_);
+
+    while (true) {
+        uint64_t now = gettickcount();
+        uint64_t next_tick = now + kMaxFlushInterval;
+
+        Entry* flush = nullptr;
+        for (auto& entry : entries_) {
+            if (!entry.dirty && entry.next_flush_tick > now) {
+                next_tick = std::min(next_tick, entry.next_flush_tick);
+                continue;
+            }
+            if (nullptr == flush || entry.urgent > flush->urgent
+                || (entry.urgent == flush->urgent && entry.fill_len > flush->fill_len)) {
+                flush = &entry;
+            }
+        }
+
+        if (nullptr != flush) {
+            XloggerAppender* appender = flush->appender;
+            flush->dirty = false;
+            flush->urgent = false;
+            flush->fill_len = 0;
+            flush->next_flush_tick = now + kMaxFlushInterval;
+
+            running_ = appender;
+            lock.unlock();
+            appender->__AsyncFlush();
+            lock.lock();
+            running_ = nullptr;
+            cond_idle_.notifyAll();
+            continue;
+        }
+
+        // maintenance only runs when no buffer is waiting
+        auto job = jobs_.end();
+        for (auto it = jobs_.begin(); it != jobs_.end(); ++it) {
+            if (job == jobs_.end() || it->due_tick < job->due_tick) {
+                job = it;
+            }
+        }
+
+        if (job != jobs_.end() && job->due_tick <= now) {
+            Job run = *job;
+            jobs_.erase(job);
+
+            running_ = run.owner;
+            lock.unlock();
+            run.func();
+            lock.lock();
+            running_ = nullptr;
+            cond_idle_.notifyAll();
+            continue;
+        }
+
+        if (job != jobs_.end()) {
+            next_tick = std::min(next_tick, job->due_tick);
+        }
+        cond_work_.wait(lock, (long)(next_tick - now));
+    }
+}
+
+}  // namespace xlog
+}  // namespace mars
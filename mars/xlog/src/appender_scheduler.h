@@ -0,0 +1,82 @@
+// Tencent is pleased to support the open source community by making Mars available.
+// Copyright (C) 2016 THL A29 Limited, a Tencent company. All rights reserved.
+
+// Licensed under the MIT License (the "License"); you may not use this file except in
+// compliance with the License. You may obtain a copy of the License at
+// http://opensource.org/licenses/MIT
+
+// Unless required by applicable law or agreed to in writing, software distributed under the License is
+// distributed on an "AS IS" basis, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+// either express or implied. See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * appender_scheduler.h
+ *
+ * One flush thread for every XloggerAppender of the process. Dirty buffers are serviced by priority
+ * (urgent first, then fullest), and file maintenance runs on the same thread as delayed jobs.
+ */
+
+#ifndef XLOG_APPENDER_SCHEDULER_H_
+#define XLOG_APPENDER_SCHEDULER_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "mars/comm/thread/condition.h"
+#include "mars/comm/thread/lock.h"
+#include "mars/comm/thread/thread.h"
+
+namespace mars {
+namespace xlog {
+
+class XloggerAppender;
+
+class AppenderScheduler {
+ public:
+    static AppenderScheduler& Instance();
+
+    void Register(XloggerAppender* _appender);
+    // Drops the appender and its pending jobs, and waits out a flush or job of it that is running right now.
+    // Returns false if it wasn't registered.
+    bool Unregister(XloggerAppender* _appender);
+    void Notify(XloggerAppender* _appender, size_t _fill_len, bool _urgent);
+    void Schedule(XloggerAppender* _appender, const std::function<void()>& _job, uint64_t _after_ms);
+
+ private:
+    AppenderScheduler();
+    AppenderScheduler(const AppenderScheduler&);
+    AppenderScheduler& operator=(const AppenderScheduler&);
+
+    void __Run();
+
+ private:
+    struct Entry {
+        XloggerAppender* appender;
+        size_t fill_len;
+        bool urgent;
+        bool dirty;
+        uint64_t next_flush_tick;
+    };
+
+    struct Job {
+        XloggerAppender* owner;
+        uint64_t due_tick;
+        std::function<void()> func;
+    };
+
+    comm::Mutex mutex_;
+    comm::Condition cond_work_;
+    comm::Condition cond_idle_;
+    std::vector<Entry> entries_;
+    std::vector<Job> jobs_;
+    XloggerAppender* running_ = nullptr;
+    comm::Thread thread_;
+};
+
+}  // namespace xlog
+}  // namespace mars
+
+#endif /* XLOG_APPENDER_SCHEDULER_H_ */
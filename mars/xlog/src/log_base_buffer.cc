@@ -268,6 +268,20 @@ void LogBaseBuffer::Flush(AutoBuffer& _buff) {
     __Clear();
 }
 
+bool LogBaseBuffer::Seal(PtrBuffer& _block) {
+    if (log_crypt_->GetLogLen((char*)buff_.Ptr(), buff_.Length()) == 0) {
+        return false;
+    }
+
+    __Flush();
+    _block.Attach(buff_.Ptr(), buff_.Length());
+    return true;
+}
+
+void LogBaseBuffer::Clear() {
+    __Clear();
+}
+
 bool LogBaseBuffer::Write(const void* _data, size_t _inputlen, AutoBuffer& _out_buff) {
     if (NULL == _data || 0 == _inputlen) {
         return false;
@@ -57,6 +57,10 @@ class LogBaseBuffer {
     PtrBuffer& GetData();
     virtual size_t Compress(const void* src, size_t inLen, void* dst, size_t outLen) = 0;
     virtual void Flush(AutoBuffer& _buff);
+    // Closes the pending block in place and points _block at it instead of copying it out. Only for a block
+    // recovered from a previous session, whose compressor state is already gone. Call Clear() once it's written.
+    bool Seal(PtrBuffer& _block);
+    void Clear();
     bool Write(const void* _data, size_t _length);
     bool Write(const void* _data, size_t _inputlen, AutoBuffer& _out_buff);
 
@@ -9,6 +9,8 @@ namespace xlog {
 
 class LogBaseBuffer;
 class XloggerAppender {
+    friend class AppenderScheduler;
+
  public:
     static XloggerAppender* NewInstance(const XLogConfig& _config, uint64_t _max_byte_size);
     static XloggerAppender* NewInstance(const XLogConfig& _config, uint64_t _max_byte_size, bool _one_shot);
@@ -64,18 +66,20 @@ class XloggerAppender {
     void __CloseLogFile();
     bool __CacheLogs();
     void __Log2File(const void* _data, size_t _len, bool _move_file);
-    void __AsyncLogThread();
+    void __AsyncFlush();
     void __WriteSync(const XLoggerInfo* _info, const char* _log);
     void __WriteAsync(const XLoggerInfo* _info, const char* _log);
     void __DelTimeoutFile(const std::string& _log_path);
     bool __AppendFile(const std::string& _src_file, const std::string& _dst_file);
     void __MoveOldFiles(const std::string& _src_path, const std::string& _dest_path, const std::string& _nameprefix);
+    LogBaseBuffer* __NewLogBuffer(void* _buffer);
+    bool __RecoverLogBuffer(LogBaseBuffer* _buffer, const char* _source);
+    bool __RecoverMmapFile(const std::string& _mmap_file_path);
 
  private:
     XLogConfig config_;
     LogBaseBuffer* log_buff_ = nullptr;
     boost::iostreams::mapped_file mmap_file_;
-    comm::Thread thread_async_;
     comm::Mutex mutex_buffer_async_;
     comm::Mutex mutex_log_file_;
     FILE* logfile_ = nullptr;
@@ -86,7 +90,6 @@ class XloggerAppender {
     bool consolelog_open_ = false;
 #endif
     bool log_close_ = true;
-    comm::Condition cond_buffer_async_;
     uint64_t max_file_size_ = 0;               // 0, will not split log file.
     long max_alive_time_ = 10 * 24 * 60 * 60;  // 10 days in second
 
@@ -94,9 +97,7 @@ class XloggerAppender {
     uint64_t last_tick_ = 0;
     char last_file_path_[1024] = {0};
 
-    std::unique_ptr<comm::Thread> thread_timeout_cache_;
-    std::unique_ptr<comm::Thread> thread_moveold_;
-    std::unique_ptr<comm::Thread> thread_timeout_log_;
+    std::string mmap_recover_path_;  // block left by the last session, written out on the first async flush
 };
 
 }  // namespace xlog